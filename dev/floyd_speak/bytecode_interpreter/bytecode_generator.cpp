@@ -1230,6 +1230,9 @@ static expression_gen_t bcgen_corecall_expression(bcgenerator_t& gen_acc, const
 	else if(details.call_name == get_opcode(make_supermap_signature())){
 		return bcgen_make_fallthrough_corecall(gen_acc, target_reg, call_output_type, details, body);
 	}
+	else if(details.call_name == get_opcode(make_sort_signature())){
+		return bcgen_make_fallthrough_corecall(gen_acc, target_reg, call_output_type, details, body);
+	}
 
 
 	else if(details.call_name == get_opcode(make_print_signature())){
@@ -1238,6 +1241,18 @@ static expression_gen_t bcgen_corecall_expression(bcgenerator_t& gen_acc, const
 	else if(details.call_name == get_opcode(make_send_signature())){
 		return bcgen_make_fallthrough_corecall(gen_acc, target_reg, call_output_type, details, body);
 	}
+	else if(details.call_name == get_opcode(make_get_process_handle_signature())){
+		return bcgen_make_fallthrough_corecall(gen_acc, target_reg, call_output_type, details, body);
+	}
+	else if(details.call_name == get_opcode(make_send_to_handle_signature())){
+		return bcgen_make_fallthrough_corecall(gen_acc, target_reg, call_output_type, details, body);
+	}
+	else if(details.call_name == get_opcode(make_post_at_time_signature())){
+		return bcgen_make_fallthrough_corecall(gen_acc, target_reg, call_output_type, details, body);
+	}
+	else if(details.call_name == get_opcode(make_post_after_signature())){
+		return bcgen_make_fallthrough_corecall(gen_acc, target_reg, call_output_type, details, body);
+	}
 
 
 	else{
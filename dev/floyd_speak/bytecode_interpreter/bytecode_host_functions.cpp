@@ -28,6 +28,12 @@
 
 #include "floyd_runtime.h"
 #include "floyd_filelib.h"
+#include "floyd_sort.h"
+#include "floyd_simd.h"
+#include "floyd_scheduler.h"
+
+#include "immer/vector_transient.hpp"
+#include "immer/algorithm.hpp"
 
 
 namespace floyd {
@@ -165,6 +171,26 @@ bc_value_t host__update(interpreter_t& vm, const bc_value_t args[], int arg_coun
 }
 */
 
+//	immer stores the elements in chunks of contiguous memory. Run the find-kernel on each chunk, stop at first hit.
+template <typename T, typename F>
+static int64_t find_in_inplace_chunks(const immer::vector<bc_inplace_value_t>& vec, F kernel){
+	static_assert(sizeof(bc_inplace_value_t) == sizeof(T), "");
+
+	int64_t offset = 0;
+	int64_t result = -1;
+	immer::for_each_chunk_p(vec, [&](const bc_inplace_value_t* first, const bc_inplace_value_t* last){
+		const auto count = static_cast<size_t>(last - first);
+		const auto r = kernel(reinterpret_cast<const T*>(first), count);
+		if(r != -1){
+			result = offset + r;
+			return false;
+		}
+		offset += count;
+		return true;
+	});
+	return result;
+}
+
 bc_value_t host__find(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(arg_count == 2);
@@ -173,12 +199,11 @@ bc_value_t host__find(interpreter_t& vm, const bc_value_t args[], int arg_count)
 	const auto wanted = args[1];
 
 	if(obj._type.is_string()){
-		const auto str = obj.get_string_value();
-		const auto wanted2 = wanted.get_string_value();
+		const auto& str = obj._pod._external->_string;
+		const auto& wanted2 = wanted._pod._external->_string;
 
-		const auto r = str.find(wanted2);
-		int result = r == std::string::npos ? -1 : static_cast<int>(r);
-		return bc_value_t::make_int(result);
+		const auto r = simd_find_substring(str.data(), str.size(), wanted2.data(), wanted2.size());
+		return bc_value_t::make_int(r);
 	}
 	else if(obj._type.is_vector()){
 		const auto element_type = obj._type.get_vector_element_type();
@@ -196,22 +221,14 @@ bc_value_t host__find(interpreter_t& vm, const bc_value_t args[], int arg_count)
 		}
 		else if(obj._type.get_vector_element_type().is_int()){
 			const auto& vec = obj._pod._external->_vector_w_inplace_elements;
-			int index = 0;
-			const auto size = vec.size();
-			while(index < size && vec[index]._int64 != wanted._pod._inplace._int64){
-				index++;
-			}
-			int result = index == size ? -1 : static_cast<int>(index);
+			const auto w = wanted._pod._inplace._int64;
+			const auto result = find_in_inplace_chunks<int64_t>(vec, [&](const int64_t* p, size_t count){ return simd_find_int64(p, count, w); });
 			return bc_value_t::make_int(result);
 		}
 		else if(obj._type.get_vector_element_type().is_double()){
 			const auto& vec = obj._pod._external->_vector_w_inplace_elements;
-			int index = 0;
-			const auto size = vec.size();
-			while(index < size && vec[index]._double != wanted._pod._inplace._double){
-				index++;
-			}
-			int result = index == size ? -1 : static_cast<int>(index);
+			const auto w = wanted._pod._inplace._double;
+			const auto result = find_in_inplace_chunks<double>(vec, [&](const double* p, size_t count){ return simd_find_double(p, count, w); });
 			return bc_value_t::make_int(result);
 		}
 		else{
@@ -674,21 +691,55 @@ bc_value_t host__map_string(interpreter_t& vm, const bc_value_t args[], int arg_
 
 
 //	R map([E] elements, R init, R f(R acc, E e))
+//	Runs a reduce-kernel over the vector's chunks, in order.
+static bc_value_t reduce_inplace_elements(const immer::vector<bc_inplace_value_t>& vec, const bc_value_t& init, reduce_kernel kernel){
+	if(init._type.is_int()){
+		auto acc = init._pod._inplace._int64;
+		immer::for_each_chunk(vec, [&](const bc_inplace_value_t* first, const bc_inplace_value_t* last){
+			acc = simd_reduce_int64(kernel, reinterpret_cast<const int64_t*>(first), static_cast<size_t>(last - first), acc);
+		});
+		return bc_value_t::make_int(acc);
+	}
+	else if(init._type.is_double()){
+		auto acc = init._pod._inplace._double;
+		immer::for_each_chunk(vec, [&](const bc_inplace_value_t* first, const bc_inplace_value_t* last){
+			acc = simd_reduce_double(kernel, reinterpret_cast<const double*>(first), static_cast<size_t>(last - first), acc);
+		});
+		return bc_value_t::make_double(acc);
+	}
+	else{
+		UNSUPPORTED();
+	}
+}
+
 bc_value_t host__reduce(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
-	QUARK_ASSERT(arg_count == 3);
+	QUARK_ASSERT(arg_count == 4);
 
 	//	Check topology.
 	QUARK_ASSERT(args[0]._type.is_vector());
 	QUARK_ASSERT(args[2]._type.is_function());
 	QUARK_ASSERT(args[2]._type.get_function_args().size () == 2);
+	QUARK_ASSERT(args[3]._type.is_int());
 
 	const auto& elements = args[0];
 	const auto& init = args[1];
 	const auto& f = args[2];
+	const auto kernel = static_cast<reduce_kernel>(args[3].get_int_value());
 
 	QUARK_ASSERT(elements._type.get_vector_element_type() == f._type.get_function_args()[1] && init._type == f._type.get_function_args()[0]);
 
+	if(kernel == reduce_kernel::k_count){
+		const auto count = encode_as_vector_w_inplace_elements(elements._type)
+			? elements._pod._external->_vector_w_inplace_elements.size()
+			: get_vector_external_elements(elements)->size();
+		return bc_value_t::make_int(init.get_int_value() + static_cast<int64_t>(count));
+	}
+	else if(kernel != reduce_kernel::k_none){
+		QUARK_ASSERT(encode_as_vector_w_inplace_elements(elements._type));
+		return reduce_inplace_elements(elements._pod._external->_vector_w_inplace_elements, init, kernel);
+	}
+
 	const auto input_vec = get_vector(elements);
 
 	bc_value_t acc = init;
@@ -759,6 +810,124 @@ bc_value_t host__filter(interpreter_t& vm, const bc_value_t args[], int arg_coun
 
 
 
+/////////////////////////////////////////		PURE -- sort()
+
+
+static immer::vector<bc_inplace_value_t> sort_inplace_elements(const immer::vector<bc_inplace_value_t>& vec, const typeid_t& e_type){
+	const auto count = vec.size();
+	auto result = immer::vector<bc_inplace_value_t>().transient();
+
+	if(e_type.is_int()){
+		std::vector<int64_t> temp(count);
+		for(size_t i = 0 ; i < count ; i++){
+			temp[i] = vec[i]._int64;
+		}
+		if(count > 0){
+			parallel_sort(&temp[0], count, [](int64_t* p, size_t n){ radix_sort_int64(p, n); }, std::less<int64_t>());
+		}
+		for(const auto& e: temp){
+			bc_inplace_value_t v;
+			v._int64 = e;
+			result.push_back(v);
+		}
+	}
+	else if(e_type.is_double()){
+		std::vector<double> temp(count);
+		for(size_t i = 0 ; i < count ; i++){
+			temp[i] = vec[i]._double;
+		}
+		if(count > 0){
+			parallel_sort(&temp[0], count, [](double* p, size_t n){ radix_sort_double(p, n); }, [](double a, double b){ return double_to_key(a) < double_to_key(b); });
+		}
+		for(const auto& e: temp){
+			bc_inplace_value_t v;
+			v._double = e;
+			result.push_back(v);
+		}
+	}
+	else if(e_type.is_bool()){
+		size_t false_count = 0;
+		for(const auto& e: vec){
+			false_count += e._bool ? 0 : 1;
+		}
+		for(size_t i = 0 ; i < count ; i++){
+			bc_inplace_value_t v;
+			v._bool = i >= false_count;
+			result.push_back(v);
+		}
+	}
+	else{
+		QUARK_ASSERT(false);
+		throw std::exception();
+	}
+	return result.persistent();
+}
+
+//	[E] sort([E])
+//	[E] sort([E], bool less(E a, E b))
+//	Arg 2 is a bool placeholder when no comparator was given.
+//	The comparator path is always serial: the interpreter cannot run Floyd functions on several threads.
+bc_value_t host__sort(interpreter_t& vm, const bc_value_t args[], int arg_count){
+	QUARK_ASSERT(vm.check_invariant());
+	QUARK_ASSERT(arg_count == 2);
+
+	//	Check topology.
+	QUARK_ASSERT(args[0]._type.is_vector());
+
+	const auto& elements = args[0];
+	const auto& e_type = elements._type.get_vector_element_type();
+
+	if(args[1]._type.is_function()){
+		const auto& f = args[1];
+		QUARK_ASSERT(f._type.get_function_args().size() == 2);
+		QUARK_ASSERT(f._type.get_function_args()[0] == e_type && f._type.get_function_args()[1] == e_type);
+
+		const auto input_vec = get_vector(elements);
+		const std::vector<bc_value_t> flat(input_vec.begin(), input_vec.end());
+		const auto indexes = make_sorted_indexes(
+			flat.size(),
+			false,
+			[&](uint32_t a, uint32_t b){
+				const bc_value_t f_args[2] = { flat[a], flat[b] };
+				const auto result1 = call_function_bc(vm, f, f_args, 2);
+				QUARK_ASSERT(result1._type.is_bool());
+				return result1.get_bool_value();
+			}
+		);
+
+		auto vec2 = immer::vector<bc_value_t>().transient();
+		for(const auto index: indexes){
+			vec2.push_back(flat[index]);
+		}
+		return make_vector(e_type, vec2.persistent());
+	}
+	else{
+		QUARK_ASSERT(args[1]._type.is_bool());
+
+		if(encode_as_vector_w_inplace_elements(elements._type)){
+			const auto& vec = *get_vector_inplace_elements(elements);
+			return make_vector(e_type, sort_inplace_elements(vec, e_type));
+		}
+		else{
+			const auto& vec = *get_vector_external_elements(elements);
+			const std::vector<bc_external_handle_t> flat(vec.begin(), vec.end());
+
+			const auto indexes = e_type.is_string()
+				? make_sorted_indexes(flat.size(), true, [&](uint32_t a, uint32_t b){ return flat[a]._external->_string < flat[b]._external->_string; })
+				: make_sorted_indexes(flat.size(), true, [&](uint32_t a, uint32_t b){ return bc_compare_value_exts(flat[a], flat[b], e_type) < 0; });
+
+			auto vec2 = immer::vector<bc_external_handle_t>().transient();
+			for(const auto index: indexes){
+				vec2.push_back(flat[index]);
+			}
+			return make_vector(e_type, vec2.persistent());
+		}
+	}
+}
+
+
+
+
 /////////////////////////////////////////		PURE -- SUPERMAP()
 
 
@@ -1009,20 +1178,69 @@ bc_value_t host__print(interpreter_t& vm, const bc_value_t args[], int arg_count
 
 	return bc_value_t::make_undefined();
 }
+//	JSON messages are passed as json_t. "stop" is the stop message even when sent as a plain string.
+//	All other values are passed as a reference to the bc_value_t, without copying its contents.
+static process_message_t make_process_message(const bc_value_t& message){
+	if(message._type.is_json_value()){
+		return process_message_t(message.get_json_value());
+	}
+	else if(message._type.is_string() && message.get_string_value() == "stop"){
+		return process_message_t(json_t("stop"));
+	}
+	else{
+		return process_message_t(std::shared_ptr<const void>(std::make_shared<bc_value_t>(message)));
+	}
+}
+
 bc_value_t host__send(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(arg_count == 2);
 	QUARK_ASSERT(args[0]._type.is_string());
-	QUARK_ASSERT(args[1]._type.is_json_value());
 
 	const auto& process_id = args[0].get_string_value();
-	const auto& message_json = args[1].get_json_value();
+	vm._handler->on_send(process_id, make_process_message(args[1]));
+	return bc_value_t::make_undefined();
+}
+
+bc_value_t host__get_process_handle(interpreter_t& vm, const bc_value_t args[], int arg_count){
+	QUARK_ASSERT(vm.check_invariant());
+	QUARK_ASSERT(arg_count == 1);
+	QUARK_ASSERT(args[0]._type.is_string());
+
+	const auto& process_id = args[0].get_string_value();
+	return bc_value_t::make_int(vm._handler != nullptr ? vm._handler->get_process_handle(process_id) : -1);
+}
+
+bc_value_t host__send_to_handle(interpreter_t& vm, const bc_value_t args[], int arg_count){
+	QUARK_ASSERT(vm.check_invariant());
+	QUARK_ASSERT(arg_count == 2);
+	QUARK_ASSERT(args[0]._type.is_int());
+
+	vm._handler->on_send_to_handle(args[0].get_int_value(), make_process_message(args[1]));
+	return bc_value_t::make_undefined();
+}
 
-	QUARK_TRACE_SS("send(\"" << process_id << "\"," << json_to_pretty_string(message_json) <<")");
+bc_value_t host__post_at_time(interpreter_t& vm, const bc_value_t args[], int arg_count){
+	QUARK_ASSERT(vm.check_invariant());
+	QUARK_ASSERT(arg_count == 3);
+	QUARK_ASSERT(args[0]._type.is_string());
+	QUARK_ASSERT(args[1]._type.is_int());
 
+	const auto& process_id = args[0].get_string_value();
+	const auto time = get_post_time(vm._imm->_start_time, args[1].get_int_value());
+	vm._handler->on_post(process_id, make_process_message(args[2]), time);
+	return bc_value_t::make_undefined();
+}
 
-	vm._handler->on_send(process_id, message_json);
+bc_value_t host__post_after(interpreter_t& vm, const bc_value_t args[], int arg_count){
+	QUARK_ASSERT(vm.check_invariant());
+	QUARK_ASSERT(arg_count == 3);
+	QUARK_ASSERT(args[0]._type.is_string());
+	QUARK_ASSERT(args[1]._type.is_int());
 
+	const auto& process_id = args[0].get_string_value();
+	const auto time = std::chrono::steady_clock::now() + std::chrono::milliseconds(args[1].get_int_value());
+	vm._handler->on_post(process_id, make_process_message(args[2]), time);
 	return bc_value_t::make_undefined();
 }
 
@@ -1106,30 +1324,6 @@ bc_value_t host__write_text_file(interpreter_t& vm, const bc_value_t args[], int
 
 
 
-std::vector<value_t> directory_entries_to_values(const std::vector<TDirEntry>& v){
-	const auto k_fsentry_t__type = make__fsentry_t__type();
-	const auto elements = mapf<value_t>(
-		v,
-		[&k_fsentry_t__type](const auto& e){
-//			const auto t = value_t::make_string(e.fName);
-			const auto type_string = e.fType == TDirEntry::kFile ? "file": "dir";
-			const auto t2 = value_t::make_struct_value(
-				k_fsentry_t__type,
-				{
-					value_t::make_string(type_string),
-					value_t::make_string(e.fNameOnly),
-					value_t::make_string(e.fParent)
-				}
-			);
-			return t2;
-		}
-	);
-	return elements;
-}
-
-
-
-
 bc_value_t host__get_fsentries_shallow(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(arg_count == 1);
@@ -1181,58 +1375,6 @@ bc_value_t host__get_fsentries_deep(interpreter_t& vm, const bc_value_t args[],
 }
 
 
-//??? implement
-std::string posix_timespec__to__utc(const time_t& t){
-	return std::to_string(t);
-}
-
-
-value_t impl__get_fsentry_info(const std::string& path){
-	if(is_valid_absolute_dir_path(path) == false){
-		quark::throw_runtime_error("get_fsentry_info() illegal input path.");
-	}
-
-	TFileInfo info;
-	bool ok = GetFileInfo(path, info);
-	QUARK_ASSERT(ok);
-	if(ok == false){
-		quark::throw_exception();
-	}
-
-	const auto parts = SplitPath(path);
-	const auto parent = UpDir2(path);
-
-	const auto type_string = info.fDirFlag ? "dir" : "string";
-	const auto name = info.fDirFlag ? parent.second : parts.fName;
-	const auto parent_path = info.fDirFlag ? parent.first : parts.fPath;
-
-	const auto creation_date = posix_timespec__to__utc(info.fCreationDate);
-	const auto modification_date = posix_timespec__to__utc(info.fModificationDate);
-	const auto file_size = info.fFileSize;
-
-	const auto result = value_t::make_struct_value(
-		make__fsentry_info_t__type(),
-		{
-			value_t::make_string(type_string),
-			value_t::make_string(name),
-			value_t::make_string(parent_path),
-
-			value_t::make_string(creation_date),
-			value_t::make_string(modification_date),
-
-			value_t::make_int(file_size)
-		}
-	);
-
-#if 1
-	const auto debug = value_and_type_to_ast_json(result);
-	QUARK_TRACE(json_to_pretty_string(debug));
-#endif
-
-	return result;
-}
-
-
 bc_value_t host__get_fsentry_info(interpreter_t& vm, const bc_value_t args[], int arg_count){
 	QUARK_ASSERT(vm.check_invariant());
 	QUARK_ASSERT(arg_count == 1);
@@ -1394,9 +1536,14 @@ static std::map<function_id_t, BC_HOST_FUNCTION_PTR> bc_get_corecalls_internal()
 	result.find(make_filter_signature()._function_id)->second = host__filter;
 	result.find(make_reduce_signature()._function_id)->second = host__reduce;
 	result.find(make_supermap_signature()._function_id)->second = host__supermap;
+	result.find(make_sort_signature()._function_id)->second = host__sort;
 
 	result.find(make_print_signature()._function_id)->second = host__print;
 	result.find(make_send_signature()._function_id)->second = host__send;
+	result.find(make_get_process_handle_signature()._function_id)->second = host__get_process_handle;
+	result.find(make_send_to_handle_signature()._function_id)->second = host__send_to_handle;
+	result.find(make_post_at_time_signature()._function_id)->second = host__post_at_time;
+	result.find(make_post_after_signature()._function_id)->second = host__post_after;
 	return result;
 }
 
@@ -22,8 +22,8 @@ namespace floyd {
 void release_pod_external(bc_pod_value_t& value){
 	QUARK_ASSERT(value._external != nullptr);
 
-	value._external->_rc--;
-	if(value._external->_rc == 0){
+	//	Decrement and test in one step: another thread may release the same value at the same time.
+	if(--value._external->_rc == 0){
 		delete value._external;
 		value._external = nullptr;
 	}
@@ -407,8 +407,7 @@ bc_external_handle_t& bc_external_handle_t::operator=(const bc_external_handle_t
 bc_external_handle_t::~bc_external_handle_t(){
 	QUARK_ASSERT(check_invariant());
 
-	_external->_rc--;
-	if(_external->_rc == 0){
+	if(--_external->_rc == 0){
 		delete _external;
 		_external = nullptr;
 	}
@@ -1265,7 +1264,7 @@ int bc_compare_struct_true_deep(const std::vector<bc_value_t>& left, const std::
 int bc_compare_vectors_obj(const immer::vector<bc_external_handle_t>& left, const immer::vector<bc_external_handle_t>& right, const typeid_t& type){
 	QUARK_ASSERT(type.is_vector());
 
-	const auto& shared_count = std::min(left.size(), right.size());
+	const auto shared_count = std::min(left.size(), right.size());
 	const auto& element_type = typeid_t(type.get_vector_element_type());
 	for(int i = 0 ; i < shared_count ; i++){
 		const auto element_result = bc_compare_value_true_deep(bc_value_t(element_type, left[i]), bc_value_t(element_type, right[i]), element_type);
@@ -1322,7 +1321,7 @@ int compare_doubles(const bc_inplace_value_t& left, const bc_inplace_value_t& ri
 }
 
 int bc_compare_vectors_bool(const immer::vector<bc_inplace_value_t>& left, const immer::vector<bc_inplace_value_t>& right){
-	const auto& shared_count = std::min(left.size(), right.size());
+	const auto shared_count = std::min(left.size(), right.size());
 	for(int i = 0 ; i < shared_count ; i++){
 		int result = compare_bools(left[i], right[i]);
 		if(result != 0){
@@ -1340,7 +1339,7 @@ int bc_compare_vectors_bool(const immer::vector<bc_inplace_value_t>& left, const
 	}
 }
 int bc_compare_vectors_int(const immer::vector<bc_inplace_value_t>& left, const immer::vector<bc_inplace_value_t>& right){
-	const auto& shared_count = std::min(left.size(), right.size());
+	const auto shared_count = std::min(left.size(), right.size());
 	for(int i = 0 ; i < shared_count ; i++){
 		int result = compare_ints(left[i], right[i]);
 		if(result != 0){
@@ -1358,7 +1357,7 @@ int bc_compare_vectors_int(const immer::vector<bc_inplace_value_t>& left, const
 	}
 }
 int bc_compare_vectors_double(const immer::vector<bc_inplace_value_t>& left, const immer::vector<bc_inplace_value_t>& right){
-	const auto& shared_count = std::min(left.size(), right.size());
+	const auto shared_count = std::min(left.size(), right.size());
 	for(int i = 0 ; i < shared_count ; i++){
 		int result = compare_doubles(left[i], right[i]);
 		if(result != 0){
@@ -2255,22 +2254,25 @@ json_t bcvalue_and_type_to_json(const bc_value_t& v){
 
 
 
-interpreter_t::interpreter_t(const bc_program_t& program, runtime_handler_i* handler) :
-	_stack(nullptr),
-	_handler(handler)
-{
+std::shared_ptr<interpreter_imm_t> make_interpreter_imm(const bc_program_t& program){
 	QUARK_ASSERT(program.check_invariant());
 
 	const auto start_time = std::chrono::high_resolution_clock::now();
 
-
 	const auto corecalls = bc_get_corecalls();
 	const auto filelib_calls = bc_get_filelib_calls();
 	auto host_functions = corecalls;
 	host_functions.insert(filelib_calls.begin(), filelib_calls.end());
 
+	return std::make_shared<interpreter_imm_t>(interpreter_imm_t{start_time, program, host_functions });
+}
 
-	_imm = std::make_shared<interpreter_imm_t>(interpreter_imm_t{start_time, program, host_functions });
+interpreter_t::interpreter_t(const std::shared_ptr<interpreter_imm_t>& imm, runtime_handler_i* handler) :
+	_imm(imm),
+	_handler(handler),
+	_stack(nullptr)
+{
+	QUARK_ASSERT(imm != nullptr);
 
 	interpreter_stack_t temp(&_imm->_program._globals);
 	temp.swap(_stack);
@@ -2281,6 +2283,26 @@ interpreter_t::interpreter_t(const bc_program_t& program, runtime_handler_i* han
 	/*const auto& r =*/ execute_instructions(*this, _imm->_program._globals._instructions);
 	QUARK_ASSERT(check_invariant());
 }
+
+interpreter_t::interpreter_t(const interpreter_t& globals, runtime_handler_i* handler) :
+	_imm(globals._imm),
+	_handler(handler),
+	_stack(nullptr)
+{
+	QUARK_ASSERT(globals.check_invariant());
+
+	interpreter_stack_t temp(&_imm->_program._globals);
+	temp.swap(_stack);
+	_stack.save_frame();
+	_stack.open_frame(_imm->_program._globals, 0);
+	_stack.copy_globals(globals._stack);
+	QUARK_ASSERT(check_invariant());
+}
+
+interpreter_t::interpreter_t(const bc_program_t& program, runtime_handler_i* handler) :
+	interpreter_t(make_interpreter_imm(program), handler)
+{
+}
 interpreter_t::interpreter_t(const bc_program_t& program) : interpreter_t(program, nullptr) {}
 
 void interpreter_t::swap(interpreter_t& other) throw(){
@@ -943,6 +943,32 @@ struct interpreter_stack_t {
 	}
 
 
+	//	Copies the values of all global variables from other, which must have the same global frame. Only increments
+	//	RCs, values are immutable and can be shared.
+	public: void copy_globals(const interpreter_stack_t& other){
+		QUARK_ASSERT(check_invariant());
+		QUARK_ASSERT(other.check_invariant());
+		QUARK_ASSERT(_global_frame == other._global_frame);
+		QUARK_ASSERT(_stack_size >= k_frame_overhead + _global_frame->_locals_exts.size());
+
+		const auto& exts = _global_frame->_locals_exts;
+		for(int i = 0 ; i < exts.size() ; i++){
+			const auto pos = k_frame_overhead + i;
+			if(exts[i]){
+				auto prev_copy = _entries[pos];
+				other._entries[pos]._external->_rc++;
+				_entries[pos] = other._entries[pos];
+				release_pod_external(prev_copy);
+			}
+			else{
+				_entries[pos] = other._entries[pos];
+			}
+		}
+
+		QUARK_ASSERT(check_invariant());
+	}
+
+
 	//////////////////////////////////////		FRAMES & REGISTERS
 
 
@@ -1343,6 +1369,10 @@ struct interpreter_imm_t {
 	public: const std::map<function_id_t, BC_HOST_FUNCTION_PTR> _host_functions;
 };
 
+//	Never changes once made, so all interpreters that run the same program can share it, for example all processes
+//	of a container.
+std::shared_ptr<interpreter_imm_t> make_interpreter_imm(const bc_program_t& program);
+
 
 //////////////////////////////////////		value_entry_t
 
@@ -1375,6 +1405,11 @@ struct value_entry_t {
 struct interpreter_t {
 	public: explicit interpreter_t(const bc_program_t& program);
 	public: explicit interpreter_t(const bc_program_t& program, runtime_handler_i* handler);
+	public: explicit interpreter_t(const std::shared_ptr<interpreter_imm_t>& imm, runtime_handler_i* handler);
+
+	//	Shares globals' program and starts out with the same values in all global variables, without running the
+	//	global initialization again.
+	public: interpreter_t(const interpreter_t& globals, runtime_handler_i* handler);
 	public: interpreter_t(const interpreter_t& other) = delete;
 	public: const interpreter_t& operator=(const interpreter_t& other)= delete;
 #if DEBUG
@@ -17,12 +17,14 @@
 #include "bytecode_generator.h"
 #include "compiler_helpers.h"
 #include "os_process.h"
+#include "floyd_scheduler.h"
 
 #include <thread>
 #include <deque>
 #include <future>
 
 #include <condition_variable>
+#include <unordered_map>
 
 namespace floyd {
 
@@ -291,6 +293,25 @@ std::pair<std::shared_ptr<interpreter_t>, value_t> run_main(const compilation_un
 	}
 }
 
+QUARK_UNIT_TEST("interpreter_t", "interpreter_t(globals, handler)", "shares program, copies globals, no global init", ""){
+	const auto program = compile_to_bytecode(make_compilation_unit_nolib(R"(
+		let a = [ 1, 2, 3 ]
+		let b = "hello"
+		let c = 42
+		print("global init")
+	)", ""));
+
+	interpreter_t globals(make_interpreter_imm(program), nullptr);
+	interpreter_t process(globals, nullptr);
+
+	QUARK_UT_VERIFY(process._imm == globals._imm);
+	QUARK_UT_VERIFY(globals._print_output.size() == 1);
+	QUARK_UT_VERIFY(process._print_output.empty());
+	QUARK_UT_VERIFY(bc_to_value(find_global_symbol2(process, "a")->_value) == bc_to_value(find_global_symbol2(globals, "a")->_value));
+	QUARK_UT_VERIFY(bc_to_value(find_global_symbol2(process, "b")->_value) == value_t::make_string("hello"));
+	QUARK_UT_VERIFY(bc_to_value(find_global_symbol2(process, "c")->_value) == value_t::make_int(42));
+}
+
 void print_vm_printlog(const interpreter_t& vm){
 	QUARK_ASSERT(vm.check_invariant());
 
@@ -307,117 +328,121 @@ void print_vm_printlog(const interpreter_t& vm){
 
 
 /*
-
-std::packaged_task
+	Processes don't get their own OS thread. process_scheduler_t runs them as tasks on a pool of worker threads.
 */
 
-//	https://en.cppreference.com/w/cpp/thread/condition_variable/wait
-
-
 struct process_interface {
 	virtual ~process_interface(){};
-	virtual void on_message(const json_t& message) = 0;
+	virtual void on_message(const process_message_t& message) = 0;
 	virtual void on_init() = 0;
 };
 
 
-//	NOTICE: Each process inbox has its own mutex + condition variable. No mutex protects cout.
+//	NOTICE: The scheduler guarantees only one thread at a time runs a process. No mutex protects cout.
 struct bc_process_t {
-	std::condition_variable _inbox_condition_variable;
-	std::mutex _inbox_mutex;
-	std::deque<json_t> _inbox;
-
 	std::string _name_key;
 	std::string _function_key;
-	std::thread::id _thread_id;
 
 	std::shared_ptr<interpreter_t> _interpreter;
 	std::shared_ptr<value_entry_t> _init_function;
 	std::shared_ptr<value_entry_t> _process_function;
-	value_t _process_state;
-
 
-	std::shared_ptr<process_interface> _processor;
-};
+	//	Kept as a bc_value_t between messages -- never converted to value_t.
+	bc_value_t _process_state;
 
-struct bc_process_runtime_t {
-	container_t _container;
-	std::map<std::string, std::string> _process_infos;
-	std::thread::id _main_thread_id;
 
-	std::vector<std::shared_ptr<bc_process_t>> _processes;
-	std::vector<std::thread> _worker_threads;
+	std::shared_ptr<process_interface> _processor;
 };
 
-/*
-??? have ONE runtime PER computer or one per interpreter?
-??? Separate system-interpreter (all processes and many clock busses) vs ONE thread of execution?
-*/
-
-static void send_message(bc_process_runtime_t& runtime, int process_id, const json_t& message){
-	auto& process = *runtime._processes[process_id];
+struct bc_process_runtime_t : public process_executor_i {
+	virtual void on_process_init(int process_id){
+		auto& process = *_processes[process_id];
 
-    {
-        std::lock_guard<std::mutex> lk(process._inbox_mutex);
-        process._inbox.push_front(message);
-        QUARK_TRACE("Notifying...");
-    }
-    process._inbox_condition_variable.notify_one();
-//    process._inbox_condition_variable.notify_all();
-}
-
-static void process_process(bc_process_runtime_t& runtime, int process_id){
-	auto& process = *runtime._processes[process_id];
-	bool stop = false;
-
-	const auto thread_name = get_current_thread_name();
+		if(process._processor){
+			process._processor->on_init();
+		}
 
-	if(process._processor){
-		process._processor->on_init();
+		if(process._init_function != nullptr){
+			process._process_state = call_function_bc(*process._interpreter, process._init_function->_value, nullptr, 0);
+		}
 	}
 
-	if(process._init_function != nullptr){
-		const std::vector<value_t> args = {};
-		process._process_state = call_function(*process._interpreter, bc_to_value(process._init_function->_value), args);
+	virtual void on_process_message(int process_id, const process_message_t& message){
+		on_process_messages(process_id, &message, 1);
 	}
 
-	while(stop == false){
-		json_t message;
-		{
-			std::unique_lock<std::mutex> lk(process._inbox_mutex);
+	virtual void on_process_messages(int process_id, const process_message_t messages[], int count){
+		auto& process = *_processes[process_id];
 
-        	QUARK_TRACE_SS(thread_name << ": waiting......");
-			process._inbox_condition_variable.wait(lk, [&]{ return process._inbox.empty() == false; });
-        	QUARK_TRACE_SS(thread_name << ": continue");
+		if(process._processor){
+			for(int i = 0 ; i < count ; i++){
+				process._processor->on_message(messages[i]);
+			}
+		}
 
-			//	Pop message.
-			QUARK_ASSERT(process._inbox.empty() == false);
-			message = process._inbox.back();
-			process._inbox.pop_back();
+		if(process._process_function != nullptr){
+			const auto message_type = process._process_function->_symbol._value_type.get_function_args()[1];
+
+			//	Batched handler: one call with all the messages.
+			if(is_batch_message_type(message_type)){
+				const auto element_type = message_type.get_vector_element_type();
+				immer::vector<bc_external_handle_t> elements;
+				for(int i = 0 ; i < count ; i++){
+					elements = elements.push_back(bc_external_handle_t(make_message_arg(element_type, messages[i])));
+				}
+				const bc_value_t args[] = { process._process_state, make_vector(element_type, elements) };
+				process._process_state = call_function_bc(*process._interpreter, process._process_function->_value, args, 2);
+			}
+			else{
+				for(int i = 0 ; i < count ; i++){
+					const bc_value_t args[] = { process._process_state, make_message_arg(message_type, messages[i]) };
+					process._process_state = call_function_bc(*process._interpreter, process._process_function->_value, args, 2);
+				}
+			}
 		}
-		QUARK_TRACE_SS("RECEIVED: " << json_to_pretty_string(message));
+	}
 
-		if(message.is_string() && message.get_string() == "stop"){
-			stop = true;
-        	QUARK_TRACE_SS(thread_name << ": STOP");
+	//	Typed messages are the sender's bc_value_t, passed on as-is. A typed message sent to a process that takes
+	//	json_value is converted to JSON. Anything else that doesn't match the process's message type is an error.
+	static bc_value_t make_message_arg(const typeid_t& message_type, const process_message_t& message){
+		if(message._value == nullptr){
+			if(message_type.is_json_value() == false){
+				quark::throw_runtime_error("Process expects messages of type " + typeid_to_compact_string(message_type) + ", got json_value.");
+			}
+			return bc_value_t::make_json_value(message._json);
 		}
 		else{
-			if(process._processor){
-				process._processor->on_message(message);
+			const auto& value = *static_cast<const bc_value_t*>(message._value.get());
+			if(message_type.is_json_value()){
+				return bc_value_t::make_json_value(value_to_ast_json(bc_to_value(value), json_tags::k_plain));
 			}
-
-			if(process._process_function != nullptr){
-				const std::vector<value_t> args = { process._process_state, value_t::make_json_value(message) };
-				const auto& state2 = call_function(*process._interpreter, bc_to_value(process._process_function->_value), args);
-				process._process_state = state2;
+			else if(value._type != message_type){
+				quark::throw_runtime_error("Process expects messages of type " + typeid_to_compact_string(message_type) + ", got " + typeid_to_compact_string(value._type) + ".");
 			}
+			return value;
 		}
 	}
-}
+
+	container_t _container;
+	std::map<std::string, std::string> _process_infos;
+
+	//	Ran the global initialization. The processes' interpreters start out with copies of its global variables.
+	std::shared_ptr<interpreter_t> _globals;
+
+	std::vector<std::shared_ptr<bc_process_t>> _processes;
+	//	Process name -> handle, the process's index in _processes and in the scheduler. Filled once before any
+	//	process code runs.
+	std::unordered_map<std::string, int> _process_ids;
+	std::shared_ptr<process_scheduler_t> _scheduler;
+};
+
+/*
+??? have ONE runtime PER computer or one per interpreter?
+??? Separate system-interpreter (all processes and many clock busses) vs ONE thread of execution?
+*/
 
 static std::map<std::string, value_t> run_container_int(const bc_program_t& program, const std::vector<std::string>& args, const std::string& container_key){
 	bc_process_runtime_t runtime;
-	runtime._main_thread_id = std::this_thread::get_id();
 
 /*
 	if(program._software_system._name == ""){
@@ -444,14 +469,57 @@ static std::map<std::string, value_t> run_container_int(const bc_program_t& prog
 		return acc2;
 	});
 
+	//	Processes on the same clock bus run on the same scheduler clock, so send() between them is synchronous.
+	std::map<std::string, int> clock_by_process;
+	std::map<std::string, inbox_def_t> inbox_by_process;
+	std::vector<std::pair<std::string, double>> clock_periods;
+	int clock_count = 0;
+	for(const auto& bus: runtime._container._clock_busses){
+		for(const auto& e: bus.second._processes){
+			clock_by_process.insert({ e.first, clock_count });
+			const auto inbox_it = bus.second._inboxes.find(e.first);
+			inbox_by_process.insert({ e.first, inbox_it != bus.second._inboxes.end() ? inbox_it->second : inbox_def_t{} });
+		}
+		clock_periods.push_back({ bus.first, bus.second._period_ms });
+		clock_count++;
+	}
+
+	//	Real-time clocks have threads of their own, the worker threads only run the others.
+	const auto real_time_clock_count = std::count_if(clock_periods.begin(), clock_periods.end(), [](const std::pair<std::string, double>& e){ return e.second > 0.0; });
+	std::vector<int> process_clocks;
+	std::vector<inbox_def_t> process_inboxes;
+	for(const auto& t: runtime._process_infos){
+		runtime._process_ids.insert({ t.first, static_cast<int>(process_clocks.size()) });
+		process_clocks.push_back(clock_by_process.at(t.first));
+		process_inboxes.push_back(inbox_by_process.at(t.first));
+	}
+
 	struct my_interpreter_handler_t : public runtime_handler_i {
 		my_interpreter_handler_t(bc_process_runtime_t& runtime) : _runtime(runtime) {}
 
-		virtual void on_send(const std::string& process_id, const json_t& message){
-			const auto it = std::find_if(_runtime._processes.begin(), _runtime._processes.end(), [&](const std::shared_ptr<bc_process_t>& process){ return process->_name_key == process_id; });
-			if(it != _runtime._processes.end()){
-				const auto process_index = it - _runtime._processes.begin();
-				send_message(_runtime, static_cast<int>(process_index), message);
+		virtual void on_send(const std::string& process_id, const process_message_t& message){
+			const auto it = _runtime._process_ids.find(process_id);
+			if(it != _runtime._process_ids.end()){
+				_runtime._scheduler->send_message(it->second, message);
+			}
+		}
+
+		virtual int64_t get_process_handle(const std::string& process_id){
+			const auto it = _runtime._process_ids.find(process_id);
+			return it != _runtime._process_ids.end() ? it->second : -1;
+		}
+
+		//	Like on_send(), a message to a process that doesn't exist is dropped.
+		virtual void on_send_to_handle(int64_t process_handle, const process_message_t& message){
+			if(process_handle >= 0 && process_handle < static_cast<int64_t>(_runtime._process_ids.size())){
+				_runtime._scheduler->send_message(static_cast<int>(process_handle), message);
+			}
+		}
+
+		virtual void on_post(const std::string& process_id, const process_message_t& message, std::chrono::steady_clock::time_point time){
+			const auto it = _runtime._process_ids.find(process_id);
+			if(it != _runtime._process_ids.end()){
+				_runtime._scheduler->post_message(it->second, message, time);
 			}
 		}
 
@@ -460,45 +528,63 @@ static std::map<std::string, value_t> run_container_int(const bc_program_t& prog
 	auto my_interpreter_handler = my_interpreter_handler_t{runtime};
 
 
+	//	Create the scheduler before the interpreters: their global code may send messages.
+	runtime._scheduler = std::make_shared<process_scheduler_t>(
+		process_clocks,
+		runtime,
+		process_scheduler_t::get_default_thread_count(clock_count - static_cast<int>(real_time_clock_count))
+	);
+	for(int process_id = 0 ; process_id < static_cast<int>(process_inboxes.size()) ; process_id++){
+		runtime._scheduler->set_inbox_def(process_id, process_inboxes[process_id]);
+	}
+	for(int clock_id = 0 ; clock_id < static_cast<int>(clock_periods.size()) ; clock_id++){
+		if(clock_periods[clock_id].second > 0.0){
+			const auto period = std::chrono::duration<double, std::milli>(clock_periods[clock_id].second);
+			runtime._scheduler->set_clock_period(clock_id, std::chrono::duration_cast<std::chrono::nanoseconds>(period));
+		}
+	}
+
+	//	All processes share one program image and run the global initialization once, here. Each process gets its own
+	//	interpreter for its stack, starting out with the same global values. The processes don't need the
+	//	container-def, which lists every process in the container.
+	auto process_program = program;
+	process_program._container_def = container_t{};
+	runtime._globals = std::make_shared<interpreter_t>(make_interpreter_imm(process_program), &my_interpreter_handler);
+
 	for(const auto& t: runtime._process_infos){
 		auto process = std::make_shared<bc_process_t>();
 		process->_name_key = t.first;
 		process->_function_key = t.second;
-		process->_interpreter = std::make_shared<interpreter_t>(program, &my_interpreter_handler);
+		process->_interpreter = std::make_shared<interpreter_t>(*runtime._globals, &my_interpreter_handler);
 		process->_init_function = find_global_symbol2(*process->_interpreter, t.second + "__init");
 		process->_process_function = find_global_symbol2(*process->_interpreter, t.second);
 
+		QUARK_ASSERT(runtime._process_ids.at(t.first) == static_cast<int>(runtime._processes.size()));
 		runtime._processes.push_back(process);
 	}
 
-	//	Remember that current thread (main) is also a thread, no need to create a worker thread for one process.
-	runtime._processes[0]->_thread_id = runtime._main_thread_id;
-
-	for(int process_id = 1 ; process_id < runtime._processes.size() ; process_id++){
-		runtime._worker_threads.push_back(std::thread([&](int process_id){
-
-//			const auto native_thread = thread::native_handle();
-
-			std::stringstream thread_name;
-			thread_name << std::string() << "process " << process_id << " thread";
-#ifdef __APPLE__
-			pthread_setname_np(/*pthread_self(),*/ thread_name.str().c_str());
-#endif
+	runtime._scheduler->run();
 
-			process_process(runtime, process_id);
-		}, process_id));
+	for(int process_id = 0 ; process_id < static_cast<int>(runtime._processes.size()) ; process_id++){
+		const auto stats = runtime._scheduler->get_inbox_stats(process_id);
+		QUARK_TRACE_SS("Inbox of " << runtime._processes[process_id]->_name_key << ": high-water mark " << stats._high_water << ", dropped " << stats._dropped);
 	}
-
-	process_process(runtime, 0);
-
-	for(auto &t: runtime._worker_threads){
-		t.join();
+	for(int clock_id = 0 ; clock_id < static_cast<int>(clock_periods.size()) ; clock_id++){
+		if(clock_periods[clock_id].second > 0.0){
+			const auto stats = runtime._scheduler->get_clock_stats(clock_id);
+			QUARK_TRACE_SS("Clock " << clock_periods[clock_id].first << ": " << stats._tick_count << " ticks"
+				<< ", deadline misses " << stats._deadline_misses
+				<< ", skipped ticks " << stats._skipped_ticks
+				<< ", jitter mean " << stats._jitter_mean.count() << " ns, max " << stats._jitter_max.count() << " ns"
+				<< ", execution mean " << stats._execution_mean.count() << " ns, max " << stats._execution_max.count() << " ns"
+			);
+		}
 	}
 
 #if 0
 	const auto result_vec = mapf<pair<string, value_t>>(
 		runtime._processes,
-		[](const auto& process){ return pair<string, value_t>{ process->_name_key, process->_process_state };}
+		[](const auto& process){ return pair<string, value_t>{ process->_name_key, bc_to_value(process->_process_state) };}
 	);
 	std::map<string, value_t> result_map;
 	for(const auto& e: result_vec){
@@ -29,13 +29,27 @@ using namespace std;
 
 
 
-struct itype_lookup {
-};
+//////////////////////////////////////////////////		type_interner_t
 
 
-//////////////////////////////////////////////////		type_interner_t
 
+static const int32_t k_itype_range_size = 100000000;
+
+static void add_interned(type_interner_t& interner, const std::pair<itype_t, typeid_t>& p){
+	const auto index = static_cast<int32_t>(interner.interned.size());
+	interner.interned.push_back(p);
+
+	const auto range = p.first.itype / k_itype_range_size;
+	const auto offset = p.first.itype % k_itype_range_size;
+	QUARK_ASSERT(range >= 0 && range < interner.itype_indexes.size());
+	auto& indexes = interner.itype_indexes[range];
+	if(offset >= indexes.size()){
+		indexes.resize(offset + 1, -1);
+	}
+	indexes[offset] = index;
 
+	interner.type_indexes.insert({ hash_type(p.second), index });
+}
 
 type_interner_t::type_interner_t() :
 	simple_next_id(0),
@@ -44,17 +58,17 @@ type_interner_t::type_interner_t() :
 	dict_next_id(300000000),
 	function_next_id(400000000)
 {
-	interned.push_back(std::pair<itype_t, typeid_t>{ itype_t(0), typeid_t::make_undefined() });
-	interned.push_back(std::pair<itype_t, typeid_t>{ itype_t(1), typeid_t::make_any() });
-	interned.push_back(std::pair<itype_t, typeid_t>{ itype_t(2), typeid_t::make_void() });
+	add_interned(*this, std::pair<itype_t, typeid_t>{ itype_t(0), typeid_t::make_undefined() });
+	add_interned(*this, std::pair<itype_t, typeid_t>{ itype_t(1), typeid_t::make_any() });
+	add_interned(*this, std::pair<itype_t, typeid_t>{ itype_t(2), typeid_t::make_void() });
 
-	interned.push_back(std::pair<itype_t, typeid_t>{ itype_t(3), typeid_t::make_bool() });
-	interned.push_back(std::pair<itype_t, typeid_t>{ itype_t(4), typeid_t::make_int() });
-	interned.push_back(std::pair<itype_t, typeid_t>{ itype_t(5), typeid_t::make_double() });
-	interned.push_back(std::pair<itype_t, typeid_t>{ itype_t(6), typeid_t::make_string() });
-	interned.push_back(std::pair<itype_t, typeid_t>{ itype_t(7), typeid_t::make_json_value() });
+	add_interned(*this, std::pair<itype_t, typeid_t>{ itype_t(3), typeid_t::make_bool() });
+	add_interned(*this, std::pair<itype_t, typeid_t>{ itype_t(4), typeid_t::make_int() });
+	add_interned(*this, std::pair<itype_t, typeid_t>{ itype_t(5), typeid_t::make_double() });
+	add_interned(*this, std::pair<itype_t, typeid_t>{ itype_t(6), typeid_t::make_string() });
+	add_interned(*this, std::pair<itype_t, typeid_t>{ itype_t(7), typeid_t::make_json_value() });
 
-	interned.push_back(std::pair<itype_t, typeid_t>{ itype_t(8), typeid_t::make_typeid() });
+	add_interned(*this, std::pair<itype_t, typeid_t>{ itype_t(8), typeid_t::make_typeid() });
 	simple_next_id = static_cast<int32_t>(interned.size());
 
 	QUARK_ASSERT(check_invariant());
@@ -86,7 +100,7 @@ bool type_interner_t::check_invariant() const {
 	//!!! We don't register struct, vector, dict and function, since those get explicit types.
 
 
-	//	Make sure each itype
+	QUARK_ASSERT(type_indexes.size() == interned.size());
 
 	return true;
 }
@@ -161,37 +175,123 @@ itype_t make_new_itype_recursive(type_interner_t& interner, const typeid_t& type
 	return { new_id };
 }
 
+static void hash_combine(std::size_t& seed, std::size_t value){
+	seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+//	Equal types must get the same hash, see typeid_t::operator==().
+std::size_t hash_type(const typeid_t& type){
+	QUARK_ASSERT(type.check_invariant());
+
+	struct visitor_t {
+		std::size_t& seed;
+
+		void operator()(const typeid_t::undefined_t& e) const{
+		}
+		void operator()(const typeid_t::any_t& e) const{
+		}
+		void operator()(const typeid_t::void_t& e) const{
+		}
+		void operator()(const typeid_t::bool_t& e) const{
+		}
+		void operator()(const typeid_t::int_t& e) const{
+		}
+		void operator()(const typeid_t::double_t& e) const{
+		}
+		void operator()(const typeid_t::string_t& e) const{
+		}
+		void operator()(const typeid_t::json_type_t& e) const{
+		}
+		void operator()(const typeid_t::typeid_type_t& e) const{
+		}
+
+		void operator()(const typeid_t::struct_t& e) const{
+			for(const auto& m: e._struct_def->_members){
+				hash_combine(seed, std::hash<std::string>()(m._name));
+				hash_combine(seed, hash_type(m._type));
+			}
+		}
+		void operator()(const typeid_t::vector_t& e) const{
+			for(const auto& m: e._parts){
+				hash_combine(seed, hash_type(m));
+			}
+		}
+		void operator()(const typeid_t::dict_t& e) const{
+			for(const auto& m: e._parts){
+				hash_combine(seed, hash_type(m));
+			}
+		}
+		void operator()(const typeid_t::function_t& e) const{
+			for(const auto& m: e._parts){
+				hash_combine(seed, hash_type(m));
+			}
+			hash_combine(seed, static_cast<std::size_t>(e.pure));
+			hash_combine(seed, static_cast<std::size_t>(e.dyn_return));
+		}
+		void operator()(const typeid_t::unresolved_t& e) const{
+			hash_combine(seed, std::hash<std::string>()(e._unresolved_type_identifier));
+		}
+	};
+	std::size_t seed = type._contents.index();
+	std::visit(visitor_t{ seed }, type._contents);
+	return seed;
+}
+
+//	Returns -1 if not found.
+static int32_t find_interned_index(const type_interner_t& interner, const typeid_t& type){
+	const auto range = interner.type_indexes.equal_range(hash_type(type));
+	for(auto it = range.first ; it != range.second ; it++){
+		if(interner.interned[it->second].second == type){
+			return it->second;
+		}
+	}
+	return -1;
+}
+
 std::pair<itype_t, typeid_t> intern_type(type_interner_t& interner, const typeid_t& type){
 	QUARK_ASSERT(interner.check_invariant());
 	QUARK_ASSERT(type.check_invariant());
 
-	const auto it = std::find_if(interner.interned.begin(), interner.interned.end(), [&](const std::pair<itype_t, typeid_t>& e){ return e.second == type; });
-	if(it != interner.interned.end()){
-		return *it;
+	const auto index = find_interned_index(interner, type);
+	if(index != -1){
+		return interner.interned[index];
 	}
 	else{
 		const auto itype = make_new_itype_recursive(interner, type);
 		const auto p = std::pair<itype_t, typeid_t>{ itype, type };
-		interner.interned.push_back(p);
+		add_interned(interner, p);
 		return p;
 	}
 }
 
 
-itype_t lookup_itype(const type_interner_t& interner, const typeid_t& type){
-	const auto it = std::find_if(interner.interned.begin(), interner.interned.end(), [&](const std::pair<itype_t, typeid_t>& e){ return e.second == type; });
-	if(it != interner.interned.end()){
-		return it->first;
+int32_t lookup_interned_index(const type_interner_t& interner, const typeid_t& type){
+	const auto index = find_interned_index(interner, type);
+	if(index == -1){
+		throw std::exception();
 	}
-	throw std::exception();
+	return index;
 }
 
-typeid_t lookup_type(const type_interner_t& interner, const itype_t& type){
-	const auto it = std::find_if(interner.interned.begin(), interner.interned.end(), [&](const std::pair<itype_t, typeid_t>& e){ return e.first.itype == type.itype; });
-	if(it != interner.interned.end()){
-		return it->second;
+int32_t lookup_interned_index(const type_interner_t& interner, const itype_t& type){
+	const auto range = type.itype / k_itype_range_size;
+	const auto offset = type.itype % k_itype_range_size;
+	if(type.itype < 0 || range >= interner.itype_indexes.size()){
+		throw std::exception();
 	}
-	throw std::exception();
+	const auto& indexes = interner.itype_indexes[range];
+	if(offset >= indexes.size() || indexes[offset] == -1){
+		throw std::exception();
+	}
+	return indexes[offset];
+}
+
+itype_t lookup_itype(const type_interner_t& interner, const typeid_t& type){
+	return interner.interned[lookup_interned_index(interner, type)].first;
+}
+
+const typeid_t& lookup_type(const type_interner_t& interner, const itype_t& type){
+	return interner.interned[lookup_interned_index(interner, type)].second;
 }
 
 
@@ -266,4 +366,39 @@ general_purpose_ast_t json_to_gp_ast(const json_t& json){
 
 
 
+QUARK_UNIT_TEST("type_interner_t", "intern_type()", "", "lookups find each type and itype"){
+	type_interner_t interner;
+	auto type = typeid_t::make_int();
+	for(int i = 0 ; i < 100 ; i++){
+		type = i % 2 == 0 ? typeid_t::make_vector(type) : typeid_t::make_dict(type);
+		const auto p = intern_type(interner, type);
+		QUARK_UT_VERIFY(lookup_itype(interner, type).itype == p.first.itype);
+		QUARK_UT_VERIFY(lookup_type(interner, p.first) == type);
+	}
+	QUARK_UT_VERIFY(intern_type(interner, type).first.itype == lookup_itype(interner, type).itype);
+	QUARK_UT_VERIFY(lookup_itype(interner, typeid_t::make_string()).itype == 6);
+	QUARK_UT_VERIFY(interner.check_invariant());
+}
+
+QUARK_UNIT_TEST("type_interner_t", "intern_type()", "structs with different member names", "different itypes"){
+	type_interner_t interner;
+	const auto a = intern_type(interner, typeid_t::make_struct2({ member_t(typeid_t::make_int(), "x") }));
+	const auto b = intern_type(interner, typeid_t::make_struct2({ member_t(typeid_t::make_int(), "y") }));
+	QUARK_UT_VERIFY(a.first.itype != b.first.itype);
+	QUARK_UT_VERIFY(lookup_type(interner, b.first) == b.second);
+}
+
+QUARK_UNIT_TEST("type_interner_t", "lookup_type()", "unknown itype", "throws"){
+	type_interner_t interner;
+	try {
+		lookup_type(interner, itype_t(200000000));
+		QUARK_UT_VERIFY(false);
+	}
+	catch(const std::exception& e){
+	}
+}
+
+
+
+
 } //	floyd
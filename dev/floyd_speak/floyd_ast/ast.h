@@ -10,6 +10,8 @@
 #define parser_ast_hpp
 
 #include <vector>
+#include <array>
+#include <unordered_map>
 #include "quark.h"
 #include "statement.h"
 #include "software_system.h"
@@ -102,6 +104,7 @@ namespace floyd {
 
 
 		////////////////////////////////	STATE
+		//	Only add types using intern_type(), it keeps the lookup tables below in sync.
 		std::vector<std::pair<itype_t, typeid_t>> interned;
 
 		int32_t simple_next_id;
@@ -109,12 +112,28 @@ namespace floyd {
 		int32_t vector_next_id;
 		int32_t dict_next_id;
 		int32_t function_next_id;
+
+		//	Index in interned for each itype. One table per itype range (simple, struct, vector, dict, function),
+		//	indexed by the itype minus the start of its range.
+		std::array<std::vector<int32_t>, 5> itype_indexes;
+
+		//	Index in interned for each type, by hash_type() of the type.
+		std::unordered_multimap<std::size_t, int32_t> type_indexes;
 	};
 
 
+	std::size_t hash_type(const typeid_t& type);
+
 	std::pair<itype_t, typeid_t> intern_type(type_interner_t& interner, const typeid_t& type);
+
+	//	Constant time. They throw if the type isn't interned.
 	itype_t lookup_itype(const type_interner_t& interner, const typeid_t& type);
-	typeid_t lookup_type(const type_interner_t& interner, const itype_t& type);
+	//	The reference is valid until the interner gets more types.
+	const typeid_t& lookup_type(const type_interner_t& interner, const itype_t& type);
+
+	//	Where the type is in interner.interned. Throws if the type isn't interned.
+	int32_t lookup_interned_index(const type_interner_t& interner, const typeid_t& type);
+	int32_t lookup_interned_index(const type_interner_t& interner, const itype_t& type);
 
 
 
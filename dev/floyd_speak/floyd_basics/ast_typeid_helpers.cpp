@@ -74,12 +74,19 @@ json_t typeid_to_ast_json(const typeid_t& t, json_tags tags){
 		});
 	}
 	else if(b == base_type::k_function){
-		return json_t::make_array({
+		std::vector<json_t> result = {
 			basetype_str,
 			typeid_to_ast_json(t.get_function_return(), tags),
 			typeids_to_json_array(t.get_function_args()),
 			t.get_function_pure() == epure::pure ? true : false
-		});
+		};
+
+		//	Only corecalls have a dynamic return type, leave it out for all other functions.
+		const auto dyn_return = t.get_function_dyn_return_type();
+		if(dyn_return != typeid_t::return_dyn_type::none){
+			result.push_back(json_t(static_cast<int>(dyn_return)));
+		}
+		return json_t::make_array(result);
 	}
 	else if(b == base_type::k_unresolved){
 		return std::string() + std::string(1, tag_unresolved_type_char) + t.get_unresolved();
@@ -191,7 +198,8 @@ typeid_t typeid_from_ast_json(const json_t& t2){
 				quark::throw_exception();
 			}
 			const bool pure = a[3].is_true();
-			return typeid_t::make_function(ret_type, arg_types, pure ? epure::pure : epure::impure);
+			const auto dyn_return = a.size() > 4 ? static_cast<typeid_t::return_dyn_type>(a[4].get_number()) : typeid_t::return_dyn_type::none;
+			return typeid_t::make_function3(ret_type, arg_types, pure ? epure::pure : epure::impure, dyn_return);
 		}
 		else if(s == "**unknown-identifier**"){
 			QUARK_ASSERT(false);
@@ -23,6 +23,7 @@
 
 #include "pass3.h"
 #include "floyd_llvm.h"
+#include "floyd_llvm_native.h"
 #include "compiler_helpers.h"
 #include "compiler_basics.h"
 
@@ -189,6 +190,12 @@ floyd help					- Show built in help for command line tool
 floyd runtests				- Runs Floyds internal unit tests
 floyd benchmark 			- Runs Floyd built in suite of benchmark tests and prints the results.
 floyd run -t mygame.floyd	- the -t turns on tracing, which shows Floyd compilation steps and internal states
+floyd run_llvm -O2 mygame.floyd	- compile "mygame.floyd" using LLVM and run it. -O0 to -O3 sets how much LLVM optimizes, default is -O0
+floyd run_llvm --cache-dir /tmp/fc mygame.floyd	- keep the machine code in "/tmp/fc" so the next run of an unchanged "mygame.floyd" starts without compiling. --no-cache turns the cache off
+floyd run_llvm --vector-backend hamt mygame.floyd	- store [T] vectors as persistent tries, so update(), push_back() and subset() on a shared vector don't copy it. Default is carray. Works with compile_native too
+floyd compile_native -o mygame mygame.floyd	- compile "mygame.floyd" to a standalone executable "mygame". Optimizes -O2 unless you give -O.
+	Links with libfloyd_runtime.a next to the floyd executable, set FLOYD_RUNTIME_LIB to use another one.
+	Set FLOYD_LINK_LIBS to change the libraries it links, separated by spaces. Default is "-lpthread".
 )";
 }
 
@@ -240,6 +247,11 @@ int do_run_command(const command_line_args_t& command_line_args){
 	}
 }
 
+static floyd::vector_backend get_vector_backend(const command_line_args_t& command_line_args){
+	const auto it = command_line_args.flags.find("vector-backend");
+	return it != command_line_args.flags.end() ? floyd::parse_vector_backend(it->second) : floyd::vector_backend::k_carray;
+}
+
 int do_run_llvm_command(const command_line_args_t& command_line_args){
 	//	Run provided script file.
 	if(command_line_args.extra_arguments.size() >= 1){
@@ -247,8 +259,20 @@ int do_run_llvm_command(const command_line_args_t& command_line_args){
 		const auto source_path = floyd_args[0];
 		const std::vector<std::string> args2(floyd_args.begin() + 1, floyd_args.end());
 
+		const auto optimization_it = command_line_args.flags.find("O");
+		const auto optimization_level = optimization_it != command_line_args.flags.end()
+			? floyd::parse_llvm_optimization_level(optimization_it->second)
+			: floyd::llvm_optimization_level::k_O0;
+
+		floyd::jit_cache_settings_t cache;
+		if(command_line_args.flags.find("no-cache") == command_line_args.flags.end()){
+			const auto cache_dir_it = command_line_args.flags.find("cache-dir");
+			cache.cache_dir = cache_dir_it != command_line_args.flags.end() ? cache_dir_it->second : floyd::get_default_jit_cache_dir();
+			cache.compiler_version = floyd_version_string;
+		}
+
 		const auto source = read_text_file(source_path);
-		const auto error_code = floyd::run_using_llvm_helper(source, source_path, args2);
+		const auto error_code = floyd::run_using_llvm_helper(source, source_path, args2, optimization_level, cache, get_vector_backend(command_line_args));
 		return static_cast<int>(error_code);
 	}
 	else{
@@ -259,9 +283,48 @@ int do_run_llvm_command(const command_line_args_t& command_line_args){
 
 
 
+int do_compile_native_command(const command_line_args_t& command_line_args){
+	if(command_line_args.extra_arguments.size() == 1){
+		const auto source_path = command_line_args.extra_arguments[0];
+
+		const auto output_it = command_line_args.flags.find("o");
+		const auto output_path = output_it != command_line_args.flags.end() ? output_it->second : RemoveExtension(source_path);
+		const auto output_path2 = output_path.front() == '/' ? output_path : MakeAbsolutePath(get_working_dir() + "/", output_path);
+
+		const auto optimization_it = command_line_args.flags.find("O");
+		const auto optimization_level = optimization_it != command_line_args.flags.end()
+			? floyd::parse_llvm_optimization_level(optimization_it->second)
+			: floyd::llvm_optimization_level::k_O2;
+
+		floyd::native_link_settings_t settings;
+		const auto runtime_lib = getenv("FLOYD_RUNTIME_LIB");
+		settings.runtime_library_path = runtime_lib != nullptr ? std::string(runtime_lib) : SplitPath(command_line_args.command).fPath + "libfloyd_runtime.a";
+
+		const auto link_libs = getenv("FLOYD_LINK_LIBS");
+		if(link_libs != nullptr){
+			settings.libraries.clear();
+			for(const auto& e: split_on_chars(seq_t(link_libs), " \t")){
+				if(e.empty() == false){
+					settings.libraries.push_back(e);
+				}
+			}
+		}
+
+		const auto source = read_text_file(source_path);
+		floyd::compile_native_helper(source, source_path, output_path2, optimization_level, settings, get_vector_backend(command_line_args));
+		return EXIT_SUCCESS;
+	}
+	else{
+		help();
+		return EXIT_SUCCESS;
+	}
+}
+
+
+
 //	Runs one of the commands, args depends on which command.
 int run_command(const std::vector<std::string>& args){
-	const auto command_line_args = parse_command_line_args_subcommands(args, "t");
+	const auto command_line_args = parse_command_line_args_subcommands(args, "tO:o:", { "cache-dir:", "no-cache", "vector-backend:" });
 	const auto path_parts = SplitPath(command_line_args.command);
 	QUARK_ASSERT(path_parts.fName == "floyd" || path_parts.fName == "floydut");
 	trace_on = command_line_args.flags.find("t") != command_line_args.flags.end() ? true : false;
@@ -287,6 +350,9 @@ int run_command(const std::vector<std::string>& args){
 	else if(command_line_args.subcommand == "run_llvm"){
 		return do_run_llvm_command(command_line_args);
 	}
+	else if(command_line_args.subcommand == "compile_native"){
+		return do_compile_native_command(command_line_args);
+	}
 	else{
 		help();
 		return EXIT_SUCCESS;
@@ -10,6 +10,10 @@
 
 
 #include "ast_typeid.h"
+#include "ast_value.h"
+#include "ast_json.h"
+#include "json_support.h"
+#include "file_handling.h"
 #include "floyd_runtime.h"
 
 namespace floyd {
@@ -339,6 +343,82 @@ typeid_t make__file_pos_t__type(){
 
 
 
+std::vector<value_t> directory_entries_to_values(const std::vector<TDirEntry>& v){
+	const auto k_fsentry_t__type = make__fsentry_t__type();
+	const auto elements = mapf<value_t>(
+		v,
+		[&k_fsentry_t__type](const auto& e){
+//			const auto t = value_t::make_string(e.fName);
+			const auto type_string = e.fType == TDirEntry::kFile ? "file": "dir";
+			const auto t2 = value_t::make_struct_value(
+				k_fsentry_t__type,
+				{
+					value_t::make_string(type_string),
+					value_t::make_string(e.fNameOnly),
+					value_t::make_string(e.fParent)
+				}
+			);
+			return t2;
+		}
+	);
+	return elements;
+}
+
+
+//??? implement
+static std::string posix_timespec__to__utc(const time_t& t){
+	return std::to_string(t);
+}
+
+
+value_t impl__get_fsentry_info(const std::string& path){
+	if(is_valid_absolute_dir_path(path) == false){
+		quark::throw_runtime_error("get_fsentry_info() illegal input path.");
+	}
+
+	TFileInfo info;
+	bool ok = GetFileInfo(path, info);
+	QUARK_ASSERT(ok);
+	if(ok == false){
+		quark::throw_exception();
+	}
+
+	const auto parts = SplitPath(path);
+	const auto parent = UpDir2(path);
+
+	const auto type_string = info.fDirFlag ? "dir" : "string";
+	const auto name = info.fDirFlag ? parent.second : parts.fName;
+	const auto parent_path = info.fDirFlag ? parent.first : parts.fPath;
+
+	const auto creation_date = posix_timespec__to__utc(info.fCreationDate);
+	const auto modification_date = posix_timespec__to__utc(info.fModificationDate);
+	const auto file_size = info.fFileSize;
+
+	const auto result = value_t::make_struct_value(
+		make__fsentry_info_t__type(),
+		{
+			value_t::make_string(type_string),
+			value_t::make_string(name),
+			value_t::make_string(parent_path),
+
+			value_t::make_string(creation_date),
+			value_t::make_string(modification_date),
+
+			value_t::make_int(file_size)
+		}
+	);
+
+#if 1
+	const auto debug = value_and_type_to_ast_json(result);
+	QUARK_TRACE(json_to_pretty_string(debug));
+#endif
+
+	return result;
+}
+
+
+
+
 //////////////////////////////////////		FILELIB
 
 
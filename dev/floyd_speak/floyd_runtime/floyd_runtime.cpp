@@ -23,7 +23,21 @@ typeid_t make_process_init_type(const typeid_t& t){
 }
 
 typeid_t make_process_message_handler_type(const typeid_t& t){
-	return typeid_t::make_function(t, { t, typeid_t::make_json_value() }, epure::impure);
+	return make_process_message_handler_type(t, typeid_t::make_json_value());
+}
+
+typeid_t make_process_message_handler_type(const typeid_t& t, const typeid_t& message_type){
+	return typeid_t::make_function(t, { t, message_type }, epure::impure);
+}
+
+bool is_batch_message_type(const typeid_t& message_type){
+	return message_type.is_vector() && message_type.get_vector_element_type().is_json_value();
+}
+
+std::chrono::steady_clock::time_point get_post_time(const std::chrono::time_point<std::chrono::high_resolution_clock>& start_time, int64_t time_ms){
+	//	The two clocks may differ, so go via the time left.
+	const auto time_left = (start_time + std::chrono::milliseconds(time_ms)) - std::chrono::high_resolution_clock::now();
+	return std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(time_left);
 }
 
 
@@ -254,19 +268,45 @@ corecall_signature_t make_map_string_signature(){
 corecall_signature_t make_filter_signature(){
 	return { "filter", 1036, typeid_t::make_function_dyn_return({ ANY_TYPE, ANY_TYPE }, epure::pure, typeid_t::return_dyn_type::arg0) };
 }
+//	pass3 adds a hidden 4th argument: an int with the reduce_kernel it recognized in the reducer function, if any.
 corecall_signature_t make_reduce_signature(){
-	return { "reduce", 1035, typeid_t::make_function_dyn_return({ ANY_TYPE, ANY_TYPE, ANY_TYPE }, epure::pure, typeid_t::return_dyn_type::arg1) };
+	return { "reduce", 1035, typeid_t::make_function_dyn_return({ ANY_TYPE, ANY_TYPE, ANY_TYPE, ANY_TYPE }, epure::pure, typeid_t::return_dyn_type::arg1) };
 }
 corecall_signature_t make_supermap_signature(){
 	return { "supermap", 1037, typeid_t::make_function_dyn_return({ ANY_TYPE, ANY_TYPE, ANY_TYPE }, epure::pure, typeid_t::return_dyn_type::vector_of_arg2func_return) };
 }
 
+//	The comparator is optional in the source code. When it's left out, pass3 supplies a placeholder argument that is
+//	not a function, which the host implementations treat as "use natural ordering".
+corecall_signature_t make_sort_signature(){
+	return { "sort", 1038, typeid_t::make_function_dyn_return({ ANY_TYPE, ANY_TYPE }, epure::pure, typeid_t::return_dyn_type::arg0) };
+}
+
 
 corecall_signature_t make_print_signature(){
 	return { "print", 1000, typeid_t::make_function(typeid_t::make_void(), { ANY_TYPE }, epure::pure) };
 }
 corecall_signature_t make_send_signature(){
-	return { "send", 1022, typeid_t::make_function(typeid_t::make_void(), { typeid_t::make_string(), typeid_t::make_json_value() }, epure::impure) };
+	//	The message can be any type. The receiving process checks it at runtime against its message type.
+	return { "send", 1022, typeid_t::make_function(typeid_t::make_void(), { typeid_t::make_string(), ANY_TYPE }, epure::impure) };
+}
+
+//	Resolves a process name once, so send_to_handle() doesn't need to look it up for each message.
+corecall_signature_t make_get_process_handle_signature(){
+	return { "get_process_handle", 1041, typeid_t::make_function(typeid_t::make_int(), { typeid_t::make_string() }, epure::impure) };
+}
+corecall_signature_t make_send_to_handle_signature(){
+	return { "send_to_handle", 1042, typeid_t::make_function(typeid_t::make_void(), { typeid_t::make_int(), ANY_TYPE }, epure::impure) };
+}
+
+//	post_at_time(process, time, message): time is in get_time_of_day()'s milliseconds.
+corecall_signature_t make_post_at_time_signature(){
+	return { "post_at_time", 1039, typeid_t::make_function(typeid_t::make_void(), { typeid_t::make_string(), typeid_t::make_int(), ANY_TYPE }, epure::impure) };
+}
+
+//	post_after(process, milliseconds, message)
+corecall_signature_t make_post_after_signature(){
+	return { "post_after", 1040, typeid_t::make_function(typeid_t::make_void(), { typeid_t::make_string(), typeid_t::make_int(), ANY_TYPE }, epure::impure) };
 }
 
 
@@ -307,9 +347,14 @@ static std::vector<corecall_signature_t> get_host_function_records(){
 		make_filter_signature(),
 		make_reduce_signature(),
 		make_supermap_signature(),
+		make_sort_signature(),
 
 		make_print_signature(),
-		make_send_signature()
+		make_send_signature(),
+		make_get_process_handle_signature(),
+		make_send_to_handle_signature(),
+		make_post_at_time_signature(),
+		make_post_after_signature()
 	};
 	return result;
 }
@@ -11,6 +11,7 @@
 
 
 #include <string>
+#include <chrono>
 #include "ast_typeid.h"
 #include "compiler_basics.h"
 
@@ -19,6 +20,7 @@ struct json_t;
 namespace floyd {
 
 struct value_t;
+struct process_message_t;
 
 
 //////////////////////////////////////		runtime_handler_i
@@ -30,7 +32,14 @@ struct value_t;
 */
 struct runtime_handler_i {
 	virtual ~runtime_handler_i(){};
-	virtual void on_send(const std::string& process_id, const json_t& message) = 0;
+	virtual void on_send(const std::string& process_id, const process_message_t& message) = 0;
+
+	//	The handle of a process in the running container, or -1 if there is no such process.
+	virtual int64_t get_process_handle(const std::string& process_id) = 0;
+	virtual void on_send_to_handle(int64_t process_handle, const process_message_t& message) = 0;
+
+	//	post_at_time() and post_after().
+	virtual void on_post(const std::string& process_id, const process_message_t& message, std::chrono::steady_clock::time_point time) = 0;
 };
 
 
@@ -57,6 +66,16 @@ typeid_t make_process_init_type(const typeid_t& t);
 //	T x(T state, json_value message) impure
 typeid_t make_process_message_handler_type(const typeid_t& t);
 
+//	T x(T state, M message) impure
+typeid_t make_process_message_handler_type(const typeid_t& t, const typeid_t& message_type);
+
+//	T x(T state, [json_value] messages) impure
+//	A handler with this message type gets all messages waiting in the inbox in one call.
+bool is_batch_message_type(const typeid_t& message_type);
+
+//	post_at_time() takes a time from get_time_of_day(): milliseconds since start_time.
+std::chrono::steady_clock::time_point get_post_time(const std::chrono::time_point<std::chrono::high_resolution_clock>& start_time, int64_t time_ms);
+
 
 
 
@@ -116,9 +135,14 @@ corecall_signature_t make_map_string_signature();
 corecall_signature_t make_filter_signature();
 corecall_signature_t make_reduce_signature();
 corecall_signature_t make_supermap_signature();
+corecall_signature_t make_sort_signature();
 
 corecall_signature_t make_print_signature();
 corecall_signature_t make_send_signature();
+corecall_signature_t make_get_process_handle_signature();
+corecall_signature_t make_send_to_handle_signature();
+corecall_signature_t make_post_at_time_signature();
+corecall_signature_t make_post_after_signature();
 
 std::vector<corecall_signature_t> get_corecall_signatures();
 
@@ -0,0 +1,1333 @@
+//
+//  floyd_scheduler.cpp
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-07-08.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#include "floyd_scheduler.h"
+
+#include "quark.h"
+
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <sstream>
+#include <functional>
+#include <chrono>
+#include <pthread.h>
+#include <sched.h>
+
+
+namespace floyd {
+
+
+//	Max number of messages each process handles, as one batch, before its clock goes back to the run queue. Keeps one
+//	busy clock from starving the others.
+static const int k_max_batch_size = 256;
+
+//	Max depth of synchronous send()s. Deeper chains go via the inbox so we don't run out of C++ stack.
+static const int k_max_sync_depth = 64;
+
+//	How many times an idle worker checks the run queue before it parks. On a single core spinning only delays the
+//	thread that would give us work, so then we park at once.
+static const int k_spin_count = 256;
+
+//	Timers are rounded up to whole ticks.
+static const int64_t k_timer_tick_ns = 100 * 1000;
+
+static const int64_t k_no_timers = INT64_MAX;
+
+//	A real-time clock's thread sleeps until this long before its tick is due and spins the rest.
+static const auto k_real_time_spin = std::chrono::microseconds(250);
+
+static inline void spin_pause(){
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#else
+	std::this_thread::yield();
+#endif
+}
+
+
+//	What the current worker thread is running right now, if anything. Used to detect synchronous sends.
+static thread_local const process_scheduler_t* t_running_scheduler = nullptr;
+static thread_local int t_running_clock = -1;
+static thread_local int t_sync_depth = 0;
+
+//	Set on the threads of real-time clocks. They never wait for a full inbox.
+static thread_local bool t_real_time_thread = false;
+
+namespace {
+
+struct running_clock_scope_t;
+
+//	Innermost clock run by this thread. A worker blocked on a full inbox runs other clocks, so they nest.
+static thread_local const running_clock_scope_t* t_running_scope = nullptr;
+
+struct running_clock_scope_t {
+	running_clock_scope_t(const process_scheduler_t* scheduler, int clock_id) :
+		_scheduler(scheduler),
+		_clock(clock_id),
+		_prev_scheduler(t_running_scheduler),
+		_prev_clock(t_running_clock),
+		_prev_scope(t_running_scope)
+	{
+		t_running_scheduler = scheduler;
+		t_running_clock = clock_id;
+		t_running_scope = this;
+	}
+	~running_clock_scope_t(){
+		t_running_scheduler = _prev_scheduler;
+		t_running_clock = _prev_clock;
+		t_running_scope = _prev_scope;
+	}
+
+	const process_scheduler_t* _scheduler;
+	int _clock;
+	const process_scheduler_t* _prev_scheduler;
+	int _prev_clock;
+	const running_clock_scope_t* _prev_scope;
+};
+
+bool is_clock_running_on_this_thread(const process_scheduler_t* scheduler, int clock_id){
+	for(auto scope = t_running_scope ; scope != nullptr ; scope = scope->_prev_scope){
+		if(scope->_scheduler == scheduler && scope->_clock == clock_id){
+			return true;
+		}
+	}
+	return false;
+}
+
+struct busy_scope_t {
+	busy_scope_t(bool& busy) :
+		_busy(busy)
+	{
+		_busy = true;
+		t_sync_depth++;
+	}
+	~busy_scope_t(){
+		t_sync_depth--;
+		_busy = false;
+	}
+
+	bool& _busy;
+};
+
+//	Needs privileges on most systems. Without them we quietly keep the normal priority.
+void raise_thread_priority(){
+#ifdef __APPLE__
+	pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0);
+#else
+	sched_param param;
+	param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+	pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+#endif
+}
+
+std::vector<int> make_one_clock_per_process(int process_count){
+	std::vector<int> result;
+	for(int i = 0 ; i < process_count ; i++){
+		result.push_back(i);
+	}
+	return result;
+}
+
+}
+
+
+process_scheduler_t::process_scheduler_t(int process_count, process_executor_i& executor, int thread_count) :
+	process_scheduler_t(make_one_clock_per_process(process_count), executor, thread_count)
+{
+}
+
+process_scheduler_t::process_scheduler_t(const std::vector<int>& process_clocks, process_executor_i& executor, int thread_count) :
+	_executor(executor),
+	_thread_count(thread_count),
+	_spin_count(std::thread::hardware_concurrency() > 1 ? k_spin_count : 0),
+	_start_time(std::chrono::steady_clock::now()),
+	_run_queue_count(0),
+	_parked_count(0),
+	_timer_keeper_parked(false),
+	_next_timer_ns(k_no_timers),
+	_stopped_count(0),
+	_done(false)
+{
+	QUARK_ASSERT(thread_count >= 1);
+
+	for(int process_id = 0 ; process_id < static_cast<int>(process_clocks.size()) ; process_id++){
+		const auto clock_id = process_clocks[process_id];
+		QUARK_ASSERT(clock_id >= 0);
+
+		while(static_cast<int>(_clocks.size()) <= clock_id){
+			_clocks.push_back(std::make_unique<clock_state_t>());
+		}
+
+		auto process = std::make_unique<process_t>();
+		process->_clock = clock_id;
+		_processes.push_back(std::move(process));
+		_clocks[clock_id]->_process_ids.push_back(process_id);
+	}
+
+	//	All clocks start scheduled so their processes get to run their init.
+	for(int clock_id = 0 ; clock_id < static_cast<int>(_clocks.size()) ; clock_id++){
+		if(_clocks[clock_id]->_process_ids.empty() == false){
+			_clocks[clock_id]->_scheduled = true;
+			_run_queue.push_back(clock_id);
+		}
+	}
+	_run_queue_count = static_cast<int>(_run_queue.size());
+}
+
+process_scheduler_t::~process_scheduler_t(){
+}
+
+void process_scheduler_t::set_inbox_def(int process_id, const inbox_def_t& def){
+	QUARK_ASSERT(process_id >= 0 && process_id < static_cast<int>(_processes.size()));
+	QUARK_ASSERT(def._capacity >= 0);
+
+	_processes[process_id]->_inbox_def = def;
+}
+
+process_scheduler_t::inbox_stats_t process_scheduler_t::get_inbox_stats(int process_id) const {
+	QUARK_ASSERT(process_id >= 0 && process_id < static_cast<int>(_processes.size()));
+
+	const auto& process = *_processes[process_id];
+	return inbox_stats_t{ process._high_water, process._dropped.load() };
+}
+
+void process_scheduler_t::set_clock_period(int clock_id, std::chrono::nanoseconds period){
+	QUARK_ASSERT(clock_id >= 0 && clock_id < static_cast<int>(_clocks.size()));
+	QUARK_ASSERT(period.count() > 0);
+
+	auto& clock = *_clocks[clock_id];
+	clock._period = period;
+
+	//	Its own thread runs it, including the inits.
+	clock._scheduled = true;
+	const auto it = std::find(_run_queue.begin(), _run_queue.end(), clock_id);
+	if(it != _run_queue.end()){
+		_run_queue.erase(it);
+		_run_queue_count--;
+	}
+}
+
+process_scheduler_t::clock_stats_t process_scheduler_t::get_clock_stats(int clock_id) const {
+	QUARK_ASSERT(clock_id >= 0 && clock_id < static_cast<int>(_clocks.size()));
+
+	const auto& clock = *_clocks[clock_id];
+	const auto count = std::max<int64_t>(clock._tick_count, 1);
+	return clock_stats_t{
+		clock._tick_count,
+		clock._deadline_misses,
+		clock._skipped_ticks,
+		std::chrono::nanoseconds(clock._jitter_sum_ns / count),
+		std::chrono::nanoseconds(clock._jitter_max_ns),
+		std::chrono::nanoseconds(clock._execution_sum_ns / count),
+		std::chrono::nanoseconds(clock._execution_max_ns)
+	};
+}
+
+int process_scheduler_t::get_default_thread_count(int clock_count){
+	const int hardware_threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+	return std::max(1, std::min(hardware_threads, clock_count));
+}
+
+void process_scheduler_t::enqueue(int clock_id){
+	bool wake = false;
+	bool wake_timer_keeper = false;
+	{
+		std::lock_guard<std::mutex> lk(_run_queue_mutex);
+		_run_queue.push_back(clock_id);
+		_run_queue_count++;
+		wake = _parked_count > 0;
+		wake_timer_keeper = wake == false && _timer_keeper_parked;
+	}
+	if(wake){
+		_run_queue_condition_variable.notify_one();
+	}
+	else if(wake_timer_keeper){
+		_timer_condition_variable.notify_one();
+	}
+}
+
+void process_scheduler_t::send_message(int process_id, const process_message_t& message){
+	QUARK_ASSERT(process_id >= 0 && process_id < static_cast<int>(_processes.size()));
+
+	auto& process = *_processes[process_id];
+	auto& clock = *_clocks[process._clock];
+
+	//	Only the thread running the clock may touch _busy, so check that first.
+	const bool on_clock_thread = t_running_scheduler == this && t_running_clock == process._clock;
+
+	if(process._stopped){
+		return;
+	}
+
+	//	We are the inbox's consumer when we run on its clock, so we may check if it's empty.
+	if(on_clock_thread && process._busy == false && is_inbox_empty(process) && t_sync_depth < k_max_sync_depth){
+		deliver(process_id, &message, 1);
+	}
+	else{
+		if(process._inbox_def._capacity > 0){
+			push_bounded(process, message);
+		}
+		else{
+			process._inbox_count.fetch_add(1, std::memory_order_relaxed);
+			process._inbox.push(message);
+		}
+
+		//	Must come after the push: the thread running the clock clears _scheduled before it checks the inboxes.
+		if(clock._scheduled.exchange(true) == false){
+			enqueue(process._clock);
+		}
+	}
+}
+
+void process_scheduler_t::push_bounded(process_t& process, const process_message_t& message){
+	const auto capacity = static_cast<size_t>(process._inbox_def._capacity);
+	const bool is_stop = message.is_stop();
+
+	std::unique_lock<std::mutex> lk(process._bounded_mutex);
+	while(is_stop == false && process._bounded_inbox.size() >= capacity){
+		//	The receiver stops before it gets to this message.
+		if(process._stop_waiting || process._stopped){
+			return;
+		}
+
+		const auto overflow = process._inbox_def._overflow;
+		if(overflow == inbox_overflow_t::k_drop_oldest){
+			process._bounded_inbox.pop_front();
+			process._inbox_count--;
+			process._dropped++;
+		}
+		else if(overflow == inbox_overflow_t::k_coalesce){
+			process._bounded_inbox.back() = message;
+			process._dropped++;
+			return;
+		}
+		else{
+			QUARK_ASSERT(overflow == inbox_overflow_t::k_block);
+
+			//	Waiting for a clock that runs further up our own call stack would never end. A real-time clock must
+			//	not wait at all.
+			if(_done || t_real_time_thread || is_clock_running_on_this_thread(this, process._clock)){
+				break;
+			}
+
+			//	Run other clocks while we wait: the receiver's clock may be one of them.
+			int clock_id = -1;
+			lk.unlock();
+			const bool ran = t_running_scheduler == this && pop_run_queue(clock_id);
+			if(ran){
+				run_slice(clock_id);
+			}
+			lk.lock();
+
+			if(ran == false && process._bounded_inbox.size() >= capacity){
+				process._not_full.wait_for(lk, std::chrono::milliseconds(1));
+			}
+		}
+	}
+
+	if(process._stop_waiting){
+		return;
+	}
+	process._bounded_inbox.push_back(message);
+	process._inbox_count++;
+	if(is_stop){
+		process._stop_waiting = true;
+	}
+}
+
+//	Moves messages from the inbox to _batch.
+void process_scheduler_t::take_batch(process_t& process){
+	process._high_water = std::max(process._high_water, process._inbox_count.load(std::memory_order_relaxed));
+
+	int count = 0;
+	if(process._inbox_def._capacity > 0){
+		{
+			std::lock_guard<std::mutex> lk(process._bounded_mutex);
+			while(process._batch.size() < k_max_batch_size && process._bounded_inbox.empty() == false){
+				process._batch.push_back(std::move(process._bounded_inbox.front()));
+				process._bounded_inbox.pop_front();
+				count++;
+			}
+			process._inbox_count -= count;
+		}
+		if(count > 0){
+			process._not_full.notify_all();
+		}
+	}
+	else{
+		process_message_t message;
+		while(process._batch.size() < k_max_batch_size && process._inbox.pop(message)){
+			process._batch.push_back(std::move(message));
+			count++;
+		}
+		process._inbox_count.fetch_sub(count, std::memory_order_relaxed);
+	}
+}
+
+void process_scheduler_t::drop_inbox(process_t& process){
+	if(process._inbox_def._capacity > 0){
+		{
+			std::lock_guard<std::mutex> lk(process._bounded_mutex);
+			process._inbox_count -= static_cast<int>(process._bounded_inbox.size());
+			process._bounded_inbox.clear();
+		}
+		process._not_full.notify_all();
+	}
+	else{
+		process_message_t message;
+		int count = 0;
+		while(process._inbox.pop(message)){
+			count++;
+		}
+		process._inbox_count.fetch_sub(count, std::memory_order_relaxed);
+	}
+}
+
+//	Only call from the thread running the process's clock.
+bool process_scheduler_t::is_inbox_empty(process_t& process){
+	if(process._inbox_def._capacity > 0){
+		std::lock_guard<std::mutex> lk(process._bounded_mutex);
+		return process._bounded_inbox.empty();
+	}
+	else{
+		return process._inbox.empty();
+	}
+}
+
+void process_scheduler_t::post_message(int process_id, const process_message_t& message, std::chrono::steady_clock::time_point time){
+	QUARK_ASSERT(process_id >= 0 && process_id < static_cast<int>(_processes.size()));
+
+	const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(time - _start_time).count();
+	const int64_t tick = (std::max<int64_t>(ns, 0) + k_timer_tick_ns - 1) / k_timer_tick_ns;
+
+	bool earlier = false;
+	{
+		std::lock_guard<std::mutex> lk(_timers_mutex);
+		_timers.add(tick, timer_t{ process_id, message });
+		const auto next_timer_ns = _timers.get_next_tick() * k_timer_tick_ns;
+		earlier = next_timer_ns < _next_timer_ns;
+		_next_timer_ns = next_timer_ns;
+	}
+
+	//	The parked workers may sleep until a later timer, or not wait for timers at all.
+	if(earlier){
+		bool wake = false;
+		bool wake_timer_keeper = false;
+		{
+			std::lock_guard<std::mutex> lk(_run_queue_mutex);
+			wake_timer_keeper = _timer_keeper_parked;
+			wake = wake_timer_keeper == false && _parked_count > 0;
+		}
+		if(wake_timer_keeper){
+			_timer_condition_variable.notify_one();
+		}
+		else if(wake){
+			_run_queue_condition_variable.notify_one();
+		}
+	}
+}
+
+//	Sends the messages of all timers that are due.
+void process_scheduler_t::fire_timers(){
+	const auto next_timer_ns = _next_timer_ns.load(std::memory_order_relaxed);
+	if(next_timer_ns == k_no_timers){
+		return;
+	}
+	const int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start_time).count();
+	if(now_ns < next_timer_ns){
+		return;
+	}
+
+	std::vector<timer_t> expired;
+	{
+		//	Another worker is already at it.
+		std::unique_lock<std::mutex> lk(_timers_mutex, std::try_to_lock);
+		if(lk.owns_lock() == false){
+			return;
+		}
+		_timers.advance(now_ns / k_timer_tick_ns, expired);
+		_next_timer_ns = _timers.empty() ? k_no_timers : _timers.get_next_tick() * k_timer_tick_ns;
+	}
+
+	//	Not on any clock, but a send to a full inbox may run other clocks while it waits, see push_bounded().
+	running_clock_scope_t running(this, -1);
+	for(const auto& e: expired){
+		send_message(e._process_id, e._message);
+	}
+}
+
+void process_scheduler_t::ensure_init(int process_id){
+	auto& process = *_processes[process_id];
+	if(process._init_done == false){
+		process._init_done = true;
+
+		busy_scope_t busy(process._busy);
+		_executor.on_process_init(process_id);
+	}
+}
+
+//	Messages after a "stop" are dropped.
+void process_scheduler_t::deliver(int process_id, const process_message_t messages[], int count){
+	auto& process = *_processes[process_id];
+	QUARK_ASSERT(process._busy == false);
+
+	ensure_init(process_id);
+
+	int stop_index = count;
+	for(int i = 0 ; i < count ; i++){
+		if(messages[i]._value == nullptr){
+			QUARK_TRACE_SS("RECEIVED: " << json_to_pretty_string(messages[i]._json));
+		}
+		if(messages[i].is_stop()){
+			stop_index = i;
+			break;
+		}
+	}
+
+	if(stop_index > 0){
+		busy_scope_t busy(process._busy);
+		_executor.on_process_messages(process_id, messages, stop_index);
+	}
+
+	if(stop_index < count){
+		process._stopped = true;
+
+		std::lock_guard<std::mutex> lk(_run_queue_mutex);
+		_stopped_count++;
+		if(_stopped_count == static_cast<int>(_processes.size())){
+			_done = true;
+			_run_queue_condition_variable.notify_all();
+			_timer_condition_variable.notify_all();
+			_real_time_condition_variable.notify_all();
+		}
+	}
+}
+
+void process_scheduler_t::run_slice(int clock_id){
+	auto& clock = *_clocks[clock_id];
+	running_clock_scope_t running(this, clock_id);
+
+	for(const auto process_id: clock._process_ids){
+		ensure_init(process_id);
+	}
+
+	for(const auto process_id: clock._process_ids){
+		auto& process = *_processes[process_id];
+
+		//	Take everything waiting in the inbox and hand it over as one batch.
+		if(process._stopped == false){
+			take_batch(process);
+		}
+		if(process._batch.empty() == false){
+			deliver(process_id, &process._batch[0], static_cast<int>(process._batch.size()));
+			process._batch.clear();
+		}
+
+		//	Messages that arrived after "stop" are dropped.
+		if(process._stopped){
+			drop_inbox(process);
+		}
+	}
+
+	//	Clear _scheduled *before* checking the inboxes. A sender that pushes after our check will see _scheduled == false
+	//	and enqueue the clock itself.
+	clock._scheduled = false;
+
+	bool requeue = false;
+	for(const auto process_id: clock._process_ids){
+		if(is_inbox_empty(*_processes[process_id]) == false){
+			requeue = true;
+		}
+	}
+
+	if(requeue && clock._scheduled.exchange(true) == false){
+		enqueue(clock_id);
+	}
+}
+
+//	Returns false when all processes of the clock have stopped.
+bool process_scheduler_t::run_tick(int clock_id){
+	static const process_message_t tick_message(json_t("tick"));
+
+	auto& clock = *_clocks[clock_id];
+	running_clock_scope_t running(this, clock_id);
+
+	for(const auto process_id: clock._process_ids){
+		ensure_init(process_id);
+	}
+
+	bool running_processes = false;
+	for(const auto process_id: clock._process_ids){
+		auto& process = *_processes[process_id];
+		if(process._stopped == false){
+			take_batch(process);
+			process._batch.push_back(tick_message);
+			deliver(process_id, &process._batch[0], static_cast<int>(process._batch.size()));
+			process._batch.clear();
+		}
+
+		if(process._stopped){
+			drop_inbox(process);
+		}
+		else{
+			running_processes = true;
+		}
+	}
+	return running_processes;
+}
+
+void process_scheduler_t::real_time_loop(int clock_id){
+	auto& clock = *_clocks[clock_id];
+	const auto period = clock._period;
+
+	t_real_time_thread = true;
+	raise_thread_priority();
+
+	auto due = std::chrono::steady_clock::now();
+	while(true){
+		{
+			std::unique_lock<std::mutex> lk(_run_queue_mutex);
+			_real_time_condition_variable.wait_until(lk, due - k_real_time_spin, [&](){ return _done.load(); });
+		}
+		if(_done){
+			return;
+		}
+		while(std::chrono::steady_clock::now() < due){
+			spin_pause();
+		}
+
+		const auto start = std::chrono::steady_clock::now();
+		bool running_processes = false;
+		try {
+			running_processes = run_tick(clock_id);
+		}
+		catch(...){
+			stop_with_exception(std::current_exception());
+			return;
+		}
+		const auto end = std::chrono::steady_clock::now();
+
+		const int64_t jitter_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(start - due).count();
+		const int64_t execution_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+		clock._tick_count++;
+		clock._jitter_sum_ns += jitter_ns;
+		clock._jitter_max_ns = std::max(clock._jitter_max_ns, jitter_ns);
+		clock._execution_sum_ns += execution_ns;
+		clock._execution_max_ns = std::max(clock._execution_max_ns, execution_ns);
+
+		if(running_processes == false){
+			return;
+		}
+
+		due += period;
+		if(end > due){
+			clock._deadline_misses++;
+		}
+
+		//	Run the tick that is due at once, even if we're late, but skip ticks that are entirely in the past.
+		while(due + period <= end){
+			due += period;
+			clock._skipped_ticks++;
+		}
+	}
+}
+
+bool process_scheduler_t::pop_run_queue(int& clock_id){
+	std::lock_guard<std::mutex> lk(_run_queue_mutex);
+	if(_done || _run_queue.empty()){
+		return false;
+	}
+	clock_id = _run_queue.front();
+	_run_queue.pop_front();
+	_run_queue_count--;
+	return true;
+}
+
+//	One parked worker, the timer keeper, sleeps until the next timer is due. The others sleep until there is work.
+void process_scheduler_t::park(std::unique_lock<std::mutex>& lk){
+	const auto next_timer_ns = _next_timer_ns.load();
+	if(next_timer_ns != k_no_timers && _timer_keeper_parked == false){
+		_timer_keeper_parked = true;
+		_timer_condition_variable.wait_until(lk, _start_time + std::chrono::nanoseconds(next_timer_ns));
+		_timer_keeper_parked = false;
+
+		//	We leave to do work. Let another parked worker take over waiting for timers.
+		if(_run_queue.empty() == false && _parked_count > 0){
+			_run_queue_condition_variable.notify_one();
+		}
+	}
+	else{
+		_parked_count++;
+		_run_queue_condition_variable.wait(lk);
+		_parked_count--;
+	}
+}
+
+//	The first exception wins, run() rethrows it.
+void process_scheduler_t::stop_with_exception(std::exception_ptr exception){
+	std::lock_guard<std::mutex> lk(_run_queue_mutex);
+	if(_exception == nullptr){
+		_exception = exception;
+	}
+	_done = true;
+	_run_queue_condition_variable.notify_all();
+	_timer_condition_variable.notify_all();
+	_real_time_condition_variable.notify_all();
+}
+
+void process_scheduler_t::worker_loop(){
+	while(true){
+		try {
+			fire_timers();
+		}
+		catch(...){
+			stop_with_exception(std::current_exception());
+			return;
+		}
+
+		int clock_id = -1;
+
+		//	Spin a little before parking: a message often arrives right away and parking + waking costs syscalls.
+		for(int i = 0 ; i < _spin_count && _run_queue_count.load(std::memory_order_relaxed) == 0 && _done == false ; i++){
+			spin_pause();
+		}
+
+		if(pop_run_queue(clock_id) == false){
+			std::unique_lock<std::mutex> lk(_run_queue_mutex);
+			if(_done == false && _run_queue.empty()){
+				park(lk);
+			}
+			if(_done){
+				return;
+			}
+
+			//	Woken to fire timers or to become the timer keeper.
+			if(_run_queue.empty()){
+				continue;
+			}
+			clock_id = _run_queue.front();
+			_run_queue.pop_front();
+			_run_queue_count--;
+		}
+
+		try {
+			run_slice(clock_id);
+		}
+		catch(...){
+			stop_with_exception(std::current_exception());
+			return;
+		}
+	}
+}
+
+void process_scheduler_t::run(){
+	if(_processes.empty()){
+		return;
+	}
+
+	std::vector<std::thread> real_time_threads;
+	for(int clock_id = 0 ; clock_id < static_cast<int>(_clocks.size()) ; clock_id++){
+		if(_clocks[clock_id]->_period.count() > 0 && _clocks[clock_id]->_process_ids.empty() == false){
+			real_time_threads.push_back(std::thread([&](int real_time_clock_id){
+				std::stringstream thread_name;
+				thread_name << std::string() << "floyd real-time clock " << real_time_clock_id;
+#ifdef __APPLE__
+				pthread_setname_np(/*pthread_self(),*/ thread_name.str().c_str());
+#endif
+				real_time_loop(real_time_clock_id);
+			}, clock_id));
+		}
+	}
+
+	std::vector<std::thread> worker_threads;
+	for(int i = 1 ; i < _thread_count ; i++){
+		worker_threads.push_back(std::thread([&](int thread_index){
+			std::stringstream thread_name;
+			thread_name << std::string() << "floyd worker " << thread_index;
+#ifdef __APPLE__
+			pthread_setname_np(/*pthread_self(),*/ thread_name.str().c_str());
+#endif
+			worker_loop();
+		}, i));
+	}
+
+	worker_loop();
+
+	for(auto& t: worker_threads){
+		t.join();
+	}
+	for(auto& t: real_time_threads){
+		t.join();
+	}
+
+	{
+		std::lock_guard<std::mutex> lk(_timers_mutex);
+		_timers.clear();
+		_next_timer_ns = k_no_timers;
+	}
+
+	if(_exception != nullptr){
+		std::rethrow_exception(_exception);
+	}
+}
+
+
+
+//////////////////////////////////////		TESTS
+
+
+QUARK_UNIT_TEST("mpsc_queue_t", "pop()", "FIFO order", ""){
+	mpsc_queue_t<int> q;
+	QUARK_UT_VERIFY(q.empty());
+
+	q.push(10);
+	q.push(11);
+	q.push(12);
+	QUARK_UT_VERIFY(q.empty() == false);
+
+	int v = 0;
+	QUARK_UT_VERIFY(q.pop(v) && v == 10);
+	QUARK_UT_VERIFY(q.pop(v) && v == 11);
+	QUARK_UT_VERIFY(q.pop(v) && v == 12);
+	QUARK_UT_VERIFY(q.pop(v) == false);
+	QUARK_UT_VERIFY(q.empty());
+}
+
+QUARK_UNIT_TEST("mpsc_queue_t", "push()", "4 producers, each one's values stay in order", ""){
+	const int k_producers = 4;
+	const int k_count = 20000;
+	mpsc_queue_t<int> q;
+
+	std::vector<std::thread> producers;
+	for(int p = 0 ; p < k_producers ; p++){
+		producers.push_back(std::thread([&q](int p){
+			for(int i = 0 ; i < k_count ; i++){
+				q.push(p * k_count + i);
+			}
+		}, p));
+	}
+
+	std::vector<int> next(k_producers, 0);
+	int received = 0;
+	bool in_order = true;
+	while(received < k_producers * k_count){
+		int v = 0;
+		if(q.pop(v)){
+			const auto p = v / k_count;
+			if(v % k_count != next[p]){
+				in_order = false;
+			}
+			next[p] = v % k_count + 1;
+			received++;
+		}
+		else{
+			std::this_thread::yield();
+		}
+	}
+	for(auto& t: producers){
+		t.join();
+	}
+
+	QUARK_UT_VERIFY(in_order);
+	QUARK_UT_VERIFY(q.empty());
+}
+
+
+QUARK_UNIT_TEST("timer_wheel_t", "advance()", "expires in tick order", ""){
+	timer_wheel_t<int> wheel;
+	wheel.add(70, 70);
+	wheel.add(3, 3);
+	wheel.add(5000, 5000);
+	wheel.add(64, 64);
+	QUARK_UT_VERIFY(wheel.get_next_tick() == 3);
+
+	std::vector<int> expired;
+	wheel.advance(2, expired);
+	QUARK_UT_VERIFY(expired.empty());
+
+	wheel.advance(69, expired);
+	QUARK_UT_VERIFY((expired == std::vector<int>{ 3, 64 }));
+
+	wheel.advance(10000, expired);
+	QUARK_UT_VERIFY((expired == std::vector<int>{ 3, 64, 70, 5000 }));
+	QUARK_UT_VERIFY(wheel.empty());
+	QUARK_UT_VERIFY(wheel.get_next_tick() == -1);
+}
+
+QUARK_UNIT_TEST("timer_wheel_t", "get_next_tick()", "advance() stopped at the start of a level-1 slot", ""){
+	timer_wheel_t<int> wheel;
+	wheel.add(130, 130);
+
+	std::vector<int> expired;
+	wheel.advance(127, expired);
+	QUARK_UT_VERIFY(expired.empty());
+	QUARK_UT_VERIFY(wheel.get_next_tick() == 130);
+}
+
+QUARK_UNIT_TEST("timer_wheel_t", "add()", "tick that has passed expires at next advance()", ""){
+	timer_wheel_t<int> wheel;
+	std::vector<int> expired;
+	wheel.advance(100, expired);
+	wheel.add(50, 50);
+	QUARK_UT_VERIFY(wheel.get_next_tick() == 101);
+
+	wheel.advance(101, expired);
+	QUARK_UT_VERIFY((expired == std::vector<int>{ 50 }));
+}
+
+//	Compares with a sorted list, using ticks on all levels and in the overflow list.
+QUARK_UNIT_TEST("timer_wheel_t", "advance()", "random ticks, never early or late", ""){
+	timer_wheel_t<int64_t> wheel;
+	std::vector<int64_t> pending;
+	uint64_t seed = 12345;
+	const auto random = [&](int64_t range){
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		return static_cast<int64_t>((seed >> 33) % static_cast<uint64_t>(range));
+	};
+
+	int64_t now = 0;
+	bool ok = true;
+	for(int round = 0 ; round < 2000 ; round++){
+		const int64_t ranges[] = { 64, 4096, 1 << 18, 1 << 26 };
+		const auto tick = now + 1 + random(ranges[random(4)]);
+		wheel.add(tick, tick);
+		pending.push_back(tick);
+
+		const auto next = *std::min_element(pending.begin(), pending.end());
+		if(wheel.get_next_tick() > next){
+			ok = false;
+		}
+
+		now = now + random(round % 100 == 0 ? 1 << 20 : 300);
+		std::vector<int64_t> expired;
+		wheel.advance(now, expired);
+		for(const auto& e: expired){
+			const auto it = std::find(pending.begin(), pending.end(), e);
+			if(e > now || it == pending.end()){
+				ok = false;
+			}
+			else{
+				pending.erase(it);
+			}
+		}
+		for(const auto& e: pending){
+			if(e <= now){
+				ok = false;
+			}
+		}
+		if(std::is_sorted(expired.begin(), expired.end()) == false){
+			ok = false;
+		}
+	}
+	QUARK_UT_VERIFY(ok);
+}
+
+
+namespace {
+
+//	Each process forwards a counter to the next process until it reaches 0, then stops everybody.
+struct test_ring_t : public process_executor_i {
+	test_ring_t(int process_count, int thread_count) :
+		_scheduler(process_count, *this, thread_count),
+		_process_count(process_count),
+		_message_counts(process_count, 0),
+		_running(process_count)
+	{
+		for(auto& e: _running){
+			e = false;
+		}
+	}
+
+	virtual void on_process_init(int process_id){
+		_init_count++;
+		if(process_id == 0){
+			_scheduler.send_message(0, json_t(1000.0));
+		}
+	}
+
+	virtual void on_process_message(int process_id, const process_message_t& message){
+		//	Detect two threads running the same process at the same time.
+		const bool was_running = _running[process_id].exchange(true);
+		QUARK_ASSERT(was_running == false);
+		if(was_running){
+			_overlap_detected = true;
+		}
+
+		_message_counts[process_id]++;
+		const auto n = static_cast<int>(message._json.get_number());
+		if(n > 0){
+			_scheduler.send_message((process_id + 1) % _process_count, json_t(static_cast<double>(n - 1)));
+		}
+		else{
+			for(int i = 0 ; i < _process_count ; i++){
+				_scheduler.send_message(i, json_t("stop"));
+			}
+		}
+
+		_running[process_id] = false;
+	}
+
+	process_scheduler_t _scheduler;
+	int _process_count;
+	std::vector<int> _message_counts;
+	std::vector<std::atomic<bool>> _running;
+	std::atomic<int> _init_count { 0 };
+	std::atomic<bool> _overlap_detected { false };
+};
+
+struct test_throw_t : public process_executor_i {
+	virtual void on_process_init(int process_id){
+		if(process_id == 1){
+			throw std::runtime_error("init failed");
+		}
+	}
+	virtual void on_process_message(int, const process_message_t&){
+	}
+};
+
+}
+
+QUARK_UNIT_TEST("process_scheduler_t", "run()", "ring of 100 processes on 4 threads", ""){
+	test_ring_t ring(100, 4);
+	ring._scheduler.run();
+
+	QUARK_UT_VERIFY(ring._init_count == 100);
+	QUARK_UT_VERIFY(ring._overlap_detected == false);
+
+	int total = 0;
+	for(const auto e: ring._message_counts){
+		total += e;
+	}
+	QUARK_UT_VERIFY(total == 1001);
+	QUARK_UT_VERIFY(ring._message_counts[0] == 11);
+	QUARK_UT_VERIFY(ring._message_counts[1] == 10);
+}
+
+QUARK_UNIT_TEST("process_scheduler_t", "run()", "more processes than threads, one thread", ""){
+	test_ring_t ring(10, 1);
+	ring._scheduler.run();
+	QUARK_UT_VERIFY(ring._init_count == 10);
+}
+
+QUARK_UNIT_TEST("process_scheduler_t", "run()", "exception is rethrown", ""){
+	test_throw_t executor;
+	process_scheduler_t scheduler(3, executor, 2);
+	try {
+		scheduler.run();
+		QUARK_UT_VERIFY(false);
+	}
+	catch(const std::runtime_error& e){
+		QUARK_UT_VERIFY(std::string(e.what()) == "init failed");
+	}
+}
+
+
+namespace {
+
+//	Logs what happens. Only use with one worker thread.
+struct test_log_executor_t : public process_executor_i {
+	virtual void on_process_init(int process_id){
+		if(_on_init){
+			_on_init(process_id);
+		}
+	}
+	virtual void on_process_message(int process_id, const process_message_t& message){
+		_log.push_back(std::to_string(process_id) + " got " + message._json.get_string());
+		if(_on_message){
+			_on_message(process_id, message);
+		}
+	}
+
+	std::function<void (int process_id)> _on_init;
+	std::function<void (int process_id, const process_message_t& message)> _on_message;
+	std::vector<std::string> _log;
+};
+
+}
+
+QUARK_UNIT_TEST("process_scheduler_t", "send_message()", "same clock, receiver runs before send returns", ""){
+	test_log_executor_t executor;
+	process_scheduler_t scheduler(std::vector<int>{ 0, 0 }, executor, 1);
+	executor._on_init = [&](int process_id){
+		if(process_id == 0){
+			scheduler.send_message(1, json_t("x"));
+			executor._log.push_back("0 sent");
+			scheduler.send_message(0, json_t("stop"));
+			scheduler.send_message(1, json_t("stop"));
+		}
+	};
+	scheduler.run();
+
+	QUARK_UT_VERIFY((executor._log == std::vector<std::string>{ "1 got x", "0 sent" }));
+}
+
+QUARK_UNIT_TEST("process_scheduler_t", "send_message()", "same clock, reply to busy sender goes via inbox", ""){
+	test_log_executor_t executor;
+	process_scheduler_t scheduler(std::vector<int>{ 0, 0 }, executor, 1);
+	executor._on_init = [&](int process_id){
+		if(process_id == 0){
+			scheduler.send_message(1, json_t("ping"));
+			executor._log.push_back("0 sent");
+		}
+	};
+	executor._on_message = [&](int process_id, const process_message_t&){
+		if(process_id == 1){
+			scheduler.send_message(0, json_t("pong"));
+		}
+		else{
+			scheduler.send_message(0, json_t("stop"));
+			scheduler.send_message(1, json_t("stop"));
+		}
+	};
+	scheduler.run();
+
+	QUARK_UT_VERIFY((executor._log == std::vector<std::string>{ "1 got ping", "0 sent", "0 got pong" }));
+}
+
+QUARK_UNIT_TEST("process_scheduler_t", "send_message()", "different clocks, send is async", ""){
+	test_log_executor_t executor;
+	process_scheduler_t scheduler(std::vector<int>{ 0, 1 }, executor, 1);
+	executor._on_init = [&](int process_id){
+		if(process_id == 0){
+			scheduler.send_message(1, json_t("x"));
+			executor._log.push_back("0 sent");
+		}
+	};
+	executor._on_message = [&](int, const process_message_t&){
+		scheduler.send_message(0, json_t("stop"));
+		scheduler.send_message(1, json_t("stop"));
+	};
+	scheduler.run();
+
+	QUARK_UT_VERIFY((executor._log == std::vector<std::string>{ "0 sent", "1 got x" }));
+}
+
+QUARK_UNIT_TEST("process_scheduler_t", "send_message()", "same clock, receiver is initialized first", ""){
+	test_log_executor_t executor;
+	process_scheduler_t scheduler(std::vector<int>{ 0, 0 }, executor, 1);
+	executor._on_init = [&](int process_id){
+		executor._log.push_back(std::to_string(process_id) + " init");
+		if(process_id == 0){
+			scheduler.send_message(1, json_t("x"));
+			scheduler.send_message(0, json_t("stop"));
+			scheduler.send_message(1, json_t("stop"));
+		}
+	};
+	scheduler.run();
+
+	QUARK_UT_VERIFY((executor._log == std::vector<std::string>{ "0 init", "1 init", "1 got x" }));
+}
+
+
+namespace {
+
+//	Logs each batch as "process_id: message message ...". Only use with one worker thread.
+struct test_batch_executor_t : public process_executor_i {
+	virtual void on_process_init(int process_id){
+		if(_on_init){
+			_on_init(process_id);
+		}
+	}
+	virtual void on_process_message(int, const process_message_t&){
+		QUARK_ASSERT(false);
+	}
+	virtual void on_process_messages(int process_id, const process_message_t messages[], int count){
+		std::string s = std::to_string(process_id) + ":";
+		for(int i = 0 ; i < count ; i++){
+			s = s + " " + messages[i]._json.get_string();
+		}
+		_log.push_back(s);
+	}
+
+	std::function<void (int process_id)> _on_init;
+	std::vector<std::string> _log;
+};
+
+}
+
+QUARK_UNIT_TEST("process_scheduler_t", "run()", "waiting messages are delivered as one batch", ""){
+	test_batch_executor_t executor;
+	process_scheduler_t scheduler(std::vector<int>{ 0, 1 }, executor, 1);
+	executor._on_init = [&](int process_id){
+		if(process_id == 0){
+			scheduler.send_message(1, json_t("a"));
+			scheduler.send_message(1, json_t("b"));
+			scheduler.send_message(1, json_t("c"));
+			scheduler.send_message(0, json_t("stop"));
+			scheduler.send_message(1, json_t("stop"));
+		}
+	};
+	scheduler.run();
+
+	QUARK_UT_VERIFY((executor._log == std::vector<std::string>{ "1: a b c" }));
+}
+
+QUARK_UNIT_TEST("process_scheduler_t", "run()", "messages after stop in a batch are dropped", ""){
+	test_batch_executor_t executor;
+	process_scheduler_t scheduler(std::vector<int>{ 0, 1 }, executor, 1);
+	executor._on_init = [&](int process_id){
+		if(process_id == 0){
+			scheduler.send_message(1, json_t("a"));
+			scheduler.send_message(1, json_t("stop"));
+			scheduler.send_message(1, json_t("b"));
+			scheduler.send_message(0, json_t("stop"));
+		}
+	};
+	scheduler.run();
+
+	QUARK_UT_VERIFY((executor._log == std::vector<std::string>{ "1: a" }));
+}
+
+QUARK_UNIT_TEST("process_scheduler_t", "send_message()", "full inbox, drop oldest", ""){
+	test_batch_executor_t executor;
+	process_scheduler_t scheduler(std::vector<int>{ 0, 1 }, executor, 1);
+	scheduler.set_inbox_def(1, inbox_def_t{ 2, inbox_overflow_t::k_drop_oldest });
+	executor._on_init = [&](int process_id){
+		if(process_id == 0){
+			for(const auto& e: std::vector<std::string>{ "a", "b", "c", "d", "e" }){
+				scheduler.send_message(1, json_t(e));
+			}
+			scheduler.send_message(1, json_t("stop"));
+			scheduler.send_message(0, json_t("stop"));
+		}
+	};
+	scheduler.run();
+
+	QUARK_UT_VERIFY((executor._log == std::vector<std::string>{ "1: d e" }));
+	QUARK_UT_VERIFY(scheduler.get_inbox_stats(1)._dropped == 3);
+	QUARK_UT_VERIFY(scheduler.get_inbox_stats(1)._high_water == 3);
+}
+
+QUARK_UNIT_TEST("process_scheduler_t", "send_message()", "full inbox, coalesce", ""){
+	test_batch_executor_t executor;
+	process_scheduler_t scheduler(std::vector<int>{ 0, 1 }, executor, 1);
+	scheduler.set_inbox_def(1, inbox_def_t{ 2, inbox_overflow_t::k_coalesce });
+	executor._on_init = [&](int process_id){
+		if(process_id == 0){
+			for(const auto& e: std::vector<std::string>{ "a", "b", "c", "d" }){
+				scheduler.send_message(1, json_t(e));
+			}
+			scheduler.send_message(1, json_t("stop"));
+			scheduler.send_message(0, json_t("stop"));
+		}
+	};
+	scheduler.run();
+
+	QUARK_UT_VERIFY((executor._log == std::vector<std::string>{ "1: a d" }));
+	QUARK_UT_VERIFY(scheduler.get_inbox_stats(1)._dropped == 2);
+}
+
+//	With one worker thread the blocked sender runs the receiver's clock itself.
+QUARK_UNIT_TEST("process_scheduler_t", "send_message()", "full inbox, block", ""){
+	test_batch_executor_t executor;
+	process_scheduler_t scheduler(std::vector<int>{ 0, 1 }, executor, 1);
+	scheduler.set_inbox_def(1, inbox_def_t{ 1, inbox_overflow_t::k_block });
+	executor._on_init = [&](int process_id){
+		if(process_id == 0){
+			for(const auto& e: std::vector<std::string>{ "a", "b", "c" }){
+				scheduler.send_message(1, json_t(e));
+			}
+			scheduler.send_message(1, json_t("stop"));
+			scheduler.send_message(0, json_t("stop"));
+		}
+	};
+	scheduler.run();
+
+	QUARK_UT_VERIFY((executor._log == std::vector<std::string>{ "1: a", "1: b", "1: c" }));
+	QUARK_UT_VERIFY(scheduler.get_inbox_stats(1)._dropped == 0);
+}
+
+QUARK_UNIT_TEST("process_scheduler_t", "post_message()", "delivered in time order, never early", ""){
+	test_log_executor_t executor;
+	process_scheduler_t scheduler(std::vector<int>{ 0 }, executor, 1);
+
+	const auto start = std::chrono::steady_clock::now();
+	std::vector<std::chrono::steady_clock::duration> received;
+	executor._on_init = [&](int){
+		scheduler.post_message(0, json_t("c"), start + std::chrono::milliseconds(6));
+		scheduler.post_message(0, json_t("a"), start + std::chrono::milliseconds(2));
+		scheduler.post_message(0, json_t("b"), start + std::chrono::milliseconds(4));
+		scheduler.post_message(0, json_t("d"), start + std::chrono::hours(1));
+	};
+	executor._on_message = [&](int, const process_message_t& message){
+		received.push_back(std::chrono::steady_clock::now() - start);
+		if(message._json.get_string() == "c"){
+			scheduler.send_message(0, json_t("stop"));
+		}
+	};
+	scheduler.run();
+
+	QUARK_UT_VERIFY((executor._log == std::vector<std::string>{ "0 got a", "0 got b", "0 got c" }));
+	QUARK_UT_VERIFY(received.size() == 3);
+	QUARK_UT_VERIFY(received[0] >= std::chrono::milliseconds(2));
+	QUARK_UT_VERIFY(received[1] >= std::chrono::milliseconds(4));
+	QUARK_UT_VERIFY(received[2] >= std::chrono::milliseconds(6));
+}
+
+QUARK_UNIT_TEST("process_scheduler_t", "set_clock_period()", "ticks at the period, waiting messages come before the tick", ""){
+	test_log_executor_t executor;
+	process_scheduler_t scheduler(std::vector<int>{ 0 }, executor, 1);
+	scheduler.set_clock_period(0, std::chrono::milliseconds(2));
+
+	const auto start = std::chrono::steady_clock::now();
+	std::vector<std::chrono::steady_clock::time_point> ticks;
+	executor._on_message = [&](int, const process_message_t& message){
+		if(message._json.get_string() == "tick"){
+			ticks.push_back(std::chrono::steady_clock::now());
+			if(ticks.size() == 1){
+				scheduler.send_message(0, json_t("x"));
+			}
+			else if(ticks.size() == 5){
+				scheduler.send_message(0, json_t("stop"));
+			}
+		}
+	};
+	scheduler.run();
+
+	QUARK_UT_VERIFY((executor._log == std::vector<std::string>{ "0 got tick", "0 got x", "0 got tick", "0 got tick", "0 got tick", "0 got tick" }));
+	QUARK_UT_VERIFY(ticks[4] - start >= std::chrono::milliseconds(8));
+
+	//	The tick that delivered "stop" counts too.
+	const auto stats = scheduler.get_clock_stats(0);
+	QUARK_UT_VERIFY(stats._tick_count == 6);
+	QUARK_UT_VERIFY(stats._jitter_max >= stats._jitter_mean);
+	QUARK_UT_VERIFY(stats._execution_max >= stats._execution_mean);
+}
+
+QUARK_UNIT_TEST("process_scheduler_t", "set_clock_period()", "slow tick misses its deadline, ticks in the past are skipped", ""){
+	test_log_executor_t executor;
+	process_scheduler_t scheduler(std::vector<int>{ 0, 1 }, executor, 1);
+	scheduler.set_clock_period(0, std::chrono::milliseconds(1));
+
+	int ticks = 0;
+	executor._on_init = [&](int process_id){
+		if(process_id == 1){
+			scheduler.send_message(1, json_t("stop"));
+		}
+	};
+	executor._on_message = [&](int, const process_message_t&){
+		ticks++;
+		if(ticks == 1){
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+		else if(ticks == 3){
+			scheduler.send_message(0, json_t("stop"));
+		}
+	};
+	scheduler.run();
+
+	const auto stats = scheduler.get_clock_stats(0);
+	QUARK_UT_VERIFY(stats._deadline_misses >= 1);
+	QUARK_UT_VERIFY(stats._skipped_ticks >= 3);
+	QUARK_UT_VERIFY(stats._execution_max >= std::chrono::milliseconds(5));
+
+	QUARK_UT_VERIFY(scheduler.get_clock_stats(1)._tick_count == 0);
+}
+
+}	// floyd
@@ -0,0 +1,557 @@
+//
+//  floyd_scheduler.h
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-07-08.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#ifndef floyd_scheduler_hpp
+#define floyd_scheduler_hpp
+
+/*
+	Runs the processes of a container as tasks on a fixed pool of OS threads (M:N scheduling).
+
+	- Each process belongs to a clock. The clock is what gets scheduled: only one thread at a time runs the
+		processes of a clock. Different clocks run in parallel.
+	- Each process has an inbox. Sending a message to a process whose clock isn't already scheduled puts the clock
+		in the run queue.
+	- A worker thread takes a clock from the run queue and runs it for a slice: each process gets all messages
+		waiting in its inbox as one batch, up to a limit. If any inbox still has messages afterwards the clock goes to
+		the back of the run queue.
+	- A clock is never in the run queue and running at the same time, so each process runs serially, but it may
+		move between OS threads from slice to slice.
+	- A process's init runs before any message is delivered to it.
+	- The message "stop" stops a process. run() returns when all processes have stopped.
+	- Messages are process_message_t: a json_t or a Floyd value the backend passes by reference.
+
+	SYNCHRONOUS DELIVERY
+	When a process sends a message to another process on the same clock, the receiver handles the message at once,
+	on the sender's thread, before send() returns -- like a function call. This is skipped and the message goes to the
+	inbox as usual if the receiver is already busy further up the call stack (A sends to B that sends back to A), if
+	it already has messages waiting in its inbox (keeps messages in order) or if the chain of synchronous calls gets
+	too deep.
+
+	BOUNDED INBOXES
+	By default inboxes are unbounded. An inbox with a capacity (see inbox_def_t) decides what happens when it's full:
+	- k_block: send() waits until the receiver has taken messages from its inbox. A worker thread that is blocked
+		runs other clocks from the run queue meanwhile, so the receiver gets to run even with a single worker thread.
+		If the receiver's clock is running further up the same thread's call stack it can't make room, so the message
+		is added anyway. A cycle of processes that block on each other's full inboxes on different threads deadlocks.
+	- k_drop_oldest: the oldest waiting message is dropped.
+	- k_coalesce: the new message replaces the newest waiting message.
+	"stop" is never dropped or replaced. Messages sent after a "stop" is waiting are dropped: they'd never be handled.
+	Each inbox counts the most messages that have been waiting at once (high-water mark) and the dropped messages.
+
+	TIMERS
+	post_message() puts a message in a process's inbox at a given time. All timers live in one timer_wheel_t. There is
+	no timer thread: the worker threads fire due timers between slices, and one parked worker sleeps until the next
+	timer is due, the others until there's work. Timers still pending when run() returns are dropped.
+
+	REAL-TIME CLOCKS
+	A clock with a period (see set_clock_period()) is not run by the worker threads. It gets a thread of its own that
+	asks the OS for high priority and wakes up once per period, the tick. Each tick every process of the clock gets the
+	messages waiting in its inbox followed by the message "tick". The thread sleeps until shortly before the tick is due
+	and spins the rest of the way, since waking up from sleep isn't precise. For each tick it measures how late it
+	started (jitter) and how long it took. A tick that doesn't finish before the next one is due is a deadline miss. If
+	the thread falls behind a whole period or more the ticks it missed are skipped, not run back to back.
+
+	LOCKING
+	Unbounded inboxes are lock-free multi-producer / single-consumer queues, see mpsc_queue_t. Senders never take a
+	lock unless they need to put a clock in the run queue. A worker thread with nothing to do spins for a short while
+	before it parks on the run queue's condition variable, and senders only notify when some worker is actually parked.
+	A bounded inbox is a std::deque protected by its own mutex. The timer wheel has its own mutex.
+
+	The scheduler knows nothing about the interpreter or the LLVM runtime: it calls them through process_executor_i.
+*/
+
+#include "json_support.h"
+#include "software_system.h"
+
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+
+namespace floyd {
+
+
+//////////////////////////////////////		mpsc_queue_t
+
+/*
+	Unbounded lock-free queue: any number of threads can push(), only one thread at a time may pop() or empty().
+	Linked list of nodes with a dummy node at the tail. push() is one atomic exchange.
+
+	A push() that is still in progress on another thread can make the queue look empty for a moment. Callers that
+	need to know must check again after the pushing thread has signaled them some other way.
+*/
+template <typename T> class mpsc_queue_t {
+	public: mpsc_queue_t() :
+		_head(new node_t()),
+		_tail(_head.load())
+	{
+	}
+
+	public: ~mpsc_queue_t(){
+		T temp;
+		while(pop(temp)){
+		}
+		delete _tail;
+	}
+
+	public: mpsc_queue_t(const mpsc_queue_t& other) = delete;
+	public: mpsc_queue_t& operator=(const mpsc_queue_t& other) = delete;
+
+	//	Thread safe.
+	public: void push(const T& value){
+		auto node = new node_t();
+		node->_value = value;
+		const auto prev = _head.exchange(node);
+		prev->_next.store(node);
+	}
+
+	//	Consumer only.
+	public: bool pop(T& out){
+		const auto tail = _tail;
+		const auto next = tail->_next.load();
+		if(next == nullptr){
+			return false;
+		}
+		out = std::move(next->_value);
+		_tail = next;
+		delete tail;
+		return true;
+	}
+
+	//	Consumer only.
+	public: bool empty() const {
+		return _tail->_next.load() == nullptr;
+	}
+
+
+	/////////////////////////////////////		STATE
+
+	private: struct node_t {
+		std::atomic<node_t*> _next { nullptr };
+		T _value;
+	};
+
+	//	Producers push here.
+	private: std::atomic<node_t*> _head;
+
+	//	The consumer's dummy node. Its _next is the next value to pop.
+	private: node_t* _tail;
+};
+
+
+
+//////////////////////////////////////		timer_wheel_t
+
+/*
+	Hierarchical timer wheel. Time is counted in ticks. There are 4 levels of 64 slots each: a level-0 slot covers one
+	tick, a level-1 slot 64 ticks, a level-2 slot 64 * 64 ticks and so on. Timers further away than level 3 reaches
+	wait in an overflow list.
+
+	A timer goes to the lowest level that can tell its tick apart from now: level 0 if they are in the same 64 ticks,
+	level 1 if they are in the same 64 * 64 ticks etc. So a slot only ever holds timers for its very next turn. When now
+	reaches the start of a higher-level slot, its timers move down a level or more. add() is O(1), and each timer moves
+	at most 4 times before it expires.
+
+	Not thread safe.
+*/
+template <typename T> class timer_wheel_t {
+	public: timer_wheel_t() :
+		_now_tick(0),
+		_count(0)
+	{
+		for(auto& e: _occupied){
+			e = 0;
+		}
+	}
+
+	public: timer_wheel_t(const timer_wheel_t& other) = delete;
+	public: timer_wheel_t& operator=(const timer_wheel_t& other) = delete;
+
+	//	A tick that has already passed expires at the next advance().
+	public: void add(int64_t tick, const T& value){
+		insert(entry_t{ std::max(tick, _now_tick), value });
+		_count++;
+	}
+
+	//	Expires all timers up to and including tick and appends them to expired, in tick order.
+	public: void advance(int64_t tick, std::vector<T>& expired){
+		while(_now_tick <= tick){
+			const int slot = static_cast<int>(_now_tick & k_slot_mask);
+			if(_occupied[0] & bit(slot)){
+				auto& entries = _slots[0][slot];
+				for(auto& e: entries){
+					expired.push_back(std::move(e._value));
+				}
+				_count -= static_cast<int64_t>(entries.size());
+				entries.clear();
+				_occupied[0] &= ~bit(slot);
+			}
+
+			//	Skip to the next occupied level-0 slot or the next cascade, whichever comes first.
+			const auto later = _occupied[0] & ~((bit(slot) << 1) - 1);
+			const int64_t next = later != 0 ? (_now_tick & ~k_slot_mask) + __builtin_ctzll(later) : (_now_tick | k_slot_mask) + 1;
+			_now_tick = std::min(next, tick + 1);
+			if((_now_tick & k_slot_mask) == 0){
+				cascade();
+			}
+		}
+	}
+
+	//	The first tick when advance() has something to do: expire timers or move them down a level. -1 if empty.
+	public: int64_t get_next_tick() const {
+		if(_count == 0){
+			return -1;
+		}
+
+		for(int level = 0 ; level < k_level_count ; level++){
+			const int shift = level * k_level_bits;
+			const int slot = static_cast<int>((_now_tick >> shift) & k_slot_mask);
+
+			//	Level 0 includes the current slot, higher levels have already moved the current slot down.
+			const auto from = level == 0 ? bit(slot) : (bit(slot) << 1);
+			const auto later = _occupied[level] & ~(from - 1);
+			if(later != 0){
+				const int64_t base = (_now_tick >> (shift + k_level_bits)) << (shift + k_level_bits);
+				return base + (static_cast<int64_t>(__builtin_ctzll(later)) << shift);
+			}
+		}
+
+		//	Only overflow timers: next time the top level wraps around.
+		const int top_shift = k_level_count * k_level_bits;
+		return ((_now_tick >> top_shift) + 1) << top_shift;
+	}
+
+	public: bool empty() const {
+		return _count == 0;
+	}
+
+	public: void clear(){
+		for(int level = 0 ; level < k_level_count ; level++){
+			for(auto& e: _slots[level]){
+				e.clear();
+			}
+			_occupied[level] = 0;
+		}
+		_overflow.clear();
+		_count = 0;
+	}
+
+
+	/////////////////////////////////////		INTERNALS
+
+	private: static const int k_level_bits = 6;
+	private: static const int k_level_count = 4;
+	private: static const int k_slot_count = 1 << k_level_bits;
+	private: static const int64_t k_slot_mask = k_slot_count - 1;
+
+	private: struct entry_t {
+		int64_t _tick;
+		T _value;
+	};
+
+	private: static uint64_t bit(int slot){
+		return static_cast<uint64_t>(1) << slot;
+	}
+
+	private: void insert(entry_t&& entry){
+		QUARK_ASSERT(entry._tick >= _now_tick);
+
+		const auto diff = static_cast<uint64_t>(entry._tick ^ _now_tick);
+		const int level = diff == 0 ? 0 : (63 - __builtin_clzll(diff)) / k_level_bits;
+		if(level >= k_level_count){
+			_overflow.push_back(std::move(entry));
+		}
+		else{
+			const int slot = static_cast<int>((entry._tick >> (level * k_level_bits)) & k_slot_mask);
+			_slots[level][slot].push_back(std::move(entry));
+			_occupied[level] |= bit(slot);
+		}
+	}
+
+	//	Called as soon as now reaches the start of a level-0 turn. Moves timers down from each level whose slot starts
+	//	now. Higher levels first, their timers may land in a lower level's slot that also starts now.
+	private: void cascade(){
+		const int top_shift = k_level_count * k_level_bits;
+		if((_now_tick & ((static_cast<int64_t>(1) << top_shift) - 1)) == 0 && _overflow.empty() == false){
+			auto entries = std::move(_overflow);
+			_overflow.clear();
+			for(auto& e: entries){
+				insert(std::move(e));
+			}
+		}
+
+		for(int level = k_level_count - 1 ; level >= 1 ; level--){
+			const int shift = level * k_level_bits;
+			if((_now_tick & ((static_cast<int64_t>(1) << shift) - 1)) == 0){
+				const int slot = static_cast<int>((_now_tick >> shift) & k_slot_mask);
+				if(_occupied[level] & bit(slot)){
+					auto entries = std::move(_slots[level][slot]);
+					_slots[level][slot].clear();
+					_occupied[level] &= ~bit(slot);
+					for(auto& e: entries){
+						insert(std::move(e));
+					}
+				}
+			}
+		}
+	}
+
+
+	/////////////////////////////////////		STATE
+
+	//	The next tick that advance() will process. All earlier ticks are done, and so is the cascade for this tick.
+	private: int64_t _now_tick;
+	private: int64_t _count;
+
+	private: std::vector<entry_t> _slots[k_level_count][k_slot_count];
+
+	//	Bit n is set when slot n of that level has timers.
+	private: uint64_t _occupied[k_level_count];
+
+	private: std::vector<entry_t> _overflow;
+};
+
+
+
+//////////////////////////////////////		process_message_t
+
+/*
+	A message to a process. Either JSON or a typed Floyd value.
+
+	Typed values are kept in the sending backend's own representation (bc_value_t, runtime_value_t) and are passed
+	by reference -- the value is immutable and reference counted, so it's never copied or serialized. Only the
+	backend knows what _value points to.
+*/
+struct process_message_t {
+	process_message_t(){}
+	process_message_t(const json_t& json) :
+		_json(json)
+	{
+	}
+	process_message_t(const std::shared_ptr<const void>& value) :
+		_value(value)
+	{
+	}
+
+	bool is_stop() const {
+		return _value == nullptr && _json.is_string() && _json.get_string() == "stop";
+	}
+
+
+	/////////////////////////////////////		STATE
+
+	//	Used when _value is nullptr.
+	json_t _json;
+
+	std::shared_ptr<const void> _value;
+};
+
+
+//////////////////////////////////////		process_executor_i
+
+//	Implemented by the backend. Called from the worker threads, never for the same process from two threads at once.
+struct process_executor_i {
+	virtual ~process_executor_i(){};
+	virtual void on_process_init(int process_id) = 0;
+	virtual void on_process_message(int process_id, const process_message_t& message) = 0;
+
+	//	The messages that were waiting in the inbox, in order. Never contains "stop". Override to handle the whole
+	//	batch at once.
+	virtual void on_process_messages(int process_id, const process_message_t messages[], int count){
+		for(int i = 0 ; i < count ; i++){
+			on_process_message(process_id, messages[i]);
+		}
+	}
+};
+
+
+//////////////////////////////////////		process_scheduler_t
+
+
+class process_scheduler_t {
+	//	Each process gets its own clock.
+	public: process_scheduler_t(int process_count, process_executor_i& executor, int thread_count);
+
+	//	process_clocks[process_id] is the clock of each process, clocks are numbered 0 to clock count - 1.
+	public: process_scheduler_t(const std::vector<int>& process_clocks, process_executor_i& executor, int thread_count);
+	public: ~process_scheduler_t();
+
+	//	Call before run(). Default is an unbounded inbox.
+	public: void set_inbox_def(int process_id, const inbox_def_t& def);
+
+	public: struct inbox_stats_t {
+		int _high_water;
+		int64_t _dropped;
+	};
+
+	//	Call after run().
+	public: inbox_stats_t get_inbox_stats(int process_id) const;
+
+	//	Call before run(). Makes clock_id a real-time clock that ticks every period, see REAL-TIME CLOCKS.
+	public: void set_clock_period(int clock_id, std::chrono::nanoseconds period);
+
+	public: struct clock_stats_t {
+		int64_t _tick_count;
+
+		//	Ticks that finished after the next tick was due.
+		int64_t _deadline_misses;
+
+		//	Ticks that never ran because the clock had fallen a whole period behind.
+		int64_t _skipped_ticks;
+
+		//	How late the ticks started.
+		std::chrono::nanoseconds _jitter_mean;
+		std::chrono::nanoseconds _jitter_max;
+
+		//	How long the ticks took to run.
+		std::chrono::nanoseconds _execution_mean;
+		std::chrono::nanoseconds _execution_max;
+	};
+
+	//	Call after run(). All zeros for clocks without a period.
+	public: clock_stats_t get_clock_stats(int clock_id) const;
+
+	//	Thread safe. Can be called from inside process_executor_i.
+	public: void send_message(int process_id, const process_message_t& message);
+
+	//	Thread safe. Sends the message when time has come, or as soon as possible after. Never early.
+	public: void post_message(int process_id, const process_message_t& message, std::chrono::steady_clock::time_point time);
+
+	//	Runs all processes until each one got "stop". The calling thread is one of the worker threads. Real-time clocks
+	//	get their own threads on top of those.
+	//	If a process throws an exception, all processing stops and the exception is rethrown here.
+	public: void run();
+
+	//	One thread per hardware thread, but never more threads than clocks.
+	public: static int get_default_thread_count(int clock_count);
+
+	public: int get_thread_count() const { return _thread_count; }
+
+
+	/////////////////////////////////////		INTERNALS
+
+	private: struct process_t {
+		int _clock;
+
+		inbox_def_t _inbox_def;
+
+		//	Unbounded inbox, used when _inbox_def._capacity == 0.
+		mpsc_queue_t<process_message_t> _inbox;
+
+		//	Bounded inbox, used when _inbox_def._capacity > 0. All protected by _bounded_mutex.
+		std::mutex _bounded_mutex;
+		std::condition_variable _not_full;
+		std::deque<process_message_t> _bounded_inbox;
+		bool _stop_waiting = false;
+
+		//	Messages waiting in the inbox. Senders add, the thread running the clock subtracts.
+		std::atomic<int> _inbox_count { 0 };
+
+		//	Messages popped from the inbox for the current slice. Kept to reuse its memory.
+		std::vector<process_message_t> _batch;
+
+		//	Only touched by the thread running the clock.
+		int _high_water = 0;
+
+		std::atomic<int64_t> _dropped { 0 };
+
+		//	Only set by the thread running the clock. Senders read it to drop messages to stopped processes.
+		std::atomic<bool> _stopped { false };
+
+		//	Only touched by the thread running the clock.
+		bool _init_done = false;
+		bool _busy = false;
+	};
+
+	private: struct clock_state_t {
+		std::vector<int> _process_ids;
+
+		//	True while the clock is in the run queue or being run. Always true for real-time clocks so senders never
+		//	put them in the run queue.
+		std::atomic<bool> _scheduled { false };
+
+		//	Real-time clocks only. The stats are only touched by the clock's own thread.
+		std::chrono::nanoseconds _period { 0 };
+		int64_t _tick_count = 0;
+		int64_t _deadline_misses = 0;
+		int64_t _skipped_ticks = 0;
+		int64_t _jitter_sum_ns = 0;
+		int64_t _jitter_max_ns = 0;
+		int64_t _execution_sum_ns = 0;
+		int64_t _execution_max_ns = 0;
+	};
+
+	private: void worker_loop();
+	private: bool pop_run_queue(int& clock_id);
+	private: void run_slice(int clock_id);
+	private: void real_time_loop(int clock_id);
+	private: bool run_tick(int clock_id);
+	private: void ensure_init(int process_id);
+	private: void deliver(int process_id, const process_message_t messages[], int count);
+	private: void enqueue(int clock_id);
+	private: void push_bounded(process_t& process, const process_message_t& message);
+	private: void take_batch(process_t& process);
+	private: void drop_inbox(process_t& process);
+	private: bool is_inbox_empty(process_t& process);
+	private: void fire_timers();
+	private: void park(std::unique_lock<std::mutex>& lk);
+	private: void stop_with_exception(std::exception_ptr exception);
+
+
+	/////////////////////////////////////		STATE
+
+	private: process_executor_i& _executor;
+	private: const int _thread_count;
+	private: const int _spin_count;
+	private: const std::chrono::steady_clock::time_point _start_time;
+	private: std::vector<std::unique_ptr<process_t>> _processes;
+	private: std::vector<std::unique_ptr<clock_state_t>> _clocks;
+
+	private: std::mutex _run_queue_mutex;
+	private: std::condition_variable _run_queue_condition_variable;
+	private: std::deque<int> _run_queue;
+
+	//	Mirrors _run_queue.size() so idle workers can spin without taking the lock.
+	private: std::atomic<int> _run_queue_count;
+
+	//	Workers waiting on _run_queue_condition_variable. Protected by _run_queue_mutex.
+	private: int _parked_count;
+
+	//	The parked worker that sleeps until the next timer waits on this instead. Protected by _run_queue_mutex.
+	private: std::condition_variable _timer_condition_variable;
+	private: bool _timer_keeper_parked;
+
+	//	Real-time clock threads sleep on this between ticks, so they wake up at once when all processes have stopped.
+	private: std::condition_variable _real_time_condition_variable;
+
+	private: struct timer_t {
+		int _process_id;
+		process_message_t _message;
+	};
+	private: std::mutex _timers_mutex;
+	private: timer_wheel_t<timer_t> _timers;
+
+	//	When the next timer is due, in nanoseconds from _start_time. Lets workers check without taking the lock.
+	private: std::atomic<int64_t> _next_timer_ns;
+
+	private: int _stopped_count;
+	private: std::atomic<bool> _done;
+	private: std::exception_ptr _exception;
+};
+
+
+}	// floyd
+
+#endif /* floyd_scheduler_hpp */
@@ -0,0 +1,837 @@
+//
+//  floyd_shm_transport.cpp
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-07-16.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#include "floyd_shm_transport.h"
+
+#include "text_parser.h"
+#include "quark.h"
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <vector>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+
+namespace floyd {
+
+
+//	"floydrng"
+static const uint64_t k_ring_magic = 0x666C6F7964726E67ULL;
+
+static const size_t k_cache_line_size = 64;
+
+//	Records start at multiples of this. Also the size of record_header_t, so a pad record always fits before the end.
+static const size_t k_record_alignment = 16;
+
+//	How many times a side checks the other side's position before it sleeps.
+static const int k_spin_count = 64;
+
+//	Longest sleep before checking again for close or a crashed peer.
+static const auto k_wait_timeout = std::chrono::milliseconds(10);
+
+
+//////////////////////////////////////		shm_ring_header_t
+
+
+//	Lives at the start of the shared memory, the ring's data follows on the next cache line.
+struct shm_ring_header_t {
+	std::atomic<uint64_t> _magic;
+	uint64_t _capacity;
+
+	//	Only used for sleeping, see wait_readable() and wait_writable().
+	pthread_mutex_t _mutex;
+	pthread_cond_t _readable;
+	pthread_cond_t _writable;
+	std::atomic<uint32_t> _reader_waiting;
+	std::atomic<uint32_t> _writer_waiting;
+
+	std::atomic<uint32_t> _writer_closed;
+	std::atomic<uint32_t> _reader_closed;
+
+	//	The OS processes of each side, to notice if one dies without closing. 0 = the writer hasn't opened the ring yet.
+	std::atomic<pid_t> _reader_pid;
+	std::atomic<pid_t> _writer_pid;
+
+	//	Positions count bytes since the ring was created, they never wrap. Offset in the ring = position & (capacity - 1).
+	alignas(k_cache_line_size) std::atomic<uint64_t> _write_pos;
+	alignas(k_cache_line_size) std::atomic<uint64_t> _read_pos;
+};
+
+struct record_header_t {
+	uint32_t _size;
+	uint16_t _kind;
+	uint16_t _unused0;
+	int32_t _process_handle;
+	uint32_t _unused1;
+};
+static_assert(sizeof(record_header_t) == k_record_alignment, "");
+
+static size_t round_up(size_t value, size_t alignment){
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static size_t get_record_size(size_t payload_size){
+	return round_up(sizeof(record_header_t) + payload_size, k_record_alignment);
+}
+
+static size_t get_data_offset(){
+	return round_up(sizeof(shm_ring_header_t), k_cache_line_size);
+}
+
+//	The mutex is robust: if the other OS process dies holding it, we get it with EOWNERDEAD. It only guards sleeping,
+//	there's no state to repair. macOS has no robust mutexes.
+static void make_consistent(int lock_result, pthread_mutex_t& mutex){
+#if defined(__APPLE__)
+	(void)lock_result;
+	(void)mutex;
+#else
+	if(lock_result == EOWNERDEAD){
+		pthread_mutex_consistent(&mutex);
+	}
+#endif
+}
+
+static void lock(pthread_mutex_t& mutex){
+	make_consistent(pthread_mutex_lock(&mutex), mutex);
+}
+
+static void wait_for(pthread_cond_t& cond, pthread_mutex_t& mutex, std::chrono::milliseconds timeout){
+	//	pthread_cond_timedwait() takes the wall clock time, macOS can't switch it to a monotonic clock.
+	timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	const auto ns = static_cast<int64_t>(ts.tv_nsec) + std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+	ts.tv_sec += static_cast<time_t>(ns / 1000000000);
+	ts.tv_nsec = static_cast<long>(ns % 1000000000);
+	make_consistent(pthread_cond_timedwait(&cond, &mutex, &ts), mutex);
+}
+
+static void signal(pthread_cond_t& cond, pthread_mutex_t& mutex){
+	lock(mutex);
+	pthread_cond_signal(&cond);
+	pthread_mutex_unlock(&mutex);
+}
+
+//	kill() with signal 0 only checks that the process exists. EPERM means it exists but isn't ours.
+static bool is_process_alive(pid_t pid){
+	return pid == 0 || kill(pid, 0) == 0 || errno == EPERM;
+}
+
+
+//////////////////////////////////////		shm_ring_t
+
+
+shm_ring_t::shm_ring_t(const std::string& name, size_t capacity) :
+	_name(name),
+	_owner(true),
+	_mapped_size(0),
+	_header(nullptr),
+	_data(nullptr),
+	_pending_pos(0)
+{
+	QUARK_ASSERT(capacity > 0);
+
+	size_t capacity2 = k_cache_line_size;
+	while(capacity2 < capacity){
+		capacity2 = capacity2 * 2;
+	}
+
+	//	A ring left behind by a crashed OS process has the same name. Replace it.
+	shm_unlink(name.c_str());
+	const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	if(fd == -1){
+		quark::throw_runtime_error("Cannot create shared memory ring \"" + name + "\".");
+	}
+	const auto size = get_data_offset() + capacity2;
+	if(ftruncate(fd, static_cast<off_t>(size)) != 0){
+		close(fd);
+		shm_unlink(name.c_str());
+		quark::throw_runtime_error("Cannot size shared memory ring \"" + name + "\".");
+	}
+	map(fd, size);
+
+	auto header = new (_header) shm_ring_header_t();
+	header->_capacity = capacity2;
+
+	pthread_mutexattr_t mutex_attr;
+	pthread_mutexattr_init(&mutex_attr);
+	pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
+#if !defined(__APPLE__)
+	pthread_mutexattr_setrobust(&mutex_attr, PTHREAD_MUTEX_ROBUST);
+#endif
+	pthread_mutex_init(&header->_mutex, &mutex_attr);
+	pthread_mutexattr_destroy(&mutex_attr);
+
+	pthread_condattr_t cond_attr;
+	pthread_condattr_init(&cond_attr);
+	pthread_condattr_setpshared(&cond_attr, PTHREAD_PROCESS_SHARED);
+	pthread_cond_init(&header->_readable, &cond_attr);
+	pthread_cond_init(&header->_writable, &cond_attr);
+	pthread_condattr_destroy(&cond_attr);
+
+	header->_reader_waiting = 0;
+	header->_writer_waiting = 0;
+	header->_writer_closed = 0;
+	header->_reader_closed = 0;
+	header->_reader_pid = getpid();
+	header->_writer_pid = 0;
+	header->_write_pos = 0;
+	header->_read_pos = 0;
+
+	//	Last: the other side checks the magic before it uses anything else.
+	header->_magic.store(k_ring_magic, std::memory_order_release);
+
+	QUARK_ASSERT(check_invariant());
+}
+
+shm_ring_t::shm_ring_t(const std::string& name) :
+	_name(name),
+	_owner(false),
+	_mapped_size(0),
+	_header(nullptr),
+	_data(nullptr),
+	_pending_pos(0)
+{
+	const int fd = shm_open(name.c_str(), O_RDWR, 0600);
+	if(fd == -1){
+		quark::throw_runtime_error("Cannot open shared memory ring \"" + name + "\".");
+	}
+	struct stat st;
+	if(fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < get_data_offset()){
+		close(fd);
+		quark::throw_runtime_error("Shared memory ring \"" + name + "\" is not ready.");
+	}
+	map(fd, static_cast<size_t>(st.st_size));
+
+	if(_header->_magic.load(std::memory_order_acquire) != k_ring_magic || get_data_offset() + _header->_capacity != _mapped_size){
+		munmap(_header, _mapped_size);
+		quark::throw_runtime_error("Shared memory ring \"" + name + "\" is not ready.");
+	}
+	_header->_writer_pid.store(getpid());
+
+	QUARK_ASSERT(check_invariant());
+}
+
+void shm_ring_t::map(int fd, size_t size){
+	const auto p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(p == MAP_FAILED){
+		if(_owner){
+			shm_unlink(_name.c_str());
+		}
+		quark::throw_runtime_error("Cannot map shared memory ring \"" + _name + "\".");
+	}
+	_mapped_size = size;
+	_header = static_cast<shm_ring_header_t*>(p);
+	_data = static_cast<uint8_t*>(p) + get_data_offset();
+}
+
+shm_ring_t::~shm_ring_t(){
+	QUARK_ASSERT(check_invariant());
+
+	//	The mutex and condition variables are left alone: the other side may still use them.
+	munmap(_header, _mapped_size);
+	if(_owner){
+		shm_unlink(_name.c_str());
+	}
+}
+
+bool shm_ring_t::check_invariant() const {
+	QUARK_ASSERT(_header != nullptr);
+	QUARK_ASSERT(_data == reinterpret_cast<uint8_t*>(_header) + get_data_offset());
+	QUARK_ASSERT((_header->_capacity & (_header->_capacity - 1)) == 0);
+	QUARK_ASSERT(_header->_write_pos - _header->_read_pos <= _header->_capacity);
+	return true;
+}
+
+size_t shm_ring_t::get_capacity() const {
+	return _header->_capacity;
+}
+
+size_t shm_ring_t::get_max_payload_size() const {
+	return _header->_capacity / 2 - sizeof(record_header_t);
+}
+
+
+/////////////////////////////////////		WRITER
+
+
+uint8_t* shm_ring_t::begin_write(shm_payload_t kind, int32_t process_handle, size_t size){
+	QUARK_ASSERT(check_invariant());
+	QUARK_ASSERT(kind != shm_payload_t::k_pad);
+
+	if(size > get_max_payload_size()){
+		quark::throw_runtime_error("Message too big for shared memory ring \"" + _name + "\".");
+	}
+
+	const auto capacity = _header->_capacity;
+	const auto record_size = get_record_size(size);
+	auto pos = _header->_write_pos.load(std::memory_order_relaxed);
+	const auto to_end = capacity - (pos & (capacity - 1));
+
+	//	A record that doesn't fit before the end also needs room for the pad.
+	wait_writable(record_size <= to_end ? record_size : to_end + record_size);
+
+	if(record_size > to_end){
+		auto pad = reinterpret_cast<record_header_t*>(_data + (pos & (capacity - 1)));
+		pad->_size = static_cast<uint32_t>(to_end - sizeof(record_header_t));
+		pad->_kind = static_cast<uint16_t>(shm_payload_t::k_pad);
+		pad->_process_handle = -1;
+		pos = pos + to_end;
+	}
+
+	auto header = reinterpret_cast<record_header_t*>(_data + (pos & (capacity - 1)));
+	header->_size = static_cast<uint32_t>(size);
+	header->_kind = static_cast<uint16_t>(kind);
+	header->_process_handle = process_handle;
+	_pending_pos = pos + record_size;
+	return reinterpret_cast<uint8_t*>(header + 1);
+}
+
+void shm_ring_t::end_write(){
+	QUARK_ASSERT(check_invariant());
+
+	//	seq_cst store then load, the reader does the opposite: one of us is sure to see the other. See wait_readable().
+	_header->_write_pos.store(_pending_pos);
+	if(_header->_reader_waiting.load() != 0){
+		signal(_header->_readable, _header->_mutex);
+	}
+}
+
+void shm_ring_t::wait_writable(size_t record_size){
+	const auto has_room = [&](){
+		return _header->_capacity - (_header->_write_pos.load(std::memory_order_relaxed) - _header->_read_pos.load()) >= record_size;
+	};
+
+	for(int i = 0 ; i < k_spin_count ; i++){
+		if(_header->_reader_closed.load() != 0){
+			quark::throw_runtime_error("Shared memory ring \"" + _name + "\" was closed by the receiver.");
+		}
+		if(has_room()){
+			return;
+		}
+	}
+
+	while(true){
+		lock(_header->_mutex);
+		_header->_writer_waiting.store(1);
+		const bool wait = has_room() == false && _header->_reader_closed.load() == 0;
+		if(wait){
+			wait_for(_header->_writable, _header->_mutex, k_wait_timeout);
+		}
+		_header->_writer_waiting.store(0);
+		pthread_mutex_unlock(&_header->_mutex);
+
+		if(_header->_reader_closed.load() != 0){
+			quark::throw_runtime_error("Shared memory ring \"" + _name + "\" was closed by the receiver.");
+		}
+		if(has_room()){
+			return;
+		}
+		if(is_process_alive(_header->_reader_pid.load()) == false){
+			quark::throw_runtime_error("Shared memory ring \"" + _name + "\": the receiver's OS process has died.");
+		}
+	}
+}
+
+void shm_ring_t::close_writer(){
+	QUARK_ASSERT(check_invariant());
+
+	_header->_writer_closed.store(1);
+	signal(_header->_readable, _header->_mutex);
+}
+
+
+/////////////////////////////////////		READER
+
+
+bool shm_ring_t::begin_read(record_t& out){
+	QUARK_ASSERT(check_invariant());
+
+	const auto capacity = _header->_capacity;
+	while(true){
+		const auto pos = _header->_read_pos.load(std::memory_order_relaxed);
+		if(pos == _header->_write_pos.load(std::memory_order_acquire)){
+			return false;
+		}
+
+		const auto header = reinterpret_cast<const record_header_t*>(_data + (pos & (capacity - 1)));
+		const auto kind = static_cast<shm_payload_t>(header->_kind);
+		const auto record_size = get_record_size(header->_size);
+		if(record_size > capacity - (pos & (capacity - 1)) || (kind != shm_payload_t::k_pad && header->_size > get_max_payload_size())){
+			quark::throw_runtime_error("Shared memory ring \"" + _name + "\" is corrupt.");
+		}
+
+		if(kind == shm_payload_t::k_pad){
+			_pending_pos = pos + record_size;
+			end_read();
+		}
+		else if(kind == shm_payload_t::k_json || kind == shm_payload_t::k_flat){
+			out = record_t{ kind, header->_process_handle, reinterpret_cast<const uint8_t*>(header + 1), header->_size };
+			_pending_pos = pos + record_size;
+			return true;
+		}
+		else{
+			quark::throw_runtime_error("Shared memory ring \"" + _name + "\" is corrupt.");
+		}
+	}
+}
+
+void shm_ring_t::end_read(){
+	QUARK_ASSERT(check_invariant());
+
+	_header->_read_pos.store(_pending_pos);
+	if(_header->_writer_waiting.load() != 0){
+		signal(_header->_writable, _header->_mutex);
+	}
+}
+
+/*
+	The reader sets _reader_waiting then checks the write position, the writer stores the write position then checks
+	_reader_waiting. Either the reader sees the new record or the writer sees the flag. In the second case the writer
+	signals under the mutex, which the reader holds until it's inside pthread_cond_timedwait(), so the signal can't
+	be lost.
+*/
+bool shm_ring_t::wait_readable(std::chrono::milliseconds timeout){
+	QUARK_ASSERT(check_invariant());
+
+	const auto has_record = [&](){
+		return _header->_read_pos.load(std::memory_order_relaxed) != _header->_write_pos.load();
+	};
+
+	for(int i = 0 ; i < k_spin_count ; i++){
+		if(has_record()){
+			return true;
+		}
+	}
+
+	lock(_header->_mutex);
+	_header->_reader_waiting.store(1);
+	if(has_record() == false && _header->_writer_closed.load() == 0){
+		wait_for(_header->_readable, _header->_mutex, timeout);
+	}
+	_header->_reader_waiting.store(0);
+	pthread_mutex_unlock(&_header->_mutex);
+
+	if(has_record()){
+		return true;
+	}
+
+	//	A writer that died can't close the ring, do it for it. Records it published before are still read.
+	if(_header->_writer_closed.load() == 0 && is_process_alive(_header->_writer_pid.load()) == false){
+		_header->_writer_closed.store(1);
+	}
+	return has_record();
+}
+
+bool shm_ring_t::is_writer_closed() const {
+	return _header->_writer_closed.load() != 0;
+}
+
+void shm_ring_t::close_reader(){
+	QUARK_ASSERT(check_invariant());
+
+	_header->_reader_closed.store(1);
+	signal(_header->_writable, _header->_mutex);
+}
+
+
+
+//////////////////////////////////////		shm_sender_t
+
+
+shm_sender_t::shm_sender_t(const std::string& ring_name) :
+	_ring(ring_name)
+{
+}
+
+shm_sender_t::~shm_sender_t(){
+	_ring.close_writer();
+}
+
+void shm_sender_t::send(int process_handle, const json_t& message){
+	const auto s = json_to_compact_string(message);
+	auto p = _ring.begin_write(shm_payload_t::k_json, process_handle, s.size());
+	std::memcpy(p, s.data(), s.size());
+	_ring.end_write();
+}
+
+uint8_t* shm_sender_t::begin_flat(int process_handle, size_t size){
+	return _ring.begin_write(shm_payload_t::k_flat, process_handle, size);
+}
+
+void shm_sender_t::end_flat(){
+	_ring.end_write();
+}
+
+void shm_sender_t::send_flat(int process_handle, const void* data, size_t size){
+	auto p = _ring.begin_write(shm_payload_t::k_flat, process_handle, size);
+	std::memcpy(p, data, size);
+	_ring.end_write();
+}
+
+void shm_sender_t::close(){
+	_ring.close_writer();
+}
+
+
+
+//////////////////////////////////////		shm_receiver_t
+
+
+shm_receiver_t::shm_receiver_t(const std::string& ring_name, size_t capacity, process_scheduler_t& scheduler, int process_count, const flat_reader_t& flat_reader) :
+	_ring(ring_name, capacity),
+	_scheduler(scheduler),
+	_process_count(process_count),
+	_flat_reader(flat_reader)
+{
+}
+
+shm_receiver_t::~shm_receiver_t(){
+	stop();
+}
+
+void shm_receiver_t::start(){
+	QUARK_ASSERT(_thread.joinable() == false);
+
+	_thread = std::thread([this](){ pump(); });
+}
+
+void shm_receiver_t::join(){
+	if(_thread.joinable()){
+		_thread.join();
+	}
+	if(_exception){
+		std::rethrow_exception(_exception);
+	}
+}
+
+void shm_receiver_t::stop(){
+	_stop = true;
+	if(_thread.joinable()){
+		_thread.join();
+	}
+	_ring.close_reader();
+}
+
+void shm_receiver_t::pump(){
+	try {
+		while(_stop == false){
+			//	Check before reading: records written before the close are visible once we see it.
+			const bool closed = _ring.is_writer_closed();
+
+			shm_ring_t::record_t record;
+			if(_ring.begin_read(record)){
+				deliver(record);
+				_ring.end_read();
+				_message_count++;
+			}
+			else if(closed){
+				break;
+			}
+			else{
+				_ring.wait_readable(k_wait_timeout);
+			}
+		}
+	}
+	catch(...){
+		_exception = std::current_exception();
+		_ring.close_reader();
+	}
+}
+
+void shm_receiver_t::deliver(const shm_ring_t::record_t& record){
+	if(record._process_handle < 0 || record._process_handle >= _process_count){
+		quark::throw_runtime_error("Shared memory ring: no process with handle " + std::to_string(record._process_handle) + ".");
+	}
+
+	const auto chars = reinterpret_cast<const char*>(record._payload);
+	if(record._kind == shm_payload_t::k_json){
+		const auto result = parse_json(seq_t(std::string(chars, record._size)));
+		_scheduler.send_message(record._process_handle, process_message_t(result.first));
+	}
+	else if(_flat_reader){
+		_scheduler.send_message(record._process_handle, _flat_reader(record._process_handle, record._payload, record._size));
+	}
+	else{
+		_scheduler.send_message(record._process_handle, process_message_t(json_t(std::string(chars, record._size))));
+	}
+}
+
+
+
+//////////////////////////////////////		TESTS
+
+
+static std::string make_test_ring_name(const std::string& suffix){
+	return "/floyd-test-" + std::to_string(getpid()) + "-" + suffix;
+}
+
+//	Payload i is i % 251 bytes, each byte is (i + byte index) & 0xff.
+static size_t get_test_payload_size(int i){
+	return static_cast<size_t>(i % 251);
+}
+
+static bool check_test_payload(int i, const uint8_t* data, size_t size){
+	if(size != get_test_payload_size(i)){
+		return false;
+	}
+	for(size_t b = 0 ; b < size ; b++){
+		if(data[b] != static_cast<uint8_t>(i + b)){
+			return false;
+		}
+	}
+	return true;
+}
+
+static void write_test_payloads(shm_ring_t& ring, int count){
+	for(int i = 0 ; i < count ; i++){
+		const auto size = get_test_payload_size(i);
+		auto p = ring.begin_write(shm_payload_t::k_flat, i, size);
+		for(size_t b = 0 ; b < size ; b++){
+			p[b] = static_cast<uint8_t>(i + b);
+		}
+		ring.end_write();
+	}
+}
+
+//	Returns how many records arrived intact and in order.
+static int read_test_payloads(shm_ring_t& ring, int count){
+	int ok_count = 0;
+	int i = 0;
+	while(i < count){
+		shm_ring_t::record_t record;
+		if(ring.begin_read(record)){
+			if(record._process_handle == i && check_test_payload(i, record._payload, record._size)){
+				ok_count++;
+			}
+			ring.end_read();
+			i++;
+		}
+		else{
+			ring.wait_readable(k_wait_timeout);
+		}
+	}
+	return ok_count;
+}
+
+
+QUARK_UNIT_TEST("shm_ring_t", "begin_read()", "wraps around, pads, keeps order", ""){
+	const auto name = make_test_ring_name("wrap");
+	shm_ring_t reader(name, 1024);
+	shm_ring_t writer(name);
+	QUARK_UT_VERIFY(writer.get_capacity() == 1024);
+
+	//	Write a few records at a time so the ring wraps many times without ever getting full.
+	int ok_count = 0;
+	for(int i = 0 ; i < 2000 ; i++){
+		const auto size = get_test_payload_size(i);
+		auto p = writer.begin_write(shm_payload_t::k_flat, i, size);
+		for(size_t b = 0 ; b < size ; b++){
+			p[b] = static_cast<uint8_t>(i + b);
+		}
+		writer.end_write();
+
+		shm_ring_t::record_t record;
+		QUARK_UT_VERIFY(reader.begin_read(record));
+		if(record._process_handle == i && record._kind == shm_payload_t::k_flat && check_test_payload(i, record._payload, record._size)){
+			ok_count++;
+		}
+		reader.end_read();
+	}
+	QUARK_UT_VERIFY(ok_count == 2000);
+
+	shm_ring_t::record_t record;
+	QUARK_UT_VERIFY(reader.begin_read(record) == false);
+}
+
+QUARK_UNIT_TEST("shm_ring_t", "begin_write()", "writer waits while the ring is full", ""){
+	const auto name = make_test_ring_name("full");
+	shm_ring_t reader(name, 1024);
+	shm_ring_t writer(name);
+
+	const int count = 20000;
+	std::thread thread([&](){ write_test_payloads(writer, count); });
+	const auto ok_count = read_test_payloads(reader, count);
+	thread.join();
+	QUARK_UT_VERIFY(ok_count == count);
+}
+
+QUARK_UNIT_TEST("shm_ring_t", "begin_write()", "payload too big throws", ""){
+	const auto name = make_test_ring_name("big");
+	shm_ring_t reader(name, 1024);
+	shm_ring_t writer(name);
+	try {
+		writer.begin_write(shm_payload_t::k_flat, 0, 1024);
+		QUARK_UT_VERIFY(false);
+	}
+	catch(const std::runtime_error& e){
+	}
+}
+
+
+namespace {
+
+//	Records every message. The last message to each process is "stop".
+struct test_shm_executor_t : public process_executor_i {
+	virtual void on_process_init(int){
+	}
+	virtual void on_process_message(int process_id, const process_message_t& message){
+		_messages[process_id].push_back(message);
+	}
+
+	std::vector<std::vector<process_message_t>> _messages = std::vector<std::vector<process_message_t>>(2);
+};
+
+}
+
+QUARK_UNIT_TEST("shm_receiver_t", "start()", "json and flat messages reach the processes", ""){
+	const auto name = make_test_ring_name("receiver");
+	test_shm_executor_t executor;
+	process_scheduler_t scheduler(2, executor, 2);
+
+	//	Sums the flat payload's bytes, reading them in place.
+	const auto flat_reader = [](int, const uint8_t* data, size_t size){
+		int sum = 0;
+		for(size_t i = 0 ; i < size ; i++){
+			sum += data[i];
+		}
+		return process_message_t(json_t(sum));
+	};
+	shm_receiver_t receiver(name, 4096, scheduler, 2, flat_reader);
+	receiver.start();
+
+	std::thread thread([&](){
+		shm_sender_t sender(name);
+		sender.send(0, json_t::make_object({ { "x", 3.0 } }));
+		auto p = sender.begin_flat(1, 3);
+		p[0] = 1;
+		p[1] = 2;
+		p[2] = 3;
+		sender.end_flat();
+		sender.send(1, json_t("hello"));
+		sender.send(0, json_t("stop"));
+		sender.send(1, json_t("stop"));
+		sender.close();
+	});
+
+	scheduler.run();
+	thread.join();
+	receiver.join();
+
+	QUARK_UT_VERIFY(receiver.get_message_count() == 5);
+	QUARK_UT_VERIFY(executor._messages[0].size() == 1);
+	QUARK_UT_VERIFY(executor._messages[0][0]._json == json_t::make_object({ { "x", 3.0 } }));
+	QUARK_UT_VERIFY(executor._messages[1].size() == 2);
+	QUARK_UT_VERIFY(executor._messages[1][0]._json == json_t(6));
+	QUARK_UT_VERIFY(executor._messages[1][1]._json == json_t("hello"));
+}
+
+QUARK_UNIT_TEST("shm_receiver_t", "join()", "bad process handle is rethrown", ""){
+	const auto name = make_test_ring_name("bad-handle");
+	test_shm_executor_t executor;
+	process_scheduler_t scheduler(2, executor, 1);
+	shm_receiver_t receiver(name, 4096, scheduler, 2);
+	receiver.start();
+	{
+		shm_sender_t sender(name);
+		sender.send(7, json_t("hello"));
+	}
+	try {
+		receiver.join();
+		QUARK_UT_VERIFY(false);
+	}
+	catch(const std::runtime_error& e){
+	}
+}
+
+QUARK_UNIT_TEST("shm_ring_t", "begin_read()", "writer in another OS process", ""){
+	const auto name = make_test_ring_name("fork");
+	shm_ring_t reader(name, 4096);
+
+	const int count = 20000;
+	const auto pid = fork();
+	if(pid == 0){
+		int exit_code = 0;
+		try {
+			shm_ring_t writer(name);
+			write_test_payloads(writer, count);
+			writer.close_writer();
+		}
+		catch(...){
+			exit_code = 1;
+		}
+		_exit(exit_code);
+	}
+	QUARK_UT_VERIFY(pid > 0);
+
+	const auto ok_count = read_test_payloads(reader, count);
+	int status = 0;
+	waitpid(pid, &status, 0);
+	QUARK_UT_VERIFY(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	QUARK_UT_VERIFY(ok_count == count);
+
+	//	The close comes after the last record.
+	shm_ring_t::record_t record;
+	QUARK_UT_VERIFY(reader.begin_read(record) == false);
+	QUARK_UT_VERIFY(reader.is_writer_closed());
+}
+
+QUARK_UNIT_TEST("shm_ring_t", "wait_readable()", "writer process dies without closing", "ring counts as closed"){
+	const auto name = make_test_ring_name("dead-writer");
+	shm_ring_t reader(name, 4096);
+
+	const auto pid = fork();
+	if(pid == 0){
+		shm_ring_t writer(name);
+		write_test_payloads(writer, 10);
+		_exit(0);
+	}
+	QUARK_UT_VERIFY(pid > 0);
+	int status = 0;
+	waitpid(pid, &status, 0);
+
+	QUARK_UT_VERIFY(read_test_payloads(reader, 10) == 10);
+	QUARK_UT_VERIFY(reader.is_writer_closed() == false);
+	QUARK_UT_VERIFY(reader.wait_readable(k_wait_timeout) == false);
+	QUARK_UT_VERIFY(reader.is_writer_closed());
+}
+
+QUARK_UNIT_TEST("shm_ring_t", "begin_write()", "reader process dies while the ring is full", "throws"){
+	const auto name = make_test_ring_name("dead-reader");
+
+	//	The reader creates the ring then dies. _exit() skips ~shm_ring_t() so the ring stays.
+	const auto pid = fork();
+	if(pid == 0){
+		new shm_ring_t(name, 1024);
+		_exit(0);
+	}
+	QUARK_UT_VERIFY(pid > 0);
+	int status = 0;
+	waitpid(pid, &status, 0);
+
+	try {
+		shm_ring_t writer(name);
+		write_test_payloads(writer, 2000);
+		QUARK_UT_VERIFY(false);
+	}
+	catch(const std::runtime_error& e){
+		QUARK_UT_VERIFY(std::string(e.what()).find("has died") != std::string::npos);
+	}
+	shm_unlink(name.c_str());
+}
+
+
+}	// floyd
@@ -0,0 +1,224 @@
+//
+//  floyd_shm_transport.h
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-07-16.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#ifndef floyd_shm_transport_hpp
+#define floyd_shm_transport_hpp
+
+/*
+	Sends process messages between OS processes on the same machine, through ring buffers in POSIX shared memory.
+
+	- One ring carries messages in one direction, from one sending OS process to one receiving OS process. Two
+		containers that talk both ways use two rings.
+	- The receiving side creates the ring and names it, the sending side opens it by name. The name looks like a file
+		name: "/floyd-ui-to-audio".
+	- Each message is addressed to a process of the receiving container, by its process handle (the index of the
+		process, see get_process_handle()). The receiver hands it to its process_scheduler_t.
+
+	PAYLOADS
+	- JSON: the sender serializes the message to a compact JSON string and copies it into the ring. The receiver
+		parses it.
+	- Flat: a block of bytes with no pointers in it -- a vector of numbers, a sample buffer, a pixel row. The sender
+		gets a pointer into the ring and writes the bytes there itself, the receiver reads them where they are: no
+		serialization and no copies in between (zero-copy). A flat reader decides what message to make from the bytes.
+		Without one, the message is a JSON string holding the bytes.
+
+	RING
+	Single producer / single consumer. The writer owns the write position, the reader the read position, and they
+	live on separate cache lines. Records are 16-byte aligned and never wrap: if a record doesn't fit before the end
+	of the ring the writer pads to the end and starts over from the beginning. So a record can be at most half the
+	ring's capacity.
+
+	Neither side takes a lock unless it has to wait: the reader for an empty ring, the writer for a full one. Then it
+	sets a "waiting" flag in the ring and sleeps on a process-shared condition variable. The other side only takes
+	the lock and signals when it sees that flag.
+
+	A crashed peer can't hang us forever. The ring holds the pid of each side, and a side that is still waiting after
+	a timeout checks that the other OS process is alive. A writer whose reader has died throws, a reader whose writer
+	has died sees the ring as closed. The mutex is robust, so a peer that dies holding it doesn't block us either.
+*/
+
+#include "floyd_scheduler.h"
+#include "json_support.h"
+
+#include <string>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+
+namespace floyd {
+
+
+//////////////////////////////////////		shm_ring_t
+
+
+enum class shm_payload_t : uint16_t {
+	//	Writer skips the rest of the ring. Never returned by the reader.
+	k_pad = 0,
+
+	k_json = 1,
+	k_flat = 2
+};
+
+struct shm_ring_header_t;
+
+//	One mapping of a ring. Not thread safe: one thread writes, one thread reads.
+class shm_ring_t {
+	//	Creates the shared memory object and maps it. capacity is rounded up to a power of 2. The name is unlinked when
+	//	this object is destroyed -- mappings the other side already has keep working.
+	public: shm_ring_t(const std::string& name, size_t capacity);
+
+	//	Opens and maps a ring another OS process created. The side that opens the ring is its writer.
+	public: explicit shm_ring_t(const std::string& name);
+
+	public: ~shm_ring_t();
+
+	public: shm_ring_t(const shm_ring_t& other) = delete;
+	public: shm_ring_t& operator=(const shm_ring_t& other) = delete;
+
+	public: bool check_invariant() const;
+
+	public: size_t get_capacity() const;
+
+	//	Largest payload that fits in one record.
+	public: size_t get_max_payload_size() const;
+
+
+	/////////////////////////////////////		WRITER
+
+	//	Reserves a record and returns where to write its payload. Waits while the ring is full. Call end_write() to
+	//	publish the record. Throws if the payload is too big or the reader has closed.
+	public: uint8_t* begin_write(shm_payload_t kind, int32_t process_handle, size_t size);
+	public: void end_write();
+
+	//	The reader sees this after it has read all records.
+	public: void close_writer();
+
+
+	/////////////////////////////////////		READER
+
+	public: struct record_t {
+		shm_payload_t _kind;
+		int32_t _process_handle;
+
+		//	Points into the ring, valid until end_read().
+		const uint8_t* _payload;
+		size_t _size;
+	};
+
+	//	Returns false if the ring is empty. Call end_read() when done with the record's payload.
+	public: bool begin_read(record_t& out);
+	public: void end_read();
+
+	//	Waits until there is a record to read, the writer has closed or timeout. Returns true if there's a record.
+	//	If the writer's OS process has died it closes the writer side for it.
+	public: bool wait_readable(std::chrono::milliseconds timeout);
+
+	public: bool is_writer_closed() const;
+
+	//	The writer sees this at its next write.
+	public: void close_reader();
+
+
+	/////////////////////////////////////		STATE
+
+	private: void map(int fd, size_t size);
+	private: void wait_writable(size_t record_size);
+
+	private: std::string _name;
+	private: bool _owner;
+	private: size_t _mapped_size;
+	private: shm_ring_header_t* _header;
+	private: uint8_t* _data;
+
+	//	Where this side's position goes at end_write() / end_read().
+	private: uint64_t _pending_pos;
+};
+
+
+//////////////////////////////////////		shm_sender_t
+
+
+//	The sending end. Messages to the same process arrive in the order they were sent.
+class shm_sender_t {
+	public: explicit shm_sender_t(const std::string& ring_name);
+	public: ~shm_sender_t();
+
+	public: void send(int process_handle, const json_t& message);
+
+	//	Zero-copy: write size bytes to the returned pointer, then call end_flat().
+	public: uint8_t* begin_flat(int process_handle, size_t size);
+	public: void end_flat();
+
+	//	Copies data into the ring.
+	public: void send_flat(int process_handle, const void* data, size_t size);
+
+	//	The receiver stops after it has delivered all messages sent before this.
+	public: void close();
+
+
+	/////////////////////////////////////		STATE
+
+	private: shm_ring_t _ring;
+};
+
+
+//////////////////////////////////////		shm_receiver_t
+
+
+/*
+	The receiving end. Creates the ring, then a thread that takes each message from the ring and sends it to a process
+	using process_scheduler_t::send_message().
+*/
+class shm_receiver_t {
+	//	Reads a flat payload in place, on the receiver's thread, and makes the message to deliver. data is only valid
+	//	during the call.
+	public: typedef std::function<process_message_t (int process_handle, const uint8_t* data, size_t size)> flat_reader_t;
+
+	public: shm_receiver_t(const std::string& ring_name, size_t capacity, process_scheduler_t& scheduler, int process_count, const flat_reader_t& flat_reader = nullptr);
+
+	//	Calls stop().
+	public: ~shm_receiver_t();
+
+	//	Delivering starts at once, so the scheduler must already be running or about to run.
+	public: void start();
+
+	//	Waits until the sender has closed and all messages are delivered, then joins the thread. Rethrows an exception
+	//	from the thread, like a malformed message or a bad process handle.
+	public: void join();
+
+	//	Stops at once, messages still in the ring are dropped.
+	public: void stop();
+
+	public: int64_t get_message_count() const { return _message_count; }
+
+
+	/////////////////////////////////////		STATE
+
+	private: void pump();
+	private: void deliver(const shm_ring_t::record_t& record);
+
+	private: shm_ring_t _ring;
+	private: process_scheduler_t& _scheduler;
+	private: const int _process_count;
+	private: const flat_reader_t _flat_reader;
+
+	private: std::thread _thread;
+	private: std::atomic<bool> _stop { false };
+	private: std::atomic<int64_t> _message_count { 0 };
+	private: std::exception_ptr _exception;
+};
+
+
+}	// floyd
+
+#endif /* floyd_shm_transport_hpp */
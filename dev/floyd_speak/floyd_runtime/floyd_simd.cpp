@@ -0,0 +1,627 @@
+//
+//  floyd_simd.cpp
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-07-04.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#include "floyd_simd.h"
+
+#include "quark.h"
+
+#include <cstring>
+#include <vector>
+#include <cmath>
+#include <limits>
+
+//	AVX2 functions are compiled using target attributes so the rest of the program don't need -mavx2.
+//	They are only called after get_simd_level() has checked the CPU.
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(__GNUC__) || defined(__clang__))
+	#define FLOYD_SIMD_X86 1
+	#include <immintrin.h>
+	#define FLOYD_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+	#define FLOYD_SIMD_X86 0
+#endif
+
+
+namespace floyd {
+
+
+static simd_level_t detect_simd_level(){
+#if FLOYD_SIMD_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2")){
+		return simd_level_t::k_avx2;
+	}
+	else{
+		return simd_level_t::k_sse2;
+	}
+#else
+	return simd_level_t::k_scalar;
+#endif
+}
+
+simd_level_t get_simd_level(){
+	static const simd_level_t level = detect_simd_level();
+	return level;
+}
+
+std::string simd_level_to_string(simd_level_t level){
+	if(level == simd_level_t::k_scalar){
+		return "scalar";
+	}
+	else if(level == simd_level_t::k_sse2){
+		return "sse2";
+	}
+	else if(level == simd_level_t::k_avx2){
+		return "avx2";
+	}
+	else{
+		QUARK_ASSERT(false);
+		throw std::exception();
+	}
+}
+
+//	Only check the CPU's capabilities when the program actually runs on the level.
+static bool is_level_available(simd_level_t level){
+	return static_cast<int>(level) <= static_cast<int>(get_simd_level());
+}
+
+
+
+//////////////////////////////////////		SCALAR
+
+
+static int64_t find_byte_scalar(const char* data, size_t size, char wanted){
+	const auto p = static_cast<const char*>(std::memchr(data, wanted, size));
+	return p == nullptr ? -1 : static_cast<int64_t>(p - data);
+}
+
+//	Checks every position from start. needle_size must be >= 1 and <= size.
+static int64_t find_substring_scalar(const char* data, size_t size, const char* needle, size_t needle_size, size_t start){
+	QUARK_ASSERT(needle_size >= 1 && needle_size <= size);
+
+	const auto last_pos = size - needle_size;
+	for(size_t i = start ; i <= last_pos ; i++){
+		if(data[i] == needle[0] && std::memcmp(data + i + 1, needle + 1, needle_size - 1) == 0){
+			return static_cast<int64_t>(i);
+		}
+	}
+	return -1;
+}
+
+static int64_t find_int64_scalar(const int64_t* data, size_t count, int64_t wanted, size_t start){
+	for(size_t i = start ; i < count ; i++){
+		if(data[i] == wanted){
+			return static_cast<int64_t>(i);
+		}
+	}
+	return -1;
+}
+
+static int64_t find_double_scalar(const double* data, size_t count, double wanted, size_t start){
+	for(size_t i = start ; i < count ; i++){
+		if(data[i] == wanted){
+			return static_cast<int64_t>(i);
+		}
+	}
+	return -1;
+}
+
+
+
+#if FLOYD_SIMD_X86
+
+//////////////////////////////////////		SSE2
+
+
+static int64_t find_byte_sse2(const char* data, size_t size, char wanted){
+	const auto w = _mm_set1_epi8(wanted);
+	size_t i = 0;
+	for(; i + 16 <= size ; i += 16){
+		const auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, w));
+		if(mask != 0){
+			return static_cast<int64_t>(i + __builtin_ctz(mask));
+		}
+	}
+	const auto r = find_byte_scalar(data + i, size - i, wanted);
+	return r == -1 ? -1 : static_cast<int64_t>(i) + r;
+}
+
+//	Compares the first and last character of the needle at 16 positions at a time, then memcmp():s the candidates.
+static int64_t find_substring_sse2(const char* data, size_t size, const char* needle, size_t needle_size){
+	QUARK_ASSERT(needle_size >= 2 && needle_size <= size);
+
+	const auto first = _mm_set1_epi8(needle[0]);
+	const auto last = _mm_set1_epi8(needle[needle_size - 1]);
+	size_t i = 0;
+	for(; i + needle_size - 1 + 16 <= size ; i += 16){
+		const auto block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		const auto block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + needle_size - 1));
+		int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last)));
+		while(mask != 0){
+			const auto bit = __builtin_ctz(mask);
+			if(std::memcmp(data + i + bit + 1, needle + 1, needle_size - 2) == 0){
+				return static_cast<int64_t>(i + bit);
+			}
+			mask &= mask - 1;
+		}
+	}
+	return find_substring_scalar(data, size, needle, needle_size, i);
+}
+
+//	SSE2 has no 64 bit compare: compare the 32 bit halves and require both to match.
+static int64_t find_int64_sse2(const int64_t* data, size_t count, int64_t wanted){
+	const auto w = _mm_set1_epi64x(wanted);
+	size_t i = 0;
+	for(; i + 2 <= count ; i += 2){
+		const auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		const auto eq32 = _mm_cmpeq_epi32(block, w);
+		const auto eq64 = _mm_and_si128(eq32, _mm_shuffle_epi32(eq32, _MM_SHUFFLE(2, 3, 0, 1)));
+		const int mask = _mm_movemask_pd(_mm_castsi128_pd(eq64));
+		if(mask != 0){
+			return static_cast<int64_t>(i + __builtin_ctz(mask));
+		}
+	}
+	return find_int64_scalar(data, count, wanted, i);
+}
+
+static int64_t find_double_sse2(const double* data, size_t count, double wanted){
+	const auto w = _mm_set1_pd(wanted);
+	size_t i = 0;
+	for(; i + 2 <= count ; i += 2){
+		const auto block = _mm_loadu_pd(data + i);
+		const int mask = _mm_movemask_pd(_mm_cmpeq_pd(block, w));
+		if(mask != 0){
+			return static_cast<int64_t>(i + __builtin_ctz(mask));
+		}
+	}
+	return find_double_scalar(data, count, wanted, i);
+}
+
+
+
+//////////////////////////////////////		AVX2
+
+
+FLOYD_TARGET_AVX2 static int64_t find_byte_avx2(const char* data, size_t size, char wanted){
+	const auto w = _mm256_set1_epi8(wanted);
+	size_t i = 0;
+	for(; i + 32 <= size ; i += 32){
+		const auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, w)));
+		if(mask != 0){
+			return static_cast<int64_t>(i + __builtin_ctz(mask));
+		}
+	}
+	const auto r = find_byte_sse2(data + i, size - i, wanted);
+	return r == -1 ? -1 : static_cast<int64_t>(i) + r;
+}
+
+FLOYD_TARGET_AVX2 static int64_t find_substring_avx2(const char* data, size_t size, const char* needle, size_t needle_size){
+	QUARK_ASSERT(needle_size >= 2 && needle_size <= size);
+
+	const auto first = _mm256_set1_epi8(needle[0]);
+	const auto last = _mm256_set1_epi8(needle[needle_size - 1]);
+	size_t i = 0;
+	for(; i + needle_size - 1 + 32 <= size ; i += 32){
+		const auto block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		const auto block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + needle_size - 1));
+		auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(block_first, first), _mm256_cmpeq_epi8(block_last, last))));
+		while(mask != 0){
+			const auto bit = __builtin_ctz(mask);
+			if(std::memcmp(data + i + bit + 1, needle + 1, needle_size - 2) == 0){
+				return static_cast<int64_t>(i + bit);
+			}
+			mask &= mask - 1;
+		}
+	}
+	return find_substring_scalar(data, size, needle, needle_size, i);
+}
+
+FLOYD_TARGET_AVX2 static int64_t find_int64_avx2(const int64_t* data, size_t count, int64_t wanted){
+	const auto w = _mm256_set1_epi64x(wanted);
+	size_t i = 0;
+	for(; i + 4 <= count ; i += 4){
+		const auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		const int mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(block, w)));
+		if(mask != 0){
+			return static_cast<int64_t>(i + __builtin_ctz(mask));
+		}
+	}
+	return find_int64_scalar(data, count, wanted, i);
+}
+
+FLOYD_TARGET_AVX2 static int64_t find_double_avx2(const double* data, size_t count, double wanted){
+	const auto w = _mm256_set1_pd(wanted);
+	size_t i = 0;
+	for(; i + 4 <= count ; i += 4){
+		const auto block = _mm256_loadu_pd(data + i);
+		const int mask = _mm256_movemask_pd(_mm256_cmp_pd(block, w, _CMP_EQ_OQ));
+		if(mask != 0){
+			return static_cast<int64_t>(i + __builtin_ctz(mask));
+		}
+	}
+	return find_double_scalar(data, count, wanted, i);
+}
+
+#endif
+
+
+
+//////////////////////////////////////		DISPATCH
+
+
+static int64_t find_byte_level(simd_level_t level, const char* data, size_t size, char wanted){
+#if FLOYD_SIMD_X86
+	if(level == simd_level_t::k_avx2){
+		return find_byte_avx2(data, size, wanted);
+	}
+	else if(level == simd_level_t::k_sse2){
+		return find_byte_sse2(data, size, wanted);
+	}
+#endif
+	return find_byte_scalar(data, size, wanted);
+}
+
+static int64_t find_substring_level(simd_level_t level, const char* data, size_t size, const char* needle, size_t needle_size){
+	if(needle_size == 0){
+		return 0;
+	}
+	else if(needle_size > size){
+		return -1;
+	}
+	else if(needle_size == 1){
+		return find_byte_level(level, data, size, needle[0]);
+	}
+
+#if FLOYD_SIMD_X86
+	if(level == simd_level_t::k_avx2){
+		return find_substring_avx2(data, size, needle, needle_size);
+	}
+	else if(level == simd_level_t::k_sse2){
+		return find_substring_sse2(data, size, needle, needle_size);
+	}
+#endif
+	return find_substring_scalar(data, size, needle, needle_size, 0);
+}
+
+static int64_t find_int64_level(simd_level_t level, const int64_t* data, size_t count, int64_t wanted){
+#if FLOYD_SIMD_X86
+	if(level == simd_level_t::k_avx2){
+		return find_int64_avx2(data, count, wanted);
+	}
+	else if(level == simd_level_t::k_sse2){
+		return find_int64_sse2(data, count, wanted);
+	}
+#endif
+	return find_int64_scalar(data, count, wanted, 0);
+}
+
+static int64_t find_double_level(simd_level_t level, const double* data, size_t count, double wanted){
+#if FLOYD_SIMD_X86
+	if(level == simd_level_t::k_avx2){
+		return find_double_avx2(data, count, wanted);
+	}
+	else if(level == simd_level_t::k_sse2){
+		return find_double_sse2(data, count, wanted);
+	}
+#endif
+	return find_double_scalar(data, count, wanted, 0);
+}
+
+
+int64_t simd_find_byte(const char* data, size_t size, char wanted){
+	QUARK_ASSERT(data != nullptr || size == 0);
+
+	return find_byte_level(get_simd_level(), data, size, wanted);
+}
+
+int64_t simd_find_substring(const char* data, size_t size, const char* needle, size_t needle_size){
+	QUARK_ASSERT(data != nullptr || size == 0);
+	QUARK_ASSERT(needle != nullptr || needle_size == 0);
+
+	return find_substring_level(get_simd_level(), data, size, needle, needle_size);
+}
+
+int64_t simd_find_int64(const int64_t* data, size_t count, int64_t wanted){
+	QUARK_ASSERT(data != nullptr || count == 0);
+
+	return find_int64_level(get_simd_level(), data, count, wanted);
+}
+
+int64_t simd_find_double(const double* data, size_t count, double wanted){
+	QUARK_ASSERT(data != nullptr || count == 0);
+
+	return find_double_level(get_simd_level(), data, count, wanted);
+}
+
+
+
+//////////////////////////////////////		REDUCE KERNELS
+
+
+//	For ints, ties don't matter: all the "smaller" kernels compute min, all the "larger" kernels compute max.
+static bool is_min_kernel(reduce_kernel kernel){
+	return kernel == reduce_kernel::k_keep_acc_if_smaller
+		|| kernel == reduce_kernel::k_keep_acc_if_smaller_or_equal
+		|| kernel == reduce_kernel::k_keep_e_if_smaller
+		|| kernel == reduce_kernel::k_keep_e_if_smaller_or_equal;
+}
+static bool is_max_kernel(reduce_kernel kernel){
+	return kernel == reduce_kernel::k_keep_acc_if_larger
+		|| kernel == reduce_kernel::k_keep_acc_if_larger_or_equal
+		|| kernel == reduce_kernel::k_keep_e_if_larger
+		|| kernel == reduce_kernel::k_keep_e_if_larger_or_equal;
+}
+
+//	Floyd ints wrap on overflow. Do the math on unsigned to avoid C++ undefined behavior.
+static int64_t wrap_add(int64_t a, int64_t b){
+	return static_cast<int64_t>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b));
+}
+static int64_t wrap_mul(int64_t a, int64_t b){
+	return static_cast<int64_t>(static_cast<uint64_t>(a) * static_cast<uint64_t>(b));
+}
+
+static int64_t reduce_int64_scalar(reduce_kernel kernel, const int64_t* data, size_t count, int64_t acc){
+	if(kernel == reduce_kernel::k_sum){
+		for(size_t i = 0 ; i < count ; i++){
+			acc = wrap_add(acc, data[i]);
+		}
+		return acc;
+	}
+	else if(kernel == reduce_kernel::k_product){
+		for(size_t i = 0 ; i < count ; i++){
+			acc = wrap_mul(acc, data[i]);
+		}
+		return acc;
+	}
+	else if(kernel == reduce_kernel::k_count){
+		return wrap_add(acc, static_cast<int64_t>(count));
+	}
+	else if(is_min_kernel(kernel)){
+		for(size_t i = 0 ; i < count ; i++){
+			acc = data[i] < acc ? data[i] : acc;
+		}
+		return acc;
+	}
+	else if(is_max_kernel(kernel)){
+		for(size_t i = 0 ; i < count ; i++){
+			acc = data[i] > acc ? data[i] : acc;
+		}
+		return acc;
+	}
+	else{
+		QUARK_ASSERT(false);
+		throw std::exception();
+	}
+}
+
+#if FLOYD_SIMD_X86
+
+static int64_t reduce_int64_sse2(reduce_kernel kernel, const int64_t* data, size_t count, int64_t acc){
+	//	SSE2 has no 64 bit compares, only the sum is vectorized.
+	if(kernel != reduce_kernel::k_sum){
+		return reduce_int64_scalar(kernel, data, count, acc);
+	}
+
+	auto sum = _mm_setzero_si128();
+	size_t i = 0;
+	for(; i + 2 <= count ; i += 2){
+		sum = _mm_add_epi64(sum, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+	}
+	int64_t lanes[2];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), sum);
+	acc = wrap_add(acc, wrap_add(lanes[0], lanes[1]));
+	return reduce_int64_scalar(kernel, data + i, count - i, acc);
+}
+
+FLOYD_TARGET_AVX2 static int64_t reduce_int64_avx2(reduce_kernel kernel, const int64_t* data, size_t count, int64_t acc){
+	if(kernel == reduce_kernel::k_sum){
+		auto sum = _mm256_setzero_si256();
+		size_t i = 0;
+		for(; i + 4 <= count ; i += 4){
+			sum = _mm256_add_epi64(sum, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)));
+		}
+		int64_t lanes[4];
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), sum);
+		acc = wrap_add(acc, wrap_add(wrap_add(lanes[0], lanes[1]), wrap_add(lanes[2], lanes[3])));
+		return reduce_int64_scalar(kernel, data + i, count - i, acc);
+	}
+	else if(is_min_kernel(kernel) || is_max_kernel(kernel)){
+		const bool is_min = is_min_kernel(kernel);
+		auto m = _mm256_set1_epi64x(acc);
+		size_t i = 0;
+		for(; i + 4 <= count ; i += 4){
+			const auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+			const auto take = is_min ? _mm256_cmpgt_epi64(m, block) : _mm256_cmpgt_epi64(block, m);
+			m = _mm256_blendv_epi8(m, block, take);
+		}
+		int64_t lanes[4];
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), m);
+		acc = reduce_int64_scalar(kernel, lanes, 4, acc);
+		return reduce_int64_scalar(kernel, data + i, count - i, acc);
+	}
+	else{
+		return reduce_int64_scalar(kernel, data, count, acc);
+	}
+}
+
+#endif
+
+//	Mirrors the reducer expressions exactly, including NaN and -0.0 behavior.
+static double reduce_double_scalar(reduce_kernel kernel, const double* data, size_t count, double acc){
+	switch(kernel){
+		case reduce_kernel::k_sum:
+			for(size_t i = 0 ; i < count ; i++){ acc = acc + data[i]; }
+			return acc;
+		case reduce_kernel::k_product:
+			for(size_t i = 0 ; i < count ; i++){ acc = acc * data[i]; }
+			return acc;
+		case reduce_kernel::k_keep_acc_if_smaller:
+			for(size_t i = 0 ; i < count ; i++){ acc = acc < data[i] ? acc : data[i]; }
+			return acc;
+		case reduce_kernel::k_keep_acc_if_smaller_or_equal:
+			for(size_t i = 0 ; i < count ; i++){ acc = acc <= data[i] ? acc : data[i]; }
+			return acc;
+		case reduce_kernel::k_keep_acc_if_larger:
+			for(size_t i = 0 ; i < count ; i++){ acc = acc > data[i] ? acc : data[i]; }
+			return acc;
+		case reduce_kernel::k_keep_acc_if_larger_or_equal:
+			for(size_t i = 0 ; i < count ; i++){ acc = acc >= data[i] ? acc : data[i]; }
+			return acc;
+		case reduce_kernel::k_keep_e_if_smaller:
+			for(size_t i = 0 ; i < count ; i++){ acc = data[i] < acc ? data[i] : acc; }
+			return acc;
+		case reduce_kernel::k_keep_e_if_smaller_or_equal:
+			for(size_t i = 0 ; i < count ; i++){ acc = data[i] <= acc ? data[i] : acc; }
+			return acc;
+		case reduce_kernel::k_keep_e_if_larger:
+			for(size_t i = 0 ; i < count ; i++){ acc = data[i] > acc ? data[i] : acc; }
+			return acc;
+		case reduce_kernel::k_keep_e_if_larger_or_equal:
+			for(size_t i = 0 ; i < count ; i++){ acc = data[i] >= acc ? data[i] : acc; }
+			return acc;
+		default:
+			QUARK_ASSERT(false);
+			throw std::exception();
+	}
+}
+
+static int64_t reduce_int64_level(simd_level_t level, reduce_kernel kernel, const int64_t* data, size_t count, int64_t acc){
+#if FLOYD_SIMD_X86
+	if(level == simd_level_t::k_avx2){
+		return reduce_int64_avx2(kernel, data, count, acc);
+	}
+	else if(level == simd_level_t::k_sse2){
+		return reduce_int64_sse2(kernel, data, count, acc);
+	}
+#endif
+	return reduce_int64_scalar(kernel, data, count, acc);
+}
+
+int64_t simd_reduce_int64(reduce_kernel kernel, const int64_t* data, size_t count, int64_t acc){
+	QUARK_ASSERT(kernel != reduce_kernel::k_none);
+	QUARK_ASSERT(data != nullptr || count == 0);
+
+	return reduce_int64_level(get_simd_level(), kernel, data, count, acc);
+}
+
+double simd_reduce_double(reduce_kernel kernel, const double* data, size_t count, double acc){
+	QUARK_ASSERT(kernel != reduce_kernel::k_none && kernel != reduce_kernel::k_count);
+	QUARK_ASSERT(data != nullptr || count == 0);
+
+	return reduce_double_scalar(kernel, data, count, acc);
+}
+
+
+
+//////////////////////////////////////		TESTS
+
+
+static const simd_level_t k_test_levels[] = { simd_level_t::k_scalar, simd_level_t::k_sse2, simd_level_t::k_avx2 };
+
+static std::string make_test_text(size_t size){
+	std::string result;
+	for(size_t i = 0 ; i < size ; i++){
+		result.push_back(static_cast<char>('a' + (i * 7) % 13));
+	}
+	return result;
+}
+
+QUARK_UNIT_TEST("floyd_simd", "simd_find_byte()", "all levels, all positions", ""){
+	const auto text = make_test_text(100);
+	for(const auto level: k_test_levels){
+		if(is_level_available(level)){
+			for(size_t size = 0 ; size < text.size() ; size++){
+				for(char ch = 'a' ; ch <= 'z' ; ch++){
+					const auto pos = text.substr(0, size).find(ch);
+					const auto expected = pos == std::string::npos ? -1 : static_cast<int64_t>(pos);
+					QUARK_UT_VERIFY(find_byte_level(level, text.data(), size, ch) == expected);
+				}
+			}
+		}
+	}
+}
+
+QUARK_UNIT_TEST("floyd_simd", "simd_find_substring()", "all levels, needles of different sizes", ""){
+	const auto text = make_test_text(150) + "needle in the haystack" + make_test_text(40);
+	for(const auto level: k_test_levels){
+		if(is_level_available(level)){
+			for(size_t start = 0 ; start < 80 ; start += 3){
+				for(size_t needle_size = 0 ; needle_size < 40 ; needle_size++){
+					const auto needle = text.substr(start, needle_size);
+					const auto expected = static_cast<int64_t>(text.find(needle));
+					QUARK_UT_VERIFY(find_substring_level(level, text.data(), text.size(), needle.data(), needle.size()) == expected);
+				}
+			}
+			QUARK_UT_VERIFY(find_substring_level(level, text.data(), text.size(), "needle in", 9) == 150);
+			QUARK_UT_VERIFY(find_substring_level(level, text.data(), text.size(), "haystacks", 9) == -1);
+			QUARK_UT_VERIFY(find_substring_level(level, "ab", 2, "abc", 3) == -1);
+		}
+	}
+}
+
+QUARK_UNIT_TEST("floyd_simd", "simd_find_int64()", "all levels, halves must both match", ""){
+	std::vector<int64_t> data;
+	for(int64_t i = 0 ; i < 37 ; i++){
+		//	Same low 32 bits as 5, different high bits.
+		data.push_back(i == 20 ? 5 : (i + 100) | (int64_t(1) << 40));
+	}
+	data.push_back(5);
+	for(const auto level: k_test_levels){
+		if(is_level_available(level)){
+			QUARK_UT_VERIFY(find_int64_level(level, data.data(), data.size(), 5) == 20);
+			QUARK_UT_VERIFY(find_int64_level(level, data.data() + 21, data.size() - 21, 5) == 16);
+			QUARK_UT_VERIFY(find_int64_level(level, data.data(), data.size(), int64_t(5) | (int64_t(1) << 40)) == -1);
+			QUARK_UT_VERIFY(find_int64_level(level, data.data(), 0, 5) == -1);
+		}
+	}
+}
+
+QUARK_UNIT_TEST("floyd_simd", "simd_find_double()", "all levels, IEEE equality", ""){
+	std::vector<double> data = { 1.5, NAN, -0.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0 };
+	for(const auto level: k_test_levels){
+		if(is_level_available(level)){
+			QUARK_UT_VERIFY(find_double_level(level, data.data(), data.size(), 8.0) == 8);
+			QUARK_UT_VERIFY(find_double_level(level, data.data(), data.size(), 0.0) == 2);
+			QUARK_UT_VERIFY(find_double_level(level, data.data(), data.size(), NAN) == -1);
+			QUARK_UT_VERIFY(find_double_level(level, data.data(), data.size(), 9.0) == -1);
+		}
+	}
+}
+
+QUARK_UNIT_TEST("floyd_simd", "simd_reduce_int64()", "all levels match scalar", ""){
+	std::vector<int64_t> data;
+	for(int64_t i = 0 ; i < 103 ; i++){
+		data.push_back((i * 7919) % 211 - 100);
+	}
+	data[50] = std::numeric_limits<int64_t>::max();
+	data[51] = 5;
+
+	const reduce_kernel kernels[] = { reduce_kernel::k_sum, reduce_kernel::k_product, reduce_kernel::k_count, reduce_kernel::k_keep_acc_if_smaller, reduce_kernel::k_keep_e_if_larger_or_equal };
+	for(const auto kernel: kernels){
+		for(size_t count = 0 ; count < data.size() ; count += 5){
+			const auto expected = reduce_int64_scalar(kernel, data.data(), count, 3);
+			for(const auto level: k_test_levels){
+				if(is_level_available(level)){
+					QUARK_UT_VERIFY(reduce_int64_level(level, kernel, data.data(), count, 3) == expected);
+				}
+			}
+		}
+	}
+	QUARK_UT_VERIFY(simd_reduce_int64(reduce_kernel::k_keep_e_if_smaller, data.data(), data.size(), 1000) == -100);
+	QUARK_UT_VERIFY(simd_reduce_int64(reduce_kernel::k_keep_acc_if_larger, data.data(), data.size(), 0) == std::numeric_limits<int64_t>::max());
+}
+
+QUARK_UNIT_TEST("floyd_simd", "simd_reduce_double()", "keeps order of additions", ""){
+	const std::vector<double> data = { 1e16, 1.0, -1e16, 1.0 };
+	QUARK_UT_VERIFY(simd_reduce_double(reduce_kernel::k_sum, data.data(), data.size(), 0.0) == ((0.0 + 1e16) + 1.0 - 1e16) + 1.0);
+	QUARK_UT_VERIFY(simd_reduce_double(reduce_kernel::k_keep_e_if_larger, data.data(), data.size(), 0.0) == 1e16);
+	QUARK_UT_VERIFY(simd_reduce_double(reduce_kernel::k_keep_acc_if_smaller, data.data(), data.size(), 0.0) == -1e16);
+}
+
+}	// floyd
@@ -0,0 +1,113 @@
+//
+//  floyd_simd.h
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-07-04.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#ifndef floyd_simd_hpp
+#define floyd_simd_hpp
+
+/*
+	SIMD kernels used by corecalls in both the bytecode interpreter and the LLVM runtime.
+	The backends hand the kernels flat C++ arrays: a string's characters or a chunk of a vector's elements.
+
+	On x86-64 each kernel has an SSE2 version (always available) and an AVX2 version, picked at runtime using
+	get_simd_level(). Other CPUs use the scalar versions.
+
+	All find-kernels return the index of the first match or -1.
+
+	Reduce-kernels replace calls to simple reducer functions, see reduce_kernel. They give the exact same result as
+	calling the reducer for each element in order. Int sums and min/max use SIMD since integer add wraps and min/max
+	don't depend on order. Double kernels are tight scalar loops: reordering the additions would change the result.
+*/
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+
+namespace floyd {
+
+
+enum class simd_level_t {
+	k_scalar,
+	k_sse2,
+	k_avx2
+};
+
+//	Checks the CPU once, then returns cached result.
+simd_level_t get_simd_level();
+std::string simd_level_to_string(simd_level_t level);
+
+
+//////////////////////////////////////		FIND KERNELS
+
+
+int64_t simd_find_byte(const char* data, size_t size, char wanted);
+
+//	Empty needle matches at 0, like std::string::find().
+int64_t simd_find_substring(const char* data, size_t size, const char* needle, size_t needle_size);
+
+int64_t simd_find_int64(const int64_t* data, size_t count, int64_t wanted);
+
+//	Uses IEEE equality: 0.0 matches -0.0 and NaN never matches.
+int64_t simd_find_double(const double* data, size_t count, double wanted);
+
+
+
+
+//////////////////////////////////////		REDUCE KERNELS
+
+
+/*
+	Reducer functions that pass3 recognizes in calls to reduce(). The kernel is passed to the host function as a
+	hidden int argument. acc is the reducer's first argument, e the second.
+*/
+enum class reduce_kernel {
+	//	Not recognized: call the reducer function for each element.
+	k_none = 0,
+
+	//	return acc + e
+	k_sum,
+
+	//	return acc * e
+	k_product,
+
+	//	return acc + 1. Works for any element type.
+	k_count,
+
+	//	return acc < e ? acc : e
+	k_keep_acc_if_smaller,
+
+	//	return acc <= e ? acc : e
+	k_keep_acc_if_smaller_or_equal,
+
+	//	return acc > e ? acc : e
+	k_keep_acc_if_larger,
+
+	//	return acc >= e ? acc : e
+	k_keep_acc_if_larger_or_equal,
+
+	//	return e < acc ? e : acc
+	k_keep_e_if_smaller,
+
+	//	return e <= acc ? e : acc
+	k_keep_e_if_smaller_or_equal,
+
+	//	return e > acc ? e : acc
+	k_keep_e_if_larger,
+
+	//	return e >= acc ? e : acc
+	k_keep_e_if_larger_or_equal
+};
+
+//	Continues reducing from acc, so a vector stored in chunks can be reduced one chunk at a time.
+int64_t simd_reduce_int64(reduce_kernel kernel, const int64_t* data, size_t count, int64_t acc);
+double simd_reduce_double(reduce_kernel kernel, const double* data, size_t count, double acc);
+
+
+}	// floyd
+
+#endif /* floyd_simd_hpp */
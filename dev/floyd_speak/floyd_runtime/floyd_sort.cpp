@@ -0,0 +1,171 @@
+//
+//  floyd_sort.cpp
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-07-02.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#include "floyd_sort.h"
+
+#include "quark.h"
+
+#include <cstring>
+#include <limits>
+
+
+namespace floyd {
+
+
+//	LSD radix sort on the 64 bit keys. Stable.
+static void radix_sort_keys(uint64_t* keys, size_t count){
+	if(count < 2){
+		return;
+	}
+
+	std::vector<uint64_t> buffer(count);
+	uint64_t* src = keys;
+	uint64_t* dest = &buffer[0];
+
+	for(int shift = 0 ; shift < 64 ; shift += 8){
+		size_t histogram[256] = {};
+		for(size_t i = 0 ; i < count ; i++){
+			histogram[(src[i] >> shift) & 0xff]++;
+		}
+
+		//	All keys have the same digit -- no need to move anything.
+		if(histogram[(src[0] >> shift) & 0xff] == count){
+			continue;
+		}
+
+		size_t pos = 0;
+		for(int d = 0 ; d < 256 ; d++){
+			const auto c = histogram[d];
+			histogram[d] = pos;
+			pos += c;
+		}
+		for(size_t i = 0 ; i < count ; i++){
+			const auto d = (src[i] >> shift) & 0xff;
+			dest[histogram[d]++] = src[i];
+		}
+		std::swap(src, dest);
+	}
+	if(src != keys){
+		std::memcpy(keys, src, count * sizeof(uint64_t));
+	}
+}
+
+//	Flip sign bit so negative numbers sort before positive.
+static uint64_t int64_to_key(int64_t v){
+	return static_cast<uint64_t>(v) ^ (uint64_t(1) << 63);
+}
+static int64_t key_to_int64(uint64_t k){
+	return static_cast<int64_t>(k ^ (uint64_t(1) << 63));
+}
+
+//	IEEE 754: flip all bits of negative numbers, only sign bit of positive numbers.
+uint64_t double_to_key(double v){
+	uint64_t bits;
+	std::memcpy(&bits, &v, sizeof(bits));
+	return (bits & (uint64_t(1) << 63)) ? ~bits : bits ^ (uint64_t(1) << 63);
+}
+static double key_to_double(uint64_t k){
+	const uint64_t bits = (k & (uint64_t(1) << 63)) ? k ^ (uint64_t(1) << 63) : ~k;
+	double v;
+	std::memcpy(&v, &bits, sizeof(v));
+	return v;
+}
+
+
+void radix_sort_int64(int64_t* values, size_t count){
+	QUARK_ASSERT(values != nullptr || count == 0);
+
+	std::vector<uint64_t> keys(count);
+	for(size_t i = 0 ; i < count ; i++){
+		keys[i] = int64_to_key(values[i]);
+	}
+	radix_sort_keys(keys.data(), count);
+	for(size_t i = 0 ; i < count ; i++){
+		values[i] = key_to_int64(keys[i]);
+	}
+}
+
+void radix_sort_double(double* values, size_t count){
+	QUARK_ASSERT(values != nullptr || count == 0);
+
+	std::vector<uint64_t> keys(count);
+	for(size_t i = 0 ; i < count ; i++){
+		keys[i] = double_to_key(values[i]);
+	}
+	radix_sort_keys(keys.data(), count);
+	for(size_t i = 0 ; i < count ; i++){
+		values[i] = key_to_double(keys[i]);
+	}
+}
+
+size_t get_parallel_sort_chunk_count(size_t count){
+	if(count < k_parallel_sort_threshold){
+		return 1;
+	}
+	const size_t hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+	const size_t max_chunks = count / (k_parallel_sort_threshold / 2);
+	return std::max(size_t(1), std::min(hardware_threads, max_chunks));
+}
+
+
+
+QUARK_UNIT_TEST("floyd_sort", "radix_sort_int64()", "", ""){
+	std::vector<int64_t> a = { 5, -3, 0, 9223372036854775807, -9223372036854775807 - 1, 1, -1 };
+	radix_sort_int64(a.data(), a.size());
+	QUARK_UT_VERIFY((a == std::vector<int64_t>{ -9223372036854775807 - 1, -3, -1, 0, 1, 5, 9223372036854775807 }));
+}
+
+QUARK_UNIT_TEST("floyd_sort", "radix_sort_double()", "", ""){
+	std::vector<double> a = { 2.5, -0.5, 0.0, -100.0, 1e300, -1e-300, 3.0 };
+	radix_sort_double(a.data(), a.size());
+	QUARK_UT_VERIFY((a == std::vector<double>{ -100.0, -0.5, -1e-300, 0.0, 2.5, 3.0, 1e300 }));
+}
+
+QUARK_UNIT_TEST("floyd_sort", "merge_sort()", "stable", ""){
+	std::vector<std::pair<int, int>> a;
+	for(int i = 0 ; i < 1000 ; i++){
+		a.push_back({ (i * 7919) % 13, i });
+	}
+	merge_sort(a.data(), a.size(), [](const std::pair<int, int>& x, const std::pair<int, int>& y){ return x.first < y.first; });
+	for(size_t i = 1 ; i < a.size() ; i++){
+		QUARK_UT_VERIFY(a[i - 1].first < a[i].first || (a[i - 1].first == a[i].first && a[i - 1].second < a[i].second));
+	}
+}
+
+QUARK_UNIT_TEST("floyd_sort", "parallel_sort()", "above threshold", ""){
+	std::vector<int64_t> a;
+	for(int64_t i = 0 ; i < int64_t(k_parallel_sort_threshold) * 4 ; i++){
+		a.push_back((i * 2654435761) % 1000003 - 500000);
+	}
+	auto expected = a;
+	std::sort(expected.begin(), expected.end());
+
+	parallel_sort(a.data(), a.size(), [](int64_t* p, size_t n){ radix_sort_int64(p, n); }, std::less<int64_t>());
+	QUARK_UT_VERIFY(a == expected);
+}
+
+QUARK_UNIT_TEST("floyd_sort", "parallel_sort()", "doubles with NaN and -0.0 merge in radix order", ""){
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	std::vector<double> a;
+	for(int64_t i = 0 ; i < int64_t(k_parallel_sort_threshold) * 4 ; i++){
+		const auto r = (i * 2654435761) % 1000003;
+		a.push_back(r % 5 == 0 ? nan : r % 5 == 1 ? -nan : r % 5 == 2 ? 0.0 : r % 5 == 3 ? -0.0 : double(r - 500000) / 7.0);
+	}
+	auto expected = a;
+	radix_sort_double(expected.data(), expected.size());
+
+	const auto less = [](double x, double y){ return double_to_key(x) < double_to_key(y); };
+	auto b = a;
+	parallel_sort(a.data(), a.size(), [](double* p, size_t n){ radix_sort_double(p, n); }, less);
+	merge_sort(b.data(), b.size(), less);
+	QUARK_UT_VERIFY(std::memcmp(a.data(), expected.data(), a.size() * sizeof(double)) == 0);
+	QUARK_UT_VERIFY(std::memcmp(b.data(), expected.data(), b.size() * sizeof(double)) == 0);
+}
+
+
+}	//	floyd
@@ -0,0 +1,169 @@
+//
+//  floyd_sort.h
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-07-02.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#ifndef floyd_sort_hpp
+#define floyd_sort_hpp
+
+/*
+	Sort kernels used by the sort() corecall in both the bytecode interpreter and the LLVM runtime.
+	The backends unpack their vectors into flat C++ arrays, sort these using the kernels below, then pack the result.
+
+	- Numbers (int, double) use LSD radix sort: 8 passes of 8 bits, no comparisons.
+	- Everything else is sorted as an array of indexes using a bottom-up merge sort. Moving 4 byte indexes is cheaper
+		than moving the elements themselves and all passes are linear sweeps over memory.
+	- Above k_parallel_sort_threshold the array is split into one chunk per hardware thread, the chunks are sorted in
+		parallel then merged pairwise, also in parallel.
+
+	All sorts are stable.
+	The parallel path must only be used with a less-function that is thread safe.
+*/
+
+#include <vector>
+#include <algorithm>
+#include <future>
+#include <thread>
+#include <cstdint>
+#include <cstddef>
+
+
+namespace floyd {
+
+
+//	Below this element count we never spawn threads.
+static const size_t k_parallel_sort_threshold = 32 * 1024;
+
+//	Runs of this size are sorted using insertion sort before merging.
+static const size_t k_merge_sort_run_size = 32;
+
+
+void radix_sort_int64(int64_t* values, size_t count);
+void radix_sort_double(double* values, size_t count);
+
+//	The order radix_sort_double() sorts in: -NaN, -inf ... -0.0, 0.0 ... inf, NaN. Merging doubles sorted by
+//	radix_sort_double() must compare these keys, std::less<double>() doesn't order NaN or tell -0.0 from 0.0.
+uint64_t double_to_key(double v);
+
+//	Returns number of chunks to split a sort into, 1 means don't go parallel.
+size_t get_parallel_sort_chunk_count(size_t count);
+
+
+
+//	Stable bottom-up merge sort. less(a, b) returns true if a should be before b.
+template <typename T, typename LESS> void merge_sort(T* values, size_t count, const LESS& less){
+	if(count < 2){
+		return;
+	}
+
+	//	Insertion sort small runs -- these fit in L1.
+	for(size_t run_start = 0 ; run_start < count ; run_start += k_merge_sort_run_size){
+		const auto run_end = std::min(run_start + k_merge_sort_run_size, count);
+		for(size_t i = run_start + 1 ; i < run_end ; i++){
+			T temp = values[i];
+			size_t j = i;
+			while(j > run_start && less(temp, values[j - 1])){
+				values[j] = values[j - 1];
+				j--;
+			}
+			values[j] = temp;
+		}
+	}
+
+	//	Merge runs, ping-ponging between values and buffer.
+	std::vector<T> buffer(count);
+	T* src = values;
+	T* dest = &buffer[0];
+	for(size_t width = k_merge_sort_run_size ; width < count ; width *= 2){
+		for(size_t start = 0 ; start < count ; start += width * 2){
+			const auto mid = std::min(start + width, count);
+			const auto end = std::min(start + width * 2, count);
+			std::merge(src + start, src + mid, src + mid, src + end, dest + start, less);
+		}
+		std::swap(src, dest);
+	}
+	if(src != values){
+		std::copy(src, src + count, values);
+	}
+}
+
+
+//	Splits values into chunks, sorts each chunk with chunk_sort(T* p, size_t count) on its own thread, then merges the
+//	chunks using less(). Falls back to one chunk_sort() call for small arrays.
+template <typename T, typename CHUNK_SORT, typename LESS> void parallel_sort(T* values, size_t count, const CHUNK_SORT& chunk_sort, const LESS& less){
+	const auto chunk_count = get_parallel_sort_chunk_count(count);
+	if(chunk_count <= 1){
+		chunk_sort(values, count);
+		return;
+	}
+
+	std::vector<size_t> bounds;
+	for(size_t i = 0 ; i < chunk_count ; i++){
+		bounds.push_back(count * i / chunk_count);
+	}
+	bounds.push_back(count);
+
+	{
+		std::vector<std::future<void>> tasks;
+		for(size_t i = 0 ; i < chunk_count ; i++){
+			const auto start = bounds[i];
+			const auto end = bounds[i + 1];
+			tasks.push_back(std::async(std::launch::async, [&chunk_sort, values, start, end](){ chunk_sort(values + start, end - start); }));
+		}
+		for(auto& e: tasks){
+			e.get();
+		}
+	}
+
+	std::vector<T> buffer(count);
+	T* src = values;
+	T* dest = &buffer[0];
+	while(bounds.size() > 2){
+		std::vector<size_t> bounds2;
+		std::vector<std::future<void>> tasks;
+		for(size_t i = 0 ; i + 1 < bounds.size() ; i += 2){
+			const auto start = bounds[i];
+			const auto mid = bounds[i + 1];
+			const auto end = i + 2 < bounds.size() ? bounds[i + 2] : mid;
+			bounds2.push_back(start);
+			tasks.push_back(std::async(std::launch::async, [&less, src, dest, start, mid, end](){
+				std::merge(src + start, src + mid, src + mid, src + end, dest + start, less);
+			}));
+		}
+		bounds2.push_back(count);
+		for(auto& e: tasks){
+			e.get();
+		}
+		std::swap(src, dest);
+		bounds.swap(bounds2);
+	}
+	if(src != values){
+		std::copy(src, src + count, values);
+	}
+}
+
+//	Returns the permutation that stable sorts elements 0 ..< count, using less(int a_index, int b_index).
+template <typename LESS> std::vector<uint32_t> make_sorted_indexes(size_t count, bool allow_parallel, const LESS& less){
+	std::vector<uint32_t> indexes(count);
+	for(size_t i = 0 ; i < count ; i++){
+		indexes[i] = static_cast<uint32_t>(i);
+	}
+	if(count > 0){
+		const auto chunk_sort = [&less](uint32_t* p, size_t n){ merge_sort(p, n, less); };
+		if(allow_parallel){
+			parallel_sort(&indexes[0], count, chunk_sort, less);
+		}
+		else{
+			chunk_sort(&indexes[0], count);
+		}
+	}
+	return indexes;
+}
+
+
+}	//	floyd
+
+#endif /* floyd_sort_hpp */
@@ -2333,6 +2333,15 @@ QUARK_UNIT_TEST("Floyd test suite", "string find()", "", ""){
 QUARK_UNIT_TEST("Floyd test suite", "string find()", "", ""){
 	run_closed(R"(		assert(find("hello, world", "x") == -1)		)");
 }
+QUARK_UNIT_TEST("Floyd test suite", "string find()", "long string, hit after SIMD blocks", ""){
+	run_closed(R"(		assert(find("2019-07-04 12:00:01 INFO request served in 12 ms, status=200 OK, ERROR none", "ERROR") == 65)		)");
+}
+QUARK_UNIT_TEST("Floyd test suite", "string find()", "long string, no hit", ""){
+	run_closed(R"(		assert(find("2019-07-04 12:00:01 INFO request served in 12 ms, status=200 OK, nothing here", "ERRORS") == -1)		)");
+}
+QUARK_UNIT_TEST("Floyd test suite", "string find()", "empty needle", ""){
+	run_closed(R"(		assert(find("hello", "") == 0)		)");
+}
 
 
 //??? Add character-literal / type.
@@ -2345,6 +2354,21 @@ QUARK_UNIT_TEST("Floyd test suite", "string push_back()", "", ""){
 	)");
 }
 
+QUARK_UNIT_TEST("Floyd test suite", "string push_back()", "loop", "other references keep the old string"){
+	run_closed(R"(
+
+		mutable a = "x"
+		let b = a
+		for(i in 0 ..< 100){
+			a = push_back(a, 97 + i % 26)
+		}
+		assert(size(a) == 101)
+		assert(subset(a, 0, 4) == "xabc")
+		assert(b == "x")
+
+	)");
+}
+
 
 
 QUARK_UNIT_TEST("Floyd test suite", "string subset()", "string", ""){
@@ -2695,6 +2719,27 @@ QUARK_UNIT_TEST("Floyd test suite", "vector [string] push_back()", "", ""){
 	)");
 }
 
+QUARK_UNIT_TEST("Floyd test suite", "vector [string] push_back()", "loop", "other references keep the old vector"){
+	run_closed(R"(
+
+		mutable [string] a = []
+		mutable [string] copies = []
+		for(i in 0 ..< 100){
+			a = push_back(a, to_string(i))
+			if(i == 10){
+				copies = push_back(copies, a[0])
+				let b = a
+				a = push_back(a, "extra")
+				assert(size(b) == 11)
+			}
+		}
+		assert(size(a) == 101)
+		assert(a[0] == "0" && a[11] == "extra" && a[100] == "99")
+		assert(copies == ["0"])
+
+	)");
+}
+
 QUARK_UNIT_TEST("Floyd test suite", "vector [string] subset()", "", ""){
 	run_closed(R"(		assert(subset(["one", "two", "three"], 0, 3) == ["one", "two", "three"])		)");
 }
@@ -2855,6 +2900,18 @@ QUARK_UNIT_TEST("Floyd test suite", "vector [int] find()", "", ""){
 QUARK_UNIT_TEST("Floyd test suite", "vector [int] find()", "", ""){
 	run_closed(R"(		assert(find([1,2,2,2,3], 2) == 1)		)");
 }
+QUARK_UNIT_TEST("Floyd test suite", "vector [int] find()", "long vector", ""){
+	run_closed(R"(
+
+		mutable [int] a = []
+		for (i in 0 ..< 100) {
+			a = push_back(a, i * 3)
+		}
+		assert(find(a, 231) == 77)
+		assert(find(a, 232) == -1)
+
+	)");
+}
 
 QUARK_UNIT_TEST("Floyd test suite", "vector [int] push_back()", "", ""){
 	ut_verify_global_result_as_json_nolib(QUARK_POS, R"(		let [int] result = push_back([1, 2], 3)		)",		R"(		[[ "vector", "^int" ], [1, 2, 3]]		)");
@@ -2964,6 +3021,13 @@ QUARK_UNIT_TEST("Floyd test suite", "vector [double] size()", "2", ""){
 
 
 
+QUARK_UNIT_TEST("Floyd test suite", "vector [double] find()", "", ""){
+	run_closed(R"(		assert(find([1.5, 2.5, 3.5, 4.5, 5.5, 6.5, 7.5], 6.5) == 5)		)");
+}
+QUARK_UNIT_TEST("Floyd test suite", "vector [double] find()", "no hit", ""){
+	run_closed(R"(		assert(find([1.5, 2.5, 3.5, 4.5, 5.5, 6.5, 7.5], 8.0) == -1)		)");
+}
+
 QUARK_UNIT_TEST("Floyd test suite", "vector [double] push_back()", "", ""){
 	ut_verify_global_result_as_json_nolib(QUARK_POS, R"(		let [double] result = push_back([1.5, 2.5], 3.5)		)",	R"(		[[ "vector", "^double" ], [1.5, 2.5, 3.5]]		)");
 }
@@ -4896,6 +4960,120 @@ QUARK_UNIT_TEST("Floyd test suite", "reduce()", "string reduce([int], string, fu
 	)___");
 }
 
+QUARK_UNIT_TEST("Floyd test suite", "reduce()", "int sum kernel", ""){
+	run_closed(R"(
+
+		func int f(int acc, int e){
+			return acc + e
+		}
+
+		mutable [int] a = []
+		for (i in 0 ..< 100) {
+			a = push_back(a, i)
+		}
+		assert(reduce(a, 1000, f) == 5950)
+		let [int] empty = []
+		assert(reduce(empty, 7, f) == 7)
+
+	)");
+}
+
+QUARK_UNIT_TEST("Floyd test suite", "reduce()", "double sum kernel keeps order", ""){
+	run_closed(R"(
+
+		func double f(double acc, double e){
+			return e + acc
+		}
+
+		assert(reduce([ 10000000000000000.0, 1.0, -10000000000000000.0, 1.0 ], 0.0, f) == 1.0)
+
+	)");
+}
+
+QUARK_UNIT_TEST("Floyd test suite", "reduce()", "int product kernel", ""){
+	run_closed(R"(
+
+		func int f(int acc, int e){
+			return acc * e
+		}
+
+		assert(reduce([ 1, 2, 3, 4, 5 ], 1, f) == 120)
+
+	)");
+}
+
+QUARK_UNIT_TEST("Floyd test suite", "reduce()", "count kernel, any element type", ""){
+	run_closed(R"(
+
+		func int f(int acc, string e){
+			return acc + 1
+		}
+
+		assert(reduce([ "a", "b", "c" ], 10, f) == 13)
+
+	)");
+}
+
+QUARK_UNIT_TEST("Floyd test suite", "reduce()", "int min and max kernels", ""){
+	run_closed(R"(
+
+		func int smallest(int acc, int e){
+			return acc < e ? acc : e
+		}
+		func int largest(int acc, int e){
+			return acc < e ? e : acc
+		}
+
+		mutable [int] a = []
+		for (i in 0 ..< 50) {
+			a = push_back(a, (i * 37) % 101 - 50)
+		}
+		assert(reduce(a, 1000, smallest) == -50)
+		assert(reduce(a, -1000, largest) == 50)
+
+	)");
+}
+
+QUARK_UNIT_TEST("Floyd test suite", "reduce()", "double max kernel", ""){
+	run_closed(R"(
+
+		func double f(double acc, double e){
+			return e > acc ? e : acc
+		}
+
+		assert(reduce([ 1.5, -3.0, 7.25, 2.0 ], 0.0, f) == 7.25)
+
+	)");
+}
+
+QUARK_UNIT_TEST("Floyd test suite", "reduce()", "non-trivial reducer uses general path", ""){
+	run_closed(R"(
+
+		func int f(int acc, int e){
+			return acc - e
+		}
+
+		assert(reduce([ 1, 2, 3 ], 10, f) == 4)
+
+	)");
+}
+
+QUARK_UNIT_TEST("Floyd test suite", "reduce()", "4 arguments", ""){
+	ut_verify_exception_nolib(
+		QUARK_POS,
+		R"(
+
+			func int f(int acc, int e){
+				return acc + e
+			}
+
+			let result = reduce([ 1, 2, 3 ], 0, f, 7)
+
+		)",
+		"reduce() requires 3 arguments."
+	);
+}
+
 
 
 
@@ -4935,6 +5113,117 @@ QUARK_UNIT_TEST("Floyd test suite", "filter()", "string filter([int], string, fu
 
 
 
+//////////////////////////////////////////		HOST FUNCTION - sort()
+
+
+
+QUARK_UNIT_TEST("Floyd test suite", "sort()", "[int]", ""){
+	run_closed(R"(
+
+		let result = sort([ 5, -3, 12, 0, 7, -3, 1 ])
+		assert(result == [ -3, -3, 0, 1, 5, 7, 12 ])
+
+	)");
+}
+
+QUARK_UNIT_TEST("Floyd test suite", "sort()", "[double]", ""){
+	run_closed(R"(
+
+		let result = sort([ 2.5, -1.0, 0.0, 100.25, -7.5 ])
+		assert(result == [ -7.5, -1.0, 0.0, 2.5, 100.25 ])
+
+	)");
+}
+
+QUARK_UNIT_TEST("Floyd test suite", "sort()", "[string]", ""){
+	run_closed(R"___(
+
+		let result = sort([ "one", "two", "three", "four", "five" ])
+		assert(result == [ "five", "four", "one", "three", "two" ])
+
+	)___");
+}
+
+QUARK_UNIT_TEST("Floyd test suite", "sort()", "[struct]", ""){
+	run_closed(R"___(
+
+		struct pair_t { string b int a }
+
+		let result = sort([ pair_t("x", 2), pair_t("z", 1), pair_t("y", 1) ])
+		assert(size(result) == 3)
+		assert(result[0] == pair_t("x", 2))
+		assert(result[1] == pair_t("y", 1))
+		assert(result[2] == pair_t("z", 1))
+
+	)___");
+}
+
+QUARK_UNIT_TEST("Floyd test suite", "sort()", "Empty vector", ""){
+	run_closed(R"(
+
+		let [int] a = []
+		assert(sort(a) == [])
+
+	)");
+}
+
+QUARK_UNIT_TEST("Floyd test suite", "sort()", "Comparator, descending", ""){
+	run_closed(R"(
+
+		func bool f(int a, int b){
+			return a > b
+		}
+
+		let result = sort([ 5, -3, 12, 0, 7 ], f)
+		assert(result == [ 12, 7, 5, 0, -3 ])
+
+	)");
+}
+
+QUARK_UNIT_TEST("Floyd test suite", "sort()", "Comparator is stable", ""){
+	run_closed(R"___(
+
+		func bool f(string a, string b){
+			return size(a) < size(b)
+		}
+
+		let result = sort([ "three", "one", "seven", "two", "four" ], f)
+		assert(result == [ "one", "two", "four", "three", "seven" ])
+
+	)___");
+}
+
+QUARK_UNIT_TEST("Floyd test suite", "sort()", "Comparator on [double]", ""){
+	run_closed(R"(
+
+		func bool less(double a, double b){
+			return a < b
+		}
+
+		assert(sort([ 2.5, 1.5 ], less) == [ 1.5, 2.5 ])
+		assert(sort([ 0.25, -7.5, 100.0, 3.0 ], less) == [ -7.5, 0.25, 3.0, 100.0 ])
+
+	)");
+}
+
+QUARK_UNIT_TEST("Floyd test suite", "sort()", "Comparator with wrong signature", ""){
+	ut_verify_exception_nolib(
+		QUARK_POS,
+		R"(
+
+			func bool f(int a){
+				return a > 0
+			}
+
+			let result = sort([ 5, -3, 12 ], f)
+
+		)",
+		"Call to sort() uses signature \"function [int]([int],function bool(int) pure) pure\", expected to be \"function [int]([int],function bool(int,int) pure) pure\"."
+	);
+}
+
+
+
 
 
 //////////////////////////////////////////		HOST FUNCTION - supermap()
@@ -5690,6 +5979,577 @@ QUARK_UNIT_TEST("software-system", "run two CONNECTED processes", "", ""){
 	QUARK_UT_VERIFY(result.empty());
 }
 
+//	Processes share a pool of worker threads. Pairs of processes ping-pong, then report to the driver.
+QUARK_UNIT_TEST("software-system", "run many processes ping-pong", "", ""){
+	const auto test_ss = R"(
+
+		software-system {
+			"name": "ping-pong",
+			"desc": "",
+			"people": {},
+			"connections": [],
+			"containers": [ "ping-pong" ]
+		}
+
+		container-def {
+			"name": "ping-pong",
+			"tech": "",
+			"desc": "",
+			"clocks": {
+				"main": {
+					"driver": "driver",
+					"a0": "pinger", "b0": "pinger",
+					"a1": "pinger", "b1": "pinger",
+					"a2": "pinger", "b2": "pinger",
+					"a3": "pinger", "b3": "pinger",
+					"a4": "pinger", "b4": "pinger",
+					"a5": "pinger", "b5": "pinger",
+					"a6": "pinger", "b6": "pinger",
+					"a7": "pinger", "b7": "pinger"
+				}
+			}
+		}
+
+		func int driver__init() impure {
+			for(i in 0 ..< 8){
+				let a = "a" + to_string(i)
+				let b = "b" + to_string(i)
+				let json_value m = [b, a]
+				send(a, m)
+			}
+			return 0
+		}
+
+		func int driver(int state, json_value message) impure {
+			assert(message == "done")
+			let done = state + 1
+			if(done == 8){
+				print("all done")
+				for(i in 0 ..< 8){
+					send("a" + to_string(i), "stop")
+					send("b" + to_string(i), "stop")
+				}
+				send("driver", "stop")
+			}
+			return done
+		}
+
+		//	message is [other, self].
+		func int pinger__init() impure {
+			return 0
+		}
+
+		func int pinger(int state, json_value message) impure {
+			if(state == 100){
+				send("driver", "done")
+				return state
+			}
+			else{
+				let json_value reply = [string(message[1]), string(message[0])]
+				send(string(message[0]), reply)
+				return state + 1
+			}
+		}
+
+	)";
+
+	const auto result = test_run_container2(test_ss, {}, "ping-pong", "");
+	QUARK_UT_VERIFY(result.empty());
+}
+
+
+
+//	Processes can take a message type of their own instead of json_value.
+QUARK_UNIT_TEST("software-system", "run processes with typed messages", "", ""){
+	const auto test_ss = R"(
+
+		software-system {
+			"name": "typed messages",
+			"desc": "",
+			"people": {},
+			"connections": [],
+			"containers": [ "typed" ]
+		}
+
+		container-def {
+			"name": "typed",
+			"tech": "",
+			"desc": "",
+			"clocks": {
+				"main": {
+					"driver": "driver",
+					"counter": "counter",
+					"meter": "meter"
+				}
+			}
+		}
+
+		struct add_t {
+			string text
+			int amount
+		}
+
+		func int driver__init() impure {
+			for(i in 0 ..< 4){
+				send("counter", add_t("add", i + 1))
+			}
+			return 0
+		}
+
+		//	Gets a string, converted to JSON.
+		func int driver(int state, json_value message) impure {
+			assert(message == "done")
+			send("counter", "stop")
+			send("meter", "stop")
+			send("driver", "stop")
+			return state
+		}
+
+		func int counter__init() impure {
+			return 0
+		}
+
+		func int counter(int state, add_t message) impure {
+			assert(message.text == "add")
+			let total = state + message.amount
+			if(total == 10){
+				send("meter", 2.5)
+				send("meter", 0.5)
+			}
+			return total
+		}
+
+		func int meter__init() impure {
+			return 0
+		}
+
+		func int meter(int state, double message) impure {
+			if(state == 0){
+				assert(message == 2.5)
+			}
+			else{
+				assert(message == 0.5)
+				send("driver", "done")
+			}
+			return state + 1
+		}
+
+	)";
+
+	const auto result = test_run_container2(test_ss, {}, "typed", "");
+	QUARK_UT_VERIFY(result.empty());
+}
+
+QUARK_UNIT_TEST("software-system", "run processes with typed messages", "Wrong message type => error", ""){
+	const auto test_ss = R"(
+
+		software-system {
+			"name": "typed messages",
+			"desc": "",
+			"people": {},
+			"connections": [],
+			"containers": [ "typed" ]
+		}
+
+		container-def {
+			"name": "typed",
+			"tech": "",
+			"desc": "",
+			"clocks": {
+				"main": {
+					"counter": "counter"
+				}
+			}
+		}
+
+		func int counter__init() impure {
+			send("counter", "add")
+			return 0
+		}
+
+		func int counter(int state, int message) impure {
+			return state + message
+		}
+
+	)";
+
+	try {
+		test_run_container2(test_ss, {}, "typed", "");
+		QUARK_UT_VERIFY(false);
+	}
+	catch(const std::runtime_error& e){
+		ut_verify(QUARK_POS, e.what(), "Process expects messages of type int, got string.");
+	}
+}
+
+
+//	A handler that takes [json_value] gets all messages waiting in its inbox in one call.
+QUARK_UNIT_TEST("software-system", "run process with batched message handler", "", ""){
+	const auto test_ss = R"(
+
+		software-system {
+			"name": "batch",
+			"desc": "",
+			"people": {},
+			"connections": [],
+			"containers": [ "batch" ]
+		}
+
+		container-def {
+			"name": "batch",
+			"tech": "",
+			"desc": "",
+			"clocks": {
+				"a": { "sender": "sender" },
+				"b": { "receiver": "receiver" }
+			}
+		}
+
+		func int sender__init() impure {
+			for(i in 0 ..< 5){
+				send("receiver", "tick")
+			}
+			send("sender", "stop")
+			return 0
+		}
+
+		func int sender(int state, json_value message) impure {
+			return state
+		}
+
+		func int receiver__init() impure {
+			return 0
+		}
+
+		func int receiver(int state, [json_value] messages) impure {
+			assert(size(messages) > 0)
+			for(i in 0 ..< size(messages)){
+				assert(messages[i] == "tick")
+			}
+			let count = state + size(messages)
+			if(count == 5){
+				print("got all")
+				send("receiver", "stop")
+			}
+			return count
+		}
+
+	)";
+
+	const auto result = test_run_container2(test_ss, {}, "batch", "");
+	QUARK_UT_VERIFY(result.empty());
+}
+
+//	The sender blocks on the receiver's full inbox, so no message is lost.
+QUARK_UNIT_TEST("software-system", "run process with bounded inbox", "", ""){
+	const auto test_ss = R"(
+
+		software-system {
+			"name": "bounded",
+			"desc": "",
+			"people": {},
+			"connections": [],
+			"containers": [ "bounded" ]
+		}
+
+		container-def {
+			"name": "bounded",
+			"tech": "",
+			"desc": "",
+			"clocks": {
+				"a": { "sender": "sender" },
+				"b": { "receiver": { "func": "receiver", "inbox_capacity": 2, "inbox_overflow": "block" } }
+			}
+		}
+
+		func int sender__init() impure {
+			for(i in 0 ..< 20){
+				send("receiver", i)
+			}
+			send("sender", "stop")
+			return 0
+		}
+
+		func int sender(int state, json_value message) impure {
+			return state
+		}
+
+		func int receiver__init() impure {
+			return 0
+		}
+
+		func int receiver(int state, int message) impure {
+			assert(message == state)
+			if(message == 19){
+				print("got all")
+				send("receiver", "stop")
+			}
+			return state + 1
+		}
+
+	)";
+
+	const auto result = test_run_container2(test_ss, {}, "bounded", "");
+	QUARK_UT_VERIFY(result.empty());
+}
+
+QUARK_UNIT_TEST("software-system", "run process with bounded inbox", "unknown overflow => error", ""){
+	const auto test_ss = R"(
+
+		software-system {
+			"name": "bounded",
+			"desc": "",
+			"people": {},
+			"connections": [],
+			"containers": [ "bounded" ]
+		}
+
+		container-def {
+			"name": "bounded",
+			"tech": "",
+			"desc": "",
+			"clocks": {
+				"a": { "receiver": { "func": "receiver", "inbox_capacity": 2, "inbox_overflow": "fifo" } }
+			}
+		}
+
+		func int receiver__init() impure {
+			send("receiver", "stop")
+			return 0
+		}
+
+		func int receiver(int state, json_value message) impure {
+			return state
+		}
+
+	)";
+
+	try {
+		test_run_container2(test_ss, {}, "bounded", "");
+		QUARK_UT_VERIFY(false);
+	}
+	catch(const std::runtime_error& e){
+		QUARK_UT_VERIFY(std::string(e.what()) == "Unknown inbox overflow \"fifo\", use \"block\", \"drop_oldest\" or \"coalesce\".");
+	}
+}
+
+//	Ten periodic ticks with post_after(), then one post_at_time(). The state is the start time.
+QUARK_UNIT_TEST("software-system", "run process with timers", "", ""){
+	const auto test_ss = R"(
+
+		software-system {
+			"name": "timers",
+			"desc": "",
+			"people": {},
+			"connections": [],
+			"containers": [ "timers" ]
+		}
+
+		container-def {
+			"name": "timers",
+			"tech": "",
+			"desc": "",
+			"clocks": {
+				"main": { "ticker": "ticker" }
+			}
+		}
+
+		func int ticker__init() impure {
+			post_after("ticker", 1, 1)
+			return get_time_of_day()
+		}
+
+		func int ticker(int state, int message) impure {
+			if(message < 10){
+				post_after("ticker", 1, message + 1)
+			}
+			else if(message == 10){
+				assert(get_time_of_day() - state >= 10)
+				post_at_time("ticker", get_time_of_day() + 5, 11)
+			}
+			else{
+				assert(get_time_of_day() - state >= 15)
+				print("done")
+				send("ticker", "stop")
+			}
+			return state
+		}
+
+	)";
+
+	const auto result = test_run_container2(test_ss, {}, "timers", "");
+	QUARK_UT_VERIFY(result.empty());
+}
+
+//	pinger resolves ponger's name once and keeps the handle in its state.
+QUARK_UNIT_TEST("software-system", "run process, send_to_handle()", "", ""){
+	const auto test_ss = R"(
+
+		software-system {
+			"name": "handles",
+			"desc": "",
+			"people": {},
+			"connections": [],
+			"containers": [ "handles" ]
+		}
+
+		container-def {
+			"name": "handles",
+			"tech": "",
+			"desc": "",
+			"clocks": {
+				"a": { "pinger": "pinger" },
+				"b": { "ponger": "ponger" }
+			}
+		}
+
+		struct pinger_t { int ponger; int count }
+
+		func pinger_t pinger__init() impure {
+			assert(get_process_handle("nobody") == -1)
+			let ponger = get_process_handle("ponger")
+			assert(ponger >= 0)
+			send_to_handle(ponger, 0)
+			return pinger_t(ponger, 0)
+		}
+
+		func pinger_t pinger(pinger_t state, int message) impure {
+			if(message >= 10){
+				print("done")
+				send_to_handle(state.ponger, -1)
+				send("pinger", "stop")
+			}
+			else{
+				send_to_handle(state.ponger, message + 1)
+			}
+			return update(state, count, state.count + 1)
+		}
+
+		func int ponger__init() impure {
+			return get_process_handle("pinger")
+		}
+
+		func int ponger(int state, int message) impure {
+			if(message == -1){
+				send_to_handle(get_process_handle("ponger"), "stop")
+			}
+			else{
+				send_to_handle(state, message + 1)
+			}
+			return state
+		}
+
+	)";
+
+	const auto result = test_run_container2(test_ss, {}, "handles", "");
+	QUARK_UT_VERIFY(result.empty());
+}
+
+//	The gain message from the main clock reaches synth in its inbox and is handled right before a tick.
+QUARK_UNIT_TEST("software-system", "run process on real-time clock", "", ""){
+	const auto test_ss = R"(
+
+		software-system {
+			"name": "real-time",
+			"desc": "",
+			"people": {},
+			"connections": [],
+			"containers": [ "real-time" ]
+		}
+
+		container-def {
+			"name": "real-time",
+			"tech": "",
+			"desc": "",
+			"clocks": {
+				"main": { "control": "control" },
+				"audio": { "period_ms": 1, "synth": "synth" }
+			}
+		}
+
+		struct synth_t { int start; int ticks; int gain }
+
+		func int control__init() impure {
+			send("synth", "louder")
+			send("control", "stop")
+			return 0
+		}
+
+		func int control(int state, json_value message) impure {
+			return state
+		}
+
+		func synth_t synth__init() impure {
+			return synth_t(get_time_of_day(), 0, 0)
+		}
+
+		func synth_t synth(synth_t state, json_value message) impure {
+			if(message == "louder"){
+				return update(state, gain, state.gain + 1)
+			}
+			else{
+				assert(message == "tick")
+				if(state.ticks == 20){
+					assert(get_time_of_day() - state.start >= 19)
+					assert(state.gain == 1)
+					print("done")
+					send("synth", "stop")
+				}
+				return update(state, ticks, state.ticks + 1)
+			}
+		}
+
+	)";
+
+	const auto result = test_run_container2(test_ss, {}, "real-time", "");
+	QUARK_UT_VERIFY(result.empty());
+}
+
+//	The state stays a native value between messages, it's never converted to value_t and back.
+QUARK_UNIT_TEST("software-system", "run process with dictionary state", "", ""){
+	const auto test_ss = R"(
+
+		software-system {
+			"name": "dict state",
+			"desc": "",
+			"people": {},
+			"connections": [],
+			"containers": [ "dict state" ]
+		}
+
+		container-def {
+			"name": "dict state",
+			"tech": "",
+			"desc": "",
+			"clocks": {
+				"main": { "store": "store" }
+			}
+		}
+
+		func [string: int] store__init() impure {
+			for(i in 0 ..< 10){
+				send("store", i)
+			}
+			return { "count": 0 }
+		}
+
+		func [string: int] store([string: int] state, int message) impure {
+			let state2 = update(state, "count", state["count"] + 1)
+			let state3 = update(state2, "key" + to_string(message), message)
+			if(message == 9){
+				assert(state3["count"] == 10)
+				assert(state3["key7"] == 7)
+				assert(size(state3) == 11)
+				send("store", "stop")
+			}
+			return state3
+		}
+
+	)";
+
+	const auto result = test_run_container2(test_ss, {}, "dict state", "");
+	QUARK_UT_VERIFY(result.empty());
+}
 
 
 
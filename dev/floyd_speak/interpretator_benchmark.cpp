@@ -9,8 +9,28 @@
 #include "interpretator_benchmark.h"
 
 #include "benchmark_basics.h"
+#include "floyd_scheduler.h"
+#include "floyd_shm_transport.h"
+#include "floyd_llvm.h"
+#include "floyd_llvm_helpers.h"
+#include "floyd_llvm_slab.h"
+#include "file_handling.h"
+#include "pass3.h"
+#include "compiler_helpers.h"
+#include "ast_value.h"
 
 #include <string>
+#include <sstream>
+#include <map>
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <unistd.h>
+#include <sys/wait.h>
 
 using std::string;
 
@@ -127,6 +147,1477 @@ OFF_QUARK_UNIT_TEST_VIP("Basic performance", "Text metrics", "", ""){
 
 #endif
 
+//////////////////////////////////////		PROCESS PING-PONG
+
+
+/*
+	Measures the process scheduler: pairs of processes bounce a message back and forth a number of hops, then report
+	to a driver process that stops everybody.
+
+	Processes on the same clock send() synchronously, processes on different clocks go via their inboxes.
+*/
+
+enum class pingpong_clocks {
+	//	All processes on one clock.
+	k_one_clock,
+
+	k_clock_per_process
+};
+
+//	Same message pattern as the Floyd program, without any interpreter. Process 0 is the driver, then a0, b0, a1, b1...
+struct cpp_pingpong_t : public process_executor_i {
+	cpp_pingpong_t(int pairs, int hops) :
+		_pairs(pairs),
+		_hops(hops),
+		_states(1 + pairs * 2, 0)
+	{
+	}
+
+	virtual void on_process_init(int process_id){
+		if(process_id == 0){
+			for(int i = 0 ; i < _pairs ; i++){
+				const auto a = 1 + i * 2;
+				const auto b = a + 1;
+				_scheduler->send_message(a, json_t::make_array({ json_t(b), json_t(a) }));
+			}
+		}
+	}
+
+	virtual void on_process_message(int process_id, const process_message_t& message){
+		if(process_id == 0){
+			_states[0]++;
+			if(_states[0] == _pairs){
+				for(int i = 0 ; i < _states.size() ; i++){
+					_scheduler->send_message(i, json_t("stop"));
+				}
+			}
+		}
+		else if(_states[process_id] == _hops){
+			_scheduler->send_message(0, json_t("done"));
+		}
+		else{
+			const auto other = message._json.get_array_n(0);
+			const auto self = message._json.get_array_n(1);
+			_scheduler->send_message(static_cast<int>(other.get_number()), json_t::make_array({ self, other }));
+			_states[process_id]++;
+		}
+	}
+
+	int _pairs;
+	int _hops;
+	std::vector<int> _states;
+	process_scheduler_t* _scheduler = nullptr;
+};
+
+static std::string make_pingpong_floyd_str(int pairs, int hops, pingpong_clocks clocks){
+	std::vector<std::string> names = { "driver" };
+	for(int i = 0 ; i < pairs ; i++){
+		names.push_back("a" + std::to_string(i));
+		names.push_back("b" + std::to_string(i));
+	}
+
+	std::stringstream clocks_json;
+	if(clocks == pingpong_clocks::k_one_clock){
+		clocks_json << "\"main\": { ";
+		for(int i = 0 ; i < names.size() ; i++){
+			const auto function = i == 0 ? "driver" : "pinger";
+			clocks_json << (i > 0 ? ", " : "") << "\"" << names[i] << "\": \"" << function << "\"";
+		}
+		clocks_json << " }";
+	}
+	else{
+		for(int i = 0 ; i < names.size() ; i++){
+			const auto function = i == 0 ? "driver" : "pinger";
+			clocks_json << (i > 0 ? ", " : "") << "\"" << names[i] << "\": { \"" << names[i] << "\": \"" << function << "\" }";
+		}
+	}
+
+	return std::string() + R"(
+		software-system {
+			"name": "ping-pong",
+			"desc": "Many processes sending messages to each other.",
+			"people": {},
+			"connections": [],
+			"containers": [ "ping-pong" ]
+		}
+
+		container-def {
+			"name": "ping-pong",
+			"tech": "",
+			"desc": "",
+			"clocks": {
+				)" + clocks_json.str() + R"(
+			}
+		}
+
+		let pairs = )" + std::to_string(pairs) + R"(
+		let hops = )" + std::to_string(hops) + R"(
+
+		func int driver__init() impure {
+			for(i in 0 ..< pairs){
+				let a = "a" + to_string(i)
+				let b = "b" + to_string(i)
+				let json_value m = [b, a]
+				send(a, m)
+			}
+			return 0
+		}
+
+		func int driver(int state, json_value message) impure {
+			let done = state + 1
+			if(done == pairs){
+				for(i in 0 ..< pairs){
+					send("a" + to_string(i), "stop")
+					send("b" + to_string(i), "stop")
+				}
+				send("driver", "stop")
+			}
+			return done
+		}
+
+		//	message is [other, self].
+		func int pinger__init() impure {
+			return 0
+		}
+
+		func int pinger(int state, json_value message) impure {
+			if(state == hops){
+				send("driver", "done")
+				return state
+			}
+			else{
+				let json_value reply = [string(message[1]), string(message[0])]
+				send(string(message[0]), reply)
+				return state + 1
+			}
+		}
+	)";
+}
+
+static bench_result_t bench_process_pingpong(const std::string& name, int pairs, int hops, pingpong_clocks clocks){
+	const auto cpp_ns = measure_execution_time_ns(
+		[&] {
+			cpp_pingpong_t executor(pairs, hops);
+			const auto process_count = static_cast<int>(executor._states.size());
+
+			std::vector<int> process_clocks;
+			for(int i = 0 ; i < process_count ; i++){
+				process_clocks.push_back(clocks == pingpong_clocks::k_one_clock ? 0 : i);
+			}
+			const auto clock_count = clocks == pingpong_clocks::k_one_clock ? 1 : process_count;
+
+			process_scheduler_t scheduler(process_clocks, executor, process_scheduler_t::get_default_thread_count(clock_count));
+			executor._scheduler = &scheduler;
+			scheduler.run();
+		},
+		1
+	);
+
+	const auto program = compile_to_bytecode(make_compilation_unit_nolib(make_pingpong_floyd_str(pairs, hops, clocks), ""));
+	const auto floyd_ns = measure_execution_time_ns(
+		[&] {
+			run_container(program, {}, "ping-pong");
+		},
+		1
+	);
+
+	const auto result = bench_result_t{ name, cpp_ns, floyd_ns };
+	trace_result(result);
+	return result;
+}
+
+//	Many senders, one receiver. Measures inbox throughput: the senders don't run any Floyd code.
+struct cpp_fan_in_t : public process_executor_i {
+	cpp_fan_in_t(int senders, int messages_per_sender) :
+		_senders(senders),
+		_messages_per_sender(messages_per_sender)
+	{
+	}
+
+	virtual void on_process_init(int process_id){
+		if(process_id > 0){
+			for(int i = 0 ; i < _messages_per_sender ; i++){
+				_scheduler->send_message(0, json_t(i));
+			}
+		}
+	}
+
+	virtual void on_process_message(int process_id, const process_message_t& message){
+		_received++;
+		if(_received == _senders * _messages_per_sender){
+			for(int i = 0 ; i <= _senders ; i++){
+				_scheduler->send_message(i, json_t("stop"));
+			}
+		}
+	}
+
+	int _senders;
+	int _messages_per_sender;
+	int _received = 0;
+	process_scheduler_t* _scheduler = nullptr;
+};
+
+//	inbox_capacity > 0: the receiver's inbox is bounded and senders block when it's full.
+static void bench_fan_in(int senders, int inbox_capacity = 0){
+	const int k_total_messages = 160000;
+	const auto messages_per_sender = k_total_messages / senders;
+
+	const auto ns = measure_execution_time_ns(
+		[&] {
+			cpp_fan_in_t executor(senders, messages_per_sender);
+
+			//	Everybody on their own clock.
+			std::vector<int> process_clocks;
+			for(int i = 0 ; i <= senders ; i++){
+				process_clocks.push_back(i);
+			}
+			process_scheduler_t scheduler(process_clocks, executor, process_scheduler_t::get_default_thread_count(senders + 1));
+			scheduler.set_inbox_def(0, inbox_def_t{ inbox_capacity, inbox_overflow_t::k_block });
+			executor._scheduler = &scheduler;
+			scheduler.run();
+		},
+		1
+	);
+
+	const auto messages_per_second = static_cast<double>(messages_per_sender * senders) / (static_cast<double>(ns) / 1000000000.0);
+	std::cout << "send(): " << senders << " senders into one receiver"
+		<< (inbox_capacity > 0 ? ", inbox capacity " + std::to_string(inbox_capacity) : std::string()) << ": "
+		<< number_fmt(static_cast<unsigned long long>(messages_per_second)) << " messages/s" << std::endl;
+}
+
+/*
+	One process sends the same struct, holding a 1000-element vector, to another process on another clock.
+	JSON: the sender converts it to json_value and the receiver reads the vector from the JSON.
+	Typed: the receiver takes the struct type and gets the sender's value by reference.
+*/
+static std::string make_payload_floyd_str(int count, bool typed){
+	const auto message_type = typed ? "payload_t" : "json_value";
+	const auto send_expr = typed ? "p" : "value_to_jsonvalue(p)";
+	const auto samples_expr = typed ? "message.samples" : "message[\"samples\"]";
+
+	return std::string() + R"(
+		software-system {
+			"name": "payload",
+			"desc": "",
+			"people": {},
+			"connections": [],
+			"containers": [ "payload" ]
+		}
+
+		container-def {
+			"name": "payload",
+			"tech": "",
+			"desc": "",
+			"clocks": {
+				"a": { "sender": "sender" },
+				"b": { "receiver": "receiver" }
+			}
+		}
+
+		struct payload_t {
+			string name
+			[int] samples
+		}
+
+		let count = )" + std::to_string(count) + R"(
+
+		func int sender__init() impure {
+			mutable [int] samples = []
+			for(i in 0 ..< 1000){
+				samples = push_back(samples, i)
+			}
+			let p = payload_t("sensor", samples)
+			for(i in 0 ..< count){
+				send("receiver", )" + send_expr + R"()
+			}
+			send("sender", "stop")
+			return 0
+		}
+
+		func int sender(int state, json_value message) impure {
+			return state
+		}
+
+		func int receiver__init() impure {
+			return 0
+		}
+
+		func int receiver(int state, )" + message_type + R"( message) impure {
+			assert(size()" + samples_expr + R"() == 1000)
+			if(state + 1 == count){
+				send("receiver", "stop")
+			}
+			return state + 1
+		}
+	)";
+}
+
+static void bench_typed_messages(){
+	const int count = 1000;
+
+	const auto json_program = compile_to_bytecode(make_compilation_unit_nolib(make_payload_floyd_str(count, false), ""));
+	const auto json_ns = measure_execution_time_ns([&] { run_container(json_program, {}, "payload"); }, 1);
+
+	const auto typed_program = compile_to_bytecode(make_compilation_unit_nolib(make_payload_floyd_str(count, true), ""));
+	const auto typed_ns = measure_execution_time_ns([&] { run_container(typed_program, {}, "payload"); }, 1);
+
+	std::cout << "send() struct with 1000 ints, per message: json_value "
+		<< json_ns / count << " ns, typed " << typed_ns / count << " ns" << std::endl;
+}
+
+//	A process whose state is a big dictionary. Each message updates one entry.
+static std::string make_big_state_floyd_str(int count){
+	return std::string() + R"(
+		software-system {
+			"name": "big state",
+			"desc": "",
+			"people": {},
+			"connections": [],
+			"containers": [ "big state" ]
+		}
+
+		container-def {
+			"name": "big state",
+			"tech": "",
+			"desc": "",
+			"clocks": {
+				"main": { "store": "store" }
+			}
+		}
+
+		let count = )" + std::to_string(count) + R"(
+
+		func [string: int] store__init() impure {
+			mutable [string: int] d = {}
+			for(i in 0 ..< 10000){
+				d = update(d, "key" + to_string(i), i)
+			}
+			for(i in 0 ..< count){
+				send("store", i)
+			}
+			return d
+		}
+
+		func [string: int] store([string: int] state, int message) impure {
+			if(message == count - 1){
+				send("store", "stop")
+			}
+			return update(state, "key" + to_string(message), message)
+		}
+	)";
+}
+
+static void bench_process_state(){
+	const int count = 1000;
+
+	const auto program = compile_to_bytecode(make_compilation_unit_nolib(make_big_state_floyd_str(count), ""));
+	const auto ns = measure_execution_time_ns([&] { run_container(program, {}, "big state"); }, 1);
+
+	std::cout << "Process with 10000-entry dict state, per message: " << ns / count << " ns" << std::endl;
+}
+
+//	A burst of messages to a process on another clock, handled one by one or as batches.
+static std::string make_burst_floyd_str(int count, bool batched){
+	const auto handler = batched
+		? R"(
+			func int receiver(int state, [json_value] messages) impure {
+				let count2 = state + size(messages)
+				if(count2 == count){
+					send("receiver", "stop")
+				}
+				return count2
+			}
+		)"
+		: R"(
+			func int receiver(int state, json_value message) impure {
+				let count2 = state + 1
+				if(count2 == count){
+					send("receiver", "stop")
+				}
+				return count2
+			}
+		)";
+
+	return std::string() + R"(
+		software-system {
+			"name": "burst",
+			"desc": "",
+			"people": {},
+			"connections": [],
+			"containers": [ "burst" ]
+		}
+
+		container-def {
+			"name": "burst",
+			"tech": "",
+			"desc": "",
+			"clocks": {
+				"a": { "sender": "sender" },
+				"b": { "receiver": "receiver" }
+			}
+		}
+
+		let count = )" + std::to_string(count) + R"(
+
+		func int sender__init() impure {
+			for(i in 0 ..< count){
+				send("receiver", "tick")
+			}
+			send("sender", "stop")
+			return 0
+		}
+
+		func int sender(int state, json_value message) impure {
+			return state
+		}
+
+		func int receiver__init() impure {
+			return 0
+		}
+	)" + handler;
+}
+
+static void bench_burst(){
+	const int count = 10000;
+
+	for(const auto batched: { false, true }){
+		const auto program = compile_to_bytecode(make_compilation_unit_nolib(make_burst_floyd_str(count, batched), ""));
+		const auto ns = measure_execution_time_ns([&] { run_container(program, {}, "burst"); }, 1);
+		const auto messages_per_second = static_cast<double>(count) / (static_cast<double>(ns) / 1000000000.0);
+		std::cout << "Burst of " << count << " messages, " << (batched ? "batched handler: " : "one call per message: ")
+			<< number_fmt(static_cast<unsigned long long>(messages_per_second)) << " messages/s" << std::endl;
+	}
+}
+
+//	Sender sends count int messages to receiver, on another clock. By name: send() looks up "receiver" each time.
+//	By handle: the name is resolved once with get_process_handle().
+static std::string make_send_by_handle_floyd_str(int count, bool by_handle){
+	const auto send_loop = by_handle
+		? R"(
+			let receiver = get_process_handle("receiver")
+			for(i in 0 ..< count){
+				send_to_handle(receiver, i)
+			}
+		)"
+		: R"(
+			for(i in 0 ..< count){
+				send("receiver", i)
+			}
+		)";
+
+	return std::string() + R"(
+		software-system {
+			"name": "handles",
+			"desc": "",
+			"people": {},
+			"connections": [],
+			"containers": [ "handles" ]
+		}
+
+		container-def {
+			"name": "handles",
+			"tech": "",
+			"desc": "",
+			"clocks": {
+				"a": { "sender": "sender" },
+				"b": { "receiver": "receiver" }
+			}
+		}
+
+		let count = )" + std::to_string(count) + R"(
+
+		func int sender__init() impure {
+			)" + send_loop + R"(
+			send("sender", "stop")
+			return 0
+		}
+
+		func int sender(int state, json_value message) impure {
+			return state
+		}
+
+		func int receiver__init() impure {
+			return 0
+		}
+
+		func int receiver(int state, int message) impure {
+			let count2 = state + 1
+			if(count2 == count){
+				send("receiver", "stop")
+			}
+			return count2
+		}
+	)";
+}
+
+static void bench_send_by_handle(){
+	const int count = 100000;
+
+	for(const auto by_handle: { false, true }){
+		const auto program = compile_to_bytecode(make_compilation_unit_nolib(make_send_by_handle_floyd_str(count, by_handle), ""));
+		const auto ns = measure_execution_time_ns([&] { run_container(program, {}, "handles"); }, 1);
+		const auto messages_per_second = static_cast<double>(count) / (static_cast<double>(ns) / 1000000000.0);
+		std::cout << (by_handle ? "send_to_handle(): " : "send() by name: ")
+			<< number_fmt(static_cast<unsigned long long>(messages_per_second)) << " messages/s" << std::endl;
+	}
+}
+
+/*
+	Startup cost of a container with many processes. The global code builds a table, like a program with lookup tables
+	or constants would. driver stops all processes at once.
+*/
+static std::string make_startup_floyd_str(int processes, int table_size){
+	std::stringstream clocks_json;
+	clocks_json << "\"main\": { \"driver\": \"driver\" }";
+	for(int i = 0 ; i < processes ; i++){
+		clocks_json << ", \"c" << i << "\": { \"p" << i << "\": \"worker\" }";
+	}
+
+	return std::string() + R"(
+		software-system {
+			"name": "startup",
+			"desc": "",
+			"people": {},
+			"connections": [],
+			"containers": [ "startup" ]
+		}
+
+		container-def {
+			"name": "startup",
+			"tech": "",
+			"desc": "",
+			"clocks": {
+				)" + clocks_json.str() + R"(
+			}
+		}
+
+		let processes = )" + std::to_string(processes) + R"(
+
+		func [int] make_table(int count){
+			mutable [int] result = []
+			for(i in 0 ..< count){
+				result = push_back(result, i * i)
+			}
+			return result
+		}
+
+		let table = make_table()" + std::to_string(table_size) + R"()
+
+		func int driver__init() impure {
+			for(i in 0 ..< processes){
+				send("p" + to_string(i), "stop")
+			}
+			send("driver", "stop")
+			return 0
+		}
+
+		func int driver(int state, json_value message) impure {
+			return state
+		}
+
+		func int worker__init() impure {
+			return size(table)
+		}
+
+		func int worker(int state, json_value message) impure {
+			return state
+		}
+	)";
+}
+
+static void bench_container_startup(int processes, int table_size){
+	const auto program = compile_to_bytecode(make_compilation_unit_nolib(make_startup_floyd_str(processes, table_size), ""));
+	const auto ns = measure_execution_time_ns([&] { run_container(program, {}, "startup"); }, 1);
+	std::cout << "Container startup, " << processes << " processes, " << table_size << "-element global table: "
+		<< ns / 1000000 << " ms, " << ns / (processes + 1) / 1000 << " us per process" << std::endl;
+}
+
+/*
+	Many processes, each with a periodic timer. Each tick posts the next one a period after the previous deadline, so
+	lateness doesn't add up. Measures how late the ticks arrive.
+*/
+struct cpp_ticker_t : public process_executor_i {
+	cpp_ticker_t(int processes, int ticks, std::chrono::microseconds period) :
+		_ticks(ticks),
+		_period(period),
+		_lateness(processes)
+	{
+	}
+
+	virtual void on_process_init(int process_id){
+		//	Spread the processes across one period.
+		const auto offset = _period * process_id / static_cast<int>(_lateness.size());
+		post(process_id, _start + _period + offset);
+	}
+
+	virtual void on_process_message(int process_id, const process_message_t& message){
+		const auto deadline = _start + std::chrono::nanoseconds(static_cast<int64_t>(message._json.get_number()));
+		auto& lateness = _lateness[process_id];
+		lateness.push_back(std::chrono::steady_clock::now() - deadline);
+
+		if(lateness.size() < _ticks){
+			post(process_id, deadline + _period);
+		}
+		else{
+			_scheduler->send_message(process_id, json_t("stop"));
+		}
+	}
+
+	void post(int process_id, std::chrono::steady_clock::time_point deadline){
+		const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - _start).count();
+		_scheduler->post_message(process_id, json_t(static_cast<double>(ns)), deadline);
+	}
+
+	const int _ticks;
+	const std::chrono::microseconds _period;
+	const std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+	std::vector<std::vector<std::chrono::steady_clock::duration>> _lateness;
+	process_scheduler_t* _scheduler = nullptr;
+};
+
+static void bench_timers(int processes, int ticks, std::chrono::microseconds period){
+	cpp_ticker_t executor(processes, ticks, period);
+	std::vector<int> process_clocks;
+	for(int i = 0 ; i < processes ; i++){
+		process_clocks.push_back(i);
+	}
+	process_scheduler_t scheduler(process_clocks, executor, process_scheduler_t::get_default_thread_count(processes));
+	executor._scheduler = &scheduler;
+	scheduler.run();
+
+	std::vector<int64_t> all_us;
+	for(const auto& e: executor._lateness){
+		for(const auto& lateness: e){
+			all_us.push_back(std::chrono::duration_cast<std::chrono::microseconds>(lateness).count());
+		}
+	}
+	std::sort(all_us.begin(), all_us.end());
+	const auto mean_us = std::accumulate(all_us.begin(), all_us.end(), int64_t(0)) / static_cast<int64_t>(all_us.size());
+
+	std::cout << "post_message(): " << processes << " periodic timers, period " << period.count() << " us: "
+		<< "lateness mean " << mean_us << " us, p99 " << all_us[all_us.size() * 99 / 100] << " us, max " << all_us.back() << " us" << std::endl;
+}
+
+/*
+	Process 0 runs on a real-time clock. The other processes keep the worker threads busy by sending messages to
+	themselves, until process 0 has seen enough ticks and stops everyone.
+*/
+struct cpp_real_time_t : public process_executor_i {
+	cpp_real_time_t(int processes, int ticks) :
+		_processes(processes),
+		_ticks(ticks)
+	{
+	}
+
+	virtual void on_process_init(int process_id){
+		if(process_id > 0){
+			_scheduler->send_message(process_id, json_t("work"));
+		}
+	}
+
+	virtual void on_process_message(int process_id, const process_message_t& message){
+		if(process_id == 0){
+			_tick_count++;
+			if(_tick_count == _ticks){
+				for(int i = 0 ; i < _processes ; i++){
+					_scheduler->send_message(i, json_t("stop"));
+				}
+			}
+		}
+		else{
+			volatile int64_t acc = 0;
+			for(int i = 0 ; i < 10000 ; i++){
+				acc = acc + i;
+			}
+			_scheduler->send_message(process_id, json_t("work"));
+		}
+	}
+
+	const int _processes;
+	const int _ticks;
+	int _tick_count = 0;
+	process_scheduler_t* _scheduler = nullptr;
+};
+
+static void bench_real_time_clock(std::chrono::microseconds period, int ticks, int busy_processes){
+	const int processes = 1 + busy_processes;
+	cpp_real_time_t executor(processes, ticks);
+	std::vector<int> process_clocks;
+	for(int i = 0 ; i < processes ; i++){
+		process_clocks.push_back(i);
+	}
+	process_scheduler_t scheduler(process_clocks, executor, process_scheduler_t::get_default_thread_count(std::max(busy_processes, 1)));
+	scheduler.set_clock_period(0, period);
+	executor._scheduler = &scheduler;
+	scheduler.run();
+
+	const auto stats = scheduler.get_clock_stats(0);
+	std::cout << "Real-time clock, period " << period.count() << " us, " << busy_processes << " busy processes: "
+		<< stats._tick_count << " ticks, deadline misses " << stats._deadline_misses << ", skipped " << stats._skipped_ticks
+		<< ", jitter mean " << std::chrono::duration_cast<std::chrono::microseconds>(stats._jitter_mean).count() << " us"
+		<< ", max " << std::chrono::duration_cast<std::chrono::microseconds>(stats._jitter_max).count() << " us" << std::endl;
+}
+
+/*
+	Messages from another OS process through a shared memory ring vs from another thread in the same OS process.
+	flat_size == 0: each message is a JSON number. Else a flat payload of flat_size bytes: in the same OS process the
+	sender allocates the bytes and passes them by reference, from another OS process they are written straight into
+	the ring and the receiver copies them out once.
+*/
+struct cpp_counter_t : public process_executor_i {
+	cpp_counter_t(int count) :
+		_count(count)
+	{
+	}
+
+	virtual void on_process_init(int process_id){
+	}
+
+	virtual void on_process_message(int process_id, const process_message_t& message){
+		_received++;
+		if(_received == _count){
+			_scheduler->send_message(0, json_t("stop"));
+		}
+	}
+
+	const int _count;
+	int _received = 0;
+	process_scheduler_t* _scheduler = nullptr;
+};
+
+static std::shared_ptr<const void> make_flat_value(const uint8_t* data, size_t size){
+	return std::make_shared<std::vector<uint8_t>>(data, data + size);
+}
+
+//	Runs f in a child OS process that exits when f returns.
+static pid_t run_in_child_process(const std::function<void()>& f){
+	const auto pid = fork();
+	if(pid == 0){
+		f();
+		_exit(0);
+	}
+	QUARK_ASSERT(pid > 0);
+	return pid;
+}
+
+static void bench_shm_throughput(int count, size_t flat_size){
+	const auto in_process_ns = measure_execution_time_ns(
+		[&] {
+			cpp_counter_t executor(count);
+			process_scheduler_t scheduler(1, executor, 1);
+			executor._scheduler = &scheduler;
+			std::thread sender([&](){
+				const std::vector<uint8_t> bytes(flat_size, 7);
+				for(int i = 0 ; i < count ; i++){
+					if(flat_size == 0){
+						scheduler.send_message(0, json_t(i));
+					}
+					else{
+						scheduler.send_message(0, process_message_t(make_flat_value(&bytes[0], flat_size)));
+					}
+				}
+			});
+			scheduler.run();
+			sender.join();
+		},
+		1
+	);
+
+	const auto name = "/floyd-bench-" + std::to_string(getpid());
+	const auto shm_ns = measure_execution_time_ns(
+		[&] {
+			cpp_counter_t executor(count);
+			process_scheduler_t scheduler(1, executor, 1);
+			executor._scheduler = &scheduler;
+			shm_receiver_t receiver(name, 1 << 20, scheduler, 1, [](int process_handle, const uint8_t* data, size_t size){
+				return process_message_t(make_flat_value(data, size));
+			});
+
+			const auto pid = run_in_child_process([&](){
+				shm_sender_t sender(name);
+				for(int i = 0 ; i < count ; i++){
+					if(flat_size == 0){
+						sender.send(0, json_t(i));
+					}
+					else{
+						auto p = sender.begin_flat(0, flat_size);
+						std::memset(p, 7, flat_size);
+						sender.end_flat();
+					}
+				}
+				sender.close();
+			});
+			receiver.start();
+			scheduler.run();
+			receiver.join();
+			waitpid(pid, nullptr, 0);
+		},
+		1
+	);
+
+	const auto per_second = [&](int64_t ns){
+		return number_fmt(static_cast<unsigned long long>(static_cast<double>(count) / (static_cast<double>(ns) / 1000000000.0)));
+	};
+	std::cout << "Messages into one process, " << (flat_size == 0 ? std::string("JSON number") : std::to_string(flat_size) + " flat bytes") << ": "
+		<< "other thread " << per_second(in_process_ns) << " messages/s, "
+		<< "other OS process via shared memory " << per_second(shm_ns) << " messages/s" << std::endl;
+}
+
+//	Process 0 sends a number, the echo sends it back, round_trips times.
+struct cpp_echo_client_t : public process_executor_i {
+	cpp_echo_client_t(int round_trips, const std::function<void(int n)>& send) :
+		_round_trips(round_trips),
+		_send(send)
+	{
+	}
+
+	virtual void on_process_init(int process_id){
+		if(process_id == 0){
+			_send(0);
+		}
+	}
+
+	virtual void on_process_message(int process_id, const process_message_t& message){
+		const auto n = static_cast<int>(message._json.get_number());
+		if(process_id == 1){
+			_scheduler->send_message(0, json_t(n));
+		}
+		else if(n + 1 < _round_trips){
+			_send(n + 1);
+		}
+		else{
+			_scheduler->send_message(0, json_t("stop"));
+			_scheduler->send_message(1, json_t("stop"));
+		}
+	}
+
+	const int _round_trips;
+	const std::function<void(int n)> _send;
+	process_scheduler_t* _scheduler = nullptr;
+};
+
+static void bench_shm_latency(int round_trips){
+	//	Process 1 is the echo, on its own clock.
+	const auto in_process_ns = measure_execution_time_ns(
+		[&] {
+			process_scheduler_t* scheduler_ptr = nullptr;
+			cpp_echo_client_t executor(round_trips, [&](int n){ scheduler_ptr->send_message(1, json_t(n)); });
+			process_scheduler_t scheduler(std::vector<int>{ 0, 1 }, executor, 2);
+			scheduler_ptr = &scheduler;
+			executor._scheduler = &scheduler;
+			scheduler.run();
+		},
+		1
+	);
+
+	//	The echo is a loop in another OS process that copies each record back to us. Process 1 is unused.
+	const auto to_echo_name = "/floyd-bench-" + std::to_string(getpid()) + "-to-echo";
+	const auto from_echo_name = "/floyd-bench-" + std::to_string(getpid()) + "-from-echo";
+	const auto shm_ns = measure_execution_time_ns(
+		[&] {
+			shm_ring_t to_echo(to_echo_name, 4096);
+			std::unique_ptr<shm_sender_t> sender;
+			cpp_echo_client_t executor(round_trips, [&](int n){ sender->send(0, json_t(n)); });
+			process_scheduler_t scheduler(std::vector<int>{ 0, 1 }, executor, 1);
+			executor._scheduler = &scheduler;
+			shm_receiver_t receiver(from_echo_name, 4096, scheduler, 2);
+
+			const auto pid = run_in_child_process([&](){
+				shm_ring_t in(to_echo_name);
+				shm_ring_t out(from_echo_name);
+				while(true){
+					const bool closed = in.is_writer_closed();
+					shm_ring_t::record_t record;
+					if(in.begin_read(record)){
+						auto p = out.begin_write(record._kind, record._process_handle, record._size);
+						std::memcpy(p, record._payload, record._size);
+						out.end_write();
+						in.end_read();
+					}
+					else if(closed){
+						break;
+					}
+					else{
+						in.wait_readable(std::chrono::milliseconds(10));
+					}
+				}
+				out.close_writer();
+			});
+
+			sender.reset(new shm_sender_t(to_echo_name));
+			receiver.start();
+			scheduler.run();
+			sender->close();
+			receiver.join();
+			waitpid(pid, nullptr, 0);
+		},
+		1
+	);
+
+	std::cout << "Round trip to an echo process: other clock " << in_process_ns / round_trips / 1000.0 << " us, "
+		<< "other OS process via shared memory " << shm_ns / round_trips / 1000.0 << " us" << std::endl;
+}
+
+static void bench_processes(){
+	bench_fan_in(1);
+	bench_fan_in(4);
+	bench_fan_in(16);
+	bench_fan_in(4, 64);
+
+	bench_process_pingpong("10000 processes ping-pong", 5000, 10, pingpong_clocks::k_clock_per_process);
+
+	//	send() latency: one pair, many hops. Per hop = total / (hops * 2).
+	const int hops = 10000;
+	const auto sync = bench_process_pingpong("send() same clock, synchronous", 1, hops, pingpong_clocks::k_one_clock);
+	const auto async = bench_process_pingpong("send() different clocks, via inbox", 1, hops, pingpong_clocks::k_clock_per_process);
+
+	std::cout << "send() latency per hop, C++ executor: synchronous "
+		<< sync._cpp_ns / (hops * 2) << " ns, via inbox " << async._cpp_ns / (hops * 2) << " ns" << std::endl;
+	std::cout << "send() latency per hop, Floyd: synchronous "
+		<< sync._floyd_ns / (hops * 2) << " ns, via inbox " << async._floyd_ns / (hops * 2) << " ns" << std::endl;
+
+	bench_typed_messages();
+	bench_process_state();
+	bench_burst();
+	bench_send_by_handle();
+	bench_container_startup(1000, 10000);
+
+	bench_timers(10, 100, std::chrono::microseconds(1000));
+	bench_timers(2000, 20, std::chrono::microseconds(10000));
+
+	bench_real_time_clock(std::chrono::microseconds(2900), 1000, 0);
+	bench_real_time_clock(std::chrono::microseconds(2900), 1000, 8);
+
+	bench_shm_throughput(200000, 0);
+	bench_shm_throughput(200000, 256);
+	bench_shm_latency(20000);
+}
+
+
+/*
+	Compiles each program with LLVM at -O0 to -O3 and calls its f(). Compile time is from the semantic AST to
+	finalized machine code: IR generation, the optimization passes and the JIT's code generator.
+*/
+static void bench_llvm_optimization_levels(){
+	const std::vector<std::pair<std::string, std::string>> programs = {
+		{
+			"For loop incrementing variable",
+			R"(
+				func int f(){
+					mutable result = 0
+					for(i in 0 ..< 50000000){
+						result = result + 1
+					}
+					return result
+				}
+			)"
+		},
+		{
+			"For loop with if/else",
+			R"(
+				func int f(){
+					mutable result = 0
+					for(i in 0 ..< 10000000){
+						let a = result + i * i + 2 * i - result
+						if(a > 0){
+							result = -a
+						}
+						else{
+							result = a
+						}
+					}
+					return result
+				}
+			)"
+		},
+		{
+			"For loop with int math",
+			R"(
+				func int f(){
+					mutable int result1 = 0
+					mutable int result2 = 0
+					mutable int result3 = 0
+					for(i in 0 ..< 20000000){
+						result1 = result1 + i * 2
+						result2 = result2 + result1 * 2
+						result3 = result3 + result1 + result1
+					}
+					return result1 + result2 + result3
+				}
+			)"
+		},
+		{
+			"Fibonacci",
+			R"(
+				func int fibonacci(int n) {
+					if (n <= 1){
+						return n
+					}
+					return fibonacci(n - 2) + fibonacci(n - 1)
+				}
+
+				func int f(){
+					mutable sum = 0
+					for (i in 0 ..< 32) {
+						sum = sum + fibonacci(i)
+					}
+					return sum
+				}
+			)"
+		},
+		{
+			"push_back() and reduce()",
+			R"(
+				func int add(int acc, int e){
+					let sum = acc + e
+					return sum
+				}
+
+				func int f(){
+					mutable [int] a = []
+					for(i in 0 ..< 2000){
+						a = push_back(a, i)
+					}
+					mutable sum = 0
+					for(i in 0 ..< 1000){
+						sum = sum + reduce(a, i, add)
+					}
+					return sum
+				}
+			)"
+		}
+	};
+
+	const std::vector<llvm_optimization_level> levels = {
+		llvm_optimization_level::k_O0, llvm_optimization_level::k_O1, llvm_optimization_level::k_O2, llvm_optimization_level::k_O3
+	};
+
+	for(const auto& program: programs){
+		const auto cu = make_compilation_unit_lib(program.second, "");
+		const auto pass3 = compile_to_sematic_ast__errors(cu);
+
+		std::cout << "LLVM " << program.first << ":";
+		for(const auto level: levels){
+			llvm_instance_t instance;
+			const auto compile_start = std::chrono::high_resolution_clock::now();
+			auto ir = generate_llvm_ir_program(instance, pass3, "");
+			ir->optimization_level = level;
+			auto ee = make_engine_run_init(instance, *ir);
+			const auto compile_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - compile_start).count();
+
+			const auto f = bind_function(ee, "f");
+			QUARK_ASSERT(f.first != nullptr);
+			const auto f2 = *reinterpret_cast<FLOYD_RUNTIME_MAIN_NO_ARGS_PURE*>(f.first);
+			int64_t result = 0;
+			const auto run_ns = measure_execution_time_ns(
+				[&] {
+					result = (*f2)(reinterpret_cast<floyd_runtime_t*>(&ee));
+				},
+				1
+			);
+			call_floyd_runtime_deinit(ee);
+
+			std::cout << " -O" << static_cast<int>(level) << " compile " << compile_ns / 1000000 << " ms run " << run_ns / 1000 << " us"
+				<< (level == levels.back() ? "" : ",");
+		}
+		std::cout << std::endl;
+	}
+}
+
+/*
+	Startup time of run_llvm with the JIT cache: the cold run parses, generates IR and compiles, then stores the
+	machine code. The warm run loads it instead.
+*/
+static void bench_jit_cache(){
+	const std::string program_source = R"(
+		func int fibonacci(int n) {
+			if (n <= 1){
+				return n
+			}
+			return fibonacci(n - 2) + fibonacci(n - 1)
+		}
+
+		struct pixel_t {
+			double red
+			double green
+			double blue
+		}
+
+		func pixel_t mix(pixel_t a, pixel_t b){
+			return pixel_t((a.red + b.red) / 2.0, (a.green + b.green) / 2.0, (a.blue + b.blue) / 2.0)
+		}
+
+		func string describe(pixel_t p){
+			return "rgb " + to_string(p.red) + " " + to_string(p.green) + " " + to_string(p.blue)
+		}
+
+		let sum = fibonacci(10)
+		let gray = mix(pixel_t(1.0, 1.0, 1.0), pixel_t(0.0, 0.0, 0.0))
+		let s = describe(gray)
+	)";
+
+	const auto cache_dir = GetDirectories().temp_dir + "/floyd_benchmark/jit_cache";
+	DeleteDeep(cache_dir);
+
+	jit_cache_settings_t cache;
+	cache.cache_dir = cache_dir;
+	cache.compiler_version = "benchmark";
+
+	const auto no_cache_ns = measure_execution_time_ns(
+		[&] { run_using_llvm_helper(program_source, "", {}, llvm_optimization_level::k_O2); },
+		1
+	);
+	const auto cold_ns = measure_execution_time_ns(
+		[&] { run_using_llvm_helper(program_source, "", {}, llvm_optimization_level::k_O2, cache); },
+		1
+	);
+	const auto warm_ns = measure_execution_time_ns(
+		[&] { run_using_llvm_helper(program_source, "", {}, llvm_optimization_level::k_O2, cache); },
+		1
+	);
+	DeleteDeep(cache_dir);
+
+	std::cout << "LLVM JIT cache, startup -O2:"
+		<< " no cache " << no_cache_ns / 1000 << " us,"
+		<< " cold " << cold_ns / 1000 << " us,"
+		<< " warm " << warm_ns / 1000 << " us" << std::endl;
+}
+
+/*
+	Allocation heavy programs on the LLVM runtime's heap, and slab_alloc() against malloc() for the same block sizes.
+	Prints how many blocks each size class handed out.
+*/
+static void bench_slab_allocator(){
+	const std::vector<std::pair<std::string, std::string>> programs = {
+		{
+			"Structs",
+			R"(
+				struct pixel_t {
+					double red
+					double green
+					double blue
+				}
+
+				func pixel_t mix(pixel_t a, pixel_t b){
+					return pixel_t((a.red + b.red) / 2.0, (a.green + b.green) / 2.0, (a.blue + b.blue) / 2.0)
+				}
+
+				func double f(){
+					mutable p = pixel_t(1.0, 0.0, 0.5)
+					for(i in 0 ..< 1000000){
+						p = mix(p, pixel_t(0.0, 1.0, 0.25))
+					}
+					return p.red
+				}
+
+				let r = f()
+			)"
+		},
+		{
+			"Strings",
+			R"(
+				func int f(){
+					mutable count = 0
+					for(i in 0 ..< 300000){
+						let s = "pixel " + to_string(i) + " of " + to_string(300000)
+						count = count + size(s)
+					}
+					return count
+				}
+
+				let r = f()
+			)"
+		}
+	};
+
+	for(const auto& program: programs){
+		const auto stats_before = get_slab_stats();
+		const auto ns = measure_execution_time_ns(
+			[&] { run_using_llvm_helper(program.second, "", {}, llvm_optimization_level::k_O2); },
+			1
+		);
+		const auto stats_after = get_slab_stats();
+
+		std::cout << "Slab allocator, LLVM " << program.first << ": " << ns / 1000000 << " ms, blocks:";
+		for(int i = 0 ; i < stats_after.size() ; i++){
+			const auto count = stats_after[i].alloc_count - stats_before[i].alloc_count;
+			if(count > 0){
+				std::cout << " " << (stats_after[i].block_size > 0 ? std::to_string(stats_after[i].block_size) : std::string("malloc")) << ":" << count;
+			}
+		}
+		std::cout << std::endl;
+	}
+
+	//	Each thread keeps 1000 blocks alive and replaces them in a loop, sizes like STRUCT_T and short strings.
+	const auto churn = [](const std::function<void* (size_t)>& alloc_f, const std::function<void (void*, size_t)>& free_f){
+		std::vector<std::thread> threads;
+		for(int t = 0 ; t < 4 ; t++){
+			threads.push_back(std::thread([&](){
+				const size_t sizes[] = { 64 + 24, 64 + 8, 64 + 40, 64 };
+				std::vector<void*> live(1000, nullptr);
+				for(int i = 0 ; i < 2000000 ; i++){
+					const auto index = (size_t(i) * 7919) % live.size();
+					const auto size = sizes[index & 3];
+					if(live[index] != nullptr){
+						free_f(live[index], size);
+					}
+					live[index] = alloc_f(size);
+				}
+				for(int i = 0 ; i < live.size() ; i++){
+					free_f(live[i], sizes[i & 3]);
+				}
+			}));
+		}
+		for(auto& e: threads){
+			e.join();
+		}
+	};
+
+	const auto malloc_ns = measure_execution_time_ns(
+		[&] { churn([](size_t size){ return std::malloc(size); }, [](void* p, size_t size){ std::free(p); }); },
+		1
+	);
+	const auto slab_ns = measure_execution_time_ns(
+		[&] { churn([](size_t size){ return slab_alloc(size); }, [](void* p, size_t size){ slab_free(p, size); }); },
+		1
+	);
+	std::cout << "Slab allocator, 4 threads x 2M alloc/free: malloc() " << malloc_ns / 1000000 << " ms, slab_alloc() " << slab_ns / 1000000 << " ms" << std::endl;
+}
+
+/*
+	Builds a 1M element vector and a 1M character string with a = push_back(a, e). The variable is the only owner, so
+	each push_back() appends in place into amortized, doubling capacity. Compared with std::vector<int64_t>::push_back().
+*/
+static void bench_push_back(){
+	const std::vector<std::pair<std::string, std::string>> programs = {
+		{
+			"[int] 1M push_back()",
+			R"(
+				func int f(){
+					mutable [int] a = []
+					for(i in 0 ..< 1000000){
+						a = push_back(a, i)
+					}
+					return size(a)
+				}
+
+				let r = f()
+			)"
+		},
+		{
+			"string 1M push_back()",
+			R"(
+				func int f(){
+					mutable s = ""
+					for(i in 0 ..< 1000000){
+						s = push_back(s, 65 + i % 26)
+					}
+					return size(s)
+				}
+
+				let r = f()
+			)"
+		}
+	};
+
+	for(const auto& program: programs){
+		const auto ns = measure_execution_time_ns(
+			[&] { run_using_llvm_helper(program.second, "", {}, llvm_optimization_level::k_O2); },
+			1
+		);
+		std::cout << "LLVM " << program.first << ": " << ns / 1000000 << " ms" << std::endl;
+	}
+
+	const auto cpp_ns = measure_execution_time_ns(
+		[&] {
+			std::vector<int64_t> a;
+			for(int64_t i = 0 ; i < 1000000 ; i++){
+				a.push_back(i);
+			}
+			volatile size_t size = a.size();
+			(void)size;
+		},
+		1
+	);
+	std::cout << "C++ std::vector<int64_t> 1M push_back(): " << cpp_ns / 1000 << " us" << std::endl;
+}
+
+/*
+	update() 10K random elements of a 100K element [int] while the original is still in use, then reads all elements
+	100 times. Each backend once: carray copies the whole vector for each update(), hamt copies one path of the trie
+	but pays for it on each lookup.
+*/
+static void bench_vector_backends(){
+	const std::vector<std::pair<std::string, std::string>> programs = {
+		{
+			"10K update() of shared 100K [int]",
+			R"(
+				func int f(){
+					mutable [int] a = []
+					for(i in 0 ..< 100000){
+						a = push_back(a, i)
+					}
+					let [int] original = a
+					mutable [int] b = a
+					for(i in 0 ..< 10000){
+						b = update(b, (i * 7919) % 100000, i)
+					}
+					return b[5] + original[5]
+				}
+
+				let r = f()
+			)"
+		},
+		{
+			"10M lookups in 100K [int]",
+			R"(
+				func int f(){
+					mutable [int] a = []
+					for(i in 0 ..< 100000){
+						a = push_back(a, i)
+					}
+					mutable sum = 0
+					for(j in 0 ..< 100){
+						for(i in 0 ..< 100000){
+							sum = sum + a[i]
+						}
+					}
+					return sum
+				}
+
+				let r = f()
+			)"
+		}
+	};
+
+	for(const auto& program: programs){
+		for(const auto backend: { vector_backend::k_carray, vector_backend::k_hamt }){
+			const auto ns = measure_execution_time_ns(
+				[&] { run_using_llvm_helper(program.second, "", {}, llvm_optimization_level::k_O2, jit_cache_settings_t(), backend); },
+				1
+			);
+			std::cout << "LLVM " << vector_backend_to_string(backend) << " " << program.first << ": " << ns / 1000000 << " ms" << std::endl;
+		}
+	}
+}
+
+/*
+	Inserts 10K keys into a [string: int] with update(), then looks up 1M keys, 100 x 10K. update() copies the dict
+	each time. The C++ part times DICT_T directly against the std::map<std::string, runtime_value_t> it used to embed:
+	the std::map needs the key as a std::string for each lookup, DICT_T hashes the runtime string.
+*/
+static void bench_dict(){
+	const std::vector<std::pair<std::string, std::string>> programs = {
+		{
+			"10K update() of [string: int]",
+			R"(
+				func int f(){
+					mutable [string: int] d = {}
+					for(i in 0 ..< 10000){
+						d = update(d, to_string(i), i)
+					}
+					return size(d)
+				}
+
+				let r = f()
+			)"
+		},
+		{
+			"1M lookups in 10K [string: int]",
+			R"(
+				func int f(){
+					mutable [string: int] d = {}
+					mutable [string] keys = []
+					for(i in 0 ..< 10000){
+						d = update(d, to_string(i), i)
+						keys = push_back(keys, to_string(i))
+					}
+					mutable sum = 0
+					for(j in 0 ..< 100){
+						for(i in 0 ..< 10000){
+							sum = sum + d[keys[i]]
+						}
+					}
+					return sum
+				}
+
+				let r = f()
+			)"
+		}
+	};
+
+	for(const auto& program: programs){
+		const auto ns = measure_execution_time_ns(
+			[&] { run_using_llvm_helper(program.second, "", {}, llvm_optimization_level::k_O2); },
+			1
+		);
+		std::cout << "LLVM " << program.first << ": " << ns / 1000000 << " ms" << std::endl;
+	}
+
+	const int count = 100000;
+	heap_t heap;
+	std::vector<runtime_value_t> keys;
+	for(int i = 0 ; i < count ; i++){
+		const auto s = "key" + std::to_string(i);
+		auto v = alloc_vec(heap, size_to_allocation_blocks(s.size()), s.size());
+		std::memcpy(v->get_element_ptr(), s.data(), s.size());
+		keys.push_back(runtime_value_t{ .vector_ptr = v });
+	}
+	const auto to_std_string = [](runtime_value_t key){
+		const auto p = get_vec_chars(key);
+		return std::string(p, p + get_vec_string_size(key));
+	};
+
+	std::map<std::string, runtime_value_t> m;
+	const auto map_insert_ns = measure_execution_time_ns(
+		[&] {
+			for(int i = 0 ; i < count ; i++){
+				m.insert_or_assign(to_std_string(keys[i]), make_runtime_int(i));
+			}
+		},
+		1
+	);
+	auto dict = alloc_dict(heap);
+	const auto dict_insert_ns = measure_execution_time_ns(
+		[&] {
+			for(int i = 0 ; i < count ; i++){
+				store_dict_value(*dict, keys[i], make_runtime_int(i));
+			}
+		},
+		1
+	);
+
+	volatile int64_t sum = 0;
+	const auto map_lookup_ns = measure_execution_time_ns(
+		[&] {
+			for(int j = 0 ; j < 10 ; j++){
+				for(int i = 0 ; i < count ; i++){
+					sum = sum + m.find(to_std_string(keys[i]))->second.int_value;
+				}
+			}
+		},
+		1
+	);
+	const auto dict_lookup_ns = measure_execution_time_ns(
+		[&] {
+			for(int j = 0 ; j < 10 ; j++){
+				for(int i = 0 ; i < count ; i++){
+					sum = sum + find_dict_entry(*dict, keys[i])->value.int_value;
+				}
+			}
+		},
+		1
+	);
+	std::cout << "C++ std::map<std::string> 100K inserts: " << map_insert_ns / 1000 << " us, DICT_T: " << dict_insert_ns / 1000 << " us" << std::endl;
+	std::cout << "C++ std::map<std::string> 1M lookups: " << map_lookup_ns / 1000 << " us, DICT_T: " << dict_lookup_ns / 1000 << " us" << std::endl;
+
+	dec_rc(dict->alloc);
+	dispose_dict(*dict);
+	for(const auto& key: keys){
+		release_ref(key.vector_ptr->alloc);
+	}
+}
+
 void floyd_benchmark(){
 //OFF_QUARK_UNIT_TEST_VIP("Basic performance", "", "", ""){
 //	interpreter_context_t context = make_benchmark_context();
@@ -261,6 +1752,102 @@ void floyd_benchmark(){
 
 	}
 
+	//	Same sum, once with a reducer the compiler turns into a kernel, once with a reducer it calls per element.
+	if(1){
+		const auto cpp_func = [] {
+			std::vector<int64_t> a;
+			for(int64_t i = 0 ; i < 1000000 ; i++){
+				a.push_back(i);
+			}
+			volatile int64_t sum = 0;
+			for(int i = 0 ; i < 10 ; i++){
+				int64_t acc = 0;
+				for(const auto e: a){
+					acc = acc + e;
+				}
+				sum = sum + acc;
+			}
+		};
+
+		const std::string floyd_kernel_str = R"(
+			func [int] make_data(){
+				mutable [int] a = []
+				for(i in 0 ..< 1000000){
+					a = push_back(a, i)
+				}
+				return a
+			}
+			func int add(int acc, int e){
+				return acc + e
+			}
+
+			let data = make_data()
+			func void f(){
+				for(i in 0 ..< 10){
+					let sum = reduce(data, 0, add)
+				}
+			}
+		)";
+
+		const std::string floyd_call_str = R"(
+			func [int] make_data(){
+				mutable [int] a = []
+				for(i in 0 ..< 1000000){
+					a = push_back(a, i)
+				}
+				return a
+			}
+			func int add(int acc, int e){
+				let sum = acc + e
+				return sum
+			}
+
+			let data = make_data()
+			func void f(){
+				for(i in 0 ..< 10){
+					let sum = reduce(data, 0, add)
+				}
+			}
+		)";
+
+		trace_result(bench_result_t{ "reduce() sum, kernel",
+			measure_execution_time_ns(cpp_func, k_repeats),
+			measure_floyd_function_f(floyd_kernel_str, k_repeats)
+		});
+		trace_result(bench_result_t{ "reduce() sum, call per element",
+			measure_execution_time_ns(cpp_func, k_repeats),
+			measure_floyd_function_f(floyd_call_str, k_repeats)
+		});
+	}
+
+	if(1){
+		bench_processes();
+	}
+
+	if(1){
+		bench_llvm_optimization_levels();
+	}
+
+	if(1){
+		bench_jit_cache();
+	}
+
+	if(1){
+		bench_slab_allocator();
+	}
+
+	if(1){
+		bench_push_back();
+	}
+
+	if(1){
+		bench_vector_backends();
+	}
+
+	if(1){
+		bench_dict();
+	}
+
 }
 
 
@@ -15,24 +15,46 @@ namespace floyd {
 
 
 
-std::unique_ptr<llvm_ir_program_t> compile_to_ir_helper(llvm_instance_t& instance, const compilation_unit_t& cu){
+std::unique_ptr<llvm_ir_program_t> compile_to_ir_helper(llvm_instance_t& instance, const compilation_unit_t& cu, vector_backend vectors){
 	QUARK_ASSERT(instance.check_invariant());
 
 	const auto pass3 = compile_to_sematic_ast__errors(cu);
-	auto bc = generate_llvm_ir_program(instance, pass3, cu.source_file_path);
+	auto bc = generate_llvm_ir_program(instance, pass3, cu.source_file_path, vectors);
 	return bc;
 }
 
 
-int64_t run_using_llvm_helper(const std::string& program_source, const std::string& file, const std::vector<std::string>& main_args){
+static std::unique_ptr<llvm_ir_program_t> compile_source_to_ir(llvm_instance_t& instance, const std::string& program_source, const std::string& file, vector_backend vectors){
 	const auto cu = floyd::make_compilation_unit_nolib(program_source, file);
 	const auto pass3 = compile_to_sematic_ast__errors(cu);
+	return generate_llvm_ir_program(instance, pass3, file, vectors);
+}
 
+int64_t run_using_llvm_helper(const std::string& program_source, const std::string& file, const std::vector<std::string>& main_args, llvm_optimization_level optimization_level, const jit_cache_settings_t& cache, vector_backend vectors){
 	llvm_instance_t instance;
-	auto program = generate_llvm_ir_program(instance, pass3, file);
-	const auto result = run_llvm_program(instance, *program, main_args);
-	QUARK_TRACE_SS("Fib = " << result);
-	return result;
+
+	if(cache.cache_dir.empty()){
+		auto program = compile_source_to_ir(instance, program_source, file, vectors);
+		program->optimization_level = optimization_level;
+		const auto result = run_llvm_program(instance, *program, main_args);
+		QUARK_TRACE_SS("Fib = " << result);
+		return result;
+	}
+	else{
+		const auto key = make_jit_cache_key(program_source, cache.compiler_version, optimization_level, vectors);
+		jit_object_cache_t object_cache(get_cached_object_path(cache.cache_dir, key));
+
+		auto program = load_cached_program(instance, cache.cache_dir, key);
+		if(program == nullptr){
+			program = compile_source_to_ir(instance, program_source, file, vectors);
+			save_cached_program(*program, cache.cache_dir, key);
+		}
+		program->optimization_level = optimization_level;
+		program->object_cache = &object_cache;
+		const auto result = run_llvm_program(instance, *program, main_args);
+		QUARK_TRACE_SS("Fib = " << result);
+		return result;
+	}
 }
 
 }	//	floyd
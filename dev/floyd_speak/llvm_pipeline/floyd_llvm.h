@@ -10,16 +10,17 @@
 #define floyd_llvm_hpp
 
 #include "floyd_llvm_codegen.h"
-#include "floyd_llvm_runtime.h"
+#include "floyd_llvm_jit.h"
+#include "floyd_llvm_jit_cache.h"
 
 
 namespace floyd {
 
 //	Helper that goes directly from source to LLVM IR code.
-std::unique_ptr<llvm_ir_program_t> compile_to_ir_helper(llvm_instance_t& instance, const compilation_unit_t& cu);
+std::unique_ptr<llvm_ir_program_t> compile_to_ir_helper(llvm_instance_t& instance, const compilation_unit_t& cu, vector_backend vectors = vector_backend::k_carray);
 
-//	Compiles and runs the program.
-int64_t run_using_llvm_helper(const std::string& program_source, const std::string& file, const std::vector<std::string>& main_args);
+//	Compiles and runs the program. With a cache_dir it reuses the machine code from an earlier run of the same source.
+int64_t run_using_llvm_helper(const std::string& program_source, const std::string& file, const std::vector<std::string>& main_args, llvm_optimization_level optimization_level = llvm_optimization_level::k_O0, const jit_cache_settings_t& cache = jit_cache_settings_t(), vector_backend vectors = vector_backend::k_carray);
 
 
 }	//	floyd
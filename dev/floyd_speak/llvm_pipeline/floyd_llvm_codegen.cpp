@@ -11,7 +11,7 @@ const bool k_trace_types = false;
 
 #include "floyd_llvm_codegen.h"
 
-#include "floyd_llvm_runtime.h"
+#include "floyd_llvm_jit.h"
 #include "floyd_llvm_helpers.h"
 
 #include "ast_value.h"
@@ -45,6 +45,11 @@ const bool k_trace_types = false;
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/IR/DataLayout.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/IR/Operator.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/Transforms/Utils/BasicBlockUtils.h>
+#include <llvm/Transforms/Utils/Local.h>
 
 #include "llvm/Bitcode/BitstreamWriter.h"
 
@@ -99,11 +104,11 @@ struct llvm_code_generator_t;
 
 
 struct llvm_code_generator_t {
-	public: llvm_code_generator_t(llvm_instance_t& instance, llvm::Module* module, const type_interner_t& interner) :
+	public: llvm_code_generator_t(llvm_instance_t& instance, llvm::Module* module, const type_interner_t& interner, vector_backend vectors) :
 		instance(&instance),
 		module(module),
 		builder(instance.context),
-		interner(instance.context, interner)
+		interner(instance.context, interner, vectors)
 	{
 		QUARK_ASSERT(instance.check_invariant());
 
@@ -285,6 +290,68 @@ llvm::Constant* generate_itype_constant(const llvm_code_generator_t& gen_acc, co
  	return llvm::ConstantInt::get(t, itype);
 }
 
+////////////////////////////////		RC
+
+
+
+/*
+	Retain and release change the RC in the value's heap_alloc_64_t directly, with an atomic add / sub. Only when a
+	release makes the RC 0 do we call the runtime (fr_dispose_vec() etc) to release the members and free the value.
+
+	The atomic instructions are tagged with k_retain_md / k_release_md so cancel_retain_release_pairs() can find them.
+*/
+
+static const char k_retain_md[] = "floyd.retain";
+static const char k_release_md[] = "floyd.release";
+
+static llvm::Value* generate_rc_ptr(llvm::IRBuilder<>& builder, llvm::Value& value_reg){
+	auto byte_ptr_reg = builder.CreateCast(llvm::Instruction::CastOps::BitCast, &value_reg, builder.getInt8PtrTy(), "");
+	auto rc_byte_ptr_reg = builder.CreateGEP(builder.getInt8Ty(), byte_ptr_reg, builder.getInt64(k_heap_alloc_64_rc_offset), "");
+	return builder.CreateCast(llvm::Instruction::CastOps::BitCast, rc_byte_ptr_reg, builder.getInt32Ty()->getPointerTo(), "rc_ptr");
+}
+
+static void generate_inc_rc(llvm::IRBuilder<>& builder, llvm::Value& value_reg){
+	auto& context = builder.getContext();
+
+	auto rc_ptr_reg = generate_rc_ptr(builder, value_reg);
+	auto op = builder.CreateAtomicRMW(llvm::AtomicRMWInst::Add, rc_ptr_reg, builder.getInt32(1), llvm::AtomicOrdering::Monotonic);
+	op->setMetadata(k_retain_md, llvm::MDNode::get(context, {}));
+}
+
+//	Calls dispose_f if this was the last reference. Continues emitting in a new BB.
+static void generate_dec_rc(llvm::IRBuilder<>& builder, llvm::Value& value_reg, llvm::Function* dispose_f, const std::vector<llvm::Value*>& dispose_args){
+	auto& context = builder.getContext();
+	auto parent_function = builder.GetInsertBlock()->getParent();
+
+	auto rc_ptr_reg = generate_rc_ptr(builder, value_reg);
+	auto prev_rc_reg = builder.CreateAtomicRMW(llvm::AtomicRMWInst::Sub, rc_ptr_reg, builder.getInt32(1), llvm::AtomicOrdering::AcquireRelease);
+	prev_rc_reg->setMetadata(k_release_md, llvm::MDNode::get(context, {}));
+	auto last_reg = builder.CreateICmpEQ(prev_rc_reg, builder.getInt32(1), "last_ref");
+
+	auto dispose_bb = llvm::BasicBlock::Create(context, "rc-dispose", parent_function);
+	auto join_bb = llvm::BasicBlock::Create(context, "rc-join", parent_function);
+	builder.CreateCondBr(last_reg, dispose_bb, join_bb, llvm::MDBuilder(context).createBranchWeights(1, 1000));
+
+	builder.SetInsertPoint(dispose_bb);
+	builder.CreateCall(dispose_f, dispose_args, "");
+	builder.CreateBr(join_bb);
+
+	builder.SetInsertPoint(join_bb);
+}
+
+//	JSON values can be nullptr, see fr_dispose_json(). Returns the BB to continue in after the RC code.
+static llvm::BasicBlock* generate_skip_nullptr(llvm::IRBuilder<>& builder, llvm::Value& value_reg){
+	auto& context = builder.getContext();
+	auto parent_function = builder.GetInsertBlock()->getParent();
+
+	auto rc_bb = llvm::BasicBlock::Create(context, "rc-nonnull", parent_function);
+	auto skip_bb = llvm::BasicBlock::Create(context, "rc-skip", parent_function);
+	auto null_reg = builder.CreateIsNull(&value_reg, "");
+	builder.CreateCondBr(null_reg, skip_bb, rc_bb);
+	builder.SetInsertPoint(rc_bb);
+	return skip_bb;
+}
+
 void generate_retain(llvm_code_generator_t& gen_acc, llvm::Function& emit_f, llvm::Value& value_reg, const typeid_t& type){
 	QUARK_ASSERT(gen_acc.check_invariant());
 	QUARK_ASSERT(check_emitting_function(gen_acc.interner, emit_f));
@@ -292,43 +359,14 @@ void generate_retain(llvm_code_generator_t& gen_acc, llvm::Function& emit_f, llv
 
 	auto& builder = gen_acc.builder;
 	if(is_rc_value(type)){
-		if(type.is_string() || type.is_vector()){
-			const auto f = find_function_def(gen_acc, "fr_retain_vec");
-			std::vector<llvm::Value*> args = {
-				get_callers_fcp(gen_acc.interner, emit_f),
-				&value_reg,
-				generate_itype_constant(gen_acc, type)
-			};
-			builder.CreateCall(f.llvm_f, args, "");
-		}
-		else if(type.is_dict()){
-			const auto f = find_function_def(gen_acc, "fr_retain_dict");
-			std::vector<llvm::Value*> args = {
-				get_callers_fcp(gen_acc.interner, emit_f),
-				&value_reg,
-				generate_itype_constant(gen_acc, type)
-			};
-			builder.CreateCall(f.llvm_f, args, "");
+		if(type.is_json_value()){
+			auto skip_bb = generate_skip_nullptr(builder, value_reg);
+			generate_inc_rc(builder, value_reg);
+			builder.CreateBr(skip_bb);
+			builder.SetInsertPoint(skip_bb);
 		}
-		else if(type.is_json_value()){
-			const auto f = find_function_def(gen_acc, "fr_retain_json");
-			std::vector<llvm::Value*> args = {
-				get_callers_fcp(gen_acc.interner, emit_f),
-				&value_reg,
-				generate_itype_constant(gen_acc, type)
-			};
-			builder.CreateCall(f.llvm_f, args, "");
-		}
-		else if(type.is_struct()){
-			const auto f = find_function_def(gen_acc, "fr_retain_struct");
-
-			auto generic_vec_reg = builder.CreateCast(llvm::Instruction::CastOps::BitCast, &value_reg, get_generic_struct_type(gen_acc.interner)->getPointerTo(), "");
-			std::vector<llvm::Value*> args = {
-				get_callers_fcp(gen_acc.interner, emit_f),
-				generic_vec_reg,
-				generate_itype_constant(gen_acc, type)
-			};
-			builder.CreateCall(f.llvm_f, args, "");
+		else if(type.is_string() || type.is_vector() || type.is_dict() || type.is_struct()){
+			generate_inc_rc(builder, value_reg);
 		}
 		else{
 			QUARK_ASSERT(false);
@@ -345,41 +383,44 @@ void generate_release(llvm_code_generator_t& gen_acc, llvm::Function& emit_f, ll
 	auto& builder = gen_acc.builder;
 	if(is_rc_value(type)){
 		if(type.is_string() || type.is_vector()){
-			const auto f = find_function_def(gen_acc, "fr_release_vec");
+			const auto f = find_function_def(gen_acc, "fr_dispose_vec");
 			std::vector<llvm::Value*> args = {
 				get_callers_fcp(gen_acc.interner, emit_f),
 				&value_reg,
 				generate_itype_constant(gen_acc, type)
 			};
-			builder.CreateCall(f.llvm_f, args);
+			generate_dec_rc(builder, value_reg, f.llvm_f, args);
 		}
 		else if(type.is_dict()){
-			const auto f = find_function_def(gen_acc, "fr_release_dict");
+			const auto f = find_function_def(gen_acc, "fr_dispose_dict");
 			std::vector<llvm::Value*> args = {
 				get_callers_fcp(gen_acc.interner, emit_f),
 				&value_reg,
 				generate_itype_constant(gen_acc, type)
 			};
-			builder.CreateCall(f.llvm_f, args);
+			generate_dec_rc(builder, value_reg, f.llvm_f, args);
 		}
 		else if(type.is_json_value()){
-			const auto f = find_function_def(gen_acc, "fr_release_json");
+			const auto f = find_function_def(gen_acc, "fr_dispose_json");
 			std::vector<llvm::Value*> args = {
 				get_callers_fcp(gen_acc.interner, emit_f),
 				&value_reg,
 				generate_itype_constant(gen_acc, type)
 			};
-			builder.CreateCall(f.llvm_f, args);
+			auto skip_bb = generate_skip_nullptr(builder, value_reg);
+			generate_dec_rc(builder, value_reg, f.llvm_f, args);
+			builder.CreateBr(skip_bb);
+			builder.SetInsertPoint(skip_bb);
 		}
 		else if(type.is_struct()){
-			const auto f = find_function_def(gen_acc, "fr_release_struct");
+			const auto f = find_function_def(gen_acc, "fr_dispose_struct");
 			auto generic_vec_reg = builder.CreateCast(llvm::Instruction::CastOps::BitCast, &value_reg, get_generic_struct_type(gen_acc.interner)->getPointerTo(), "");
 			std::vector<llvm::Value*> args = {
 				get_callers_fcp(gen_acc.interner, emit_f),
 				generic_vec_reg,
 				generate_itype_constant(gen_acc, type)
 			};
-			builder.CreateCall(f.llvm_f, args);
+			generate_dec_rc(builder, value_reg, f.llvm_f, args);
 		}
 		else{
 			QUARK_ASSERT(false);
@@ -389,6 +430,76 @@ void generate_release(llvm_code_generator_t& gen_acc, llvm::Function& emit_f, ll
 	}
 }
 
+//	The value whose RC this retain / release changes, or nullptr if it isn't one of ours.
+static const llvm::Value* get_rc_owner(const llvm::Instruction& i, const char md_kind[]){
+	const auto op = llvm::dyn_cast<llvm::AtomicRMWInst>(&i);
+	if(op == nullptr || op->getMetadata(md_kind) == nullptr){
+		return nullptr;
+	}
+	const auto gep = llvm::dyn_cast<llvm::GEPOperator>(op->getPointerOperand()->stripPointerCasts());
+	if(gep == nullptr){
+		return nullptr;
+	}
+	return gep->getPointerOperand()->stripPointerCasts();
+}
+
+//	Finds the first retain in bb that has a release of the same value later in bb, with nothing in between that could
+//	release the value some other way. Removes both and the dispose-BB of the release. Returns false if there is none.
+static bool cancel_retain_release_pair(llvm::BasicBlock& bb){
+	for(auto& retain: bb){
+		const auto owner = get_rc_owner(retain, k_retain_md);
+		if(owner != nullptr){
+			for(auto it = std::next(retain.getIterator()) ; it != bb.end() ; it++){
+				auto& i = *it;
+				if(get_rc_owner(i, k_release_md) == owner){
+					auto release = llvm::cast<llvm::AtomicRMWInst>(&i);
+					if(release->hasOneUse() == false){
+						return false;
+					}
+					auto last_reg = llvm::dyn_cast<llvm::ICmpInst>(*release->user_begin());
+					auto branch = llvm::dyn_cast<llvm::BranchInst>(bb.getTerminator());
+					if(last_reg == nullptr || branch == nullptr || branch->isConditional() == false || branch->getCondition() != last_reg){
+						break;
+					}
+					auto dispose_bb = branch->getSuccessor(0);
+					auto join_bb = branch->getSuccessor(1);
+
+					//	The retain keeps the RC at 2 or more, so the release never disposes.
+					branch->setCondition(llvm::ConstantInt::getFalse(bb.getContext()));
+					last_reg->eraseFromParent();
+					release->eraseFromParent();
+					retain.eraseFromParent();
+
+					llvm::ConstantFoldTerminator(&bb);
+					if(llvm::pred_empty(dispose_bb)){
+						llvm::DeleteDeadBlock(dispose_bb);
+					}
+					llvm::MergeBlockIntoPredecessor(join_bb);
+					return true;
+				}
+				else if(get_rc_owner(i, k_retain_md) != nullptr){
+					//	Retaining another value can't free ours.
+				}
+				else if(i.isTerminator() || i.isAtomic() || llvm::isa<llvm::CallInst>(i) || llvm::isa<llvm::InvokeInst>(i)){
+					break;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+int cancel_retain_release_pairs(llvm::Function& f){
+	int count = 0;
+	for(auto& bb: f){
+		//	Removing a pair merges the next BB into this one, which can give us a new pair.
+		while(cancel_retain_release_pair(bb)){
+			count++;
+		}
+	}
+	return count;
+}
+
 
 std::string compose_function_def_name(function_id_t function_id, const function_definition_t& def){
 	const auto def_name = def._definition_name;
@@ -783,6 +894,24 @@ static llvm::Value* generate_lookup_element_expression(llvm_code_generator_t& ge
 		generate_release(gen_acc, emit_f, *key_reg, key_type);
 		return result;
 	}
+	else if(is_vector_hamt(gen_acc.interner, parent_type)){
+		QUARK_ASSERT(key_type.is_int());
+
+		const auto element_type0 = parent_type.get_vector_element_type();
+		const auto f = find_function_def(gen_acc, "fr_lookup_vec_hamt");
+		std::vector<llvm::Value*> args = {
+			get_callers_fcp(gen_acc.interner, emit_f),
+			parent_reg,
+			key_reg
+		};
+		auto element_value_uint64_reg = builder.CreateCall(f.llvm_f, args, "");
+		auto result_reg = generate_cast_from_runtime_value(gen_acc, *element_value_uint64_reg, element_type0);
+
+		generate_retain(gen_acc, emit_f, *result_reg, element_type0);
+		generate_release(gen_acc, emit_f, *parent_reg, parent_type);
+
+		return result_reg;
+	}
 	else if(parent_type.is_vector()){
 		QUARK_ASSERT(key_type.is_int());
 
@@ -1249,6 +1378,39 @@ static llvm::Value* generate_fallthrough_corecall(llvm_code_generator_t& gen_acc
 }
 
 
+//	Calls fr_push_back_owned(), which takes over our reference to the vector and can append in place.
+//	If vec_ptr_reg isn't nullptr, the vector is moved out of that variable instead of evaluating args[0]. The caller
+//	must store the result back into the variable.
+static llvm::Value* generate_push_back_owned(llvm_code_generator_t& gen_acc, llvm::Function& emit_f, const expression_t::corecall_t& details, llvm::Value* vec_ptr_reg){
+	QUARK_ASSERT(gen_acc.check_invariant());
+	QUARK_ASSERT(check_emitting_function(gen_acc.interner, emit_f));
+	QUARK_ASSERT(details.args.size() == 2);
+
+	auto& builder = gen_acc.builder;
+
+	const auto vec_type = details.args[0].get_output_type();
+	const auto element_type = details.args[1].get_output_type();
+
+	llvm::Value* vec_reg = vec_ptr_reg == nullptr ? generate_expression(gen_acc, emit_f, details.args[0]) : nullptr;
+
+	//	The element expression may read the variable, so only move the vector out of it after.
+	auto element_reg = generate_expression(gen_acc, emit_f, details.args[1]);
+	if(vec_ptr_reg != nullptr){
+		vec_reg = builder.CreateLoad(vec_ptr_reg, "");
+	}
+
+	const auto f = find_function_def(gen_acc, "fr_push_back_owned");
+	std::vector<llvm::Value*> args = {
+		get_callers_fcp(gen_acc.interner, emit_f),
+		vec_reg,
+		generate_cast_to_runtime_value(gen_acc, *element_reg, element_type),
+		generate_itype_constant(gen_acc, vec_type)
+	};
+	auto result = builder.CreateCall(f.llvm_f, args, "");
+	generate_release(gen_acc, emit_f, *element_reg, element_type);
+	return result;
+}
+
 static llvm::Value* generate_corecall_expression(llvm_code_generator_t& gen_acc, llvm::Function& emit_f, const expression_t& e, const expression_t::corecall_t& details){
 	QUARK_ASSERT(gen_acc.check_invariant());
 	QUARK_ASSERT(check_emitting_function(gen_acc.interner, emit_f));
@@ -1284,7 +1446,7 @@ static llvm::Value* generate_corecall_expression(llvm_code_generator_t& gen_acc,
 		return generate_fallthrough_corecall(gen_acc, emit_f, e, details);
 	}
 	else if(details.call_name == get_opcode(make_push_back_signature())){
-		return generate_fallthrough_corecall(gen_acc, emit_f, e, details);
+		return generate_push_back_owned(gen_acc, emit_f, details, nullptr);
 	}
 	else if(details.call_name == get_opcode(make_subset_signature())){
 		return generate_fallthrough_corecall(gen_acc, emit_f, e, details);
@@ -1325,6 +1487,9 @@ static llvm::Value* generate_corecall_expression(llvm_code_generator_t& gen_acc,
 	else if(details.call_name == get_opcode(make_supermap_signature())){
 		return generate_fallthrough_corecall(gen_acc, emit_f, e, details);
 	}
+	else if(details.call_name == get_opcode(make_sort_signature())){
+		return generate_fallthrough_corecall(gen_acc, emit_f, e, details);
+	}
 
 	else if(details.call_name == get_opcode(make_print_signature())){
 		return generate_fallthrough_corecall(gen_acc, emit_f, e, details);
@@ -1332,6 +1497,18 @@ static llvm::Value* generate_corecall_expression(llvm_code_generator_t& gen_acc,
 	else if(details.call_name == get_opcode(make_send_signature())){
 		return generate_fallthrough_corecall(gen_acc, emit_f, e, details);
 	}
+	else if(details.call_name == get_opcode(make_get_process_handle_signature())){
+		return generate_fallthrough_corecall(gen_acc, emit_f, e, details);
+	}
+	else if(details.call_name == get_opcode(make_send_to_handle_signature())){
+		return generate_fallthrough_corecall(gen_acc, emit_f, e, details);
+	}
+	else if(details.call_name == get_opcode(make_post_at_time_signature())){
+		return generate_fallthrough_corecall(gen_acc, emit_f, e, details);
+	}
+	else if(details.call_name == get_opcode(make_post_after_signature())){
+		return generate_fallthrough_corecall(gen_acc, emit_f, e, details);
+	}
 
 	else{
 		QUARK_ASSERT(false);
@@ -1391,10 +1568,22 @@ static llvm::Value* generate_construct_vector(llvm_code_generator_t& gen_acc, ll
 			generate_array_element_store(builder, *array_ptr_reg, element_index, *element_value_reg);
 			element_index++;
 		}
-		return vec_ptr_reg;
 	}
 	else{
 		generate_fill_array(gen_acc, emit_f, *ptr_reg, element_type1, details.elements);
+	}
+
+	//	Fill a carray like above, then let the runtime build the trie from it.
+	if(is_vector_hamt(gen_acc.interner, details.value_type)){
+		const auto f2 = find_function_def(gen_acc, "fr_vec_to_hamt");
+		std::vector<llvm::Value*> args = {
+			get_callers_fcp(gen_acc.interner, emit_f),
+			vec_ptr_reg,
+			generate_itype_constant(gen_acc, details.value_type)
+		};
+		return builder.CreateCall(f2.llvm_f, args, "");
+	}
+	else{
 		return vec_ptr_reg;
 	}
 }
@@ -1662,10 +1851,30 @@ static llvm::Value* generate_expression(llvm_code_generator_t& gen_acc, llvm::Fu
 
 
 
+//	Is the statement "a = push_back(a, e)"?
+static bool is_push_back_to_self(const statement_t::assign2_t& s){
+	const auto corecall = std::get_if<expression_t::corecall_t>(&s._expression._expression_variant);
+	if(corecall == nullptr || corecall->call_name != get_opcode(make_push_back_signature())){
+		return false;
+	}
+	const auto load = std::get_if<expression_t::load2_t>(&corecall->args[0]._expression_variant);
+	return load != nullptr && load->address == s._dest_variable;
+}
+
 static void generate_assign2_statement(llvm_code_generator_t& gen_acc, llvm::Function& emit_f, const statement_t::assign2_t& s){
 	QUARK_ASSERT(gen_acc.check_invariant());
 	QUARK_ASSERT(check_emitting_function(gen_acc.interner, emit_f));
 
+	//	Move the vector out of the variable and into push_back(), so the variable's reference is the only one and
+	//	push_back() can append in place.
+	if(is_push_back_to_self(s)){
+		auto dest = find_symbol(gen_acc, s._dest_variable);
+		const auto& corecall = std::get<expression_t::corecall_t>(s._expression._expression_variant);
+		auto value = generate_push_back_owned(gen_acc, emit_f, corecall, dest.value_ptr);
+		gen_acc.builder.CreateStore(value, dest.value_ptr);
+		return;
+	}
+
 	llvm::Value* value = generate_expression(gen_acc, emit_f, s._expression);
 
 	auto dest = find_symbol(gen_acc, s._dest_variable);
@@ -2406,14 +2615,14 @@ static void generate_floyd_runtime_deinit(llvm_code_generator_t& gen_acc, const
 
 
 
-static std::pair<std::unique_ptr<llvm::Module>, std::vector<function_def_t>> generate_module(llvm_instance_t& instance, const std::string& module_name, const semantic_ast_t& semantic_ast){
+static std::pair<std::unique_ptr<llvm::Module>, std::vector<function_def_t>> generate_module(llvm_instance_t& instance, const std::string& module_name, const semantic_ast_t& semantic_ast, vector_backend vectors){
 	QUARK_ASSERT(instance.check_invariant());
 	QUARK_ASSERT(semantic_ast.check_invariant());
 
 	//	Module must sit in a unique_ptr<> because llvm::EngineBuilder needs that.
 	auto module = std::make_unique<llvm::Module>(module_name.c_str(), instance.context);
 
-	llvm_code_generator_t gen_acc(instance, module.get(), semantic_ast._tree._interned_types);
+	llvm_code_generator_t gen_acc(instance, module.get(), semantic_ast._tree._interned_types, vectors);
 
 	//	Generate all LLVM nodes: functions and globals.
 	//	This lets all other code reference them, even if they're not filled up with code yet.
@@ -2456,7 +2665,85 @@ static std::pair<std::unique_ptr<llvm::Module>, std::vector<function_def_t>> gen
 
 
 
-std::unique_ptr<llvm_ir_program_t> generate_llvm_ir_program(llvm_instance_t& instance, const semantic_ast_t& ast0, const std::string& module_name){
+llvm_optimization_level parse_llvm_optimization_level(const std::string& s){
+	if(s == "0"){
+		return llvm_optimization_level::k_O0;
+	}
+	else if(s == "1"){
+		return llvm_optimization_level::k_O1;
+	}
+	else if(s == "2"){
+		return llvm_optimization_level::k_O2;
+	}
+	else if(s == "3"){
+		return llvm_optimization_level::k_O3;
+	}
+	else{
+		quark::throw_runtime_error("Unknown optimization level \"" + s + "\", use 0, 1, 2 or 3.");
+	}
+}
+
+QUARK_UNIT_TEST("", "parse_llvm_optimization_level()", "", ""){
+	QUARK_UT_VERIFY(parse_llvm_optimization_level("0") == llvm_optimization_level::k_O0);
+	QUARK_UT_VERIFY(parse_llvm_optimization_level("3") == llvm_optimization_level::k_O3);
+}
+
+QUARK_UNIT_TEST("", "parse_llvm_optimization_level()", "unknown level throws", ""){
+	try {
+		parse_llvm_optimization_level("fast");
+		QUARK_UT_VERIFY(false);
+	}
+	catch(const std::runtime_error& e){
+	}
+}
+
+//	Makes void f(i8* p) that retains p, calls between_f() if it isn't nullptr, then releases p.
+static llvm::Function* make_retain_release_test_function(llvm::Module& module, bool call_between){
+	auto& context = module.getContext();
+	llvm::IRBuilder<> builder(context);
+
+	auto ptr_type = builder.getInt8PtrTy();
+	auto void_f_type = llvm::FunctionType::get(builder.getVoidTy(), { ptr_type }, false);
+	auto dispose_f = llvm::Function::Create(void_f_type, llvm::Function::ExternalLinkage, "dispose", &module);
+	auto between_f = llvm::Function::Create(void_f_type, llvm::Function::ExternalLinkage, "between", &module);
+
+	auto f = llvm::Function::Create(void_f_type, llvm::Function::ExternalLinkage, "f", &module);
+	llvm::Value* p = &*f->arg_begin();
+	builder.SetInsertPoint(llvm::BasicBlock::Create(context, "entry", f));
+	generate_inc_rc(builder, *p);
+	if(call_between){
+		builder.CreateCall(between_f, { p });
+	}
+	generate_dec_rc(builder, *p, dispose_f, { p });
+	builder.CreateRetVoid();
+	return f;
+}
+
+QUARK_UNIT_TEST("", "cancel_retain_release_pairs()", "retain then release", "both removed"){
+	llvm_instance_t instance;
+	llvm::Module module("test", instance.context);
+	auto f = make_retain_release_test_function(module, false);
+	QUARK_UT_VERIFY(f->size() == 3);
+
+	QUARK_UT_VERIFY(cancel_retain_release_pairs(*f) == 1);
+	QUARK_UT_VERIFY(f->size() == 1);
+	for(const auto& i: f->front()){
+		QUARK_UT_VERIFY(i.isAtomic() == false);
+	}
+	QUARK_UT_VERIFY(llvm::verifyFunction(*f, &llvm::errs()) == false);
+}
+
+QUARK_UNIT_TEST("", "cancel_retain_release_pairs()", "call between retain and release", "both kept"){
+	llvm_instance_t instance;
+	llvm::Module module("test", instance.context);
+	auto f = make_retain_release_test_function(module, true);
+
+	QUARK_UT_VERIFY(cancel_retain_release_pairs(*f) == 0);
+	QUARK_UT_VERIFY(f->size() == 3);
+}
+
+
+std::unique_ptr<llvm_ir_program_t> generate_llvm_ir_program(llvm_instance_t& instance, const semantic_ast_t& ast0, const std::string& module_name, vector_backend vectors){
 	QUARK_ASSERT(instance.check_invariant());
 	QUARK_ASSERT(ast0.check_invariant());
 //	QUARK_ASSERT(module_name.empty() == false);
@@ -2487,11 +2774,15 @@ std::unique_ptr<llvm_ir_program_t> generate_llvm_ir_program(llvm_instance_t& ins
 
 	auto ast = ast0;
 
-	auto result0 = generate_module(instance, module_name, ast);
+	auto result0 = generate_module(instance, module_name, ast, vectors);
 	auto module = std::move(result0.first);
 	auto funcs = result0.second;
 
-	const auto interner = llvm_type_interner_t(instance.context, ast0._tree._interned_types);
+	const auto interner = llvm_type_interner_t(instance.context, ast0._tree._interned_types, vectors);
+
+	for(auto& f: *module){
+		cancel_retain_release_pairs(f);
+	}
 
 	auto result = std::make_unique<llvm_ir_program_t>(&instance, module, interner, ast._tree._globals._symbol_table, funcs);
 
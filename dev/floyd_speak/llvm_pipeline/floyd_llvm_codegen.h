@@ -29,11 +29,31 @@ namespace floyd {
 }
 namespace llvm {
 	struct Module;
+	class ObjectCache;
 }
 namespace floyd {
 
 
 
+////////////////////////////////		llvm_optimization_level
+
+
+/*
+	How hard LLVM optimizes the program before the JIT turns it into machine code. Same meaning as clang's -O0 to -O3.
+	k_O0 runs no IR passes and the fastest code generator: quickest to compile, slowest code.
+*/
+enum class llvm_optimization_level {
+	k_O0 = 0,
+	k_O1 = 1,
+	k_O2 = 2,
+	k_O3 = 3
+};
+
+//	"0" to "3", like in the -O2 command line flag. Throws on anything else.
+llvm_optimization_level parse_llvm_optimization_level(const std::string& s);
+
+
+
 ////////////////////////////////		llvm_ir_program_t
 
 
@@ -73,11 +93,21 @@ struct llvm_ir_program_t {
 
 	container_t container_def;
 	software_system_t software_system;
+
+	//	Used when the program is JITed, see make_engine_run_init().
+	llvm_optimization_level optimization_level = llvm_optimization_level::k_O0;
+
+	//	Used when the program is JITed: MCJIT takes the machine code from here if it has it, else stores it here.
+	llvm::ObjectCache* object_cache = nullptr;
 };
 
 
-//	Converts the semantic AST to LLVM IR code.
-std::unique_ptr<llvm_ir_program_t> generate_llvm_ir_program(llvm_instance_t& instance, const semantic_ast_t& ast, const std::string& module_name);
+//	Converts the semantic AST to LLVM IR code. vectors picks how all [T] vectors in the program are stored.
+std::unique_ptr<llvm_ir_program_t> generate_llvm_ir_program(llvm_instance_t& instance, const semantic_ast_t& ast, const std::string& module_name, vector_backend vectors = vector_backend::k_carray);
+
+//	Removes a retain and a later release of the same value in the same BB, when nothing in between can release the
+//	value. generate_llvm_ir_program() runs this on all functions. Returns the number of pairs removed.
+int cancel_retain_release_pairs(llvm::Function& f);
 
 //	Runs the LLVM IR program.
 int64_t run_llvm_program(llvm_instance_t& instance, llvm_ir_program_t& program_breaks, const std::vector<std::string>& main_args);
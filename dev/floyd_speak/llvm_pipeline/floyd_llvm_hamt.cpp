@@ -0,0 +1,440 @@
+//
+//  floyd_llvm_hamt.cpp
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-07-28.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#include "floyd_llvm_hamt.h"
+
+#include "quark.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace floyd {
+
+
+
+////////////////////////////////		NODES
+
+
+
+struct hamt_node_t {
+	heap_alloc_64_t alloc;
+};
+
+static uint64_t get_node_shift(const hamt_node_t& node){
+	return node.alloc.data_a;
+}
+
+static uint64_t get_used_count(const hamt_node_t& node){
+	return node.alloc.data_b;
+}
+
+static runtime_value_t* get_slots(hamt_node_t& node){
+	return static_cast<runtime_value_t*>(get_alloc_ptr(node.alloc));
+}
+static const runtime_value_t* get_slots(const hamt_node_t& node){
+	return static_cast<const runtime_value_t*>(get_alloc_ptr(node.alloc));
+}
+
+static hamt_node_t* get_child(const hamt_node_t& node, uint64_t slot){
+	QUARK_ASSERT(get_node_shift(node) > 0);
+	QUARK_ASSERT(slot < get_used_count(node));
+
+	return reinterpret_cast<hamt_node_t*>(get_slots(node)[slot].function_ptr);
+}
+
+static uint64_t get_slot(uint64_t shift, uint64_t index){
+	return (index >> shift) & (k_hamt_branch_count - 1);
+}
+
+static hamt_node_t* alloc_node(heap_t& heap, uint64_t shift){
+	auto alloc = alloc_64(heap, k_hamt_branch_count);
+	alloc->data_a = shift;
+	alloc->data_b = 0;
+	alloc->debug_info[0] = 'H';
+	alloc->debug_info[1] = 'A';
+	alloc->debug_info[2] = 'M';
+	alloc->debug_info[3] = 'T';
+
+	auto node = reinterpret_cast<hamt_node_t*>(alloc);
+	std::memset(get_slots(*node), 0, k_hamt_branch_count * sizeof(runtime_value_t));
+	return node;
+}
+
+static void release_node(hamt_node_t* node, const hamt_element_ops_t& ops);
+
+static void dispose_node(hamt_node_t* node, const hamt_element_ops_t& ops){
+	QUARK_ASSERT(node != nullptr && node->alloc.rc == 0);
+
+	const auto slots = get_slots(*node);
+	const auto used = get_used_count(*node);
+	if(get_node_shift(*node) == 0){
+		if(ops.release){
+			for(uint64_t i = 0 ; i < used ; i++){
+				ops.release(slots[i]);
+			}
+		}
+	}
+	else{
+		for(uint64_t i = 0 ; i < used ; i++){
+			release_node(get_child(*node, i), ops);
+		}
+	}
+	dispose_alloc(node->alloc);
+}
+
+static void release_node(hamt_node_t* node, const hamt_element_ops_t& ops){
+	if(node != nullptr && dec_rc(node->alloc) == 0){
+		dispose_node(node, ops);
+	}
+}
+
+//	The copy gets its own RC of everything node has.
+static hamt_node_t* copy_node(heap_t& heap, const hamt_node_t& node, const hamt_element_ops_t& ops){
+	const auto shift = get_node_shift(node);
+	const auto used = get_used_count(node);
+
+	auto result = alloc_node(heap, shift);
+	result->alloc.data_b = used;
+	auto dest = get_slots(*result);
+	const auto source = get_slots(node);
+	for(uint64_t i = 0 ; i < used ; i++){
+		dest[i] = source[i];
+		if(shift > 0){
+			inc_rc(get_child(node, i)->alloc);
+		}
+		else if(ops.retain){
+			ops.retain(source[i]);
+		}
+	}
+	return result;
+}
+
+//	Stores element at index in the subtree. Takes over the caller's RC of node and of element and returns the node
+//	that replaces node. node is changed in place if nobody else uses it, else it's copied. nullptr = a new node.
+static hamt_node_t* store_in_node(heap_t& heap, hamt_node_t* node, uint64_t shift, uint64_t index, runtime_value_t element, const hamt_element_ops_t& ops){
+	if(node == nullptr){
+		node = alloc_node(heap, shift);
+	}
+	else if(node->alloc.rc > 1){
+		auto copy = copy_node(heap, *node, ops);
+		release_node(node, ops);
+		node = copy;
+	}
+	QUARK_ASSERT(get_node_shift(*node) == shift);
+
+	const auto slot = get_slot(shift, index);
+	const auto used = get_used_count(*node);
+	auto slots = get_slots(*node);
+
+	//	Elements are added at the end of the trie, so a new slot is always the next unused one.
+	QUARK_ASSERT(slot <= used);
+	if(slot == used){
+		node->alloc.data_b = used + 1;
+	}
+
+	if(shift == 0){
+		if(slot < used && ops.release){
+			ops.release(slots[slot]);
+		}
+		slots[slot] = element;
+	}
+	else{
+		const auto child = slot < used ? get_child(*node, slot) : nullptr;
+		const auto child2 = store_in_node(heap, child, shift - k_hamt_bits, index, element, ops);
+		slots[slot].function_ptr = child2;
+	}
+	return node;
+}
+
+
+
+////////////////////////////////		VEC_T
+
+
+
+static uint64_t get_offset(const VEC_T& vec){
+	return vec.alloc.data_c;
+}
+
+static hamt_node_t* get_root(const VEC_T& vec){
+	return reinterpret_cast<hamt_node_t*>(vec.alloc.data_b);
+}
+
+//	Takes over the caller's RC of root.
+static VEC_T* alloc_vec_hamt_header(heap_t& heap, hamt_node_t* root, uint64_t offset, uint64_t count){
+	auto vec = alloc_vec(heap, 0, count);
+	vec->alloc.data_b = reinterpret_cast<uint64_t>(root);
+	vec->alloc.data_c = offset;
+	vec->alloc.debug_info[3] = 'H';
+	return vec;
+}
+
+static void release_vec_hamt(VEC_T* vec, const hamt_element_ops_t& ops){
+	if(dec_rc(vec->alloc) == 0){
+		dispose_vec_hamt(*vec, ops);
+	}
+}
+
+VEC_T* alloc_vec_hamt(heap_t& heap, const runtime_value_t elements[], uint64_t count){
+	auto vec = alloc_vec_hamt_header(heap, nullptr, 0, 0);
+	for(uint64_t i = 0 ; i < count ; i++){
+		vec = store_vec_hamt_element_owned(heap, vec, i, elements[i], hamt_element_ops_t{});
+	}
+	return vec;
+}
+
+void dispose_vec_hamt(VEC_T& vec, const hamt_element_ops_t& ops){
+	QUARK_ASSERT(vec.check_invariant());
+	QUARK_ASSERT(vec.alloc.rc == 0);
+
+	release_node(get_root(vec), ops);
+	dispose_vec(vec);
+}
+
+runtime_value_t load_vec_hamt_element(const VEC_T& vec, uint64_t index){
+	QUARK_ASSERT(vec.check_invariant());
+	QUARK_ASSERT(index < vec.get_element_count());
+
+	const auto trie_index = get_offset(vec) + index;
+	const hamt_node_t* node = get_root(vec);
+	auto shift = get_node_shift(*node);
+	while(shift > 0){
+		node = get_child(*node, get_slot(shift, trie_index));
+		shift = shift - k_hamt_bits;
+	}
+	return get_slots(*node)[get_slot(0, trie_index)];
+}
+
+void copy_vec_hamt_elements(const VEC_T& vec, runtime_value_t dest[]){
+	QUARK_ASSERT(vec.check_invariant());
+
+	const auto count = vec.get_element_count();
+	const auto offset = get_offset(vec);
+
+	//	One walk from the root per leaf.
+	uint64_t i = 0;
+	while(i < count){
+		const auto trie_index = offset + i;
+		const hamt_node_t* node = get_root(vec);
+		auto shift = get_node_shift(*node);
+		while(shift > 0){
+			node = get_child(*node, get_slot(shift, trie_index));
+			shift = shift - k_hamt_bits;
+		}
+		const auto slot = get_slot(0, trie_index);
+		const auto n = std::min(k_hamt_branch_count - slot, count - i);
+		std::memcpy(&dest[i], &get_slots(*node)[slot], n * sizeof(runtime_value_t));
+		i = i + n;
+	}
+}
+
+VEC_T* store_vec_hamt_element(heap_t& heap, const VEC_T& vec, uint64_t index, runtime_value_t element, const hamt_element_ops_t& ops){
+	QUARK_ASSERT(vec.check_invariant());
+
+	auto root = get_root(vec);
+	if(root != nullptr){
+		inc_rc(root->alloc);
+	}
+	auto result = alloc_vec_hamt_header(heap, root, get_offset(vec), vec.get_element_count());
+	return store_vec_hamt_element_owned(heap, result, index, element, ops);
+}
+
+VEC_T* store_vec_hamt_element_owned(heap_t& heap, VEC_T* vec, uint64_t index, runtime_value_t element, const hamt_element_ops_t& ops){
+	QUARK_ASSERT(vec != nullptr && vec->check_invariant());
+
+	const auto count = vec->get_element_count();
+	QUARK_ASSERT(index <= count);
+
+	if(vec->alloc.rc > 1){
+		auto result = store_vec_hamt_element(heap, *vec, index, element, ops);
+		release_vec_hamt(vec, ops);
+		return result;
+	}
+
+	const auto trie_index = get_offset(*vec) + index;
+	auto root = get_root(*vec);
+
+	//	Add levels on top until the trie has room for trie_index. The old root becomes the first child.
+	auto shift = root != nullptr ? get_node_shift(*root) : 0;
+	while(root != nullptr && (trie_index >> shift) >= k_hamt_branch_count){
+		auto root2 = alloc_node(heap, shift + k_hamt_bits);
+		root2->alloc.data_b = 1;
+		get_slots(*root2)[0].function_ptr = root;
+		root = root2;
+		shift = shift + k_hamt_bits;
+	}
+
+	root = store_in_node(heap, root, shift, trie_index, element, ops);
+	vec->alloc.data_b = reinterpret_cast<uint64_t>(root);
+	vec->alloc.data_a = std::max(count, index + 1);
+	return vec;
+}
+
+VEC_T* subset_vec_hamt(heap_t& heap, const VEC_T& vec, uint64_t start, uint64_t end){
+	QUARK_ASSERT(vec.check_invariant());
+	QUARK_ASSERT(start <= end && end <= vec.get_element_count());
+
+	auto root = get_root(vec);
+	if(start == end){
+		return alloc_vec_hamt_header(heap, nullptr, 0, 0);
+	}
+	inc_rc(root->alloc);
+	return alloc_vec_hamt_header(heap, root, get_offset(vec) + start, end - start);
+}
+
+static uint64_t count_nodes(const hamt_node_t& node){
+	uint64_t result = 1;
+	if(get_node_shift(node) > 0){
+		for(uint64_t i = 0 ; i < get_used_count(node) ; i++){
+			result = result + count_nodes(*get_child(node, i));
+		}
+	}
+	return result;
+}
+
+uint64_t count_vec_hamt_nodes(const VEC_T& vec){
+	QUARK_ASSERT(vec.check_invariant());
+
+	const auto root = get_root(vec);
+	return root != nullptr ? count_nodes(*root) : 0;
+}
+
+
+}	//	floyd
+
+
+
+////////////////////////////////		TESTS
+
+
+
+using namespace floyd;
+
+static std::vector<runtime_value_t> make_test_elements(uint64_t count){
+	std::vector<runtime_value_t> result;
+	for(uint64_t i = 0 ; i < count ; i++){
+		result.push_back(make_runtime_int(i * 10));
+	}
+	return result;
+}
+
+static void release_test_vec(VEC_T* vec){
+	if(dec_rc(vec->alloc) == 0){
+		dispose_vec_hamt(*vec, hamt_element_ops_t{});
+	}
+}
+
+QUARK_UNIT_TEST("", "alloc_vec_hamt()", "3 levels", ""){
+	heap_t heap;
+	const auto elements = make_test_elements(40000);
+	auto vec = alloc_vec_hamt(heap, elements.data(), elements.size());
+	QUARK_UT_VERIFY(vec->get_element_count() == 40000);
+	for(uint64_t i = 0 ; i < elements.size() ; i++){
+		QUARK_UT_VERIFY(load_vec_hamt_element(*vec, i).int_value == elements[i].int_value);
+	}
+
+	std::vector<runtime_value_t> copy(elements.size());
+	copy_vec_hamt_elements(*vec, copy.data());
+	QUARK_UT_VERIFY(copy[0].int_value == 0 && copy[39999].int_value == 399990);
+
+	release_test_vec(vec);
+	QUARK_UT_VERIFY(heap.count_used() == 0);
+}
+
+QUARK_UNIT_TEST("", "store_vec_hamt_element()", "old vector is unchanged, shares all but one path", ""){
+	heap_t heap;
+	const auto elements = make_test_elements(2000);
+	auto a = alloc_vec_hamt(heap, elements.data(), elements.size());
+	const auto a_nodes = count_vec_hamt_nodes(*a);
+	const auto used_before = heap.count_used();
+
+	auto b = store_vec_hamt_element(heap, *a, 1234, make_runtime_int(-1), hamt_element_ops_t{});
+	QUARK_UT_VERIFY(load_vec_hamt_element(*a, 1234).int_value == 12340);
+	QUARK_UT_VERIFY(load_vec_hamt_element(*b, 1234).int_value == -1);
+	QUARK_UT_VERIFY(load_vec_hamt_element(*b, 1235).int_value == 12350);
+
+	//	The new VEC_T and a new root, middle node and leaf.
+	QUARK_UT_VERIFY(count_vec_hamt_nodes(*b) == a_nodes);
+	QUARK_UT_VERIFY(heap.count_used() == used_before + 4);
+
+	release_test_vec(a);
+	release_test_vec(b);
+	QUARK_UT_VERIFY(heap.count_used() == 0);
+}
+
+QUARK_UNIT_TEST("", "store_vec_hamt_element_owned()", "only owner changes in place", ""){
+	heap_t heap;
+	auto a = alloc_vec_hamt(heap, nullptr, 0);
+	for(uint64_t i = 0 ; i < 100 ; i++){
+		auto a2 = store_vec_hamt_element_owned(heap, a, i, make_runtime_int(i), hamt_element_ops_t{});
+		QUARK_UT_VERIFY(a2 == a);
+	}
+	QUARK_UT_VERIFY(a->get_element_count() == 100);
+
+	inc_rc(a->alloc);
+	auto b = store_vec_hamt_element_owned(heap, a, 100, make_runtime_int(100), hamt_element_ops_t{});
+	QUARK_UT_VERIFY(b != a);
+	QUARK_UT_VERIFY(a->get_element_count() == 100);
+	QUARK_UT_VERIFY(b->get_element_count() == 101);
+	QUARK_UT_VERIFY(load_vec_hamt_element(*b, 100).int_value == 100);
+
+	release_test_vec(a);
+	release_test_vec(b);
+	QUARK_UT_VERIFY(heap.count_used() == 0);
+}
+
+QUARK_UNIT_TEST("", "subset_vec_hamt()", "push_back() onto a subset", ""){
+	heap_t heap;
+	const auto elements = make_test_elements(100);
+	auto a = alloc_vec_hamt(heap, elements.data(), elements.size());
+	auto b = subset_vec_hamt(heap, *a, 10, 20);
+	QUARK_UT_VERIFY(b->get_element_count() == 10);
+	QUARK_UT_VERIFY(load_vec_hamt_element(*b, 0).int_value == 100);
+
+	//	Overwrites element 20 of the shared trie in a copy. a still has it.
+	auto c = store_vec_hamt_element(heap, *b, 10, make_runtime_int(-1), hamt_element_ops_t{});
+	QUARK_UT_VERIFY(c->get_element_count() == 11);
+	QUARK_UT_VERIFY(load_vec_hamt_element(*c, 10).int_value == -1);
+	QUARK_UT_VERIFY(load_vec_hamt_element(*a, 20).int_value == 200);
+
+	std::vector<runtime_value_t> copy(11);
+	copy_vec_hamt_elements(*c, copy.data());
+	QUARK_UT_VERIFY(copy[0].int_value == 100 && copy[9].int_value == 190 && copy[10].int_value == -1);
+
+	release_test_vec(a);
+	release_test_vec(b);
+	release_test_vec(c);
+	QUARK_UT_VERIFY(heap.count_used() == 0);
+}
+
+QUARK_UNIT_TEST("", "store_vec_hamt_element()", "RC elements", ""){
+	heap_t heap;
+	int64_t rc = 0;
+	const auto ops = hamt_element_ops_t{
+		[&](runtime_value_t){ rc++; },
+		[&](runtime_value_t){ rc--; }
+	};
+
+	//	Each vector owns one RC of each of its elements: a has 3, b has 4.
+	const auto elements = make_test_elements(3);
+	rc = 3;
+	auto a = alloc_vec_hamt(heap, elements.data(), elements.size());
+	rc++;
+	auto b = store_vec_hamt_element(heap, *a, 3, make_runtime_int(30), ops);
+	QUARK_UT_VERIFY(rc == 3 + 4);
+
+	if(dec_rc(a->alloc) == 0){
+		dispose_vec_hamt(*a, ops);
+	}
+	QUARK_UT_VERIFY(rc == 4);
+	if(dec_rc(b->alloc) == 0){
+		dispose_vec_hamt(*b, ops);
+	}
+	QUARK_UT_VERIFY(rc == 0);
+	QUARK_UT_VERIFY(heap.count_used() == 0);
+}
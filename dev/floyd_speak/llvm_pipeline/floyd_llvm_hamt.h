@@ -0,0 +1,77 @@
+//
+//  floyd_llvm_hamt.h
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-07-28.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#ifndef floyd_llvm_hamt_hpp
+#define floyd_llvm_hamt_hpp
+
+/*
+	Persistent vectors for the LLVM runtime, used for [T] when the program is compiled with vector_backend::k_hamt.
+
+	The elements sit in a 32-way trie, like Clojure's and immer's vectors. Changing or appending an element copies the
+	path from the root to its leaf, about log32(n) nodes, and shares all other nodes with the old vector.
+
+	- Each node is a heap_t block with 32 words: elements in leaves, child node pointers in the other nodes.
+		alloc.data_a is the node's shift, 0 for leaves, and alloc.data_b how many of its 32 slots are used.
+	- Nodes are reference counted. A node owns an RC of each of its children, and of each of its elements when they are
+		RC values. The trie can't see the element type, hamt_element_ops_t retains and releases them.
+	- The VEC_T is a view of the elements [offset, offset + count) in the trie:
+		alloc.data_a is the count, alloc.data_b the root node and alloc.data_c the offset.
+		subset() makes a new view of the same trie, so the elements outside it are kept until the trie is released.
+	- A vector and nodes that nobody else uses are changed in place, see store_vec_hamt_element_owned().
+
+	We use our own trie instead of immer: immer would free elements without knowing their Floyd type.
+*/
+
+#include "floyd_llvm_heap.h"
+
+#include <functional>
+
+namespace floyd {
+
+
+static const int k_hamt_bits = 5;
+static const uint64_t k_hamt_branch_count = 1 << k_hamt_bits;
+
+
+//	Both are empty when the elements aren't RC values.
+struct hamt_element_ops_t {
+	std::function<void (runtime_value_t element)> retain;
+	std::function<void (runtime_value_t element)> release;
+};
+
+
+//	Takes over the caller's RC of each element.
+VEC_T* alloc_vec_hamt(heap_t& heap, const runtime_value_t elements[], uint64_t count);
+
+//	Frees vec and the nodes only it uses. Call when vec's RC has reached 0.
+void dispose_vec_hamt(VEC_T& vec, const hamt_element_ops_t& ops);
+
+//	Doesn't retain the element.
+runtime_value_t load_vec_hamt_element(const VEC_T& vec, uint64_t index);
+
+//	dest must have room for all elements of vec. Doesn't retain them.
+void copy_vec_hamt_elements(const VEC_T& vec, runtime_value_t dest[]);
+
+//	Returns a new vector with element at index, or with element appended if index is the element count. vec isn't
+//	changed. Takes over the caller's RC of element.
+VEC_T* store_vec_hamt_element(heap_t& heap, const VEC_T& vec, uint64_t index, runtime_value_t element, const hamt_element_ops_t& ops);
+
+//	Like store_vec_hamt_element() but takes over the caller's reference to vec. If nobody else has vec, it is changed
+//	in place, including the nodes nobody else uses.
+VEC_T* store_vec_hamt_element_owned(heap_t& heap, VEC_T* vec, uint64_t index, runtime_value_t element, const hamt_element_ops_t& ops);
+
+//	The elements [start, end) of vec, sharing vec's trie. start <= end <= element count.
+VEC_T* subset_vec_hamt(heap_t& heap, const VEC_T& vec, uint64_t start, uint64_t end);
+
+//	How many trie nodes vec uses, including the ones it shares. For tests.
+uint64_t count_vec_hamt_nodes(const VEC_T& vec);
+
+
+}	//	floyd
+
+#endif /* floyd_llvm_hamt_hpp */
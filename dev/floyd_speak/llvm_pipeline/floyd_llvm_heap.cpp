@@ -0,0 +1,1116 @@
+//
+//  floyd_llvm_heap.cpp
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-04-16.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#include "floyd_llvm_heap.h"
+#include "floyd_llvm_slab.h"
+
+#include "ast.h"
+#include "json_support.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <thread>
+
+#include "quark.h"
+
+
+namespace floyd {
+
+
+
+////////////////////////////////		heap_t
+
+
+
+void trace_alloc(const heap_rec_t& e){
+	QUARK_TRACE_SS(""
+//		<< "used: " << e.in_use
+		<< " rc: " << e.alloc_ptr->rc
+		<< " debug[0]: " << e.alloc_ptr->debug_info[0]
+		<< " data_a: " << e.alloc_ptr->data_a
+	);
+}
+
+void trace_heap(const heap_t& heap){
+	QUARK_ASSERT(heap.check_invariant());
+
+	if(false && heap.record_allocs){
+		QUARK_SCOPED_TRACE("HEAP");
+
+		std::lock_guard<std::mutex> guard(*heap.alloc_records_mutex);
+
+		for(int i = 0 ; i < heap.alloc_records.size() ; i++){
+			const auto& e = heap.alloc_records[i];
+			trace_alloc(e);
+		}
+	}
+}
+
+void detect_leaks(const heap_t& heap){
+	QUARK_ASSERT(heap.check_invariant());
+
+	const auto leaks = heap.count_used();
+	if(leaks > 0){
+		QUARK_SCOPED_TRACE("LEAKS");
+
+		trace_heap(heap);
+
+#if 1
+		if(leaks > 0){
+			throw std::exception();
+		}
+#endif
+	}
+}
+
+
+static size_t get_alloc_64_size(const heap_alloc_64_t& alloc){
+	return sizeof(heap_alloc_64_t) + alloc.allocation_word_count * sizeof(uint64_t);
+}
+
+heap_t::~heap_t(){
+	QUARK_ASSERT(check_invariant());
+
+#if DEBUG
+	const auto leaks = count_used();
+	if(leaks > 0){
+		QUARK_SCOPED_TRACE("LEAKS");
+		trace_heap(*this);
+	}
+#endif
+
+	if(record_allocs){
+		for(const auto& e: alloc_records){
+			slab_free(e.alloc_ptr, get_alloc_64_size(*e.alloc_ptr));
+		}
+	}
+}
+
+
+
+heap_alloc_64_t* alloc_64(heap_t& heap, uint64_t allocation_word_count){
+	QUARK_ASSERT(heap.check_invariant());
+
+	const auto header_size = sizeof(heap_alloc_64_t);
+	QUARK_ASSERT(header_size == 64);
+
+	void* alloc0 = slab_alloc(header_size + allocation_word_count * sizeof(uint64_t));
+
+	auto alloc = reinterpret_cast<heap_alloc_64_t*>(alloc0);
+
+	alloc->allocation_word_count = allocation_word_count;
+	alloc->rc = 1;
+	alloc->magic = ALLOC_64_MAGIC;
+
+	alloc->data_a = 0;
+	alloc->data_b = 0;
+	alloc->data_c = 0;
+
+	alloc->heap64 = &heap;
+	memset(&alloc->debug_info[0], 0x00, 16);
+
+	std::atomic_fetch_add_explicit(&heap.alloc_count, int64_t(1), std::memory_order_relaxed);
+
+	if(heap.record_allocs){
+		std::lock_guard<std::mutex> guard(*heap.alloc_records_mutex);
+		heap.alloc_records.push_back({ alloc });
+	}
+
+	QUARK_ASSERT(alloc->check_invariant());
+	QUARK_ASSERT(heap.check_invariant());
+	return alloc;
+}
+
+QUARK_UNIT_TEST("heap_t", "alloc_64()", "", ""){
+	heap_t heap;
+	QUARK_UT_VERIFY(heap.check_invariant());
+}
+
+QUARK_UNIT_TEST("heap_t", "alloc_64()", "", ""){
+	heap_t heap;
+	auto a = alloc_64(heap, 0);
+	QUARK_UT_VERIFY(a != nullptr);
+	QUARK_UT_VERIFY(a->check_invariant());
+	QUARK_UT_VERIFY(a->allocation_word_count == 0);
+	QUARK_UT_VERIFY(a->rc == 1);
+
+	//	Must release alloc or heap will detect leakage.
+	release_ref(*a);
+}
+
+QUARK_UNIT_TEST("heap_t", "add_ref()", "", ""){
+	heap_t heap;
+	auto a = alloc_64(heap, 0);
+	add_ref(*a);
+	QUARK_UT_VERIFY(a->rc == 2);
+
+	//	Must release alloc or heap will detect leakage.
+	release_ref(*a);
+	release_ref(*a);
+}
+
+QUARK_UNIT_TEST("heap_t", "release_ref()", "", ""){
+	//	Record allocations so the block is still there to inspect after release.
+	heap_t heap(true);
+	auto a = alloc_64(heap, 0);
+
+	QUARK_UT_VERIFY(a->rc == 1);
+	release_ref(*a);
+	QUARK_UT_VERIFY(a->rc == 0);
+
+	const auto count = heap.count_used();
+	QUARK_UT_VERIFY(count == 0);
+}
+
+QUARK_UNIT_TEST("heap_t", "count_used()", "", ""){
+	heap_t heap;
+	auto a = alloc_64(heap, 0);
+	auto b = alloc_64(heap, 10);
+	QUARK_UT_VERIFY(heap.count_used() == 2);
+
+	release_ref(*a);
+	QUARK_UT_VERIFY(heap.count_used() == 1);
+	release_ref(*b);
+	QUARK_UT_VERIFY(heap.count_used() == 0);
+}
+
+QUARK_UNIT_TEST("heap_t", "k_heap_alloc_64_rc_offset", "", ""){
+	heap_t heap;
+	auto a = alloc_64(heap, 0);
+	const auto rc_ptr = reinterpret_cast<uint8_t*>(a) + k_heap_alloc_64_rc_offset;
+	QUARK_UT_VERIFY(rc_ptr == reinterpret_cast<uint8_t*>(&a->rc));
+	QUARK_UT_VERIFY(sizeof(a->rc) == sizeof(int32_t));
+	release_ref(*a);
+}
+
+QUARK_UNIT_TEST("heap_t", "alloc_64()", "many threads share one heap", ""){
+	heap_t heap;
+	std::vector<std::thread> threads;
+	for(int t = 0 ; t < 4 ; t++){
+		threads.push_back(std::thread([&heap](){
+			std::vector<heap_alloc_64_t*> allocs;
+			for(int i = 0 ; i < 10000 ; i++){
+				allocs.push_back(alloc_64(heap, i & 7));
+			}
+			for(auto e: allocs){
+				release_ref(*e);
+			}
+		}));
+	}
+	for(auto& e: threads){
+		e.join();
+	}
+	QUARK_UT_VERIFY(heap.count_used() == 0);
+}
+
+
+
+void* get_alloc_ptr(heap_alloc_64_t& alloc){
+	QUARK_ASSERT(alloc.check_invariant());
+
+	auto p = &alloc;
+	return p + 1;
+}
+const void* get_alloc_ptr(const heap_alloc_64_t& alloc){
+	QUARK_ASSERT(alloc.check_invariant());
+
+	auto p = &alloc;
+	return p + 1;
+}
+
+
+bool heap_alloc_64_t::check_invariant() const{
+	QUARK_ASSERT(magic == ALLOC_64_MAGIC);
+	QUARK_ASSERT(heap64 != nullptr);
+	QUARK_ASSERT(heap64->magic == HEAP_MAGIC);
+
+//	auto it = std::find_if(heap64->alloc_records.begin(), heap64->alloc_records.end(), [&](heap_rec_t& e){ return e.alloc_ptr == this; });
+//	QUARK_ASSERT(it != heap64->alloc_records.end());
+
+	return true;
+}
+
+int32_t dec_rc(heap_alloc_64_t& alloc){
+	QUARK_ASSERT(alloc.check_invariant());
+
+	const auto prev_rc = std::atomic_fetch_sub_explicit(&alloc.rc, 1, std::memory_order_relaxed);
+	const auto rc2 = prev_rc - 1;
+
+	if(rc2 < 0){
+		QUARK_ASSERT(false);
+		throw std::exception();
+	}
+
+	return rc2;
+}
+int32_t inc_rc(heap_alloc_64_t& alloc){
+	QUARK_ASSERT(alloc.check_invariant());
+
+	const auto prev_rc = std::atomic_fetch_add_explicit(&alloc.rc, 1, std::memory_order_relaxed);
+	const auto rc2 = prev_rc + 1;
+	return rc2;
+}
+
+void add_ref(heap_alloc_64_t& alloc){
+	QUARK_ASSERT(alloc.check_invariant());
+
+	inc_rc(alloc);
+}
+
+
+void dispose_alloc(heap_alloc_64_t& alloc){
+	QUARK_ASSERT(alloc.check_invariant());
+	QUARK_ASSERT(alloc.rc == 0);
+
+	auto& heap = *alloc.heap64;
+	const auto prev_count = std::atomic_fetch_sub_explicit(&heap.alloc_count, int64_t(1), std::memory_order_relaxed);
+	QUARK_ASSERT(prev_count > 0);
+
+	//	When recording we keep the block, to help debugging. ~heap_t() frees it.
+	if(heap.record_allocs == false){
+		slab_free(&alloc, get_alloc_64_size(alloc));
+	}
+}
+
+
+void release_ref(heap_alloc_64_t& alloc){
+	QUARK_ASSERT(alloc.check_invariant());
+
+	if(dec_rc(alloc) == 0){
+		dispose_alloc(alloc);
+	}
+}
+
+bool heap_t::check_invariant() const{
+	QUARK_ASSERT(magic == HEAP_MAGIC);
+	QUARK_ASSERT(alloc_count >= 0);
+	QUARK_ASSERT(record_allocs == false || alloc_records_mutex);
+	return true;
+}
+
+int heap_t::count_used() const {
+	QUARK_ASSERT(check_invariant());
+
+	return static_cast<int>(alloc_count.load());
+}
+
+
+uint64_t size_to_allocation_blocks(std::size_t size){
+	const auto r = (size >> 3) + ((size & 7) > 0 ? 1 : 0);
+
+	QUARK_ASSERT((r * sizeof(uint64_t) - size) >= 0);
+	QUARK_ASSERT((r * sizeof(uint64_t) - size) < sizeof(uint64_t));
+
+	return r;
+}
+
+
+////////////////////////////////	runtime_type_t
+
+
+runtime_type_t make_runtime_type(int32_t itype){
+	return runtime_type_t{ itype };
+}
+
+
+
+
+
+////////////////////////////////	native_value_t
+
+
+QUARK_UNIT_TEST("", "", "", ""){
+	const auto s = sizeof(runtime_value_t);
+	QUARK_UT_VERIFY(s == 8);
+}
+
+
+
+QUARK_UNIT_TEST("", "", "", ""){
+	auto y = make_runtime_int(8);
+	auto a = make_runtime_int(1234);
+
+	y = a;
+
+	runtime_value_t c(y);
+}
+
+
+
+runtime_value_t make_blank_runtime_value(){
+	return make_runtime_int(0xdeadbee1);
+}
+
+runtime_value_t make_runtime_bool(bool value){
+	return { .bool_value = value };
+}
+
+runtime_value_t make_runtime_int(int64_t value){
+	return { .int_value = value };
+}
+runtime_value_t make_runtime_typeid(runtime_type_t type){
+	return { .typeid_itype = type };
+}
+runtime_value_t make_runtime_struct(STRUCT_T* struct_ptr){
+	runtime_value_t tmp;
+	tmp.struct_ptr = struct_ptr;
+	return   tmp;
+	//return { .struct_ptr = struct_ptr };
+}
+
+
+
+
+
+
+char* get_vec_chars(runtime_value_t str){
+	QUARK_ASSERT(str.vector_ptr != nullptr);
+
+	return reinterpret_cast<char*>(str.vector_ptr->get_element_ptr());
+}
+
+uint64_t get_vec_string_size(runtime_value_t str){
+	QUARK_ASSERT(str.vector_ptr != nullptr);
+
+	return str.vector_ptr->get_element_count();
+}
+
+
+
+
+VEC_T* unpack_vec_arg(const type_interner_t& types, runtime_value_t arg_value, runtime_type_t arg_type){
+#if DEBUG
+	const auto& type = lookup_type(types, arg_type);
+#endif
+	QUARK_ASSERT(type.is_vector());
+	QUARK_ASSERT(arg_value.vector_ptr != nullptr);
+	QUARK_ASSERT(arg_value.vector_ptr->check_invariant());
+
+	return arg_value.vector_ptr;
+}
+
+DICT_T* unpack_dict_arg(const type_interner_t& types, runtime_value_t arg_value, runtime_type_t arg_type){
+#if DEBUG
+	const auto& type = lookup_type(types, arg_type);
+#endif
+	QUARK_ASSERT(type.is_dict());
+	QUARK_ASSERT(arg_value.dict_ptr != nullptr);
+
+	QUARK_ASSERT(arg_value.dict_ptr->check_invariant());
+
+	return arg_value.dict_ptr;
+}
+
+
+
+
+
+base_type get_base_type(const type_interner_t& interner, const runtime_type_t& type){
+	const auto& a = lookup_type(interner, type);
+	const auto a_basetype = a.get_base_type();
+
+	//??? We know ranges where type.itype maps to base_type -- no need to look up in type_interner.
+	return a_basetype;
+}
+
+
+const typeid_t& lookup_type(const type_interner_t& interner, const runtime_type_t& type){
+	return lookup_type(interner, itype_t(static_cast<int32_t>(type)));
+}
+
+runtime_type_t lookup_runtime_type(const type_interner_t& interner, const typeid_t& type){
+	const auto a = lookup_itype(interner, type);
+	return make_runtime_type(a.itype);
+}
+
+
+
+////////////////////////////////		WIDE_RETURN_T
+
+
+
+
+WIDE_RETURN_T make_wide_return_2x64(runtime_value_t a, runtime_value_t b){
+	return WIDE_RETURN_T{ a, b };
+}
+
+
+
+
+////////////////////////////////		VEC_T
+
+
+
+QUARK_UNIT_TEST("", "", "", ""){
+	const auto vec_struct_size = sizeof(std::vector<int>);
+	QUARK_UT_VERIFY(vec_struct_size == 24);
+}
+
+QUARK_UNIT_TEST("", "", "", ""){
+	const auto wr_struct_size = sizeof(WIDE_RETURN_T);
+	QUARK_UT_VERIFY(wr_struct_size == 16);
+}
+
+
+VEC_T::~VEC_T(){
+	QUARK_ASSERT(check_invariant());
+}
+
+bool VEC_T::check_invariant() const {
+	QUARK_ASSERT(this->alloc.check_invariant());
+	return true;
+}
+
+VEC_T* alloc_vec(heap_t& heap, uint64_t allocation_count, uint64_t element_count){
+	QUARK_ASSERT(heap.check_invariant());
+
+	heap_alloc_64_t* alloc = alloc_64(heap, allocation_count);
+	alloc->data_a = element_count;
+	alloc->debug_info[0] = 'V';
+	alloc->debug_info[1] = 'E';
+	alloc->debug_info[2] = 'C';
+
+	auto vec = reinterpret_cast<VEC_T*>(alloc);
+
+	QUARK_ASSERT(vec->check_invariant());
+	QUARK_ASSERT(heap.check_invariant());
+
+	return vec;
+}
+
+void dispose_vec(VEC_T& vec){
+	QUARK_ASSERT(vec.check_invariant());
+
+	auto& heap = *vec.alloc.heap64;
+	dispose_alloc(vec.alloc);
+	QUARK_ASSERT(heap.check_invariant());
+}
+
+
+
+vector_backend parse_vector_backend(const std::string& s){
+	if(s == "carray"){
+		return vector_backend::k_carray;
+	}
+	else if(s == "hamt"){
+		return vector_backend::k_hamt;
+	}
+	else{
+		quark::throw_runtime_error("Unknown vector backend \"" + s + "\", use carray or hamt.");
+	}
+}
+
+std::string vector_backend_to_string(vector_backend backend){
+	return backend == vector_backend::k_hamt ? "hamt" : "carray";
+}
+
+QUARK_UNIT_TEST("", "parse_vector_backend()", "", ""){
+	QUARK_UT_VERIFY(parse_vector_backend("hamt") == vector_backend::k_hamt);
+	QUARK_UT_VERIFY(parse_vector_backend(vector_backend_to_string(vector_backend::k_carray)) == vector_backend::k_carray);
+}
+
+
+
+WIDE_RETURN_T make_wide_return_vec(VEC_T* vec){
+	return make_wide_return_2x64(runtime_value_t{.vector_ptr = vec}, runtime_value_t{.int_value = 0});
+}
+
+VEC_T* wide_return_to_vec(const WIDE_RETURN_T& ret){
+	return ret.a.vector_ptr;
+}
+
+
+
+
+
+
+////////////////////////////////		DICT_T
+
+
+
+static const uint64_t k_dict_min_capacity = 8;
+
+bool DICT_T::check_invariant() const{
+	QUARK_ASSERT(alloc.check_invariant());
+	QUARK_ASSERT(alloc.data_c == 0 || (alloc.data_c & (alloc.data_c - 1)) == 0);
+	QUARK_ASSERT((alloc.data_b == 0) == (alloc.data_c == 0));
+	QUARK_ASSERT(alloc.data_a * 4 <= alloc.data_c * 3);
+	return true;
+}
+
+uint64_t DICT_T::size() const {
+	QUARK_ASSERT(check_invariant());
+
+	return alloc.data_a;
+}
+
+DICT_T* alloc_dict(heap_t& heap){
+	QUARK_ASSERT(heap.check_invariant());
+
+	heap_alloc_64_t* alloc = alloc_64(heap, 0);
+	auto dict = reinterpret_cast<DICT_T*>(alloc);
+
+	alloc->debug_info[0] = 'D';
+	alloc->debug_info[1] = 'I';
+	alloc->debug_info[2] = 'C';
+	alloc->debug_info[3] = 'T';
+
+	alloc->data_a = 0;
+	alloc->data_b = 0;
+	alloc->data_c = 0;
+
+	QUARK_ASSERT(heap.check_invariant());
+	QUARK_ASSERT(dict->check_invariant());
+
+	return dict;
+}
+
+static dict_entry_t* alloc_dict_entries(heap_t& heap, uint64_t capacity, heap_alloc_64_t*& table){
+	static_assert(sizeof(dict_entry_t) == 3 * sizeof(uint64_t), "");
+
+	table = alloc_64(heap, capacity * 3);
+	table->debug_info[0] = 'D';
+	table->debug_info[1] = 'T';
+	table->debug_info[2] = 'A';
+	table->debug_info[3] = 'B';
+
+	//	alloc_64() doesn't clear the words, key == nullptr marks the empty slots.
+	auto entries = static_cast<dict_entry_t*>(get_alloc_ptr(*table));
+	std::memset(entries, 0, capacity * sizeof(dict_entry_t));
+	return entries;
+}
+
+//	The table is only referenced by its dict, so it is disposed directly.
+static void dispose_dict_entries(DICT_T& dict){
+	if(dict.alloc.data_b != 0){
+		auto& table = *reinterpret_cast<heap_alloc_64_t*>(dict.alloc.data_b);
+		table.rc = 0;
+		dispose_alloc(table);
+		dict.alloc.data_b = 0;
+	}
+}
+
+static void release_dict_key(VEC_T* key){
+	if(dec_rc(key->alloc) == 0){
+		dispose_vec(*key);
+	}
+}
+
+void dispose_dict(DICT_T& dict){
+	QUARK_ASSERT(dict.check_invariant());
+
+	auto& heap = *dict.alloc.heap64;
+	for_each_dict_entry(dict, [](const dict_entry_t& e){ release_dict_key(e.key); });
+	dispose_dict_entries(dict);
+	dispose_alloc(dict.alloc);
+	QUARK_ASSERT(heap.check_invariant());
+}
+
+
+static inline uint64_t fmix64(uint64_t k){
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdULL;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ULL;
+	k ^= k >> 33;
+	return k;
+}
+
+//	Hashes 8 chars at a time. Only the first size chars are read: the words of a string's VEC_T may have garbage
+//	after its last char.
+uint64_t hash_dict_key(const char s[], uint64_t size){
+	uint64_t h = size * 0x9e3779b97f4a7c15ULL;
+	uint64_t pos = 0;
+	for(; pos + 8 <= size ; pos += 8){
+		uint64_t w;
+		std::memcpy(&w, s + pos, 8);
+		h = (h ^ fmix64(w)) * 0x9e3779b97f4a7c15ULL;
+	}
+	if(pos < size){
+		uint64_t w = 0;
+		std::memcpy(&w, s + pos, size - pos);
+		h = (h ^ fmix64(w)) * 0x9e3779b97f4a7c15ULL;
+	}
+	return fmix64(h);
+}
+
+static inline bool dict_key_equal(const dict_entry_t& e, uint64_t hash, VEC_T* key){
+	if(e.key == key){
+		return true;
+	}
+	else if(e.hash != hash){
+		return false;
+	}
+	else{
+		const auto size = key->get_element_count();
+		return e.key->get_element_count() == size && std::memcmp(e.key->get_element_ptr(), key->get_element_ptr(), size) == 0;
+	}
+}
+
+//	The slot with key, or the empty slot where key goes. capacity must be > 0.
+static uint64_t find_dict_slot(const dict_entry_t entries[], uint64_t capacity, uint64_t hash, VEC_T* key){
+	const auto mask = capacity - 1;
+	auto i = hash & mask;
+	while(entries[i].key != nullptr && dict_key_equal(entries[i], hash, key) == false){
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+static uint64_t hash_dict_key(VEC_T* key){
+	return hash_dict_key(reinterpret_cast<const char*>(key->get_element_ptr()), key->get_element_count());
+}
+
+const dict_entry_t* find_dict_entry(const DICT_T& dict, runtime_value_t key){
+	QUARK_ASSERT(dict.check_invariant());
+	QUARK_ASSERT(key.vector_ptr != nullptr);
+
+	if(dict.alloc.data_a == 0){
+		return nullptr;
+	}
+	const auto entries = dict.get_entries();
+	const auto i = find_dict_slot(entries, dict.get_capacity(), hash_dict_key(key.vector_ptr), key.vector_ptr);
+	return entries[i].key != nullptr ? &entries[i] : nullptr;
+}
+
+//	Moves the entries to a new table, using their cached hashes.
+static void resize_dict(DICT_T& dict, uint64_t capacity){
+	heap_alloc_64_t* table = nullptr;
+	auto entries = alloc_dict_entries(*dict.alloc.heap64, capacity, table);
+
+	const auto mask = capacity - 1;
+	for_each_dict_entry(dict, [&](const dict_entry_t& e){
+		auto i = e.hash & mask;
+		while(entries[i].key != nullptr){
+			i = (i + 1) & mask;
+		}
+		entries[i] = e;
+	});
+
+	dispose_dict_entries(dict);
+	dict.alloc.data_b = reinterpret_cast<uint64_t>(table);
+	dict.alloc.data_c = capacity;
+}
+
+void store_dict_value(DICT_T& dict, runtime_value_t key, runtime_value_t value){
+	QUARK_ASSERT(dict.check_invariant());
+	QUARK_ASSERT(key.vector_ptr != nullptr);
+
+	const auto hash = hash_dict_key(key.vector_ptr);
+	if(dict.alloc.data_a > 0){
+		auto entries = dict.get_entries();
+		const auto i = find_dict_slot(entries, dict.get_capacity(), hash, key.vector_ptr);
+		if(entries[i].key != nullptr){
+			entries[i].value = value;
+			return;
+		}
+	}
+
+	if((dict.alloc.data_a + 1) * 4 > dict.get_capacity() * 3){
+		resize_dict(dict, std::max(k_dict_min_capacity, dict.get_capacity() * 2));
+	}
+
+	auto entries = dict.get_entries();
+	const auto i = find_dict_slot(entries, dict.get_capacity(), hash, key.vector_ptr);
+	inc_rc(key.vector_ptr->alloc);
+	entries[i] = dict_entry_t{ hash, key.vector_ptr, value };
+	dict.alloc.data_a++;
+
+	QUARK_ASSERT(dict.check_invariant());
+}
+
+//	Backward shift deletion: moves later entries of the probe run into the hole, so lookups need no tombstones.
+bool erase_dict_value(DICT_T& dict, runtime_value_t key){
+	QUARK_ASSERT(dict.check_invariant());
+	QUARK_ASSERT(key.vector_ptr != nullptr);
+
+	if(dict.alloc.data_a == 0){
+		return false;
+	}
+	auto entries = dict.get_entries();
+	const auto mask = dict.get_capacity() - 1;
+	auto hole = find_dict_slot(entries, dict.get_capacity(), hash_dict_key(key.vector_ptr), key.vector_ptr);
+	if(entries[hole].key == nullptr){
+		return false;
+	}
+
+	release_dict_key(entries[hole].key);
+	auto i = (hole + 1) & mask;
+	while(entries[i].key != nullptr){
+		const auto home = entries[i].hash & mask;
+
+		//	Move entry i if its home slot isn't in (hole, i], cyclically.
+		if(((i - home) & mask) >= ((i - hole) & mask)){
+			entries[hole] = entries[i];
+			hole = i;
+		}
+		i = (i + 1) & mask;
+	}
+	entries[hole] = dict_entry_t{ 0, nullptr, make_blank_runtime_value() };
+	dict.alloc.data_a--;
+
+	QUARK_ASSERT(dict.check_invariant());
+	return true;
+}
+
+DICT_T* copy_dict(heap_t& heap, const DICT_T& dict){
+	QUARK_ASSERT(heap.check_invariant());
+	QUARK_ASSERT(dict.check_invariant());
+
+	auto result = alloc_dict(heap);
+	if(dict.alloc.data_a > 0){
+		heap_alloc_64_t* table = nullptr;
+		auto entries = alloc_dict_entries(heap, dict.get_capacity(), table);
+		std::memcpy(entries, dict.get_entries(), dict.get_capacity() * sizeof(dict_entry_t));
+		for_each_dict_entry(dict, [](const dict_entry_t& e){ inc_rc(e.key->alloc); });
+
+		result->alloc.data_a = dict.alloc.data_a;
+		result->alloc.data_b = reinterpret_cast<uint64_t>(table);
+		result->alloc.data_c = dict.get_capacity();
+	}
+
+	QUARK_ASSERT(result->check_invariant());
+	return result;
+}
+
+
+
+static runtime_value_t make_test_dict_key(heap_t& heap, const std::string& s){
+	auto v = alloc_vec(heap, size_to_allocation_blocks(s.size()), s.size());
+	std::memcpy(v->get_element_ptr(), s.data(), s.size());
+	return runtime_value_t{ .vector_ptr = v };
+}
+
+static void release_test_dict(DICT_T* dict){
+	if(dec_rc(dict->alloc) == 0){
+		dispose_dict(*dict);
+	}
+}
+
+QUARK_UNIT_TEST("DICT_T", "hash_dict_key()", "", ""){
+	const std::string s = "abcdefghijklmnopq";
+	QUARK_UT_VERIFY(hash_dict_key(s.data(), 0) == hash_dict_key("x", 0));
+	QUARK_UT_VERIFY(hash_dict_key(s.data(), 9) == hash_dict_key("abcdefghi", 9));
+	QUARK_UT_VERIFY(hash_dict_key(s.data(), 9) != hash_dict_key(s.data(), 10));
+	QUARK_UT_VERIFY(hash_dict_key("a", 1) != hash_dict_key("b", 1));
+}
+
+QUARK_UNIT_TEST("DICT_T", "store_dict_value()", "equal keys that are different strings", ""){
+	heap_t heap;
+	auto dict = alloc_dict(heap);
+	const auto a = make_test_dict_key(heap, "hello");
+	const auto b = make_test_dict_key(heap, "hello");
+
+	store_dict_value(*dict, a, make_runtime_int(1));
+	store_dict_value(*dict, b, make_runtime_int(2));
+	QUARK_UT_VERIFY(dict->size() == 1);
+	QUARK_UT_VERIFY(find_dict_entry(*dict, b)->value.int_value == 2);
+	QUARK_UT_VERIFY(find_dict_entry(*dict, b)->key == a.vector_ptr);
+	QUARK_UT_VERIFY(a.vector_ptr->alloc.rc == 2);
+	QUARK_UT_VERIFY(b.vector_ptr->alloc.rc == 1);
+
+	release_dict_key(a.vector_ptr);
+	release_dict_key(b.vector_ptr);
+	release_test_dict(dict);
+	QUARK_UT_VERIFY(heap.count_used() == 0);
+}
+
+QUARK_UNIT_TEST("DICT_T", "store_dict_value()", "grow, erase, copy", ""){
+	heap_t heap;
+	auto dict = alloc_dict(heap);
+	const int count = 1000;
+	for(int i = 0 ; i < count ; i++){
+		const auto key = make_test_dict_key(heap, "key" + std::to_string(i));
+		store_dict_value(*dict, key, make_runtime_int(i));
+		release_dict_key(key.vector_ptr);
+	}
+	QUARK_UT_VERIFY(dict->size() == count);
+	QUARK_UT_VERIFY(dict->get_capacity() == 2048);
+
+	for(int i = 0 ; i < count ; i += 2){
+		const auto key = make_test_dict_key(heap, "key" + std::to_string(i));
+		QUARK_UT_VERIFY(erase_dict_value(*dict, key));
+		QUARK_UT_VERIFY(erase_dict_value(*dict, key) == false);
+		release_dict_key(key.vector_ptr);
+	}
+	QUARK_UT_VERIFY(dict->size() == count / 2);
+
+	auto dict2 = copy_dict(heap, *dict);
+	release_test_dict(dict);
+
+	for(int i = 0 ; i < count ; i++){
+		const auto key = make_test_dict_key(heap, "key" + std::to_string(i));
+		const auto e = find_dict_entry(*dict2, key);
+		if(i % 2 == 0){
+			QUARK_UT_VERIFY(e == nullptr);
+		}
+		else{
+			QUARK_UT_VERIFY(e != nullptr && e->value.int_value == i);
+		}
+		release_dict_key(key.vector_ptr);
+	}
+
+	release_test_dict(dict2);
+	QUARK_UT_VERIFY(heap.count_used() == 0);
+}
+
+
+
+WIDE_RETURN_T make_wide_return_dict(DICT_T* dict){
+	runtime_value_t tmp;
+	tmp.dict_ptr=dict;
+	return make_wide_return_2x64(tmp, { .int_value = 0 });
+	//return make_wide_return_2x64({ .dict_ptr = dict }, { .int_value = 0 });
+}
+
+DICT_T* wide_return_to_dict(const WIDE_RETURN_T& ret){
+	return ret.a.dict_ptr;
+}
+
+
+
+
+
+////////////////////////////////		JSON_T
+
+
+
+QUARK_UNIT_TEST("", "", "", ""){
+	const auto size = sizeof(STDMAP);
+	QUARK_ASSERT(size == 24);
+}
+
+bool JSON_T::check_invariant() const{
+	QUARK_ASSERT(alloc.check_invariant());
+	QUARK_ASSERT(get_json().check_invariant());
+	return true;
+}
+
+JSON_T* alloc_json(heap_t& heap, const json_t& init){
+	QUARK_ASSERT(heap.check_invariant());
+	QUARK_ASSERT(init.check_invariant());
+
+	heap_alloc_64_t* alloc = alloc_64(heap, 0);
+
+	alloc->debug_info[0] = 'J';
+	alloc->debug_info[1] = 'S';
+	alloc->debug_info[2] = 'O';
+	alloc->debug_info[3] = 'N';
+
+	auto json = reinterpret_cast<JSON_T*>(alloc);
+	auto copy = new json_t(init);
+	json->alloc.data_a = reinterpret_cast<uint64_t>(copy);
+
+	QUARK_ASSERT(json->check_invariant());
+	QUARK_ASSERT(heap.check_invariant());
+	return json;
+}
+
+void dispose_json(JSON_T& json){
+	QUARK_ASSERT(json.check_invariant());
+
+	auto& heap = *json.alloc.heap64;
+	delete &json.get_json();
+	json.alloc.data_a = 666;
+	dispose_alloc(json.alloc);
+
+	QUARK_ASSERT(heap.check_invariant());
+}
+
+
+
+
+
+////////////////////////////////		STRUCT_T
+
+
+
+
+STRUCT_T::~STRUCT_T(){
+	QUARK_ASSERT(check_invariant());
+}
+
+bool STRUCT_T::check_invariant() const {
+	QUARK_ASSERT(this->alloc.check_invariant());
+	return true;
+}
+
+STRUCT_T* alloc_struct(heap_t& heap, std::size_t size){
+	const auto allocation_count = size_to_allocation_blocks(size);
+
+	heap_alloc_64_t* alloc = alloc_64(heap, allocation_count);
+	alloc->debug_info[0] = 'S';
+	alloc->debug_info[1] = 'T';
+	alloc->debug_info[2] = 'R';
+	alloc->debug_info[3] = 'U';
+	alloc->debug_info[4] = 'C';
+	alloc->debug_info[5] = 'T';
+
+	auto vec = reinterpret_cast<STRUCT_T*>(alloc);
+	return vec;
+}
+
+void dispose_struct(STRUCT_T& s){
+	QUARK_ASSERT(s.check_invariant());
+
+	auto& heap = *s.alloc.heap64;
+	dispose_alloc(s.alloc);
+
+	QUARK_ASSERT(heap.check_invariant());
+}
+
+
+
+WIDE_RETURN_T make_wide_return_structptr(STRUCT_T* s){
+	return WIDE_RETURN_T{ { .struct_ptr = s }, { .int_value = 0 } };
+}
+
+STRUCT_T* wide_return_to_struct(const WIDE_RETURN_T& ret){
+	return ret.a.struct_ptr;
+}
+
+
+
+
+
+bool is_rc_value(const typeid_t& type){
+	return type.is_string() || type.is_vector() || type.is_dict() || type.is_struct() || type.is_json_value();
+}
+
+
+
+
+
+
+
+
+
+
+// IMPORTANT: Different types will access different number of bytes, for example a BYTE. We cannot dereference pointer as a uint64*!!
+runtime_value_t load_via_ptr2(const void* value_ptr, const typeid_t& type){
+	QUARK_ASSERT(value_ptr != nullptr);
+	QUARK_ASSERT(type.check_invariant());
+
+	struct visitor_t {
+		const void* value_ptr;
+
+		runtime_value_t operator()(const typeid_t::undefined_t& e) const{
+			UNSUPPORTED();
+		}
+		runtime_value_t operator()(const typeid_t::any_t& e) const{
+			UNSUPPORTED();
+		}
+
+		runtime_value_t operator()(const typeid_t::void_t& e) const{
+			UNSUPPORTED();
+		}
+		runtime_value_t operator()(const typeid_t::bool_t& e) const{
+			const auto temp = *static_cast<const uint8_t*>(value_ptr);
+			return runtime_value_t{ .bool_value = temp };
+		}
+		runtime_value_t operator()(const typeid_t::int_t& e) const{
+			const auto temp = *static_cast<const uint64_t*>(value_ptr);
+			return make_runtime_int(temp);
+		}
+		runtime_value_t operator()(const typeid_t::double_t& e) const{
+			const auto temp = *static_cast<const double*>(value_ptr);
+			return runtime_value_t{ .double_value = temp };
+		}
+		runtime_value_t operator()(const typeid_t::string_t& e) const{
+			return *static_cast<const runtime_value_t*>(value_ptr);
+		}
+
+		runtime_value_t operator()(const typeid_t::json_type_t& e) const{
+			return *static_cast<const runtime_value_t*>(value_ptr);
+		}
+		runtime_value_t operator()(const typeid_t::typeid_type_t& e) const{
+			const auto value = *static_cast<const int32_t*>(value_ptr);
+			return runtime_value_t{ .typeid_itype = value };
+		}
+
+		runtime_value_t operator()(const typeid_t::struct_t& e) const{
+			STRUCT_T* struct_ptr = *reinterpret_cast<STRUCT_T* const *>(value_ptr);
+			return make_runtime_struct(struct_ptr);
+		}
+		runtime_value_t operator()(const typeid_t::vector_t& e) const{
+			return *static_cast<const runtime_value_t*>(value_ptr);
+		}
+		runtime_value_t operator()(const typeid_t::dict_t& e) const{
+			return *static_cast<const runtime_value_t*>(value_ptr);
+		}
+		runtime_value_t operator()(const typeid_t::function_t& e) const{
+			return *static_cast<const runtime_value_t*>(value_ptr);
+		}
+		runtime_value_t operator()(const typeid_t::unresolved_t& e) const{
+			UNSUPPORTED();
+		}
+	};
+	return std::visit(visitor_t{ value_ptr }, type._contents);
+}
+
+// IMPORTANT: Different types will access different number of bytes, for example a BYTE. We cannot dereference pointer as a uint64*!!
+void store_via_ptr2(void* value_ptr, const typeid_t& type, const runtime_value_t& value){
+	struct visitor_t {
+		void* value_ptr;
+		const runtime_value_t& value;
+
+		void operator()(const typeid_t::undefined_t& e) const{
+			UNSUPPORTED();
+		}
+		void operator()(const typeid_t::any_t& e) const{
+			UNSUPPORTED();
+		}
+
+		void operator()(const typeid_t::void_t& e) const{
+			UNSUPPORTED();
+		}
+		void operator()(const typeid_t::bool_t& e) const{
+			*static_cast<uint8_t*>(value_ptr) = value.bool_value;
+		}
+		void operator()(const typeid_t::int_t& e) const{
+			*(int64_t*)value_ptr = value.int_value;
+		}
+		void operator()(const typeid_t::double_t& e) const{
+			*static_cast<double*>(value_ptr) = value.double_value;
+		}
+		void operator()(const typeid_t::string_t& e) const{
+			*static_cast<runtime_value_t*>(value_ptr) = value;
+		}
+
+		void operator()(const typeid_t::json_type_t& e) const{
+			*static_cast<runtime_value_t*>(value_ptr) = value;
+		}
+		void operator()(const typeid_t::typeid_type_t& e) const{
+			*static_cast<int32_t*>(value_ptr) = value.typeid_itype;
+		}
+
+		void operator()(const typeid_t::struct_t& e) const{
+			*reinterpret_cast<STRUCT_T**>(value_ptr) = value.struct_ptr;
+		}
+		void operator()(const typeid_t::vector_t& e) const{
+			*static_cast<runtime_value_t*>(value_ptr) = value;
+		}
+		void operator()(const typeid_t::dict_t& e) const{
+			*static_cast<runtime_value_t*>(value_ptr) = value;
+		}
+		void operator()(const typeid_t::function_t& e) const{
+			*static_cast<runtime_value_t*>(value_ptr) = value;
+		}
+		void operator()(const typeid_t::unresolved_t& e) const{
+			UNSUPPORTED();
+		}
+	};
+	std::visit(visitor_t{ value_ptr, value }, type._contents);
+}
+
+
+}	//	floyd
@@ -0,0 +1,553 @@
+//
+//  floyd_llvm_heap.h
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-04-16.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#ifndef floyd_llvm_heap_hpp
+#define floyd_llvm_heap_hpp
+
+/*
+	The heap and the values the generated code and the runtime pass between them. Nothing here needs LLVM: the
+	runtime library that native executables link with uses it too, see floyd_llvm_runtime.h.
+*/
+
+#include "ast_typeid.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct json_t;
+
+namespace floyd {
+
+struct VEC_T;
+struct DICT_T;
+struct JSON_T;
+struct STRUCT_T;
+struct type_interner_t;
+
+
+
+////////////////////////////////		heap_t
+
+/*
+	Why: we need out own memory heap handling for:
+	- Having a unified memory handler / RC / GC / arena.
+	- Running separate heaps for separate threads / process
+	- Tracking stats and heat maps
+	- Finding problems.
+	- Reducing the number of mallocs - by putting head and body into the same alloc.
+	- Fitting data tighter than malloc()
+	- Controlling alignment and letting us address allocations more effectively than 64 bit pointers.
+	- Support never reusing the same allocation pointer/ID.
+
+	The blocks come from per-thread slabs of fixed size blocks, see floyd_llvm_slab.h.
+
+	Allocating and freeing are O(1) and take no lock, so many threads can share one heap. The heap only keeps a count
+	of live allocations, which is enough for detect_leaks(). To find out *which* allocations leak, construct the heap
+	with record_allocs = true (or set k_heap_record_allocs): it then keeps a record of every allocation, never frees
+	the blocks and trace_heap() lists them. This is slow and uses a lock -- use it for debugging only.
+*/
+
+
+struct heap_t;
+
+static const uint64_t ALLOC_64_MAGIC = 0xa110a11c;
+
+//	This header is followed by a number of uint64_t elements in the same heap block.
+//	This header represents a sharepoint of many clients and holds an RC to count clients.
+//	If you want to change the size of the allocation, allocate 0 following elements and make separate dynamic allocation and stuff its pointer into data1.
+//	Designed to be 64 bytes = 1 cacheline.
+struct heap_alloc_64_t {
+//	public: virtual ~heap_alloc_64_t(){};
+	public: bool check_invariant() const;
+
+
+	////////////////////////////////		STATE
+	uint64_t allocation_word_count;
+
+	std::atomic<int32_t> rc;
+	uint32_t magic;
+
+	//	 data_*: 3 x 8 bytes.
+	uint64_t data_a;
+	uint64_t data_b;
+	uint64_t data_c;
+
+	heap_t* heap64;
+	char debug_info[16];
+};
+
+//	Generated code changes rc directly, see generate_retain().
+static const int k_heap_alloc_64_rc_offset = 8;
+
+struct heap_rec_t {
+	heap_alloc_64_t* alloc_ptr;
+//	bool in_use;
+};
+
+static const uint64_t HEAP_MAGIC = 0xf00d1234;
+
+//	Default for heaps that don't say. Turn on to track down leaks.
+const bool k_heap_record_allocs = false;
+
+struct heap_t {
+	heap_t() :
+		heap_t(k_heap_record_allocs)
+	{
+	}
+	explicit heap_t(bool record_allocs) :
+		magic(HEAP_MAGIC),
+		alloc_count(0),
+		record_allocs(record_allocs)
+	{
+		if(record_allocs){
+			alloc_records_mutex = std::make_shared<std::mutex>();
+		}
+	}
+
+	//	Only move a heap before allocating from it: each allocation points to its heap.
+	heap_t(heap_t&& other) :
+		magic(other.magic),
+		alloc_count(other.alloc_count.load()),
+		record_allocs(other.record_allocs),
+		alloc_records_mutex(other.alloc_records_mutex),
+		alloc_records(std::move(other.alloc_records))
+	{
+		QUARK_ASSERT(alloc_count == 0);
+	}
+	~heap_t();
+	public: bool check_invariant() const;
+
+	//	Number of allocations that have not been disposed.
+	public: int count_used() const;
+
+
+	////////////////////////////////		STATE
+	uint64_t magic;
+	std::atomic<int64_t> alloc_count;
+
+	//	Only used when record_allocs is true.
+	bool record_allocs;
+	std::shared_ptr<std::mutex> alloc_records_mutex;
+	std::vector<heap_rec_t> alloc_records;
+};
+
+/*
+	Allocates a block of data using slab_alloc().
+
+	It consists of two parts: the header and the dynamic elements.
+
+	Header:
+		64 byte header with reference counter and possibility to store custom data.
+	Dynamic elements: N number of 8 byte elements.
+
+	Pointer is always aligned to 8 or 16 bytes.
+	Returned alloc has RC = 1
+	The allocation is counted by the heap_t, and recorded if the heap records allocations.
+	Only delete the block using release_ref(), never std::free() or c++ delete.
+
+	When the heap records allocations we never actually free the heap blocks, we keep them around for debugging.
+*/
+heap_alloc_64_t* alloc_64(heap_t& heap, uint64_t allocation_word_count);
+
+//	Returns pointer to the allocated words that sits after the
+void* get_alloc_ptr(heap_alloc_64_t& alloc);
+const void* get_alloc_ptr(const heap_alloc_64_t& alloc);
+void add_ref(heap_alloc_64_t& alloc);
+void release_ref(heap_alloc_64_t& alloc);
+
+//	Lists the recorded allocations. Does nothing unless the heap records allocations.
+void trace_heap(const heap_t& heap);
+void detect_leaks(const heap_t& heap);
+
+uint64_t size_to_allocation_blocks(std::size_t size);
+
+//	Returns updated RC, no need to atomically read it yourself.
+//	If returned RC is 0, there is no way for any other client to bump it up again.
+int32_t dec_rc(heap_alloc_64_t& alloc);
+int32_t inc_rc(heap_alloc_64_t& alloc);
+
+void dispose_alloc(heap_alloc_64_t& alloc);
+
+
+
+
+////////////////////////////////	runtime_type_t
+
+/*
+	An integer that specifies a unique type a type interner. Use this to specify types in running program.
+	Avoid using floyd::typeid_t
+*/
+
+typedef int64_t runtime_type_t;
+
+
+runtime_type_t make_runtime_type(int32_t itype);
+
+
+base_type get_base_type(const type_interner_t& interner, const runtime_type_t& type);
+
+const typeid_t& lookup_type(const type_interner_t& interner, const runtime_type_t& type);
+runtime_type_t lookup_runtime_type(const type_interner_t& interner, const typeid_t& type);
+
+
+
+
+////////////////////////////////	native_value_t
+
+
+/*
+	Native, runtime value, as used by x86 code when running optimized program. Executing.
+	Usually this is a 64 bit value that holds either an integer / double etc OR a pointer to a separate allocation.
+
+	Future: these can have different sizes. A vector can use SSO and embedd head + some body directly here.
+*/
+
+//	64 bits
+union runtime_value_t {
+	uint8_t bool_value;
+	int64_t int_value;
+	runtime_type_t typeid_itype;
+	double double_value;
+
+	//	Strings are encoded as VEC_T:s
+//	char* string_ptr;
+
+	VEC_T* vector_ptr;
+	DICT_T* dict_ptr;
+	JSON_T* json_ptr;
+	STRUCT_T* struct_ptr;
+	void* function_ptr;
+
+	bool check_invariant() const {
+		return true;
+	}
+};
+
+
+
+runtime_value_t make_blank_runtime_value();
+
+runtime_value_t make_runtime_bool(bool value);
+runtime_value_t make_runtime_int(int64_t value);
+runtime_value_t make_runtime_typeid(runtime_type_t type);
+runtime_value_t make_runtime_struct(STRUCT_T* struct_ptr);
+
+char* get_vec_chars(runtime_value_t str);
+uint64_t get_vec_string_size(runtime_value_t str);
+
+VEC_T* unpack_vec_arg(const type_interner_t& types, runtime_value_t arg_value, runtime_type_t arg_type);
+DICT_T* unpack_dict_arg(const type_interner_t& types, runtime_value_t arg_value, runtime_type_t arg_type);
+
+
+
+
+
+
+
+
+
+
+////////////////////////////////	floyd_runtime_ptr
+
+
+/*
+	The Floyd runtime doesn't use global variables at all. Not even for memory heaps etc.
+	Instead it passes around an invisible argumen to all functions, called Floyd Runtime Ptr (FRP).
+*/
+
+struct floyd_runtime_t {
+};
+
+////////////////////////////////		WIDE_RETURN_T
+
+
+//	Used to return structs and bigger chunks of data from LLVM functions.
+//	Can only be two members in LLVM struct, each a word wide.
+
+
+//	### Also use for arguments, not only return.
+struct WIDE_RETURN_T {
+	runtime_value_t a;
+	runtime_value_t b;
+};
+
+enum class WIDE_RETURN_MEMBERS {
+	a = 0,
+	b = 1
+};
+
+WIDE_RETURN_T make_wide_return_2x64(runtime_value_t a, runtime_value_t b);
+inline WIDE_RETURN_T make_wide_return_1x64(runtime_value_t a){
+	return make_wide_return_2x64(a, make_blank_runtime_value());
+}
+WIDE_RETURN_T make_wide_return_structptr(STRUCT_T* s);
+
+
+
+
+////////////////////////////////		VEC_T
+
+
+/*
+	Vectors
+
+	Encoded in LLVM as one 16 byte struct, VEC_T by value.
+
+	- Vector instance is a 16 byte struct.
+	- No RC or shared state -- always copied fully.
+	- Mutation = copy entire vector every time.
+
+	- The runtime handles all vectors as std::vector<uint64_t>. You need to pack and address other types of data manually.
+
+	Invariant:
+		alloc_count = roundup(element_count * element_bits, 64) / 64
+
+	Store element count in data_a.
+
+	With vector_backend::k_hamt, [T] vectors have no elements after the header, only data_b and data_c, see
+	floyd_llvm_hamt.h. get_element_ptr() and operator[] are then meaningless.
+*/
+struct VEC_T {
+	~VEC_T();
+	bool check_invariant() const;
+
+	inline uint64_t get_allocation_count() const{
+		QUARK_ASSERT(check_invariant());
+
+		return alloc.allocation_word_count;
+	}
+
+	inline uint64_t get_element_count() const{
+		QUARK_ASSERT(check_invariant());
+
+		return alloc.data_a;
+	}
+
+	inline const runtime_value_t* get_element_ptr() const{
+		QUARK_ASSERT(check_invariant());
+
+		auto p = static_cast<const runtime_value_t*>(get_alloc_ptr(alloc));
+		return p;
+	}
+	inline runtime_value_t* get_element_ptr(){
+		QUARK_ASSERT(check_invariant());
+
+		auto p = static_cast<runtime_value_t*>(get_alloc_ptr(alloc));
+		return p;
+	}
+
+	inline runtime_value_t operator[](const uint64_t index) const {
+		QUARK_ASSERT(check_invariant());
+
+		auto p = static_cast<const runtime_value_t*>(get_alloc_ptr(alloc));
+		return p[index];
+	}
+
+
+	////////////////////////////////		STATE
+	heap_alloc_64_t alloc;
+};
+
+VEC_T* alloc_vec(heap_t& heap, uint64_t allocation_count, uint64_t element_count);
+void dispose_vec(VEC_T& vec);
+
+
+//	How [T] vectors are stored. Strings are always k_carray. The code generator and the runtime must agree, so the
+//	choice is kept in llvm_type_interner_t and in the execution engine, see is_vector_hamt().
+enum class vector_backend {
+	//	The elements follow the VEC_T header, in the same heap block. Lookups are one load, but update() and subset()
+	//	copy all the elements.
+	k_carray,
+
+	//	The VEC_T header points to a persistent trie of the elements, see floyd_llvm_hamt.h. update(), push_back() and
+	//	subset() share all but about log32(n) blocks with the old vector. Lookups walk the trie.
+	k_hamt
+};
+
+//	"carray" or "hamt", like in the --vector-backend command line flag. Throws on anything else.
+vector_backend parse_vector_backend(const std::string& s);
+std::string vector_backend_to_string(vector_backend backend);
+
+//	True if values of this type are VEC_T:s with a trie instead of a carray.
+inline bool is_vector_hamt(vector_backend vectors, const typeid_t& type){
+	return type.is_vector() && vectors == vector_backend::k_hamt;
+}
+
+WIDE_RETURN_T make_wide_return_vec(VEC_T* vec);
+VEC_T* wide_return_to_vec(const WIDE_RETURN_T& ret);
+
+
+
+
+////////////////////////////////		DICT_T
+
+
+
+/*
+	A hash table with open addressing and linear probing, keyed by Floyd strings.
+
+	alloc.data_a: element count.
+	alloc.data_b: the table, a heap_t block with get_capacity() dict_entry_t:s. nullptr until the first store.
+	alloc.data_c: capacity, a power of two. The table grows when it gets 3/4 full.
+
+	- The keys are the runtime strings themselves, so lookups hash and compare their chars without converting them to
+		std::string. The dict owns an RC of each key.
+	- Each entry keeps its key's hash. Probing compares hashes before chars and growing the table doesn't rehash.
+	- The dict doesn't retain or release the values: only the runtime knows their type.
+	- The entries are in no particular order.
+*/
+
+struct dict_entry_t {
+	uint64_t hash;
+
+	//	nullptr = empty slot.
+	VEC_T* key;
+
+	runtime_value_t value;
+};
+
+struct DICT_T {
+	bool check_invariant() const;
+	uint64_t size() const;
+
+	uint64_t get_capacity() const {
+		return alloc.data_c;
+	}
+	const dict_entry_t* get_entries() const {
+		return alloc.data_b != 0 ? static_cast<const dict_entry_t*>(get_alloc_ptr(*reinterpret_cast<const heap_alloc_64_t*>(alloc.data_b))) : nullptr;
+	}
+	dict_entry_t* get_entries(){
+		return alloc.data_b != 0 ? static_cast<dict_entry_t*>(get_alloc_ptr(*reinterpret_cast<heap_alloc_64_t*>(alloc.data_b))) : nullptr;
+	}
+
+
+	////////////////////////////////		STATE
+	heap_alloc_64_t alloc;
+};
+
+DICT_T* alloc_dict(heap_t& heap);
+
+//	Releases the keys, not the values.
+void dispose_dict(DICT_T& vec);
+
+uint64_t hash_dict_key(const char s[], uint64_t size);
+
+//	key is a string. nullptr if the dict doesn't have it.
+const dict_entry_t* find_dict_entry(const DICT_T& dict, runtime_value_t key);
+
+//	Adds key or replaces its value. Retains key if it is new. Doesn't retain value or release the value it replaces.
+void store_dict_value(DICT_T& dict, runtime_value_t key, runtime_value_t value);
+
+//	Releases the key, not the value. Returns false if the dict didn't have key.
+bool erase_dict_value(DICT_T& dict, runtime_value_t key);
+
+//	A new dict with the same keys and values. Retains the keys, not the values.
+DICT_T* copy_dict(heap_t& heap, const DICT_T& dict);
+
+template <typename F> void for_each_dict_entry(const DICT_T& dict, F f){
+	const auto entries = dict.get_entries();
+	for(uint64_t i = 0 ; i < dict.get_capacity() ; i++){
+		if(entries[i].key != nullptr){
+			f(entries[i]);
+		}
+	}
+}
+
+WIDE_RETURN_T make_wide_return_dict(DICT_T* dict);
+DICT_T* wide_return_to_dict(const WIDE_RETURN_T& ret);
+
+
+
+
+
+////////////////////////////////		JSON_T
+
+
+/*
+	Store a json_t* in data_a. It need to be new/deletes via C++.
+*/
+
+typedef std::map<std::string, runtime_value_t> STDMAP;
+
+struct JSON_T {
+	bool check_invariant() const;
+
+	const json_t& get_json() const {
+		return *reinterpret_cast<const json_t*>(alloc.data_a);
+	}
+
+
+	////////////////////////////////		STATE
+	heap_alloc_64_t alloc;
+};
+
+JSON_T* alloc_json(heap_t& heap, const json_t& init);
+void dispose_json(JSON_T& vec);
+
+
+
+
+////////////////////////////////		STRUCT_T
+
+
+struct STRUCT_T {
+	~STRUCT_T();
+	bool check_invariant() const;
+
+	inline const uint8_t* get_data_ptr() const{
+		QUARK_ASSERT(check_invariant());
+
+		auto p = static_cast<const uint8_t*>(get_alloc_ptr(alloc));
+		return p;
+	}
+	inline uint8_t* get_data_ptr(){
+		QUARK_ASSERT(check_invariant());
+
+		auto p = static_cast<uint8_t*>(get_alloc_ptr(alloc));
+		return p;
+	}
+
+
+
+	////////////////////////////////		STATE
+	heap_alloc_64_t alloc;
+};
+
+STRUCT_T* alloc_struct(heap_t& heap, std::size_t size);
+void dispose_struct(STRUCT_T& v);
+
+WIDE_RETURN_T make_wide_return_struct(STRUCT_T* v);
+STRUCT_T* wide_return_to_struct(const WIDE_RETURN_T& ret);
+
+
+
+bool is_rc_value(const typeid_t& type);
+
+
+/*
+	floyd			C++			runtime_value_t			native func arg/return
+	--------------------------------------------------------------------------------------------------------------------
+	bool			bool		uint8					uint1
+	int							int64_t					int64
+	string			string		char*					char*
+	vector[T]		vector<T>	VEC_T*					VEC_T*
+	json_t			json_t		json_t*					int16*
+*/
+
+
+
+runtime_value_t load_via_ptr2(const void* value_ptr, const typeid_t& type);
+void store_via_ptr2(void* value_ptr, const typeid_t& type, const runtime_value_t& value);
+
+
+}	//	floyd
+
+#endif /* floyd_llvm_heap_hpp */
@@ -9,210 +9,24 @@
 #ifndef floyd_llvm_helpers_hpp
 #define floyd_llvm_helpers_hpp
 
+#include "floyd_llvm_heap.h"
 #include "ast_typeid.h"
 #include "ast.h"
 #include <llvm/IR/Function.h>
 #include <llvm/IR/IRBuilder.h>
 
-#include <atomic>
-
-struct json_t;
-
 namespace floyd {
 
-struct VEC_T;
-struct DICT_T;
-struct JSON_T;
-struct STRUCT_T;
-struct type_interner_t;
 struct llvm_type_interner_t;
 
 
 
-////////////////////////////////		heap_t
-
-/*
-	Why: we need out own memory heap handling for:
-	- Having a unified memory handler / RC / GC / arena.
-	- Running separate heaps for separate threads / process
-	- Tracking stats and heat maps
-	- Finding problems.
-	- Reducing the number of mallocs - by putting head and body into the same alloc.
-	- Fitting data tighter than malloc()
-	- Controlling alignment and letting us address allocations more effectively than 64 bit pointers.
-	- Support never reusing the same allocation pointer/ID.
-
-	NOTICE: Right now each alloc is made using malloc(). In the future we can switch to private heap / arena / pooling.
-*/
-
-
-struct heap_t;
-
-static const uint64_t ALLOC_64_MAGIC = 0xa110a11c;
-
-//	This header is followed by a number of uint64_t elements in the same heap block.
-//	This header represents a sharepoint of many clients and holds an RC to count clients.
-//	If you want to change the size of the allocation, allocate 0 following elements and make separate dynamic allocation and stuff its pointer into data1.
-//	Designed to be 64 bytes = 1 cacheline.
-struct heap_alloc_64_t {
-//	public: virtual ~heap_alloc_64_t(){};
-	public: bool check_invariant() const;
-
-
-	////////////////////////////////		STATE
-	uint64_t allocation_word_count;
-
-	std::atomic<int32_t> rc;
-	uint32_t magic;
-
-	//	 data_*: 3 x 8 bytes.
-	uint64_t data_a;
-	uint64_t data_b;
-	uint64_t data_c;
-
-	heap_t* heap64;
-	char debug_info[16];
-};
-
-struct heap_rec_t {
-	heap_alloc_64_t* alloc_ptr;
-//	bool in_use;
-};
-
-static const uint64_t HEAP_MAGIC = 0xf00d1234;
-
-struct heap_t {
-	heap_t() :
-		magic(0xf00d1234)
-	{
-		alloc_records_mutex = std::make_shared<std::recursive_mutex>();
-	}
-	~heap_t();
-	public: bool check_invariant() const;
-	public: int count_used() const;
-
-
-	////////////////////////////////		STATE
-	uint64_t magic;
-	std::shared_ptr<std::recursive_mutex> alloc_records_mutex;
-	std::vector<heap_rec_t> alloc_records;
-};
-
-/*
-	Allocates a block of data using malloc().
-
-	It consists of two parts: the header and the dynamic elements.
-
-	Header:
-		64 byte header with reference counter and possibility to store custom data.
-	Dynamic elements: N number of 8 byte elements.
-
-	Pointer is always aligned to 8 or 16 bytes.
-	Returned alloc has RC = 1
-	The allocation is recorded into the heap_t.
-	Only delete the block using release_ref(), never std::free() or c++ delete.
-
-	DEBUG VERSION: We never actually free the heap blocks, we keep them around for debugging.
-*/
-heap_alloc_64_t* alloc_64(heap_t& heap, uint64_t allocation_word_count);
-
-//	Returns pointer to the allocated words that sits after the
-void* get_alloc_ptr(heap_alloc_64_t& alloc);
-const void* get_alloc_ptr(const heap_alloc_64_t& alloc);
-void add_ref(heap_alloc_64_t& alloc);
-void release_ref(heap_alloc_64_t& alloc);
-
-void trace_heap(const heap_t& heap);
-void detect_leaks(const heap_t& heap);
-
-uint64_t size_to_allocation_blocks(std::size_t size);
-
-//	Returns updated RC, no need to atomically read it yourself.
-//	If returned RC is 0, there is no way for any other client to bump it up again.
-int32_t dec_rc(heap_alloc_64_t& alloc);
-int32_t inc_rc(heap_alloc_64_t& alloc);
-
-void dispose_alloc(heap_alloc_64_t& alloc);
-
+////////////////////////////////	runtime_type_t, runtime_value_t
 
 
-
-////////////////////////////////	runtime_type_t
-
-/*
-	An integer that specifies a unique type a type interner. Use this to specify types in running program.
-	Avoid using floyd::typeid_t
-*/
-
-typedef int64_t runtime_type_t;
-
 llvm::Type* make_runtime_type_type(llvm::LLVMContext& context);
-
-runtime_type_t make_runtime_type(int32_t itype);
-
-
-base_type get_base_type(const type_interner_t& interner, const runtime_type_t& type);
-
-typeid_t lookup_type(const type_interner_t& interner, const runtime_type_t& type);
-runtime_type_t lookup_runtime_type(const type_interner_t& interner, const typeid_t& type);
-
-
-
-
-////////////////////////////////	native_value_t
-
-
-/*
-	Native, runtime value, as used by x86 code when running optimized program. Executing.
-	Usually this is a 64 bit value that holds either an integer / double etc OR a pointer to a separate allocation.
-
-	Future: these can have different sizes. A vector can use SSO and embedd head + some body directly here.
-*/
-
-//	64 bits
-union runtime_value_t {
-	uint8_t bool_value;
-	int64_t int_value;
-	runtime_type_t typeid_itype;
-	double double_value;
-
-	//	Strings are encoded as VEC_T:s
-//	char* string_ptr;
-
-	VEC_T* vector_ptr;
-	DICT_T* dict_ptr;
-	JSON_T* json_ptr;
-	STRUCT_T* struct_ptr;
-	void* function_ptr;
-
-	bool check_invariant() const {
-		return true;
-	}
-};
-
-
 llvm::Type* make_runtime_value_type(llvm::LLVMContext& context);
 
-runtime_value_t make_blank_runtime_value();
-
-runtime_value_t make_runtime_bool(bool value);
-runtime_value_t make_runtime_int(int64_t value);
-runtime_value_t make_runtime_typeid(runtime_type_t type);
-runtime_value_t make_runtime_struct(STRUCT_T* struct_ptr);
-
-char* get_vec_chars(runtime_value_t str);
-uint64_t get_vec_string_size(runtime_value_t str);
-
-VEC_T* unpack_vec_arg(const type_interner_t& types, runtime_value_t arg_value, runtime_type_t arg_type);
-DICT_T* unpack_dict_arg(const type_interner_t& types, runtime_value_t arg_value, runtime_type_t arg_type);
-
-
-
-
-
-
-
-
 
 
 //	Must LLVMContext be kept while using the execution engine? Yes!
@@ -262,15 +76,6 @@ std::string print_value(llvm::Value* value);
 
 ////////////////////////////////	floyd_runtime_ptr
 
-
-/*
-	The Floyd runtime doesn't use global variables at all. Not even for memory heaps etc.
-	Instead it passes around an invisible argumen to all functions, called Floyd Runtime Ptr (FRP).
-*/
-
-struct floyd_runtime_t {
-};
-
 //	This pointer is passed as argument 0 to all compiled floyd functions and all runtime functions.
 
 bool check_callers_fcp(const llvm_type_interner_t& interner, llvm::Function& emit_f);
@@ -280,199 +85,6 @@ llvm::Type* make_frp_type(const llvm_type_interner_t& interner);
 
 
 
-////////////////////////////////		WIDE_RETURN_T
-
-
-//	Used to return structs and bigger chunks of data from LLVM functions.
-//	Can only be two members in LLVM struct, each a word wide.
-
-
-//	### Also use for arguments, not only return.
-struct WIDE_RETURN_T {
-	runtime_value_t a;
-	runtime_value_t b;
-};
-
-enum class WIDE_RETURN_MEMBERS {
-	a = 0,
-	b = 1
-};
-
-WIDE_RETURN_T make_wide_return_2x64(runtime_value_t a, runtime_value_t b);
-inline WIDE_RETURN_T make_wide_return_1x64(runtime_value_t a){
-	return make_wide_return_2x64(a, make_blank_runtime_value());
-}
-WIDE_RETURN_T make_wide_return_structptr(STRUCT_T* s);
-
-
-
-
-////////////////////////////////		VEC_T
-
-
-/*
-	Vectors
-
-	Encoded in LLVM as one 16 byte struct, VEC_T by value.
-
-	- Vector instance is a 16 byte struct.
-	- No RC or shared state -- always copied fully.
-	- Mutation = copy entire vector every time.
-
-	- The runtime handles all vectors as std::vector<uint64_t>. You need to pack and address other types of data manually.
-
-	Invariant:
-		alloc_count = roundup(element_count * element_bits, 64) / 64
-
-	Store element count in data_a.
-*/
-struct VEC_T {
-	~VEC_T();
-	bool check_invariant() const;
-
-	inline uint64_t get_allocation_count() const{
-		QUARK_ASSERT(check_invariant());
-
-		return alloc.allocation_word_count;
-	}
-
-	inline uint64_t get_element_count() const{
-		QUARK_ASSERT(check_invariant());
-
-		return alloc.data_a;
-	}
-
-	inline const runtime_value_t* get_element_ptr() const{
-		QUARK_ASSERT(check_invariant());
-
-		auto p = static_cast<const runtime_value_t*>(get_alloc_ptr(alloc));
-		return p;
-	}
-	inline runtime_value_t* get_element_ptr(){
-		QUARK_ASSERT(check_invariant());
-
-		auto p = static_cast<runtime_value_t*>(get_alloc_ptr(alloc));
-		return p;
-	}
-
-	inline runtime_value_t operator[](const uint64_t index) const {
-		QUARK_ASSERT(check_invariant());
-
-		auto p = static_cast<const runtime_value_t*>(get_alloc_ptr(alloc));
-		return p[index];
-	}
-
-
-	////////////////////////////////		STATE
-	heap_alloc_64_t alloc;
-};
-
-VEC_T* alloc_vec(heap_t& heap, uint64_t allocation_count, uint64_t element_count);
-void dispose_vec(VEC_T& vec);
-
-WIDE_RETURN_T make_wide_return_vec(VEC_T* vec);
-VEC_T* wide_return_to_vec(const WIDE_RETURN_T& ret);
-
-
-
-
-////////////////////////////////		DICT_T
-
-
-
-/*
-	A std::map<> is stored inplace into alloc.data_a / alloc.data_b / alloc.data-c.
-*/
-
-typedef std::map<std::string, runtime_value_t> STDMAP;
-
-struct DICT_T {
-	bool check_invariant() const;
-	uint64_t size() const;
-
-	const STDMAP& get_map() const {
-		return *reinterpret_cast<const STDMAP*>(&alloc.data_a);
-	}
-	STDMAP& get_map_mut(){
-		return *reinterpret_cast<STDMAP*>(&alloc.data_a);
-	}
-
-
-	////////////////////////////////		STATE
-	heap_alloc_64_t alloc;
-};
-
-DICT_T* alloc_dict(heap_t& heap);
-void dispose_dict(DICT_T& vec);
-
-WIDE_RETURN_T make_wide_return_dict(DICT_T* dict);
-DICT_T* wide_return_to_dict(const WIDE_RETURN_T& ret);
-
-
-
-
-
-////////////////////////////////		JSON_T
-
-
-/*
-	Store a json_t* in data_a. It need to be new/deletes via C++.
-*/
-
-typedef std::map<std::string, runtime_value_t> STDMAP;
-
-struct JSON_T {
-	bool check_invariant() const;
-
-	const json_t& get_json() const {
-		return *reinterpret_cast<const json_t*>(alloc.data_a);
-	}
-
-
-	////////////////////////////////		STATE
-	heap_alloc_64_t alloc;
-};
-
-JSON_T* alloc_json(heap_t& heap, const json_t& init);
-void dispose_json(JSON_T& vec);
-
-
-
-
-////////////////////////////////		STRUCT_T
-
-
-struct STRUCT_T {
-	~STRUCT_T();
-	bool check_invariant() const;
-
-	inline const uint8_t* get_data_ptr() const{
-		QUARK_ASSERT(check_invariant());
-
-		auto p = static_cast<const uint8_t*>(get_alloc_ptr(alloc));
-		return p;
-	}
-	inline uint8_t* get_data_ptr(){
-		QUARK_ASSERT(check_invariant());
-
-		auto p = static_cast<uint8_t*>(get_alloc_ptr(alloc));
-		return p;
-	}
-
-
-
-	////////////////////////////////		STATE
-	heap_alloc_64_t alloc;
-};
-
-STRUCT_T* alloc_struct(heap_t& heap, std::size_t size);
-void dispose_struct(STRUCT_T& v);
-
-WIDE_RETURN_T make_wide_return_struct(STRUCT_T* v);
-STRUCT_T* wide_return_to_struct(const WIDE_RETURN_T& ret);
-
-
-
 //llvm::StructType* make_exact_struct_type(llvm::LLVMContext& context, const llvm_type_interner_t& interner, const typeid_t& type);
 
 
@@ -527,7 +139,7 @@ llvm::GlobalVariable* generate_global0(llvm::Module& module, const std::string&
 */
 
 struct llvm_type_interner_t {
-	llvm_type_interner_t(llvm::LLVMContext& context, const type_interner_t& interner);
+	llvm_type_interner_t(llvm::LLVMContext& context, const type_interner_t& interner, vector_backend vectors = vector_backend::k_carray);
 	bool check_invariant() const;
 
 
@@ -542,8 +154,15 @@ struct llvm_type_interner_t {
 	llvm::StructType* generic_struct_type;
 	llvm::StructType* wide_return_type;
 	llvm::Type* runtime_ptr_type;
+
+	vector_backend vectors;
 };
 
+//	True if values of this type are VEC_T:s with a trie instead of a carray.
+inline bool is_vector_hamt(const llvm_type_interner_t& interner, const typeid_t& type){
+	return is_vector_hamt(interner.vectors, type);
+}
+
 //	Returns the LLVM type used to pass this type of value around. It uses generic types for vector, dict and struct.
 llvm::Type* get_exact_llvm_type(const llvm_type_interner_t& interner, const typeid_t& type);
 
@@ -562,23 +181,6 @@ llvm::Type* get_generic_struct_type(const llvm_type_interner_t& interner);
 llvm::Type* make_function_type(const llvm_type_interner_t& interner, const typeid_t& function_type);
 
 
-bool is_rc_value(const typeid_t& type);
-
-
-/*
-	floyd			C++			runtime_value_t			native func arg/return
-	--------------------------------------------------------------------------------------------------------------------
-	bool			bool		uint8					uint1
-	int							int64_t					int64
-	string			string		char*					char*
-	vector[T]		vector<T>	VEC_T*					VEC_T*
-	json_t			json_t		json_t*					int16*
-*/
-
-
-
-runtime_value_t load_via_ptr2(const void* value_ptr, const typeid_t& type);
-void store_via_ptr2(void* value_ptr, const typeid_t& type, const runtime_value_t& value);
 
 //	Converts the LLVM value into a uint64_t for storing vector, pass as DYN value.
 llvm::Value* generate_cast_to_runtime_value2(llvm::IRBuilder<>& builder, llvm::Value& value, const typeid_t& floyd_type);
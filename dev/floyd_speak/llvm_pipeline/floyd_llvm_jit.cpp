@@ -0,0 +1,713 @@
+//
+//  floyd_llvm_jit.cpp
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-04-24.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#include "floyd_llvm_jit.h"
+
+#include "floyd_llvm_codegen.h"
+#include "compiler_helpers.h"
+#include "pass3.h"
+
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/GenericValue.h>
+#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Type.h>
+#include <llvm/IR/DataLayout.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Analysis/TargetLibraryInfo.h>
+#include <llvm/Analysis/TargetTransformInfo.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Transforms/IPO.h>
+#include <llvm/Transforms/IPO/AlwaysInliner.h>
+#include <llvm/Transforms/IPO/PassManagerBuilder.h>
+
+#include <functional>
+
+namespace floyd {
+
+
+
+////////////////////////////////		RUNTIME FUNCTION SIGNATURES
+
+
+static llvm::FunctionType* fr_dispose_vec__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
+	return llvm::FunctionType::get(
+		llvm::Type::getVoidTy(context),
+		{
+			make_frp_type(interner),
+			make_generic_vec_type(interner)->getPointerTo(),
+			make_runtime_type_type(context)
+		},
+		false
+	);
+}
+
+static llvm::FunctionType* fr_dispose_dict__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
+	return llvm::FunctionType::get(
+		llvm::Type::getVoidTy(context),
+		{
+			make_frp_type(interner),
+			make_generic_dict_type(interner)->getPointerTo(),
+			make_runtime_type_type(context)
+		},
+		false
+	);
+}
+
+static llvm::FunctionType* fr_dispose_json__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
+	return llvm::FunctionType::get(
+		llvm::Type::getVoidTy(context),
+		{
+			make_frp_type(interner),
+			get_exact_llvm_type(interner, typeid_t::make_json_value()),
+			make_runtime_type_type(context)
+		},
+		false
+	);
+}
+
+static llvm::FunctionType* fr_dispose_struct__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
+	return llvm::FunctionType::get(
+		llvm::Type::getVoidTy(context),
+		{
+			make_frp_type(interner),
+			get_generic_struct_type(interner)->getPointerTo(),
+			make_runtime_type_type(context)
+		},
+		false
+	);
+}
+
+static llvm::FunctionType* floyd_runtime__allocate_vector__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
+	return llvm::FunctionType::get(
+		make_generic_vec_type(interner)->getPointerTo(),
+		{
+			make_frp_type(interner),
+			llvm::Type::getInt64Ty(context)
+		},
+		false
+	);
+}
+
+static llvm::FunctionType* fr_alloc_kstr__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
+	return llvm::FunctionType::get(
+		make_generic_vec_type(interner)->getPointerTo(),
+		{
+			make_frp_type(interner),
+			llvm::Type::getInt8PtrTy(context),
+			llvm::Type::getInt64Ty(context)
+		},
+		false
+	);
+}
+
+static llvm::FunctionType* floyd_runtime__concatunate_vectors__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
+	return llvm::FunctionType::get(
+		make_generic_vec_type(interner)->getPointerTo(),
+		{
+			make_frp_type(interner),
+			make_runtime_type_type(context),
+			make_generic_vec_type(interner)->getPointerTo(),
+			make_generic_vec_type(interner)->getPointerTo()
+		},
+		false
+	);
+}
+
+static llvm::FunctionType* floyd_runtime__allocate_dict__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
+	return llvm::FunctionType::get(
+		make_generic_dict_type(interner)->getPointerTo(),
+		{
+			make_frp_type(interner)
+		},
+		false
+	);
+}
+
+static llvm::FunctionType* floyd_runtime__store_dict_mutable__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
+	return llvm::FunctionType::get(
+		llvm::Type::getVoidTy(context),
+		{
+			make_frp_type(interner),
+			make_generic_dict_type(interner)->getPointerTo(),
+			get_exact_llvm_type(interner, typeid_t::make_string()),
+			make_runtime_value_type(context),
+			make_runtime_type_type(context)
+		},
+		false
+	);
+}
+
+static llvm::FunctionType* floyd_runtime__lookup_dict__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
+	return llvm::FunctionType::get(
+		make_runtime_value_type(context),
+		{
+			make_frp_type(interner),
+			make_generic_dict_type(interner)->getPointerTo(),
+			get_exact_llvm_type(interner, typeid_t::make_string())
+		},
+		false
+	);
+}
+
+static llvm::FunctionType* floyd_runtime__allocate_json__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
+	return llvm::FunctionType::get(
+		get_exact_llvm_type(interner, typeid_t::make_json_value()),
+		{
+			make_frp_type(interner),
+			make_runtime_value_type(context),
+			make_runtime_type_type(context)
+		},
+		false
+	);
+}
+
+static llvm::FunctionType* floyd_runtime__lookup_json__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
+	return llvm::FunctionType::get(
+		get_exact_llvm_type(interner, typeid_t::make_json_value()),
+		{
+			make_frp_type(interner),
+			get_exact_llvm_type(interner, typeid_t::make_json_value()),
+			make_runtime_value_type(context),
+			make_runtime_type_type(context)
+		},
+		false
+	);
+}
+
+static llvm::FunctionType* floyd_runtime__json_to_string__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
+	return llvm::FunctionType::get(
+		get_exact_llvm_type(interner, typeid_t::make_string()),
+		{
+			make_frp_type(interner),
+			get_exact_llvm_type(interner, typeid_t::make_json_value())
+		},
+		false
+	);
+}
+
+static llvm::FunctionType* floyd_runtime__compare_values__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
+	return llvm::FunctionType::get(
+		llvm::Type::getInt1Ty(context),
+		{
+			make_frp_type(interner),
+			llvm::Type::getInt64Ty(context),
+			make_runtime_type_type(context),
+			make_runtime_value_type(context),
+			make_runtime_value_type(context)
+		},
+		false
+	);
+}
+
+static llvm::FunctionType* floyd_runtime__allocate_struct__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
+	return llvm::FunctionType::get(
+		get_generic_struct_type(interner)->getPointerTo(),
+		{
+			make_frp_type(interner),
+			llvm::Type::getInt64Ty(context)
+		},
+		false
+	);
+}
+
+static llvm::FunctionType* fr_update_struct_member__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
+	return llvm::FunctionType::get(
+		get_generic_struct_type(interner)->getPointerTo(),
+		{
+			make_frp_type(interner),
+			get_generic_struct_type(interner)->getPointerTo(),
+			make_runtime_type_type(context),
+			llvm::Type::getInt64Ty(context),
+			make_runtime_value_type(context),
+			make_runtime_type_type(context)
+		},
+		false
+	);
+}
+
+static llvm::FunctionType* fr_push_back_owned__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
+	return llvm::FunctionType::get(
+		make_generic_vec_type(interner)->getPointerTo(),
+		{
+			make_frp_type(interner),
+			make_generic_vec_type(interner)->getPointerTo(),
+			make_runtime_value_type(context),
+			make_runtime_type_type(context)
+		},
+		false
+	);
+}
+
+static llvm::FunctionType* fr_vec_to_hamt__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
+	return llvm::FunctionType::get(
+		make_generic_vec_type(interner)->getPointerTo(),
+		{
+			make_frp_type(interner),
+			make_generic_vec_type(interner)->getPointerTo(),
+			make_runtime_type_type(context)
+		},
+		false
+	);
+}
+
+static llvm::FunctionType* fr_lookup_vec_hamt__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
+	return llvm::FunctionType::get(
+		make_runtime_value_type(context),
+		{
+			make_frp_type(interner),
+			make_generic_vec_type(interner)->getPointerTo(),
+			llvm::Type::getInt64Ty(context)
+		},
+		false
+	);
+}
+
+std::vector<host_func_t> get_runtime_functions(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
+	const std::vector<std::pair<std::string, llvm::FunctionType*>> signatures = {
+		{ "fr_dispose_vec", fr_dispose_vec__make(context, interner) },
+		{ "fr_dispose_dict", fr_dispose_dict__make(context, interner) },
+		{ "fr_dispose_json", fr_dispose_json__make(context, interner) },
+		{ "fr_dispose_struct", fr_dispose_struct__make(context, interner) },
+
+		{ "floyd_runtime__allocate_vector", floyd_runtime__allocate_vector__make(context, interner) },
+		{ "fr_alloc_kstr", fr_alloc_kstr__make(context, interner) },
+		{ "floyd_runtime__concatunate_vectors", floyd_runtime__concatunate_vectors__make(context, interner) },
+		{ "floyd_runtime__allocate_dict", floyd_runtime__allocate_dict__make(context, interner) },
+		{ "floyd_runtime__store_dict_mutable", floyd_runtime__store_dict_mutable__make(context, interner) },
+		{ "floyd_runtime__lookup_dict", floyd_runtime__lookup_dict__make(context, interner) },
+		{ "floyd_runtime__allocate_json", floyd_runtime__allocate_json__make(context, interner) },
+		{ "floyd_runtime__lookup_json", floyd_runtime__lookup_json__make(context, interner) },
+		{ "floyd_runtime__json_to_string", floyd_runtime__json_to_string__make(context, interner) },
+		{ "floyd_runtime__compare_values", floyd_runtime__compare_values__make(context, interner) },
+		{ "floyd_runtime__allocate_struct", floyd_runtime__allocate_struct__make(context, interner) },
+
+		{ "fr_update_struct_member", fr_update_struct_member__make(context, interner) },
+		{ "fr_push_back_owned", fr_push_back_owned__make(context, interner) },
+		{ "fr_vec_to_hamt", fr_vec_to_hamt__make(context, interner) },
+		{ "fr_lookup_vec_hamt", fr_lookup_vec_hamt__make(context, interner) }
+	};
+
+	const auto implementations = get_runtime_functions_map();
+	std::vector<host_func_t> result;
+	for(const auto& e: signatures){
+		QUARK_ASSERT(implementations.find(e.first) != implementations.end());
+		result.push_back(host_func_t{ e.first, e.second, implementations.at(e.first) });
+	}
+	QUARK_ASSERT(result.size() == implementations.size());
+	return result;
+}
+
+
+
+////////////////////////////////		runtime_type_info_t
+
+
+std::vector<runtime_type_info_t> make_runtime_type_infos(const llvm_type_interner_t& interner, const llvm::DataLayout& data_layout){
+	std::vector<runtime_type_info_t> result;
+	for(const auto& e: interner.interner.interned){
+		const auto& type = e.second;
+		auto info = runtime_type_info_t{ is_rc_value(type), 0, {} };
+		if(type.is_struct()){
+			const llvm::StructLayout* layout = data_layout.getStructLayout(get_exact_struct_type(interner, type));
+			info.struct_size = layout->getSizeInBytes();
+			for(int i = 0 ; i < type.get_struct()._members.size() ; i++){
+				info.member_offsets.push_back(layout->getElementOffset(i));
+			}
+		}
+		result.push_back(info);
+	}
+	return result;
+}
+
+
+
+////////////////////////////////		EXECUTION ENGINE
+
+
+#if DEBUG && 1
+//	Verify that all global functions can be accessed. If *one* is unresolved, then all return NULL!?
+void check_nulls(llvm_execution_engine_t& ee2, const llvm_ir_program_t& p){
+	int index = 0;
+	for(const auto& e: p.debug_globals._symbols){
+		if(e.second.get_type().is_function()){
+			const auto global_var = (FLOYD_RUNTIME_HOST_FUNCTION*)floyd::get_global_ptr(ee2, e.first);
+			QUARK_ASSERT(global_var != nullptr);
+
+			const auto f = *global_var;
+//				QUARK_ASSERT(f != nullptr);
+
+			const std::string suffix = f == nullptr ? " NULL POINTER" : "";
+//			const uint64_t addr = reinterpret_cast<uint64_t>(f);
+//			QUARK_TRACE_SS(index << " " << e.first << " " << addr << suffix);
+		}
+		else{
+		}
+		index++;
+	}
+}
+#endif
+
+llvm::CodeGenOpt::Level get_codegen_opt_level(llvm_optimization_level level){
+	switch(level){
+		case llvm_optimization_level::k_O0: return llvm::CodeGenOpt::Level::None;
+		case llvm_optimization_level::k_O1: return llvm::CodeGenOpt::Level::Less;
+		case llvm_optimization_level::k_O2: return llvm::CodeGenOpt::Level::Default;
+		case llvm_optimization_level::k_O3: return llvm::CodeGenOpt::Level::Aggressive;
+	}
+	QUARK_ASSERT(false);
+	throw std::exception();
+}
+
+/*
+	Runs the same IR passes as clang does for the level: first the function-level passes on each function, then the
+	module-level passes (inlining, interprocedural optimizations, loop and SLP vectorization at O2 and up).
+	The module must already have the target's data layout, the passes use it to compute sizes and offsets.
+*/
+void optimize_module(llvm::Module& module, llvm::TargetMachine& target_machine, llvm_optimization_level level){
+	if(level == llvm_optimization_level::k_O0){
+		return;
+	}
+
+	const auto opt_level = static_cast<unsigned>(level);
+	llvm::PassManagerBuilder builder;
+	builder.OptLevel = opt_level;
+	builder.SizeLevel = 0;
+	builder.Inliner = opt_level > 1 ? llvm::createFunctionInliningPass(opt_level, 0, false) : llvm::createAlwaysInlinerLegacyPass();
+	builder.LoopVectorize = opt_level > 1;
+	builder.SLPVectorize = opt_level > 1;
+	builder.LibraryInfo = new llvm::TargetLibraryInfoImpl(target_machine.getTargetTriple());
+	target_machine.adjustPassManager(builder);
+
+	llvm::legacy::FunctionPassManager function_passes(&module);
+	function_passes.add(llvm::createTargetTransformInfoWrapperPass(target_machine.getTargetIRAnalysis()));
+	builder.populateFunctionPassManager(function_passes);
+
+	llvm::legacy::PassManager module_passes;
+	module_passes.add(llvm::createTargetTransformInfoWrapperPass(target_machine.getTargetIRAnalysis()));
+	builder.populateModulePassManager(module_passes);
+
+	function_passes.doInitialization();
+	for(auto& f: module){
+		function_passes.run(f);
+	}
+	function_passes.doFinalization();
+
+	module_passes.run(module);
+}
+
+//	Looks up the program's globals and functions in the execution engine. MCJIT compiles the module the first time.
+struct jit_symbols_t : public symbol_resolver_i {
+	jit_symbols_t(const std::shared_ptr<llvm::ExecutionEngine>& ee) :
+		ee(ee)
+	{
+	}
+
+	virtual void* get_global_ptr(const std::string& name){
+		return reinterpret_cast<void*>(ee->getGlobalValueAddress(name));
+	}
+	virtual void* get_global_function(const std::string& name){
+		return reinterpret_cast<void*>(ee->getFunctionAddress(name));
+	}
+
+	std::shared_ptr<llvm::ExecutionEngine> ee;
+};
+
+//	Destroys program, can only run it once!
+static llvm_execution_engine_t make_engine_no_init(llvm_instance_t& instance, llvm_ir_program_t& program_breaks){
+	QUARK_ASSERT(instance.check_invariant());
+	QUARK_ASSERT(program_breaks.check_invariant());
+
+	std::string collectedErrors;
+
+	const auto level = program_breaks.optimization_level;
+	auto& module = *program_breaks.module;
+
+	//	WARNING: Destroys p -- uses std::move().
+	llvm::EngineBuilder builder(std::move(program_breaks.module));
+	builder
+		.setErrorStr(&collectedErrors)
+		.setOptLevel(get_codegen_opt_level(level))
+		.setVerifyModules(true)
+		.setEngineKind(llvm::EngineKind::JIT);
+
+	//	Optimize for the CPU we run on. The builder owns the module now, but it's not compiled until create().
+	llvm::TargetMachine* target_machine = builder.selectTarget();
+	if(target_machine == nullptr){
+		std::string error = "Unable to select target: " + collectedErrors;
+		perror(error.c_str());
+		throw std::exception();
+	}
+	module.setDataLayout(target_machine->createDataLayout());
+	module.setTargetTriple(target_machine->getTargetTriple().str());
+	optimize_module(module, *target_machine, level);
+
+	//	Takes ownership of target_machine.
+	llvm::ExecutionEngine* exeEng = builder.create(target_machine);
+
+	if (exeEng == nullptr){
+		std::string error = "Unable to construct execution engine: " + collectedErrors;
+		perror(error.c_str());
+		throw std::exception();
+	}
+	QUARK_ASSERT(collectedErrors.empty());
+
+	const auto start_time = std::chrono::high_resolution_clock::now();
+
+	auto ee1 = std::shared_ptr<llvm::ExecutionEngine>(exeEng);
+	auto ee2 = llvm_execution_engine_t{
+		k_debug_magic,
+		std::make_shared<jit_symbols_t>(ee1),
+		program_breaks.type_interner.interner,
+		program_breaks.type_interner.vectors,
+		program_breaks.debug_globals,
+		program_breaks.function_defs,
+		{},
+		nullptr,
+		start_time,
+		{},
+		make_runtime_type_infos(program_breaks.type_interner, exeEng->getDataLayout())
+	};
+	QUARK_ASSERT(ee2.check_invariant());
+
+	auto function_map = register_c_functions();
+
+	//	Resolve all unresolved functions.
+	{
+		//	https://stackoverflow.com/questions/33328562/add-mapping-to-c-lambda-from-llvm
+		auto lambda = [&](const std::string& s) -> void* {
+			QUARK_ASSERT(s.empty() == false);
+			QUARK_ASSERT(s[0] == '_');
+			const auto s2 = s.substr(1);
+
+			const auto it = function_map.find(s2);
+			if(it != function_map.end()){
+				return it->second;
+			}
+			else{
+			}
+
+			return nullptr;
+		};
+		std::function<void*(const std::string&)> on_lazy_function_creator2 = lambda;
+
+		if(program_breaks.object_cache != nullptr){
+			ee1->setObjectCache(program_breaks.object_cache);
+		}
+
+		//	NOTICE! Patch during finalizeObject() only, then restore!
+		ee1->InstallLazyFunctionCreator(on_lazy_function_creator2);
+		ee1->finalizeObject();
+		ee1->InstallLazyFunctionCreator(nullptr);
+
+	//	ee1->DisableGVCompilation(false);
+	//	ee1->DisableSymbolSearching(false);
+	}
+
+#if DEBUG
+	check_nulls(ee2, program_breaks);
+#endif
+
+//	llvm::WriteBitcodeToFile(exeEng->getVerifyModules(), raw_ostream &Out);
+	return ee2;
+}
+
+//	Destroys program, can only run it once!
+//	Automatically runs floyd_runtime_init() to execute Floyd's global functions and initialize global constants.
+llvm_execution_engine_t make_engine_run_init(llvm_instance_t& instance, llvm_ir_program_t& program_breaks){
+	QUARK_ASSERT(instance.check_invariant());
+	QUARK_ASSERT(program_breaks.check_invariant());
+
+	llvm_execution_engine_t ee = make_engine_no_init(instance, program_breaks);
+
+	trace_heap(ee.heap);
+
+#if DEBUG
+	{
+		const auto print_global_ptr = (FLOYD_RUNTIME_HOST_FUNCTION*)floyd::get_global_ptr(ee, "print");
+		QUARK_ASSERT(print_global_ptr != nullptr);
+
+		const auto print_f = *print_global_ptr;
+		QUARK_ASSERT(print_f != nullptr);
+		if(print_f){
+
+//			(*print_f)(&ee, 109);
+		}
+	}
+
+	{
+		auto a_func = reinterpret_cast<FLOYD_RUNTIME_INIT>(get_global_function(ee, "floyd_runtime_init"));
+		QUARK_ASSERT(a_func != nullptr);
+	}
+#endif
+
+	const auto init_result = call_floyd_runtime_init(ee);
+	QUARK_ASSERT(init_result == 667);
+
+//	check_nulls(ee, program_breaks);
+
+	trace_heap(ee.heap);
+
+	return ee;
+}
+
+
+
+std::map<std::string, value_t> run_llvm_container(llvm_ir_program_t& program_breaks, const std::vector<std::string>& main_args, const std::string& container_key){
+	if(container_key.empty()){
+		// ??? instance is already known via program_breaks.
+		llvm_execution_engine_t ee = make_engine_run_init(*program_breaks.instance, program_breaks);
+
+		const auto main_function = bind_function(ee, "main");
+		if(main_function.first != nullptr){
+			const auto main_result_int = llvm_call_main(ee, main_function, main_args);
+			const auto result = value_t::make_int(main_result_int);
+
+			call_floyd_runtime_deinit(ee);
+
+			detect_leaks(ee.heap);
+
+			return {{ "main()", result }};
+		}
+		else{
+			call_floyd_runtime_deinit(ee);
+			return {{ "global", value_t::make_void() }};
+		}
+	}
+	else{
+		//??? Confusing. Support several containers!
+		if(std::find(program_breaks.software_system._containers.begin(), program_breaks.software_system._containers.end(), container_key) == program_breaks.software_system._containers.end()){
+			quark::throw_runtime_error("Unknown container-key");
+		}
+
+		if(program_breaks.container_def._name != container_key){
+			quark::throw_runtime_error("Unknown container-key");
+		}
+
+		llvm_execution_engine_t ee = make_engine_run_init(*program_breaks.instance, program_breaks);
+		return run_container(ee, program_breaks.container_def);
+	}
+}
+
+
+}	//	namespace floyd
+
+
+
+////////////////////////////////		TESTS
+
+
+
+QUARK_UNIT_TEST("", "From source: Check that floyd_runtime_init() runs and sets 'result' global", "", ""){
+	const auto cu = floyd::make_compilation_unit_nolib("let int result = 1 + 2 + 3", "myfile.floyd");
+	const auto pass3 = compile_to_sematic_ast__errors(cu);
+
+	floyd::llvm_instance_t instance;
+	auto program = generate_llvm_ir_program(instance, pass3, "myfile.floyd");
+	auto ee = make_engine_run_init(instance, *program);
+
+	const auto result = *static_cast<uint64_t*>(floyd::get_global_ptr(ee, "result"));
+	QUARK_ASSERT(result == 6);
+
+	call_floyd_runtime_deinit(ee);
+
+//	QUARK_TRACE_SS("result = " << floyd::print_program(*program));
+}
+
+QUARK_UNIT_TEST("", "make_engine_run_init()", "all optimization levels give the same result", ""){
+	const auto cu = floyd::make_compilation_unit_nolib(R"(
+		func int fib(int n){
+			if(n <= 1){
+				return n
+			}
+			return fib(n - 2) + fib(n - 1)
+		}
+
+		let [int] v = [ 1, 2, 3 ]
+		mutable int result = fib(20) + size(v)
+		for(i in 0 ..< 100){
+			result = result + i
+		}
+	)", "myfile.floyd");
+	const auto pass3 = compile_to_sematic_ast__errors(cu);
+
+	for(const auto level: { floyd::llvm_optimization_level::k_O0, floyd::llvm_optimization_level::k_O1, floyd::llvm_optimization_level::k_O2, floyd::llvm_optimization_level::k_O3 }){
+		floyd::llvm_instance_t instance;
+		auto program = generate_llvm_ir_program(instance, pass3, "myfile.floyd");
+		program->optimization_level = level;
+		auto ee = make_engine_run_init(instance, *program);
+
+		const auto result = *static_cast<int64_t*>(floyd::get_global_ptr(ee, "result"));
+		QUARK_UT_VERIFY(result == 6765 + 3 + 4950);
+
+		call_floyd_runtime_deinit(ee);
+	}
+}
+
+QUARK_UNIT_TEST("", "make_engine_run_init()", "vector_backend::k_hamt gives the same result as k_carray", ""){
+	const auto cu = floyd::make_compilation_unit_nolib(R"(
+		let [string] a = [ "a", "b", "c" ]
+		mutable [string] b = a
+		for(i in 0 ..< 100){
+			b = push_back(b, to_string(i))
+		}
+		let c = update(b, 1, "x")
+		let d = subset(c, 1, 4)
+		let e = d + [ "y" ]
+		print(a[1] + c[1] + d[0] + e[3] + b[102])
+		print(replace(e, 1, 3, [ "z" ]))
+
+		func int count_f([int] e){ return size(e) }
+		func bool short_f(string e){ return size(e) == 1 }
+		func int add_size_f(int acc, string e){ return acc + size(e) }
+
+		let [[int]] n = [ [ 3, 1 ], [ 2 ] ]
+		let n2 = update(n, 0, sort(push_back(n[0], 4)))
+		print(n2)
+		print(map(n2, count_f))
+		print(filter(b, short_f))
+
+		let result = size(b) + find(n2[0], 4) + reduce(c, 0, add_size_f)
+	)", "myfile.floyd");
+	const auto pass3 = compile_to_sematic_ast__errors(cu);
+
+	std::vector<std::vector<std::string>> prints;
+	std::vector<int64_t> results;
+	for(const auto backend: { floyd::vector_backend::k_carray, floyd::vector_backend::k_hamt }){
+		floyd::llvm_instance_t instance;
+		auto program = generate_llvm_ir_program(instance, pass3, "myfile.floyd", backend);
+		auto ee = make_engine_run_init(instance, *program);
+		QUARK_UT_VERIFY(is_vector_hamt(ee.vectors, floyd::typeid_t::make_vector(floyd::typeid_t::make_int())) == (backend == floyd::vector_backend::k_hamt));
+
+		prints.push_back(ee._print_output);
+		results.push_back(*static_cast<int64_t*>(floyd::get_global_ptr(ee, "result")));
+
+		call_floyd_runtime_deinit(ee);
+		detect_leaks(ee.heap);
+	}
+	QUARK_UT_VERIFY(prints[0][0] == "bxxy99");
+	QUARK_UT_VERIFY(prints[1] == prints[0]);
+	QUARK_UT_VERIFY(results[1] == results[0]);
+}
+
+//	BROKEN!
+QUARK_UNIT_TEST("", "From JSON: Simple function call, call print() from floyd_runtime_init()", "", ""){
+	const auto cu = floyd::make_compilation_unit_nolib("print(5)", "myfile.floyd");
+	const auto pass3 = compile_to_sematic_ast__errors(cu);
+
+	floyd::llvm_instance_t instance;
+	auto program = generate_llvm_ir_program(instance, pass3, "myfile.floyd");
+	auto ee = make_engine_run_init(instance, *program);
+	QUARK_ASSERT(ee._print_output == std::vector<std::string>{"5"});
+	call_floyd_runtime_deinit(ee);
+}
+
+
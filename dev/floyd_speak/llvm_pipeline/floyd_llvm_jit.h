@@ -0,0 +1,70 @@
+//
+//  floyd_llvm_jit.h
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-04-24.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#ifndef floyd_llvm_jit_hpp
+#define floyd_llvm_jit_hpp
+
+/*
+	Turns an llvm_ir_program_t into machine code and an execution engine that runs it on the runtime in
+	floyd_llvm_runtime.h. Also what the code generator and compile_native need to know about the runtime that
+	depends on LLVM: the runtime functions' LLVM signatures and the type infos, which come from the target's data
+	layout.
+*/
+
+#include "floyd_llvm_runtime.h"
+#include "floyd_llvm_helpers.h"
+
+#include <llvm/IR/DataLayout.h>
+#include <llvm/Support/CodeGen.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+namespace llvm {
+	class TargetMachine;
+}
+
+namespace floyd {
+
+	struct llvm_ir_program_t;
+	enum class llvm_optimization_level;
+
+
+////////////////////////////////		host_func_t
+
+
+struct host_func_t {
+	std::string name_key;
+	llvm::FunctionType* function_type;
+	void* implementation_f;
+};
+
+//	The functions in get_runtime_functions_map(), with their LLVM signatures.
+std::vector<host_func_t> get_runtime_functions(llvm::LLVMContext& context, const llvm_type_interner_t& interner);
+
+
+//	One entry per type in interner.interner.interned, same order.
+std::vector<runtime_type_info_t> make_runtime_type_infos(const llvm_type_interner_t& interner, const llvm::DataLayout& data_layout);
+
+
+llvm::CodeGenOpt::Level get_codegen_opt_level(llvm_optimization_level level);
+
+//	Runs the same IR passes as clang does for the level. The module must already have the target's data layout.
+void optimize_module(llvm::Module& module, llvm::TargetMachine& target_machine, llvm_optimization_level level);
+
+
+llvm_execution_engine_t make_engine_run_init(llvm_instance_t& instance, llvm_ir_program_t& program);
+
+std::map<std::string, value_t> run_llvm_container(llvm_ir_program_t& program_breaks, const std::vector<std::string>& main_args, const std::string& container_key);
+
+
+}	//	namespace floyd
+
+
+#endif /* floyd_llvm_jit_hpp */
@@ -0,0 +1,233 @@
+//
+//  floyd_llvm_jit_cache.cpp
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-07-22.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#include "floyd_llvm_jit_cache.h"
+
+#include "floyd_llvm_runtime.h"
+#include "floyd_llvm_helpers.h"
+#include "sha1_class.h"
+#include "file_handling.h"
+#include "json_support.h"
+#include "text_parser.h"
+#include "compiler_helpers.h"
+#include "pass3.h"
+#include "quark.h"
+
+#include <llvm/Config/llvm-config.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/TargetSelect.h>
+
+#include <cstdio>
+#include <unistd.h>
+
+namespace floyd {
+
+
+static const int k_jit_cache_format = 4;
+
+
+std::string get_default_jit_cache_dir(){
+	return GetDirectories().cache_dir + "/floyd_jit";
+}
+
+std::string get_runtime_build_id(vector_backend vectors){
+	std::string s;
+
+	//	The runtime functions the machine code calls, with the LLVM signatures it calls them with.
+	{
+		llvm::LLVMContext context;
+		const llvm_type_interner_t interner(context, type_interner_t(), vectors);
+		for(const auto& e: get_runtime_functions(context, interner)){
+			s = s + e.name_key + " " + print_type(e.function_type) + "\n";
+		}
+	}
+	for(const auto& e: register_c_functions()){
+		s = s + e.first + "\n";
+	}
+
+	//	The floyd executable itself: any rebuild of the runtime gives it a new size or modification date.
+	TFileInfo info;
+	if(GetFileInfo(get_process_path(getpid()), info)){
+		s = s + std::to_string(info.fFileSize) + " " + std::to_string(info.fModificationDate) + "\n";
+	}
+	return SHA1ToStringPlain(CalcSHA1(s));
+}
+
+std::string make_jit_cache_key(const std::string& program_source, const std::string& compiler_version, llvm_optimization_level optimization_level, vector_backend vectors){
+	const auto s = std::string()
+		+ std::to_string(k_jit_cache_format) + "\n"
+		+ compiler_version + "\n"
+		+ get_runtime_build_id(vectors) + "\n"
+		+ LLVM_VERSION_STRING + "\n"
+		+ llvm::sys::getProcessTriple() + "\n"
+		+ llvm::sys::getHostCPUName().str() + "\n"
+		+ std::to_string(static_cast<int>(optimization_level)) + "\n"
+		+ vector_backend_to_string(vectors) + "\n"
+		+ program_source;
+	return SHA1ToStringPlain(CalcSHA1(s));
+}
+
+std::string get_cached_object_path(const std::string& cache_dir, const std::string& key){
+	return cache_dir + "/" + key + ".o";
+}
+
+static std::string get_cached_program_path(const std::string& cache_dir, const std::string& key){
+	return cache_dir + "/" + key + ".json";
+}
+
+//	Writes to a temporary file first, so another floyd running the same program never sees half a file.
+static void save_cache_file(const std::string& path, const uint8_t data[], size_t size){
+	const auto temp_path = path + ".tmp" + std::to_string(getpid());
+	SaveFile(temp_path, data, size);
+	if(std::rename(temp_path.c_str(), path.c_str()) != 0){
+		std::remove(temp_path.c_str());
+	}
+}
+
+
+
+//////////////////////////////////////		jit_object_cache_t
+
+
+
+jit_object_cache_t::jit_object_cache_t(const std::string& object_path) :
+	_object_path(object_path)
+{
+}
+
+void jit_object_cache_t::notifyObjectCompiled(const llvm::Module* module, llvm::MemoryBufferRef object){
+	//	Not being able to write the cache is no reason to stop the program.
+	try {
+		save_cache_file(_object_path, reinterpret_cast<const uint8_t*>(object.getBufferStart()), object.getBufferSize());
+	}
+	catch(...){
+	}
+}
+
+std::unique_ptr<llvm::MemoryBuffer> jit_object_cache_t::getObject(const llvm::Module* module){
+	if(DoesEntryExist(_object_path) == false){
+		return nullptr;
+	}
+
+	auto result = llvm::MemoryBuffer::getFile(_object_path);
+	if(!result){
+		return nullptr;
+	}
+	return std::move(result.get());
+}
+
+
+
+//////////////////////////////////////		PROGRAMS
+
+
+
+std::unique_ptr<llvm_ir_program_t> load_cached_program(llvm_instance_t& instance, const std::string& cache_dir, const std::string& key){
+	QUARK_ASSERT(instance.check_invariant());
+
+	const auto program_path = get_cached_program_path(cache_dir, key);
+	if(DoesEntryExist(program_path) == false || DoesEntryExist(get_cached_object_path(cache_dir, key)) == false){
+		return nullptr;
+	}
+
+	try {
+		const auto program_json = parse_json(seq_t(read_text_file(program_path))).first;
+
+		const llvm_type_interner_t type_interner(instance.context, native_json_to_types(program_json.get_object_element("types")), native_json_to_vector_backend(program_json));
+		const auto function_defs = native_json_to_function_defs(program_json.get_object_element("function_defs"));
+
+		//	The code generator isn't run, but MCJIT still needs the target.
+		llvm::InitializeNativeTarget();
+		llvm::InitializeNativeTargetAsmPrinter();
+
+		auto module = std::make_unique<llvm::Module>(key, instance.context);
+		return std::make_unique<llvm_ir_program_t>(&instance, module, type_interner, symbol_table_t{}, function_defs);
+	}
+	catch(const std::exception& e){
+		return nullptr;
+	}
+}
+
+void save_cached_program(const llvm_ir_program_t& program, const std::string& cache_dir, const std::string& key){
+	QUARK_ASSERT(program.check_invariant());
+
+	const auto program_json = make_native_program_json(
+		program.type_interner.interner,
+		make_runtime_type_infos(program.type_interner, program.module->getDataLayout()),
+		program.function_defs,
+		program.type_interner.vectors
+	);
+	const auto s = json_to_compact_string(program_json);
+	try {
+		save_cache_file(get_cached_program_path(cache_dir, key), reinterpret_cast<const uint8_t*>(s.c_str()), s.size());
+	}
+	catch(...){
+	}
+}
+
+
+}	//	floyd
+
+
+
+////////////////////////////////		TESTS
+
+
+
+QUARK_UNIT_TEST("", "make_jit_cache_key()", "", ""){
+	const auto a = floyd::make_jit_cache_key("let a = 1", "0.3", floyd::llvm_optimization_level::k_O0);
+	QUARK_UT_VERIFY(a == floyd::make_jit_cache_key("let a = 1", "0.3", floyd::llvm_optimization_level::k_O0));
+	QUARK_UT_VERIFY(a != floyd::make_jit_cache_key("let a = 2", "0.3", floyd::llvm_optimization_level::k_O0));
+	QUARK_UT_VERIFY(a != floyd::make_jit_cache_key("let a = 1", "0.4", floyd::llvm_optimization_level::k_O0));
+	QUARK_UT_VERIFY(a != floyd::make_jit_cache_key("let a = 1", "0.3", floyd::llvm_optimization_level::k_O2));
+	QUARK_UT_VERIFY(a != floyd::make_jit_cache_key("let a = 1", "0.3", floyd::llvm_optimization_level::k_O0, floyd::vector_backend::k_hamt));
+}
+
+QUARK_UNIT_TEST("", "get_runtime_build_id()", "", ""){
+	const auto a = floyd::get_runtime_build_id(floyd::vector_backend::k_carray);
+	QUARK_UT_VERIFY(a.size() == 40);
+	QUARK_UT_VERIFY(a == floyd::get_runtime_build_id(floyd::vector_backend::k_carray));
+}
+
+QUARK_UNIT_TEST("", "load_cached_program()", "second run uses the cached machine code", ""){
+	const auto source = "let int result = 1 + 2 + 3";
+	const auto cache_dir = GetDirectories().temp_dir + "/floyd_unittest/jit_cache";
+	const auto key = floyd::make_jit_cache_key(source, "test", floyd::llvm_optimization_level::k_O0);
+	const auto object_path = floyd::get_cached_object_path(cache_dir, key);
+	std::remove(object_path.c_str());
+
+	{
+		floyd::llvm_instance_t instance;
+		QUARK_UT_VERIFY(floyd::load_cached_program(instance, cache_dir, key) == nullptr);
+
+		const auto cu = floyd::make_compilation_unit_nolib(source, "myfile.floyd");
+		auto program = generate_llvm_ir_program(instance, compile_to_sematic_ast__errors(cu), "myfile.floyd");
+		floyd::save_cached_program(*program, cache_dir, key);
+
+		floyd::jit_object_cache_t object_cache(object_path);
+		program->object_cache = &object_cache;
+		auto ee = floyd::make_engine_run_init(instance, *program);
+		QUARK_UT_VERIFY(*static_cast<uint64_t*>(floyd::get_global_ptr(ee, "result")) == 6);
+		floyd::call_floyd_runtime_deinit(ee);
+	}
+
+	{
+		floyd::llvm_instance_t instance;
+		auto program = floyd::load_cached_program(instance, cache_dir, key);
+		QUARK_UT_VERIFY(program != nullptr);
+		QUARK_UT_VERIFY(program->module->empty());
+
+		floyd::jit_object_cache_t object_cache(object_path);
+		program->object_cache = &object_cache;
+		auto ee = floyd::make_engine_run_init(instance, *program);
+		QUARK_UT_VERIFY(*static_cast<uint64_t*>(floyd::get_global_ptr(ee, "result")) == 6);
+		floyd::call_floyd_runtime_deinit(ee);
+	}
+}
@@ -0,0 +1,83 @@
+//
+//  floyd_llvm_jit_cache.h
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-07-22.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#ifndef floyd_llvm_jit_cache_hpp
+#define floyd_llvm_jit_cache_hpp
+
+/*
+	Keeps the machine code the JIT makes on disk, so running an unchanged program again skips parsing, pass3, LLVM
+	code generation and LLVM compilation.
+
+	Each program has two files in the cache directory, named by its key:
+		"<key>.o"		the object file MCJIT made from the module, stored by jit_object_cache_t.
+		"<key>.json"	what the runtime needs to know about the program, see make_native_program_json().
+
+	The key is a SHA1 of the source text, Floyd's version, get_runtime_build_id(), LLVM's version, the CPU, the
+	optimization level and k_jit_cache_format. The build id changes whenever floyd is rebuilt, so a new compiler or
+	runtime never picks up machine code made by an old one. Bump k_jit_cache_format when the layout of the cache files
+	changes.
+
+	A cached program is run with an empty module: MCJIT asks jit_object_cache_t for its machine code instead of
+	compiling it, then links it to the runtime the usual way.
+*/
+
+#include "floyd_llvm_codegen.h"
+#include "floyd_llvm_jit.h"
+
+#include <llvm/ExecutionEngine/ObjectCache.h>
+
+#include <string>
+#include <memory>
+
+namespace floyd {
+
+
+struct jit_cache_settings_t {
+	//	"" = don't cache.
+	std::string cache_dir;
+
+	std::string compiler_version;
+};
+
+//	~/Library/Caches/floyd_jit
+std::string get_default_jit_cache_dir();
+
+//	SHA1 of the runtime functions' names and LLVM signatures, the host function names and the size and modification
+//	date of the running executable.
+std::string get_runtime_build_id(vector_backend vectors);
+
+std::string make_jit_cache_key(const std::string& program_source, const std::string& compiler_version, llvm_optimization_level optimization_level, vector_backend vectors = vector_backend::k_carray);
+
+
+//	Stores and loads the machine code for one module, in one file.
+class jit_object_cache_t : public llvm::ObjectCache {
+	public: explicit jit_object_cache_t(const std::string& object_path);
+
+	public: void notifyObjectCompiled(const llvm::Module* module, llvm::MemoryBufferRef object) override;
+	public: std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module* module) override;
+
+
+	/////////////////////////////////////		STATE
+
+	private: const std::string _object_path;
+};
+
+
+//	Returns nullptr if the program isn't in the cache. The program has an empty module and must run with a
+//	jit_object_cache_t for the same key.
+std::unique_ptr<llvm_ir_program_t> load_cached_program(llvm_instance_t& instance, const std::string& cache_dir, const std::string& key);
+
+//	Call before running the program with a jit_object_cache_t, which stores its machine code.
+void save_cached_program(const llvm_ir_program_t& program, const std::string& cache_dir, const std::string& key);
+
+std::string get_cached_object_path(const std::string& cache_dir, const std::string& key);
+
+
+}	//	floyd
+
+#endif /* floyd_llvm_jit_cache_hpp */
@@ -0,0 +1,342 @@
+//
+//  floyd_llvm_native.cpp
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-07-20.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#include "floyd_llvm_native.h"
+
+#include "floyd_llvm_jit.h"
+#include "floyd_llvm_helpers.h"
+#include "compiler_helpers.h"
+#include "file_handling.h"
+#include "pass3.h"
+#include "text_parser.h"
+#include "quark.h"
+
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/TargetRegistry.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetOptions.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char** environ;
+
+namespace floyd {
+
+
+//	The executable may run on other machines than the one that compiled it: no CPU-specific instructions.
+static std::unique_ptr<llvm::TargetMachine> make_native_target_machine(llvm_optimization_level level){
+	const auto triple = llvm::sys::getDefaultTargetTriple();
+
+	std::string error;
+	const auto target = llvm::TargetRegistry::lookupTarget(triple, error);
+	if(target == nullptr){
+		quark::throw_runtime_error("Unable to select target: " + error);
+	}
+
+	llvm::TargetOptions options;
+	return std::unique_ptr<llvm::TargetMachine>(
+		target->createTargetMachine(triple, "generic", "", options, llvm::Reloc::PIC_, llvm::None, get_codegen_opt_level(level))
+	);
+}
+
+static llvm::Constant* make_c_string(llvm::Module& module, const std::string& s){
+	auto& context = module.getContext();
+
+	auto chars = llvm::ConstantDataArray::getString(context, s, true);
+	auto global = new llvm::GlobalVariable(module, chars->getType(), true, llvm::GlobalValue::PrivateLinkage, chars, "floyd.str");
+	return llvm::ConstantExpr::getBitCast(global, llvm::Type::getInt8PtrTy(context));
+}
+
+static llvm::Constant* make_pointer_array(llvm::Module& module, const std::vector<llvm::Constant*>& elements, bool is_constant, const std::string& name){
+	auto& context = module.getContext();
+	auto pointer_type = llvm::Type::getInt8PtrTy(context);
+
+	auto array_type = llvm::ArrayType::get(pointer_type, elements.size());
+	auto global = new llvm::GlobalVariable(module, array_type, is_constant, llvm::GlobalValue::InternalLinkage, llvm::ConstantArray::get(array_type, elements), name);
+	return llvm::ConstantExpr::getBitCast(global, pointer_type->getPointerTo());
+}
+
+
+/*
+	Gives each runtime and host function the module calls a body that loads the real address from a table and calls
+	it. floyd_native_main() fills in the table from register_c_functions(), the same map the JIT resolves them with.
+
+	Returns the names and the table.
+*/
+static std::pair<std::vector<llvm::Constant*>, llvm::Constant*> make_host_function_stubs(llvm::Module& module, const std::map<std::string, void*>& function_map){
+	auto& context = module.getContext();
+	auto pointer_type = llvm::Type::getInt8PtrTy(context);
+
+	std::vector<llvm::Function*> functions;
+	for(auto& f: module){
+		if(f.isDeclaration() && f.isIntrinsic() == false && function_map.find(f.getName().str()) != function_map.end()){
+			functions.push_back(&f);
+		}
+	}
+
+	auto table_type = llvm::ArrayType::get(pointer_type, functions.size());
+	auto table = new llvm::GlobalVariable(module, table_type, false, llvm::GlobalValue::InternalLinkage, llvm::ConstantAggregateZero::get(table_type), "floyd.host_functions");
+
+	std::vector<llvm::Constant*> names;
+	for(int i = 0 ; i < functions.size() ; i++){
+		auto f = functions[i];
+		if(f->isVarArg()){
+			quark::throw_runtime_error("Native executables don't support variadic runtime function \"" + f->getName().str() + "\".");
+		}
+
+		f->setLinkage(llvm::GlobalValue::InternalLinkage);
+		llvm::IRBuilder<> builder(llvm::BasicBlock::Create(context, "entry", f));
+
+		auto slot = builder.CreateConstGEP2_64(table_type, table, 0, i);
+		auto address = builder.CreateLoad(pointer_type, slot);
+		auto callee = builder.CreateBitCast(address, f->getType());
+
+		std::vector<llvm::Value*> args;
+		for(auto& arg: f->args()){
+			args.push_back(&arg);
+		}
+		auto call = builder.CreateCall(f->getFunctionType(), callee, args);
+		call->setTailCall(true);
+		call->setCallingConv(f->getCallingConv());
+
+		if(f->getReturnType()->isVoidTy()){
+			builder.CreateRetVoid();
+		}
+		else{
+			builder.CreateRet(call);
+		}
+
+		names.push_back(make_c_string(module, f->getName().str()));
+	}
+	return { names, llvm::ConstantExpr::getBitCast(table, pointer_type->getPointerTo()) };
+}
+
+/*
+	Makes the program's globals and functions internal and returns their names and addresses. The runtime finds
+	floyd_runtime_init(), main() etc through these, the JIT uses the ExecutionEngine for this.
+	Floyd's main global is renamed so the C main() can have its name.
+*/
+static std::pair<std::vector<llvm::Constant*>, std::vector<llvm::Constant*>> internalize_program_symbols(llvm::Module& module){
+	auto pointer_type = llvm::Type::getInt8PtrTy(module.getContext());
+
+	std::vector<llvm::GlobalValue*> symbols;
+	for(auto& e: module.globals()){
+		if(e.isDeclaration() == false && e.hasExternalLinkage()){
+			symbols.push_back(&e);
+		}
+	}
+	for(auto& e: module){
+		if(e.isDeclaration() == false && e.hasExternalLinkage()){
+			symbols.push_back(&e);
+		}
+	}
+
+	std::vector<llvm::Constant*> names;
+	std::vector<llvm::Constant*> addresses;
+	for(auto e: symbols){
+		names.push_back(make_c_string(module, e->getName().str()));
+		addresses.push_back(llvm::ConstantExpr::getBitCast(e, pointer_type));
+
+		e->setLinkage(llvm::GlobalValue::InternalLinkage);
+		if(e->getName() == "main"){
+			e->setName("floyd.main");
+		}
+	}
+	return { names, addresses };
+}
+
+//	int main(int argc, const char* argv[]){ return floyd_native_main(argc, argv, &image); }
+static void make_c_main(llvm::Module& module, llvm::Constant* image){
+	auto& context = module.getContext();
+	auto int_type = llvm::Type::getInt32Ty(context);
+	auto argv_type = llvm::Type::getInt8PtrTy(context)->getPointerTo();
+
+	auto native_main_type = llvm::FunctionType::get(int_type, { int_type, argv_type, image->getType() }, false);
+	auto native_main = llvm::Function::Create(native_main_type, llvm::GlobalValue::ExternalLinkage, "floyd_native_main", &module);
+
+	auto main_type = llvm::FunctionType::get(int_type, { int_type, argv_type }, false);
+	auto main = llvm::Function::Create(main_type, llvm::GlobalValue::ExternalLinkage, "main", &module);
+	QUARK_ASSERT(main->getName() == "main");
+
+	llvm::IRBuilder<> builder(llvm::BasicBlock::Create(context, "entry", main));
+	auto args = main->arg_begin();
+	auto argc = &*args++;
+	auto argv = &*args++;
+	auto result = builder.CreateCall(native_main_type, native_main, { argc, argv, image });
+	builder.CreateRet(result);
+}
+
+void write_native_object_file(llvm_ir_program_t& program, const std::string& object_path){
+	QUARK_ASSERT(program.check_invariant());
+	QUARK_ASSERT(object_path.empty() == false);
+
+	auto& module = *program.module;
+	auto& context = module.getContext();
+	auto pointer_type = llvm::Type::getInt8PtrTy(context);
+	auto int64_type = llvm::Type::getInt64Ty(context);
+
+	const auto target_machine = make_native_target_machine(program.optimization_level);
+	module.setDataLayout(target_machine->createDataLayout());
+	module.setTargetTriple(target_machine->getTargetTriple().str());
+
+	const auto stubs = make_host_function_stubs(module, register_c_functions());
+	const auto symbols = internalize_program_symbols(module);
+
+	const auto program_json = make_native_program_json(
+		program.type_interner.interner,
+		make_runtime_type_infos(program.type_interner, module.getDataLayout()),
+		program.function_defs,
+		program.type_interner.vectors
+	);
+
+	//	Matches native_program_image_t.
+	auto image_type = llvm::StructType::get(context, { pointer_type, int64_type, pointer_type, pointer_type, int64_type, pointer_type, pointer_type });
+	auto image_value = llvm::ConstantStruct::get(image_type, {
+		make_c_string(module, json_to_compact_string(program_json)),
+		llvm::ConstantInt::get(int64_type, stubs.first.size()),
+		llvm::ConstantExpr::getBitCast(make_pointer_array(module, stubs.first, true, "floyd.host_function_names"), pointer_type),
+		llvm::ConstantExpr::getBitCast(stubs.second, pointer_type),
+		llvm::ConstantInt::get(int64_type, symbols.first.size()),
+		llvm::ConstantExpr::getBitCast(make_pointer_array(module, symbols.first, true, "floyd.symbol_names"), pointer_type),
+		llvm::ConstantExpr::getBitCast(make_pointer_array(module, symbols.second, true, "floyd.symbol_addresses"), pointer_type)
+	});
+	auto image = new llvm::GlobalVariable(module, image_type, true, llvm::GlobalValue::InternalLinkage, image_value, "floyd.native_image");
+	make_c_main(module, llvm::ConstantExpr::getBitCast(image, pointer_type));
+
+	QUARK_ASSERT(check_invariant__module(&module));
+
+	optimize_module(module, *target_machine, program.optimization_level);
+
+	llvm::SmallVector<char, 0> object;
+	llvm::raw_svector_ostream stream(object);
+	llvm::legacy::PassManager passes;
+	if(target_machine->addPassesToEmitFile(passes, stream, nullptr, llvm::TargetMachine::CGFT_ObjectFile)){
+		quark::throw_runtime_error("LLVM can't make object files for this target.");
+	}
+	passes.run(module);
+
+	SaveFile(object_path, reinterpret_cast<const uint8_t*>(object.data()), object.size());
+}
+
+void link_native_executable(const std::string& object_path, const std::string& executable_path, const native_link_settings_t& settings){
+	QUARK_ASSERT(object_path.empty() == false);
+	QUARK_ASSERT(executable_path.empty() == false);
+
+	if(DoesEntryExist(settings.runtime_library_path) == false){
+		quark::throw_runtime_error("Floyd runtime library not found: \"" + settings.runtime_library_path + "\".");
+	}
+
+	//	Run the linker directly, not through a shell, so paths with spaces or quotes can't change the command.
+	std::vector<std::string> args = { settings.linker, "-o", executable_path, object_path, settings.runtime_library_path };
+	args.insert(args.end(), settings.libraries.begin(), settings.libraries.end());
+
+	std::vector<char*> argv;
+	for(auto& e: args){
+		argv.push_back(&e[0]);
+	}
+	argv.push_back(nullptr);
+
+	const auto command = concat_strings_with_divider(args, " ");
+
+	pid_t pid = 0;
+	const auto spawn_result = posix_spawnp(&pid, argv[0], nullptr, nullptr, &argv[0], environ);
+	if(spawn_result != 0){
+		quark::throw_runtime_error("Can't run the linker: " + command + ": " + std::strerror(spawn_result));
+	}
+
+	int status = 0;
+	while(waitpid(pid, &status, 0) == -1){
+		if(errno != EINTR){
+			quark::throw_runtime_error("Linking failed, can't wait for the linker: " + command);
+		}
+	}
+	if(WIFEXITED(status) == false){
+		quark::throw_runtime_error("Linking failed, the linker was killed by signal " + std::to_string(WTERMSIG(status)) + ": " + command);
+	}
+	if(WEXITSTATUS(status) != 0){
+		quark::throw_runtime_error("Linking failed, the linker exited with status " + std::to_string(WEXITSTATUS(status)) + ": " + command);
+	}
+}
+
+void compile_native_helper(const std::string& program_source, const std::string& file, const std::string& executable_path, llvm_optimization_level optimization_level, const native_link_settings_t& settings, vector_backend vectors){
+	const auto cu = floyd::make_compilation_unit_nolib(program_source, file);
+	const auto pass3 = compile_to_sematic_ast__errors(cu);
+
+	llvm_instance_t instance;
+	auto program = generate_llvm_ir_program(instance, pass3, file, vectors);
+	program->optimization_level = optimization_level;
+
+	const auto object_path = executable_path + ".o";
+	write_native_object_file(*program, object_path);
+	link_native_executable(object_path, executable_path, settings);
+	std::remove(object_path.c_str());
+}
+
+
+}	//	floyd
+
+
+
+////////////////////////////////		TESTS
+
+
+
+QUARK_UNIT_TEST("", "write_native_object_file()", "", "object file"){
+	const auto cu = floyd::make_compilation_unit_nolib(R"(
+		func int main([string] args){
+			print(size(args))
+			return 3
+		}
+	)", "myfile.floyd");
+	const auto pass3 = compile_to_sematic_ast__errors(cu);
+
+	floyd::llvm_instance_t instance;
+	auto program = generate_llvm_ir_program(instance, pass3, "myfile.floyd");
+	program->optimization_level = floyd::llvm_optimization_level::k_O2;
+
+	const auto path = GetDirectories().temp_dir + "/floyd_unittest/native_object.o";
+	floyd::write_native_object_file(*program, path);
+
+	TFileInfo info;
+	QUARK_UT_VERIFY(GetFileInfo(path, info));
+	QUARK_UT_VERIFY(info.fFileSize > 0);
+	std::remove(path.c_str());
+}
+
+QUARK_UNIT_TEST("", "link_native_executable()", "linker fails", "exception with its exit status"){
+	const auto path = GetDirectories().temp_dir + "/floyd_unittest/native link's input.o";
+	SaveFile(path, reinterpret_cast<const uint8_t*>("x"), 1);
+
+	floyd::native_link_settings_t settings;
+	settings.runtime_library_path = path;
+	settings.linker = "false";
+	try{
+		floyd::link_native_executable(path, path + ".out", settings);
+		QUARK_UT_VERIFY(false);
+	}
+	catch(const std::runtime_error& e){
+		QUARK_UT_VERIFY(std::string(e.what()).find("exited with status 1") != std::string::npos);
+	}
+	std::remove(path.c_str());
+}
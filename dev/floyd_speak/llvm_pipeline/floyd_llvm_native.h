@@ -0,0 +1,62 @@
+//
+//  floyd_llvm_native.h
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-07-20.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#ifndef floyd_llvm_native_hpp
+#define floyd_llvm_native_hpp
+
+/*
+	Ahead-of-time compilation: makes a standalone executable from a Floyd program. No parsing, no code generation and
+	no JIT when it starts, which is what command line tools need.
+
+	The executable is the program's machine code in an object file, linked with the Floyd runtime library
+	(libfloyd_runtime.a). The object file also holds a C main() that calls floyd_native_main() in the runtime library,
+	with a native_program_image_t describing the program.
+
+	- The generated code calls runtime and host functions through small stubs that jump via a table. The runtime
+		library fills in the table at startup, so the object file has no undefined Floyd symbols.
+	- The program's own globals and functions get internal linkage so they can't clash with C library names. Their
+		addresses go in the image, by Floyd name.
+
+	Containers and processes are not supported yet: the executable runs the globals and main(), like run_llvm does
+	without a container.
+*/
+
+#include "floyd_llvm_codegen.h"
+#include "floyd_llvm_jit.h"
+
+#include <string>
+#include <vector>
+
+namespace floyd {
+
+
+struct native_link_settings_t {
+	//	Path to libfloyd_runtime.a.
+	std::string runtime_library_path;
+
+	std::string linker = "c++";
+
+	//	The libraries the runtime library itself needs.
+	std::vector<std::string> libraries = { "-lpthread" };
+};
+
+
+//	Writes an object file with the program's code, its native_program_image_t and a C main().
+//	Destroys program, uses its module.
+void write_native_object_file(llvm_ir_program_t& program, const std::string& object_path);
+
+//	Links an object file from write_native_object_file() with the runtime library into an executable.
+void link_native_executable(const std::string& object_path, const std::string& executable_path, const native_link_settings_t& settings);
+
+//	Helper that goes from source code to executable.
+void compile_native_helper(const std::string& program_source, const std::string& file, const std::string& executable_path, llvm_optimization_level optimization_level, const native_link_settings_t& settings, vector_backend vectors = vector_backend::k_carray);
+
+
+}	//	floyd
+
+#endif /* floyd_llvm_native_hpp */
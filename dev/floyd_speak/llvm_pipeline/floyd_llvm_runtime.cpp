@@ -8,40 +8,19 @@
 
 #include "floyd_llvm_runtime.h"
 
-#include "floyd_llvm_codegen.h"
+#include "floyd_llvm_hamt.h"
 #include "floyd_runtime.h"
 
 #include "sha1_class.h"
 #include "text_parser.h"
-#include "bytecode_host_functions.h"
 #include "file_handling.h"
 #include "os_process.h"
-#include "compiler_helpers.h"
-#include "pass3.h"
 #include "floyd_filelib.h"
-
-#include <llvm/ADT/APInt.h>
-#include <llvm/IR/Verifier.h>
-#include <llvm/ExecutionEngine/ExecutionEngine.h>
-#include <llvm/ExecutionEngine/GenericValue.h>
-#include <llvm/ExecutionEngine/MCJIT.h>
-#include <llvm/IR/Argument.h>
-#include <llvm/IR/BasicBlock.h>
-#include <llvm/IR/Constants.h>
-#include <llvm/IR/DerivedTypes.h>
-#include <llvm/IR/Function.h>
-#include <llvm/IR/InstrTypes.h>
-#include <llvm/IR/Instructions.h>
-#include <llvm/IR/LLVMContext.h>
-#include <llvm/IR/Module.h>
-#include <llvm/IR/Type.h>
-#include <llvm/IR/IRBuilder.h>
-#include <llvm/Support/Casting.h>
-#include <llvm/Support/TargetSelect.h>
-#include <llvm/Support/raw_ostream.h>
-#include <llvm/IR/DataLayout.h>
-
-#include "llvm/Bitcode/BitstreamWriter.h"
+#include "floyd_sort.h"
+#include "floyd_simd.h"
+#include "floyd_scheduler.h"
+#include "ast_typeid_helpers.h"
+#include "ast_json.h"
 
 #include <iostream>
 #include <fstream>
@@ -51,6 +30,7 @@
 #include <future>
 
 #include <condition_variable>
+#include <unordered_map>
 
 namespace floyd {
 
@@ -72,12 +52,20 @@ const function_def_t& find_function_def2(const std::vector<function_def_t>& func
 	auto it = std::find_if(function_defs.begin(), function_defs.end(), [&] (const function_def_t& e) { return e.def_name == function_name; } );
 	QUARK_ASSERT(it != function_defs.end());
 
-	QUARK_ASSERT(it->llvm_f != nullptr);
+	//	llvm_f is nullptr in native executables, they have no module.
+	QUARK_ASSERT(it->llvm_f != nullptr || it->floyd_function_id >= 0);
 	return *it;
 }
 
 
-void copy_elements(runtime_value_t dest[], runtime_value_t source[], uint64_t count){
+const runtime_type_info_t& lookup_type_info(const llvm_execution_engine_t& runtime, const typeid_t& type){
+	const auto index = lookup_interned_index(runtime.type_interner, type);
+	QUARK_ASSERT(index >= 0 && index < runtime.type_infos.size());
+	return runtime.type_infos[index];
+}
+
+
+void copy_elements(runtime_value_t dest[], const runtime_value_t source[], uint64_t count){
 	for(auto i = 0 ; i < count ; i++){
 		dest[i] = source[i];
 	}
@@ -91,16 +79,14 @@ void* get_global_ptr(llvm_execution_engine_t& ee, const std::string& name){
 	QUARK_ASSERT(ee.check_invariant());
 	QUARK_ASSERT(name.empty() == false);
 
-	const auto addr = ee.ee->getGlobalValueAddress(name);
-	return  (void*)addr;
+	return ee.symbols->get_global_ptr(name);
 }
 
 void* get_global_function(llvm_execution_engine_t& ee, const std::string& name){
 	QUARK_ASSERT(ee.check_invariant());
 	QUARK_ASSERT(name.empty() == false);
 
-	const auto addr = ee.ee->getFunctionAddress(name);
-	return (void*)addr;
+	return ee.symbols->get_global_function(name);
 }
 
 
@@ -250,20 +236,15 @@ runtime_value_t to_runtime_struct(llvm_execution_engine_t& runtime, const typeid
 	QUARK_ASSERT(runtime.check_invariant());
 	QUARK_ASSERT(value.check_invariant());
 
-	const llvm::DataLayout& data_layout = runtime.ee->getDataLayout();
-	auto t2 = get_exact_struct_type(runtime.type_interner, value.get_type());
-	const llvm::StructLayout* layout = data_layout.getStructLayout(t2);
-
-	const auto struct_bytes = layout->getSizeInBytes();
-
-	auto s = alloc_struct(runtime.heap, struct_bytes);
+	const auto& info = lookup_type_info(runtime, value.get_type());
+	auto s = alloc_struct(runtime.heap, info.struct_size);
 	const auto struct_base_ptr = s->get_data_ptr();
 
 	int member_index = 0;
 	const auto& struct_data = value.get_struct_value();
 
 	for(const auto& e: struct_data->_member_values){
-		const auto offset = layout->getElementOffset(member_index);
+		const auto offset = info.member_offsets[member_index];
 		const auto member_ptr = reinterpret_cast<void*>(struct_base_ptr + offset);
 		store_via_ptr(runtime, e.get_type(), member_ptr, e);
 		member_index++;
@@ -277,14 +258,12 @@ value_t from_runtime_struct(const llvm_execution_engine_t& runtime, const runtim
 	const auto& struct_def = type.get_struct();
 	const auto struct_base_ptr = encoded_value.struct_ptr->get_data_ptr();
 
-	const llvm::DataLayout& data_layout = runtime.ee->getDataLayout();
-	auto t2 = get_exact_struct_type(runtime.type_interner, type);
-	const llvm::StructLayout* layout = data_layout.getStructLayout(t2);
+	const auto& info = lookup_type_info(runtime, type);
 
 	std::vector<value_t> members;
 	int member_index = 0;
 	for(const auto& e: struct_def._members){
-		const auto offset = layout->getElementOffset(member_index);
+		const auto offset = info.member_offsets[member_index];
 		const auto member_ptr = reinterpret_cast<const runtime_value_t*>(struct_base_ptr + offset);
 		const auto member_value = from_runtime_value(runtime, *member_ptr, e._type);
 		members.push_back(member_value);
@@ -294,6 +273,40 @@ value_t from_runtime_struct(const llvm_execution_engine_t& runtime, const runtim
 }
 
 
+//	Points to vec's elements. A hamt vector has them spread over its trie, so they are copied to temp. Doesn't retain
+//	the elements.
+static const runtime_value_t* get_vec_elements(const llvm_execution_engine_t& r, const VEC_T& vec, const typeid_t& type, std::vector<runtime_value_t>& temp){
+	QUARK_ASSERT(type.is_vector());
+
+	if(is_vector_hamt(r.vectors, type)){
+		temp.resize(vec.get_element_count());
+		copy_vec_hamt_elements(vec, temp.data());
+		return temp.data();
+	}
+	else{
+		return vec.get_element_ptr();
+	}
+}
+
+//	Host functions build their [T] results as carrays. This gives the vector type's backend instead. Takes over the
+//	caller's reference to carray and its elements.
+static VEC_T* carray_to_backend(llvm_execution_engine_t& r, VEC_T* carray, const typeid_t& type){
+	QUARK_ASSERT(type.is_vector());
+	QUARK_ASSERT(carray->alloc.rc == 1);
+
+	if(is_vector_hamt(r.vectors, type)){
+		auto result = alloc_vec_hamt(r.heap, carray->get_element_ptr(), carray->get_element_count());
+
+		//	The elements now belong to result. Free carray without releasing them.
+		carray->alloc.rc = 0;
+		dispose_vec(*carray);
+		return result;
+	}
+	else{
+		return carray;
+	}
+}
+
 runtime_value_t to_runtime_vector(llvm_execution_engine_t& r, const value_t& value){
 	QUARK_ASSERT(r.check_invariant());
 	QUARK_ASSERT(value.check_invariant());
@@ -303,7 +316,6 @@ runtime_value_t to_runtime_vector(llvm_execution_engine_t& r, const value_t& val
 
 	const auto count = v0.size();
 	auto v = alloc_vec(r.heap, count, count);
-	auto result = runtime_value_t{ .vector_ptr = v };
 
 	const auto element_type = value.get_type().get_vector_element_type();
 	auto p = v->get_element_ptr();
@@ -313,7 +325,7 @@ runtime_value_t to_runtime_vector(llvm_execution_engine_t& r, const value_t& val
 //		retain_value(r, a, element_type);
 		p[i] = a;
 	}
-	return result;
+	return runtime_value_t{ .vector_ptr = carray_to_backend(r, v, value.get_type()) };
 }
 
 value_t from_runtime_vector(const llvm_execution_engine_t& runtime, const runtime_value_t encoded_value, const typeid_t& type){
@@ -325,7 +337,8 @@ value_t from_runtime_vector(const llvm_execution_engine_t& runtime, const runtim
 
 	std::vector<value_t> elements;
 	const auto count = vec->get_element_count();
-	auto p = vec->get_element_ptr();
+	std::vector<runtime_value_t> temp;
+	const auto p = get_vec_elements(runtime, *vec, type, temp);
 	for(int i = 0 ; i < count ; i++){
 		const auto value_encoded = p[i];
 		const auto value = from_runtime_value(runtime, value_encoded, element_type);
@@ -353,11 +366,10 @@ value_t from_runtime_dict(const llvm_execution_engine_t& runtime, const runtime_
 	const auto dict = encoded_value.dict_ptr;
 
 	std::map<std::string, value_t> values;
-	const auto& map2 = dict->get_map();
-	for(const auto& e: map2){
-		const auto value = from_runtime_value(runtime, e.second, value_type);
-		values.insert({ e.first, value} );
-	}
+	for_each_dict_entry(*dict, [&](const dict_entry_t& e){
+		const auto value = from_runtime_value(runtime, e.value, value_type);
+		values.insert({ from_runtime_string(runtime, runtime_value_t{ .vector_ptr = e.key }), value} );
+	});
 	const auto val = value_t::make_dict_value(type, values);
 	return val;
 }
@@ -403,7 +415,7 @@ runtime_value_t to_runtime_value(llvm_execution_engine_t& runtime, const value_t
 		}
 		runtime_value_t operator()(const typeid_t::typeid_type_t& e) const{
 			const auto t0 = value.get_typeid_value();
-			const auto t1 = lookup_runtime_type(runtime.type_interner.interner, t0);
+			const auto t1 = lookup_runtime_type(runtime.type_interner, t0);
 			return make_runtime_typeid(t1);
 		}
 
@@ -468,7 +480,7 @@ value_t from_runtime_value(const llvm_execution_engine_t& runtime, const runtime
 			}
 		}
 		value_t operator()(const typeid_t::typeid_type_t& e) const{
-			const auto type1 = lookup_type(runtime.type_interner.interner, encoded_value.typeid_itype);
+			const auto& type1 = lookup_type(runtime.type_interner, encoded_value.typeid_itype);
 			const auto type2 = value_t::make_typeid_value(type1);
 			return type2;
 		}
@@ -531,7 +543,7 @@ void hook(const std::string& s, floyd_runtime_t* frp, runtime_value_t arg){
 std::string gen_to_string(llvm_execution_engine_t& runtime, runtime_value_t arg_value, runtime_type_t arg_type){
 	QUARK_ASSERT(runtime.check_invariant());
 
-	const auto type = lookup_type(runtime.type_interner.interner, arg_type);
+	const auto& type = lookup_type(runtime.type_interner, arg_type);
 	const auto value = from_runtime_value(runtime, arg_value, type);
 	const auto a = to_compact_string2(value);
 	return a;
@@ -594,22 +606,69 @@ static void release_deep(llvm_execution_engine_t& runtime, runtime_value_t value
 	}
 }
 
+static hamt_element_ops_t make_hamt_element_ops(llvm_execution_engine_t& runtime, const typeid_t& element_type){
+	if(is_rc_value(element_type)){
+		return hamt_element_ops_t{
+			[&runtime, element_type](runtime_value_t e){ retain_value(runtime, e, element_type); },
+			[&runtime, element_type](runtime_value_t e){ release_deep(runtime, e, element_type); }
+		};
+	}
+	else{
+		return hamt_element_ops_t{};
+	}
+}
+
+//	Releases the elements and disposes the dict. Call when its RC has reached 0.
+static void dispose_dict_deep(llvm_execution_engine_t& runtime, DICT_T* dict, const typeid_t& type){
+	QUARK_ASSERT(dict != nullptr);
+	QUARK_ASSERT(type.is_dict());
+
+	//	Release all elements.
+	const auto element_type = type.get_dict_value_type();
+	if(is_rc_value(element_type)){
+		for_each_dict_entry(*dict, [&](const dict_entry_t& e){
+			release_deep(runtime, e.value, element_type);
+		});
+	}
+	dispose_dict(*dict);
+}
+
 static void release_dict_deep(llvm_execution_engine_t& runtime, DICT_T* dict, const typeid_t& type){
 	QUARK_ASSERT(dict != nullptr);
 	QUARK_ASSERT(type.is_dict());
 
 	if(dec_rc(dict->alloc) == 0){
+		dispose_dict_deep(runtime, dict, type);
+	}
+}
 
+static void dispose_vec_deep(llvm_execution_engine_t& runtime, VEC_T* vec, const typeid_t& type){
+	QUARK_ASSERT(vec != nullptr);
+	QUARK_ASSERT(type.is_string() || type.is_vector());
+
+	if(type.is_string()){
+		//	String has no elements to release.
+	}
+	else if(is_vector_hamt(runtime.vectors, type)){
+		//	The trie nodes own the elements, this releases them and frees vec.
+		dispose_vec_hamt(*vec, make_hamt_element_ops(runtime, type.get_vector_element_type()));
+		return;
+	}
+	else if(type.is_vector()){
 		//	Release all elements.
-		const auto element_type = type.get_dict_value_type();
+		const auto element_type = type.get_vector_element_type();
 		if(is_rc_value(element_type)){
-			auto m = dict->get_map();
-			for(const auto& e: m){
-				release_deep(runtime, e.second, element_type);
+			auto element_ptr = vec->get_element_ptr();
+			for(int i = 0 ; i < vec->get_element_count() ; i++){
+				const auto& element = element_ptr[i];
+				release_deep(runtime, element, element_type);
 			}
 		}
-		dispose_dict(*dict);
 	}
+	else{
+		QUARK_ASSERT(false);
+	}
+	dispose_vec(*vec);
 }
 
 static void release_vec_deep(llvm_execution_engine_t& runtime, VEC_T* vec, const typeid_t& type){
@@ -617,50 +676,37 @@ static void release_vec_deep(llvm_execution_engine_t& runtime, VEC_T* vec, const
 	QUARK_ASSERT(type.is_string() || type.is_vector());
 
 	if(dec_rc(vec->alloc) == 0){
-		if(type.is_string()){
-			//	String has no elements to release.
-		}
-		else if(type.is_vector()){
-			//	Release all elements.
-			const auto element_type = type.get_vector_element_type();
-			if(is_rc_value(element_type)){
-				auto element_ptr = vec->get_element_ptr();
-				for(int i = 0 ; i < vec->get_element_count() ; i++){
-					const auto& element = element_ptr[i];
-					release_deep(runtime, element, element_type);
-				}
-			}
-		}
-		else{
-			QUARK_ASSERT(false);
-		}
-		dispose_vec(*vec);
+		dispose_vec_deep(runtime, vec, type);
 	}
 }
 
 
+static void dispose_struct_deep(llvm_execution_engine_t& runtime, STRUCT_T* s, const typeid_t& type);
+
 static void release_struct_deep(llvm_execution_engine_t& runtime, STRUCT_T* s, const typeid_t& type){
 	QUARK_ASSERT(s != nullptr);
 
 	if(dec_rc(s->alloc) == 0){
-		const auto& struct_def = type.get_struct();
-		const auto struct_base_ptr = s->get_data_ptr();
-
-		const llvm::DataLayout& data_layout = runtime.ee->getDataLayout();
-		auto t2 = get_exact_struct_type(runtime.type_interner, type);
-		const llvm::StructLayout* layout = data_layout.getStructLayout(t2);
-
-		int member_index = 0;
-		for(const auto& e: struct_def._members){
-			if(is_rc_value(e._type)){
-				const auto offset = layout->getElementOffset(member_index);
-				const auto member_ptr = reinterpret_cast<const runtime_value_t*>(struct_base_ptr + offset);
-				release_deep(runtime, *member_ptr, e._type);
-				member_index++;
-			}
+		dispose_struct_deep(runtime, s, type);
+	}
+}
+
+static void dispose_struct_deep(llvm_execution_engine_t& runtime, STRUCT_T* s, const typeid_t& type){
+	QUARK_ASSERT(s != nullptr);
+
+	const auto& struct_def = type.get_struct();
+	const auto struct_base_ptr = s->get_data_ptr();
+	const auto& info = lookup_type_info(runtime, type);
+
+	for(int member_index = 0 ; member_index < struct_def._members.size() ; member_index++){
+		const auto& e = struct_def._members[member_index];
+		if(is_rc_value(e._type)){
+			const auto offset = info.member_offsets[member_index];
+			const auto member_ptr = reinterpret_cast<const runtime_value_t*>(struct_base_ptr + offset);
+			release_deep(runtime, *member_ptr, e._type);
 		}
-		dispose_struct(*s);
 	}
+	dispose_struct(*s);
 }
 
 
@@ -674,244 +720,64 @@ static void release_struct_deep(llvm_execution_engine_t& runtime, STRUCT_T* s, c
 ////////////////////////////////////////////////////////////////////////////////
 
 
-////////////////////////////////		fr_retain_vec()
+////////////////////////////////		fr_dispose_vec()
 
+//	The generated code changes the RCs itself, see generate_retain() and generate_release(). It only calls these
+//	when an RC reaches 0, to release the members and free the value.
 
-void fr_retain_vec(floyd_runtime_t* frp, VEC_T* vec, runtime_type_t type0){
-	auto& r = get_floyd_runtime(frp);
-#if DEBUG
-	QUARK_ASSERT(vec != nullptr);
-	const auto type = lookup_type(r.type_interner.interner, type0);
-	QUARK_ASSERT(type.is_string() || type.is_vector());
-	QUARK_ASSERT(is_rc_value(type));
-#endif
 
-	inc_rc(vec->alloc);
-}
-
-host_func_t fr_retain_vec__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
-	llvm::FunctionType* function_type = llvm::FunctionType::get(
-		llvm::Type::getVoidTy(context),
-		{
-			make_frp_type(interner),
-			make_generic_vec_type(interner)->getPointerTo(),
-			make_runtime_type_type(context)
-		},
-		false
-	);
-	return { "fr_retain_vec", function_type, reinterpret_cast<void*>(fr_retain_vec) };
-}
-
-
-////////////////////////////////		fr_release_vec()
-
-
-void fr_release_vec(floyd_runtime_t* frp, VEC_T* vec, runtime_type_t type0){
+void fr_dispose_vec(floyd_runtime_t* frp, VEC_T* vec, runtime_type_t type0){
 	auto& r = get_floyd_runtime(frp);
 	QUARK_ASSERT(vec != nullptr);
-	const auto type = lookup_type(r.type_interner.interner, type0);
+	QUARK_ASSERT(vec->alloc.rc == 0);
+	const auto& type = lookup_type(r.type_interner, type0);
 	QUARK_ASSERT(type.is_string() || type.is_vector());
 
-	release_vec_deep(r, vec, type);
+	dispose_vec_deep(r, vec, type);
 }
 
-host_func_t fr_release_vec__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
-	llvm::FunctionType* function_type = llvm::FunctionType::get(
-		llvm::Type::getVoidTy(context),
-		{
-			make_frp_type(interner),
-			make_generic_vec_type(interner)->getPointerTo(),
-			make_runtime_type_type(context)
-		},
-		false
-	);
-	return { "fr_release_vec", function_type, reinterpret_cast<void*>(fr_release_vec) };
-}
-
-
 
 
+////////////////////////////////		fr_dispose_dict()
 
-////////////////////////////////		fr_retain_dict()
 
-
-void fr_retain_dict(floyd_runtime_t* frp, DICT_T* dict, runtime_type_t type0){
+void fr_dispose_dict(floyd_runtime_t* frp, DICT_T* dict, runtime_type_t type0){
 	auto& r = get_floyd_runtime(frp);
 	QUARK_ASSERT(dict != nullptr);
-	const auto type = lookup_type(r.type_interner.interner, type0);
-	QUARK_ASSERT(is_rc_value(type));
-
+	QUARK_ASSERT(dict->alloc.rc == 0);
+	const auto& type = lookup_type(r.type_interner, type0);
 	QUARK_ASSERT(type.is_dict());
 
-	inc_rc(dict->alloc);
+	dispose_dict_deep(r, dict, type);
 }
 
-host_func_t fr_retain_dict__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
-	llvm::FunctionType* function_type = llvm::FunctionType::get(
-		llvm::Type::getVoidTy(context),
-		{
-			make_frp_type(interner),
-			make_generic_dict_type(interner)->getPointerTo(),
-			make_runtime_type_type(context)
-		},
-		false
-	);
-	return { "fr_retain_dict", function_type, reinterpret_cast<void*>(fr_retain_dict) };
-}
 
 
-////////////////////////////////		fr_release_dict()
+////////////////////////////////		fr_dispose_json()
 
 
+void fr_dispose_json(floyd_runtime_t* frp, JSON_T* json, runtime_type_t type0){
+	QUARK_ASSERT(json != nullptr);
+	QUARK_ASSERT(json->alloc.rc == 0);
 
-void fr_release_dict(floyd_runtime_t* frp, DICT_T* dict, runtime_type_t type0){
-	auto& r = get_floyd_runtime(frp);
-	QUARK_ASSERT(dict != nullptr);
-	const auto type = lookup_type(r.type_interner.interner, type0);
-	QUARK_ASSERT(type.is_dict());
-
-	release_dict_deep(r, dict, type);
+	dispose_json(*json);
 }
 
-host_func_t fr_release_dict__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
-	llvm::FunctionType* function_type = llvm::FunctionType::get(
-		llvm::Type::getVoidTy(context),
-		{
-			make_frp_type(interner),
-			make_generic_dict_type(interner)->getPointerTo(),
-			make_runtime_type_type(context)
-		},
-		false
-	);
-	return { "fr_release_dict", function_type, reinterpret_cast<void*>(fr_release_dict) };
-}
-
-
-////////////////////////////////		fr_retain_json()
-
-
-void fr_retain_json(floyd_runtime_t* frp, JSON_T* json, runtime_type_t type0){
-	auto& r = get_floyd_runtime(frp);
-
-	const auto type = lookup_type(r.type_interner.interner, type0);
-	QUARK_ASSERT(is_rc_value(type));
-
-	//	NOTICE: Floyd runtime() init will destruct globals, including json_value::null.
-	if(json == nullptr){
-	}
-	else{
-		QUARK_ASSERT(type.is_json_value());
-
-		inc_rc(json->alloc);
-	}
-}
-
-host_func_t fr_retain_json__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
-	llvm::FunctionType* function_type = llvm::FunctionType::get(
-		llvm::Type::getVoidTy(context),
-		{
-			make_frp_type(interner),
-			get_exact_llvm_type(interner, typeid_t::make_json_value()),
-			make_runtime_type_type(context)
-		},
-		false
-	);
-	return { "fr_retain_json", function_type, reinterpret_cast<void*>(fr_retain_json) };
-}
-
-
-////////////////////////////////		fr_release_json()
-
-
-void fr_release_json(floyd_runtime_t* frp, JSON_T* json, runtime_type_t type0){
-	auto& r = get_floyd_runtime(frp);
-	const auto type = lookup_type(r.type_interner.interner, type0);
-	QUARK_ASSERT(type.is_json_value());
-
-	//	NOTICE: Floyd runtime() init will destruct globals, including json_value::null.
-	if(json == nullptr){
-	}
-	else{
-		QUARK_ASSERT(json != nullptr);
-		if(dec_rc(json->alloc) == 0){
-			dispose_json(*json);
-		}
-	}
-}
-
-host_func_t fr_release_json__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
-	llvm::FunctionType* function_type = llvm::FunctionType::get(
-		llvm::Type::getVoidTy(context),
-		{
-			make_frp_type(interner),
-			get_exact_llvm_type(interner, typeid_t::make_json_value()),
-			make_runtime_type_type(context)
-		},
-		false
-	);
-	return { "fr_release_json", function_type, reinterpret_cast<void*>(fr_release_json) };
-}
-
-
-
-
-
-
-
-
-
-
-////////////////////////////////		fr_retain_struct()
-
-
-void fr_retain_struct(floyd_runtime_t* frp, STRUCT_T* v, runtime_type_t type0){
-	auto& r = get_floyd_runtime(frp);
-
-	const auto type = lookup_type(r.type_interner.interner, type0);
-	QUARK_ASSERT(is_rc_value(type));
-	QUARK_ASSERT(type.is_struct());
-
-	inc_rc(v->alloc);
-}
-
-host_func_t fr_retain_struct__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
-	llvm::FunctionType* function_type = llvm::FunctionType::get(
-		llvm::Type::getVoidTy(context),
-		{
-			make_frp_type(interner),
-			get_generic_struct_type(interner)->getPointerTo(),
-			make_runtime_type_type(context)
-		},
-		false
-	);
-	return { "fr_retain_struct", function_type, reinterpret_cast<void*>(fr_retain_struct) };
-}
 
 
-////////////////////////////////		fr_release_struct()
+////////////////////////////////		fr_dispose_struct()
 
 
-void fr_release_struct(floyd_runtime_t* frp, STRUCT_T* v, runtime_type_t type0){
+void fr_dispose_struct(floyd_runtime_t* frp, STRUCT_T* v, runtime_type_t type0){
 	auto& r = get_floyd_runtime(frp);
-	const auto type = lookup_type(r.type_interner.interner, type0);
+	QUARK_ASSERT(v != nullptr);
+	QUARK_ASSERT(v->alloc.rc == 0);
+	const auto& type = lookup_type(r.type_interner, type0);
 	QUARK_ASSERT(type.is_struct());
 
-	QUARK_ASSERT(v != nullptr);
-	release_struct_deep(r, v, type);
+	dispose_struct_deep(r, v, type);
 }
 
-host_func_t fr_release_struct__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
-	llvm::FunctionType* function_type = llvm::FunctionType::get(
-		llvm::Type::getVoidTy(context),
-		{
-			make_frp_type(interner),
-			get_generic_struct_type(interner)->getPointerTo(),
-			make_runtime_type_type(context)
-		},
-		false
-	);
-	return { "fr_release_struct", function_type, reinterpret_cast<void*>(fr_release_struct) };
-}
 
 
 
@@ -927,17 +793,6 @@ VEC_T* floyd_runtime__allocate_vector(floyd_runtime_t* frp, uint64_t element_cou
 	return v;
 }
 
-host_func_t floyd_runtime__allocate_vector__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
-	llvm::FunctionType* function_type = llvm::FunctionType::get(
-		make_generic_vec_type(interner)->getPointerTo(),
-		{
-			make_frp_type(interner),
-			llvm::Type::getInt64Ty(context)
-		},
-		false
-	);
-	return { "floyd_runtime__allocate_vector", function_type, reinterpret_cast<void*>(floyd_runtime__allocate_vector) };
-}
 
 
 ////////////////////////////////		allocate_string_from_strptr()
@@ -951,18 +806,6 @@ VEC_T* fr_alloc_kstr(floyd_runtime_t* frp, const char* s, uint64_t size){
 	return a.vector_ptr;
 }
 
-host_func_t fr_alloc_kstr__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
-	llvm::FunctionType* function_type = llvm::FunctionType::get(
-		make_generic_vec_type(interner)->getPointerTo(),
-		{
-			make_frp_type(interner),
-			llvm::Type::getInt8PtrTy(context),
-			llvm::Type::getInt64Ty(context)
-		},
-		false
-	);
-	return { "fr_alloc_kstr", function_type, reinterpret_cast<void*>(fr_alloc_kstr) };
-}
 
 
 ////////////////////////////////		floyd_runtime__concatunate_vectors()
@@ -975,11 +818,26 @@ VEC_T* floyd_runtime__concatunate_vectors(floyd_runtime_t* frp, runtime_type_t t
 	QUARK_ASSERT(rhs != nullptr);
 	QUARK_ASSERT(rhs->check_invariant());
 
-	const auto type0 = lookup_type(r.type_interner.interner, type);
+	const auto& type0 = lookup_type(r.type_interner, type);
 	if(type0.is_string()){
 		const auto result = from_runtime_string(r, runtime_value_t{ .vector_ptr = lhs }) + from_runtime_string(r, runtime_value_t{ .vector_ptr = rhs } );
 		return to_runtime_string(r, result).vector_ptr;
 	}
+	else if(is_vector_hamt(r.vectors, type0)){
+		//	Shares lhs's trie and appends rhs's elements to it.
+		const auto element_type = type0.get_vector_element_type();
+		const auto ops = make_hamt_element_ops(r, element_type);
+
+		std::vector<runtime_value_t> temp;
+		const auto rhs_ptr = get_vec_elements(r, *rhs, type0, temp);
+
+		auto result = subset_vec_hamt(r.heap, *lhs, 0, lhs->get_element_count());
+		for(uint64_t i = 0 ; i < rhs->get_element_count() ; i++){
+			retain_value(r, rhs_ptr[i], element_type);
+			result = store_vec_hamt_element_owned(r.heap, result, result->get_element_count(), rhs_ptr[i], ops);
+		}
+		return result;
+	}
 	else{
 		auto count2 = lhs->get_element_count() + rhs->get_element_count();
 
@@ -1014,19 +872,6 @@ VEC_T* floyd_runtime__concatunate_vectors(floyd_runtime_t* frp, runtime_type_t t
 	}
 }
 
-host_func_t floyd_runtime__concatunate_vectors__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
-	llvm::FunctionType* function_type = llvm::FunctionType::get(
-		make_generic_vec_type(interner)->getPointerTo(),
-		{
-			make_frp_type(interner),
-			make_runtime_type_type(context),
-			make_generic_vec_type(interner)->getPointerTo(),
-			make_generic_vec_type(interner)->getPointerTo()
-		},
-		false
-	);
-	return { "floyd_runtime__concatunate_vectors", function_type, reinterpret_cast<void*>(floyd_runtime__concatunate_vectors) };
-}
 
 
 
@@ -1041,16 +886,6 @@ void* floyd_runtime__allocate_dict(floyd_runtime_t* frp){
 	return v;
 }
 
-host_func_t floyd_runtime__allocate_dict__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
-	llvm::FunctionType* function_type = llvm::FunctionType::get(
-		make_generic_dict_type(interner)->getPointerTo(),
-		{
-			make_frp_type(interner)
-		},
-		false
-	);
-	return { "floyd_runtime__allocate_dict", function_type, reinterpret_cast<void*>(floyd_runtime__allocate_dict) };
-}
 
 
 
@@ -1059,26 +894,12 @@ host_func_t floyd_runtime__allocate_dict__make(llvm::LLVMContext& context, const
 
 void floyd_runtime__store_dict_mutable(floyd_runtime_t* frp, DICT_T* dict, runtime_value_t key, runtime_value_t element_value, runtime_type_t element_type){
 	auto& r = get_floyd_runtime(frp);
+	QUARK_ASSERT(r.check_invariant());
+	QUARK_ASSERT(dict->check_invariant());
 
-	const auto key_string = from_runtime_string(r, key);
-
-	dict->get_map_mut().insert_or_assign(key_string, element_value);
+	store_dict_value(*dict, key, element_value);
 }
 
-host_func_t floyd_runtime__store_dict_mutable__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
-	llvm::FunctionType* function_type = llvm::FunctionType::get(
-		llvm::Type::getVoidTy(context),
-		{
-			make_frp_type(interner),
-			make_generic_dict_type(interner)->getPointerTo(),
-			get_exact_llvm_type(interner, typeid_t::make_string()),
-			make_runtime_value_type(context),
-			make_runtime_type_type(context)
-		},
-		false
-	);
-	return { "floyd_runtime__store_dict_mutable", function_type, reinterpret_cast<void*>(floyd_runtime__store_dict_mutable) };
-}
 
 
 
@@ -1087,30 +908,18 @@ host_func_t floyd_runtime__store_dict_mutable__make(llvm::LLVMContext& context,
 
 runtime_value_t floyd_runtime__lookup_dict(floyd_runtime_t* frp, DICT_T* dict, runtime_value_t s){
 	auto& r = get_floyd_runtime(frp);
+	QUARK_ASSERT(r.check_invariant());
+	QUARK_ASSERT(dict->check_invariant());
 
-	const auto& m = dict->get_map();
-	const auto key_string = from_runtime_string(r, s);
-	const auto it = m.find(key_string);
-	if(it == m.end()){
+	const auto e = find_dict_entry(*dict, s);
+	if(e == nullptr){
 		throw std::exception();
 	}
 	else{
-		return it->second;
+		return e->value;
 	}
 }
 
-host_func_t floyd_runtime__lookup_dict__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
-	llvm::FunctionType* function_type = llvm::FunctionType::get(
-		make_runtime_value_type(context),
-		{
-			make_frp_type(interner),
-			make_generic_dict_type(interner)->getPointerTo(),
-			get_exact_llvm_type(interner, typeid_t::make_string())
-		},
-		false
-	);
-	return { "floyd_runtime__lookup_dict", function_type, reinterpret_cast<void*>(floyd_runtime__lookup_dict) };
-}
 
 
 
@@ -1122,7 +931,7 @@ host_func_t floyd_runtime__lookup_dict__make(llvm::LLVMContext& context, const l
 JSON_T* floyd_runtime__allocate_json(floyd_runtime_t* frp, runtime_value_t arg0_value, runtime_type_t arg0_type){
 	auto& r = get_floyd_runtime(frp);
 
-	const auto type0 = lookup_type(r.type_interner.interner, arg0_type);
+	const auto& type0 = lookup_type(r.type_interner, arg0_type);
 	const auto value = from_runtime_value(r, arg0_value, type0);
 
 	const auto a = value_to_ast_json(value, json_tags::k_plain);
@@ -1130,18 +939,6 @@ JSON_T* floyd_runtime__allocate_json(floyd_runtime_t* frp, runtime_value_t arg0_
 	return result;
 }
 
-host_func_t floyd_runtime__allocate_json__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
-	llvm::FunctionType* function_type = llvm::FunctionType::get(
-		get_exact_llvm_type(interner, typeid_t::make_json_value()),
-		{
-			make_frp_type(interner),
-			make_runtime_value_type(context),
-			make_runtime_type_type(context)
-		},
-		false
-	);
-	return { "floyd_runtime__allocate_json", function_type, reinterpret_cast<void*>(floyd_runtime__allocate_json) };
-}
 
 
 
@@ -1154,7 +951,7 @@ JSON_T* floyd_runtime__lookup_json(floyd_runtime_t* frp, JSON_T* json_ptr, runti
 	auto& r = get_floyd_runtime(frp);
 
 	const auto& json = json_ptr->get_json();
-	const auto type0 = lookup_type(r.type_interner.interner, arg0_type);
+	const auto& type0 = lookup_type(r.type_interner, arg0_type);
 	const auto value = from_runtime_value(r, arg0_value, type0);
 
 	if(json.is_object()){
@@ -1179,19 +976,6 @@ JSON_T* floyd_runtime__lookup_json(floyd_runtime_t* frp, JSON_T* json_ptr, runti
 	}
 }
 
-host_func_t floyd_runtime__lookup_json__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
-	llvm::FunctionType* function_type = llvm::FunctionType::get(
-		get_exact_llvm_type(interner, typeid_t::make_json_value()),
-		{
-			make_frp_type(interner),
-			get_exact_llvm_type(interner, typeid_t::make_json_value()),
-			make_runtime_value_type(context),
-			make_runtime_type_type(context)
-		},
-		false
-	);
-	return { "floyd_runtime__lookup_json", function_type, reinterpret_cast<void*>(floyd_runtime__lookup_json) };
-}
 
 
 
@@ -1215,17 +999,6 @@ runtime_value_t floyd_runtime__json_to_string(floyd_runtime_t* frp, JSON_T* json
 	}
 }
 
-host_func_t floyd_runtime__json_to_string__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
-	llvm::FunctionType* function_type = llvm::FunctionType::get(
-		get_exact_llvm_type(interner, typeid_t::make_string()),
-		{
-			make_frp_type(interner),
-			get_exact_llvm_type(interner, typeid_t::make_json_value())
-		},
-		false
-	);
-	return { "floyd_runtime__json_to_string", function_type, reinterpret_cast<void*>(floyd_runtime__json_to_string) };
-}
 
 
 
@@ -1238,7 +1011,7 @@ host_func_t floyd_runtime__json_to_string__make(llvm::LLVMContext& context, cons
 int8_t floyd_runtime__compare_values(floyd_runtime_t* frp, int64_t op, const runtime_type_t type, runtime_value_t lhs, runtime_value_t rhs){
 	auto& r = get_floyd_runtime(frp);
 
-	const auto value_type = lookup_type(r.type_interner.interner, type);
+	const auto& value_type = lookup_type(r.type_interner, type);
 
 	const auto left_value = from_runtime_value(r, lhs, value_type);
 	const auto right_value = from_runtime_value(r, rhs, value_type);
@@ -1271,20 +1044,6 @@ int8_t floyd_runtime__compare_values(floyd_runtime_t* frp, int64_t op, const run
 	}
 }
 
-host_func_t floyd_runtime__compare_values__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
-	llvm::FunctionType* function_type = llvm::FunctionType::get(
-		llvm::Type::getInt1Ty(context),
-		{
-			make_frp_type(interner),
-			llvm::Type::getInt64Ty(context),
-			make_runtime_type_type(context),
-			make_runtime_value_type(context),
-			make_runtime_value_type(context)
-		},
-		false
-	);
-	return { "floyd_runtime__compare_values", function_type, reinterpret_cast<void*>(floyd_runtime__compare_values) };
-}
 
 
 ////////////////////////////////		allocate_vector()
@@ -1298,17 +1057,6 @@ STRUCT_T* floyd_runtime__allocate_struct(floyd_runtime_t* frp, uint64_t size){
 	return v;
 }
 
-host_func_t floyd_runtime__allocate_struct__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
-	llvm::FunctionType* function_type = llvm::FunctionType::get(
-		get_generic_struct_type(interner)->getPointerTo(),
-		{
-			make_frp_type(interner),
-			llvm::Type::getInt64Ty(context)
-		},
-		false
-	);
-	return { "floyd_runtime__allocate_struct", function_type, reinterpret_cast<void*>(floyd_runtime__allocate_vector) };
-}
 
 
 
@@ -1320,8 +1068,8 @@ const WIDE_RETURN_T fr_update_struct_member(floyd_runtime_t* frp, STRUCT_T* s, r
 	QUARK_ASSERT(s != nullptr);
 	QUARK_ASSERT(member_index != -1);
 
-	const auto type0 = lookup_type(r.type_interner.interner, struct_type);
-	const auto new_value_type0 = lookup_type(r.type_interner.interner, new_value_type);
+	const auto& type0 = lookup_type(r.type_interner, struct_type);
+	const auto& new_value_type0 = lookup_type(r.type_interner, new_value_type);
 	QUARK_ASSERT(type0.is_struct());
 
 	const auto source_struct_ptr = s;
@@ -1333,82 +1081,187 @@ const WIDE_RETURN_T fr_update_struct_member(floyd_runtime_t* frp, STRUCT_T* s, r
 
 	//	Make copy of struct, overwrite member in copy.
 
-	auto& struct_type_llvm = *get_exact_struct_type(r.type_interner, type0);
-
-	const llvm::DataLayout& data_layout = r.ee->getDataLayout();
-	const llvm::StructLayout* layout = data_layout.getStructLayout(&struct_type_llvm);
-	const auto struct_bytes = layout->getSizeInBytes();
+	const auto& info = lookup_type_info(r, type0);
+	const auto struct_bytes = info.struct_size;
 
 	//??? Touches memory twice.
 	auto struct_ptr = alloc_struct(r.heap, struct_bytes);
 	auto struct_base_ptr = struct_ptr->get_data_ptr();
 	std::memcpy(struct_base_ptr, source_struct_ptr->get_data_ptr(), struct_bytes);
 
-	const auto member_offset = layout->getElementOffset(member_index);
+	const auto member_offset = info.member_offsets[member_index];
 	const auto member_ptr = reinterpret_cast<void*>(struct_base_ptr + member_offset);
 	store_via_ptr(r, new_value_type0, member_ptr, member_value);
 
 	//	Retain every member of new struct.
-	{
-		int member_index = 0;
-		for(const auto& e: struct_def._members){
-			if(is_rc_value(e._type)){
-				const auto offset = layout->getElementOffset(member_index);
-				const auto member_ptr = reinterpret_cast<const runtime_value_t*>(struct_base_ptr + offset);
-				retain_value(r, *member_ptr, e._type);
-				member_index++;
-			}
+	for(int i = 0 ; i < struct_def._members.size() ; i++){
+		const auto& e = struct_def._members[i];
+		if(is_rc_value(e._type)){
+			const auto offset = info.member_offsets[i];
+			const auto member_ptr = reinterpret_cast<const runtime_value_t*>(struct_base_ptr + offset);
+			retain_value(r, *member_ptr, e._type);
 		}
 	}
 
 	return make_wide_return_structptr(struct_ptr);
 }
-host_func_t fr_update_struct_member__make(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
-	llvm::FunctionType* function_type = llvm::FunctionType::get(
-		get_generic_struct_type(interner)->getPointerTo(),
-		{
-			make_frp_type(interner),
-			get_generic_struct_type(interner)->getPointerTo(),
-			make_runtime_type_type(context),
-			llvm::Type::getInt64Ty(context),
-			make_runtime_value_type(context),
-			make_runtime_type_type(context)
-		},
-		false
-	);
-	return { "fr_update_struct_member", function_type, reinterpret_cast<void*>(fr_update_struct_member) };
+
+
+////////////////////////////////		fr_push_back_owned()
+
+
+/*
+	A VEC_T can have room for more elements than it has: alloc.allocation_word_count is the capacity and
+	alloc.data_a the element count. Strings keep 8 chars per word.
+*/
+
+static uint64_t get_vec_word_count(bool is_string, uint64_t element_count){
+	return is_string ? size_to_allocation_blocks(element_count) : element_count;
 }
 
+//	Makes a new VEC_T with vec's elements and room for allocation_count words. Doesn't retain the elements.
+static VEC_T* copy_vec_elements(heap_t& heap, const VEC_T& vec, bool is_string, uint64_t allocation_count){
+	const auto count = vec.get_element_count();
+	QUARK_ASSERT(allocation_count >= get_vec_word_count(is_string, count));
 
+	auto result = alloc_vec(heap, allocation_count, count);
+	std::memcpy(result->get_element_ptr(), vec.get_element_ptr(), get_vec_word_count(is_string, count) * sizeof(uint64_t));
+	return result;
+}
 
+//	vec must have room for one more element. Doesn't retain element.
+static void append_element(VEC_T& vec, bool is_string, runtime_value_t element){
+	const auto count = vec.get_element_count();
+	QUARK_ASSERT(get_vec_word_count(is_string, count + 1) <= vec.get_allocation_count());
 
-std::vector<host_func_t> get_runtime_functions(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
-	std::vector<host_func_t> result = {
-		fr_retain_vec__make(context, interner),
-		fr_release_vec__make(context, interner),
+	if(is_string){
+		reinterpret_cast<char*>(vec.get_element_ptr())[count] = static_cast<char>(element.int_value);
+	}
+	else{
+		vec.get_element_ptr()[count] = element;
+	}
+	vec.alloc.data_a = count + 1;
+}
 
-		fr_retain_dict__make(context, interner),
-		fr_release_dict__make(context, interner),
+//	Makes a new VEC_T with vec's elements plus element, retaining all of them. vec is not changed.
+static VEC_T* push_back_copy(llvm_execution_engine_t& r, const VEC_T& vec, const typeid_t& vec_type, runtime_value_t element){
+	const auto is_string = vec_type.is_string();
+	const auto count = vec.get_element_count();
 
-		fr_retain_json__make(context, interner),
-		fr_release_json__make(context, interner),
+	auto result = copy_vec_elements(r.heap, vec, is_string, get_vec_word_count(is_string, count + 1));
+	if(is_string == false){
+		const auto& element_type = vec_type.get_vector_element_type();
+		if(is_rc_value(element_type)){
+			const auto element_ptr = result->get_element_ptr();
+			for(int i = 0 ; i < count ; i++){
+				retain_value(r, element_ptr[i], element_type);
+			}
+			retain_value(r, element, element_type);
+		}
+	}
+	append_element(*result, is_string, element);
+	return result;
+}
 
-		fr_retain_struct__make(context, interner),
-		fr_release_struct__make(context, interner),
+//	The generated code for "a = push_back(a, e)" calls this instead of push_back(). Takes over the caller's reference to
+//	vec. When that is the only reference, nobody else can see vec change, so we append in place, doubling the capacity
+//	when it's full. A loop of push_back() is then O(n) instead of O(n^2). Returns the vector with the element, which the
+//	caller owns. The caller still owns element.
+VEC_T* fr_push_back_owned(floyd_runtime_t* frp, VEC_T* vec, runtime_value_t element, runtime_type_t vec_type0){
+	auto& r = get_floyd_runtime(frp);
+	QUARK_ASSERT(vec != nullptr && vec->check_invariant());
+	const auto& vec_type = lookup_type(r.type_interner, vec_type0);
+	QUARK_ASSERT(vec_type.is_string() || vec_type.is_vector());
+
+	if(is_vector_hamt(r.vectors, vec_type)){
+		//	Appends in place if nobody else has vec, else shares all but the last path of the trie.
+		const auto& element_type = vec_type.get_vector_element_type();
+		retain_value(r, element, element_type);
+		return store_vec_hamt_element_owned(r.heap, vec, vec->get_element_count(), element, make_hamt_element_ops(r, element_type));
+	}
+	else if(vec->alloc.rc == 1){
+		const auto is_string = vec_type.is_string();
+		const auto words_needed = get_vec_word_count(is_string, vec->get_element_count() + 1);
+		if(words_needed > vec->get_allocation_count()){
+			auto vec2 = copy_vec_elements(r.heap, *vec, is_string, std::max<uint64_t>(words_needed, vec->get_allocation_count() * 2));
+
+			//	The elements now belong to vec2. Free vec without releasing them.
+			vec->alloc.rc = 0;
+			dispose_vec(*vec);
+			vec = vec2;
+		}
+
+		if(is_string == false && is_rc_value(vec_type.get_vector_element_type())){
+			retain_value(r, element, vec_type.get_vector_element_type());
+		}
+		append_element(*vec, is_string, element);
+		return vec;
+	}
+	else{
+		auto result = push_back_copy(r, *vec, vec_type, element);
+		release_vec_deep(r, vec, vec_type);
+		return result;
+	}
+}
+
+
+
+////////////////////////////////		fr_vec_to_hamt()
+
+
+//	The generated code builds vector literals as carrays, then calls this when the program uses hamt vectors. Takes
+//	over the caller's reference to vec and returns the hamt vector, which the caller owns.
+VEC_T* fr_vec_to_hamt(floyd_runtime_t* frp, VEC_T* vec, runtime_type_t vec_type0){
+	auto& r = get_floyd_runtime(frp);
+	QUARK_ASSERT(vec != nullptr && vec->check_invariant());
+	const auto& vec_type = lookup_type(r.type_interner, vec_type0);
+	QUARK_ASSERT(is_vector_hamt(r.vectors, vec_type));
+
+	return carray_to_backend(r, vec, vec_type);
+}
 
-		floyd_runtime__allocate_vector__make(context, interner),
-		fr_alloc_kstr__make(context, interner),
-		floyd_runtime__concatunate_vectors__make(context, interner),
-		floyd_runtime__allocate_dict__make(context, interner),
-		floyd_runtime__store_dict_mutable__make(context, interner),
-		floyd_runtime__lookup_dict__make(context, interner),
-		floyd_runtime__allocate_json__make(context, interner),
-		floyd_runtime__lookup_json__make(context, interner),
-		floyd_runtime__json_to_string__make(context, interner),
-		floyd_runtime__compare_values__make(context, interner),
-		floyd_runtime__allocate_struct__make(context, interner),
 
-		fr_update_struct_member__make(context, interner)
+
+////////////////////////////////		fr_lookup_vec_hamt()
+
+
+//	The generated code for "a[i]" when a is a hamt vector. Doesn't retain the element.
+runtime_value_t fr_lookup_vec_hamt(floyd_runtime_t* frp, VEC_T* vec, int64_t index){
+	QUARK_ASSERT(vec != nullptr && vec->check_invariant());
+
+	if(index < 0 || index >= vec->get_element_count()){
+		quark::throw_runtime_error("Vector lookup out of bounds.");
+	}
+	return load_vec_hamt_element(*vec, index);
+}
+
+
+
+
+
+std::map<std::string, void*> get_runtime_functions_map(){
+	const std::map<std::string, void*> result = {
+		{ "fr_dispose_vec", reinterpret_cast<void *>(&fr_dispose_vec) },
+		{ "fr_dispose_dict", reinterpret_cast<void *>(&fr_dispose_dict) },
+		{ "fr_dispose_json", reinterpret_cast<void *>(&fr_dispose_json) },
+		{ "fr_dispose_struct", reinterpret_cast<void *>(&fr_dispose_struct) },
+
+		{ "floyd_runtime__allocate_vector", reinterpret_cast<void *>(&floyd_runtime__allocate_vector) },
+		{ "fr_alloc_kstr", reinterpret_cast<void *>(&fr_alloc_kstr) },
+		{ "floyd_runtime__concatunate_vectors", reinterpret_cast<void *>(&floyd_runtime__concatunate_vectors) },
+		{ "floyd_runtime__allocate_dict", reinterpret_cast<void *>(&floyd_runtime__allocate_dict) },
+		{ "floyd_runtime__store_dict_mutable", reinterpret_cast<void *>(&floyd_runtime__store_dict_mutable) },
+		{ "floyd_runtime__lookup_dict", reinterpret_cast<void *>(&floyd_runtime__lookup_dict) },
+		{ "floyd_runtime__allocate_json", reinterpret_cast<void *>(&floyd_runtime__allocate_json) },
+		{ "floyd_runtime__lookup_json", reinterpret_cast<void *>(&floyd_runtime__lookup_json) },
+		{ "floyd_runtime__json_to_string", reinterpret_cast<void *>(&floyd_runtime__json_to_string) },
+		{ "floyd_runtime__compare_values", reinterpret_cast<void *>(&floyd_runtime__compare_values) },
+		{ "floyd_runtime__allocate_struct", reinterpret_cast<void *>(&floyd_runtime__allocate_struct) },
+
+		{ "fr_update_struct_member", reinterpret_cast<void *>(&fr_update_struct_member) },
+		{ "fr_push_back_owned", reinterpret_cast<void *>(&fr_push_back_owned) },
+		{ "fr_vec_to_hamt", reinterpret_cast<void *>(&fr_vec_to_hamt) },
+		{ "fr_lookup_vec_hamt", reinterpret_cast<void *>(&fr_lookup_vec_hamt) }
 	};
 	return result;
 }
@@ -1452,28 +1305,24 @@ void floyd_funcdef__assert(floyd_runtime_t* frp, runtime_value_t arg){
 WIDE_RETURN_T floyd_host_function__erase(floyd_runtime_t* frp, runtime_value_t arg0_value, runtime_type_t arg0_type, runtime_value_t arg1_value, runtime_type_t arg1_type){
 	auto& r = get_floyd_runtime(frp);
 
-	const auto type0 = lookup_type(r.type_interner.interner, arg0_type);
-	const auto type1 = lookup_type(r.type_interner.interner, arg1_type);
+	const auto& type0 = lookup_type(r.type_interner, arg0_type);
+	const auto& type1 = lookup_type(r.type_interner, arg1_type);
 
 	QUARK_ASSERT(type0.is_dict());
 	QUARK_ASSERT(type1.is_string());
 
-	const auto& dict = unpack_dict_arg(r.type_interner.interner, arg0_value, arg0_type);
+	const auto& dict = unpack_dict_arg(r.type_interner, arg0_value, arg0_type);
 
 	const auto value_type = type0.get_dict_value_type();
 
 	//	Deep copy dict.
-	auto dict2 = alloc_dict(r.heap);
-	auto& m = dict2->get_map_mut();
-	m = dict->get_map();
-
-	const auto key_string = from_runtime_string(r, arg1_value);
-	m.erase(key_string);
+	auto dict2 = copy_dict(r.heap, *dict);
+	erase_dict_value(*dict2, arg1_value);
 
 	if(is_rc_value(value_type)){
-		for(auto& e: m){
-			retain_value(r, e.second, value_type);
-		}
+		for_each_dict_entry(*dict2, [&](const dict_entry_t& e){
+			retain_value(r, e.value, value_type);
+		});
 	}
 
 	return make_wide_return_dict(dict2);
@@ -1482,16 +1331,12 @@ WIDE_RETURN_T floyd_host_function__erase(floyd_runtime_t* frp, runtime_value_t a
 uint32_t floyd_funcdef__exists(floyd_runtime_t* frp, runtime_value_t arg0_value, runtime_type_t arg0_type, runtime_value_t arg1_value, runtime_type_t arg1_type){
 	auto& r = get_floyd_runtime(frp);
 
-	const auto type0 = lookup_type(r.type_interner.interner, arg0_type);
-	const auto type1 = lookup_type(r.type_interner.interner, arg1_type);
+	const auto& type0 = lookup_type(r.type_interner, arg0_type);
+	const auto& type1 = lookup_type(r.type_interner, arg1_type);
 	QUARK_ASSERT(type0.is_dict());
 
-	const auto& dict = unpack_dict_arg(r.type_interner.interner, arg0_value, arg0_type);
-	const auto key_string = from_runtime_string(r, arg1_value);
-
-	const auto& m = dict->get_map();
-	const auto it = m.find(key_string);
-	return it != m.end() ? 1 : 0;
+	const auto& dict = unpack_dict_arg(r.type_interner, arg0_value, arg0_type);
+	return find_dict_entry(*dict, arg1_value) != nullptr ? 1 : 0;
 }
 
 
@@ -1502,8 +1347,8 @@ typedef runtime_value_t (*FILTER_F)(floyd_runtime_t* frp, runtime_value_t elemen
 WIDE_RETURN_T floyd_funcdef__filter(floyd_runtime_t* frp, runtime_value_t arg0_value, runtime_type_t arg0_type, runtime_value_t arg1_value, runtime_type_t arg1_type){
 	auto& r = get_floyd_runtime(frp);
 
-	const auto type0 = lookup_type(r.type_interner.interner, arg0_type);
-	const auto type1 = lookup_type(r.type_interner.interner, arg1_type);
+	const auto& type0 = lookup_type(r.type_interner, arg0_type);
+	const auto& type1 = lookup_type(r.type_interner, arg1_type);
 
 	QUARK_ASSERT(type0.is_vector());
 	QUARK_ASSERT(type1.is_function());
@@ -1513,68 +1358,195 @@ WIDE_RETURN_T floyd_funcdef__filter(floyd_runtime_t* frp, runtime_value_t arg0_v
 	const auto f = reinterpret_cast<FILTER_F>(arg1_value.function_ptr);
 
 	auto count = vec.get_element_count();
+	std::vector<runtime_value_t> temp;
+	const auto elements = get_vec_elements(r, vec, type0, temp);
+
+	const auto e_element_type = type0.get_vector_element_type();
+
+	std::vector<runtime_value_t> acc;
+	for(int i = 0 ; i < count ; i++){
+		const auto element_value = elements[i];
+		const auto keep = (*f)(frp, element_value);
+		if(keep.bool_value != 0){
+			acc.push_back(element_value);
+
+			if(is_rc_value(e_element_type)){
+				retain_value(r, element_value, e_element_type);
+			}
+		}
+		else{
+		}
+	}
+
+	const auto count2 = (int32_t)acc.size();
+	auto result_vec = alloc_vec(r.heap, count2, count2);
+
+	if(count2 > 0){
+		//	Count > 0 required to get address to first element in acc.
+		copy_elements(result_vec->get_element_ptr(), &acc[0], count2);
+	}
+	return make_wide_return_vec(carray_to_backend(r, result_vec, type0));
+}
+
+
+typedef runtime_value_t (*SORT_F)(floyd_runtime_t* frp, runtime_value_t a_value, runtime_value_t b_value);
+
+//	A JITed func bool(double, double) takes its arguments in floating point registers.
+typedef runtime_value_t (*SORT_DOUBLE_F)(floyd_runtime_t* frp, double a_value, double b_value);
+
+//	Returns the sort order of the elements, using natural ordering. Uses several threads for big vectors.
+static std::vector<uint32_t> make_natural_sort_indexes(llvm_execution_engine_t& r, const runtime_value_t* elements, size_t count, const typeid_t& element_type){
+	if(element_type.is_string()){
+		return make_sorted_indexes(count, true, [&](uint32_t a, uint32_t b){
+			const auto a_ptr = get_vec_chars(elements[a]);
+			const auto b_ptr = get_vec_chars(elements[b]);
+			return std::lexicographical_compare(
+				a_ptr, a_ptr + get_vec_string_size(elements[a]),
+				b_ptr, b_ptr + get_vec_string_size(elements[b])
+			);
+		});
+	}
+	else{
+		//	Unpack once up front so the comparisons don't have to.
+		std::vector<value_t> values;
+		values.reserve(count);
+		for(size_t i = 0 ; i < count ; i++){
+			values.push_back(from_runtime_value(r, elements[i], element_type));
+		}
+		return make_sorted_indexes(count, true, [&](uint32_t a, uint32_t b){
+			return value_t::compare_value_true_deep(values[a], values[b]) < 0;
+		});
+	}
+}
+
+//	[E] sort([E])
+//	[E] sort([E], bool less(E a, E b))
+//	Arg 2 is a bool placeholder when no comparator was given.
+WIDE_RETURN_T floyd_funcdef__sort(floyd_runtime_t* frp, runtime_value_t arg0_value, runtime_type_t arg0_type, runtime_value_t arg1_value, runtime_type_t arg1_type){
+	auto& r = get_floyd_runtime(frp);
+
+	const auto& type0 = lookup_type(r.type_interner, arg0_type);
+	const auto& type1 = lookup_type(r.type_interner, arg1_type);
+	QUARK_ASSERT(type0.is_vector());
 
+	auto& vec = *arg0_value.vector_ptr;
+	const auto count = vec.get_element_count();
 	const auto e_element_type = type0.get_vector_element_type();
+	std::vector<runtime_value_t> temp;
+	const auto elements = get_vec_elements(r, vec, type0, temp);
 
-	std::vector<runtime_value_t> acc;
-	for(int i = 0 ; i < count ; i++){
-		const auto element_value = vec.get_element_ptr()[i];
-		const auto keep = (*f)(frp, element_value);
-		if(keep.bool_value != 0){
-			acc.push_back(element_value);
+	auto result_vec = alloc_vec(r.heap, count, count);
+	auto result_ptr = result_vec->get_element_ptr();
+	if(count == 0){
+		return make_wide_return_vec(carray_to_backend(r, result_vec, type0));
+	}
 
-			if(is_rc_value(e_element_type)){
-				retain_value(r, element_value, e_element_type);
+	if(type1.is_function()){
+		QUARK_ASSERT(type1.get_function_args().size() == 2);
+
+		//	We can't call into JITed code from several threads, so the comparator path is always serial.
+		std::vector<uint32_t> indexes;
+		if(e_element_type.is_double()){
+			const auto f = reinterpret_cast<SORT_DOUBLE_F>(arg1_value.function_ptr);
+			indexes = make_sorted_indexes(count, false, [&](uint32_t a, uint32_t b){
+				const auto less = (*f)(frp, elements[a].double_value, elements[b].double_value);
+				return less.bool_value != 0;
+			});
+		}
+		else{
+			const auto f = reinterpret_cast<SORT_F>(arg1_value.function_ptr);
+			indexes = make_sorted_indexes(count, false, [&](uint32_t a, uint32_t b){
+				const auto less = (*f)(frp, elements[a], elements[b]);
+				return less.bool_value != 0;
+			});
+		}
+		for(size_t i = 0 ; i < count ; i++){
+			result_ptr[i] = elements[indexes[i]];
+		}
+	}
+	else{
+		QUARK_ASSERT(type1.is_bool());
+
+		if(e_element_type.is_int()){
+			copy_elements(result_ptr, elements, count);
+			auto p = reinterpret_cast<int64_t*>(result_ptr);
+			parallel_sort(p, count, [](int64_t* p, size_t n){ radix_sort_int64(p, n); }, std::less<int64_t>());
+		}
+		else if(e_element_type.is_double()){
+			copy_elements(result_ptr, elements, count);
+			auto p = reinterpret_cast<double*>(result_ptr);
+			parallel_sort(p, count, [](double* p, size_t n){ radix_sort_double(p, n); }, [](double a, double b){ return double_to_key(a) < double_to_key(b); });
+		}
+		else if(e_element_type.is_bool()){
+			size_t false_count = 0;
+			for(size_t i = 0 ; i < count ; i++){
+				false_count += elements[i].bool_value == 0 ? 1 : 0;
+			}
+			for(size_t i = 0 ; i < count ; i++){
+				result_ptr[i] = make_runtime_bool(i >= false_count);
 			}
 		}
 		else{
+			const auto indexes = make_natural_sort_indexes(r, elements, count, e_element_type);
+			for(size_t i = 0 ; i < count ; i++){
+				result_ptr[i] = elements[indexes[i]];
+			}
 		}
 	}
 
-	const auto count2 = (int32_t)acc.size();
-	auto result_vec = alloc_vec(r.heap, count2, count2);
-
-	if(count2 > 0){
-		//	Count > 0 required to get address to first element in acc.
-		copy_elements(result_vec->get_element_ptr(), &acc[0], count2);
+	if(is_rc_value(e_element_type)){
+		for(size_t i = 0 ; i < count ; i++){
+			retain_value(r, result_ptr[i], e_element_type);
+		}
 	}
-	return make_wide_return_vec(result_vec);
+	return make_wide_return_vec(carray_to_backend(r, result_vec, type0));
 }
 
 
 int64_t floyd_funcdef__find(floyd_runtime_t* frp, runtime_value_t arg0_value, runtime_type_t arg0_type, const runtime_value_t arg1_value, runtime_type_t arg1_type){
 	auto& r = get_floyd_runtime(frp);
 
-	const auto type0 = lookup_type(r.type_interner.interner, arg0_type);
-	const auto type1 = lookup_type(r.type_interner.interner, arg1_type);
+	const auto& type0 = lookup_type(r.type_interner, arg0_type);
+	const auto& type1 = lookup_type(r.type_interner, arg1_type);
 
 	if(type0.is_string()){
 		QUARK_ASSERT(type1.is_string());
 
-		const auto str = from_runtime_string(r, arg0_value);
-		const auto wanted2 = from_runtime_string(r, arg1_value);
-		const auto pos = str.find(wanted2);
-		const auto result = pos == std::string::npos ? -1 : static_cast<int64_t>(pos);
-		return result;
+		return simd_find_substring(
+			get_vec_chars(arg0_value),
+			get_vec_string_size(arg0_value),
+			get_vec_chars(arg1_value),
+			get_vec_string_size(arg1_value)
+		);
 	}
 	else if(type0.is_vector()){
 		QUARK_ASSERT(type1 == type0.get_vector_element_type());
 
-		const auto vec = unpack_vec_arg(r.type_interner.interner, arg0_value, arg0_type);
+		const auto vec = unpack_vec_arg(r.type_interner, arg0_value, arg0_type);
+		std::vector<runtime_value_t> temp;
+		const auto elements = get_vec_elements(r, *vec, type0, temp);
+		static_assert(sizeof(runtime_value_t) == sizeof(int64_t), "");
+
+		if(type1.is_int()){
+			return simd_find_int64(reinterpret_cast<const int64_t*>(elements), vec->get_element_count(), arg1_value.int_value);
+		}
+		else if(type1.is_double()){
+			return simd_find_double(reinterpret_cast<const double*>(elements), vec->get_element_count(), arg1_value.double_value);
+		}
 
 //		auto it = std::find_if(function_defs.begin(), function_defs.end(), [&] (const function_def_t& e) { return e.def_name == function_name; } );
 		const auto it = std::find_if(
-			vec->get_element_ptr(),
-			vec->get_element_ptr() + vec->get_element_count(),
+			elements,
+			elements + vec->get_element_count(),
 			[&] (const runtime_value_t& e) {
 				return floyd_runtime__compare_values(frp, static_cast<int64_t>(expression_type::k_logical_equal__2), arg1_type, e, arg1_value) == 1;
 			}
 		);
-		if(it == vec->get_element_ptr() + vec->get_element_count()){
+		if(it == elements + vec->get_element_count()){
 			return -1;
 		}
 		else{
-			const auto pos = it - vec->get_element_ptr();
+			const auto pos = it - elements;
 			return pos;
 		}
 	}
@@ -1609,7 +1581,7 @@ runtime_value_t floyd_funcdef__jsonvalue_to_value(floyd_runtime_t* frp, JSON_T*
 	QUARK_ASSERT(json_ptr != nullptr);
 
 	const auto& json_value = json_ptr->get_json();
-	const auto target_type2 = lookup_type(r.type_interner.interner, target_type);
+	const auto& target_type2 = lookup_type(r.type_interner, target_type);
 
 	const auto result = unflatten_json_to_specific_type(json_value, target_type2);
 	const auto result2 = to_runtime_value(r, result);
@@ -1626,8 +1598,8 @@ runtime_value_t floyd_funcdef__jsonvalue_to_value(floyd_runtime_t* frp, JSON_T*
 WIDE_RETURN_T floyd_funcdef__map(floyd_runtime_t* frp, runtime_value_t arg0_value, runtime_type_t arg0_type, runtime_value_t arg1_value, runtime_type_t arg1_type){
 	auto& r = get_floyd_runtime(frp);
 
-	const auto type0 = lookup_type(r.type_interner.interner, arg0_type);
-	const auto type1 = lookup_type(r.type_interner.interner, arg1_type);
+	const auto& type0 = lookup_type(r.type_interner, arg0_type);
+	const auto& type1 = lookup_type(r.type_interner, arg1_type);
 	QUARK_ASSERT(type0.is_vector());
 	QUARK_ASSERT(type1.is_function());
 
@@ -1644,12 +1616,14 @@ WIDE_RETURN_T floyd_funcdef__map(floyd_runtime_t* frp, runtime_value_t arg0_valu
 	const auto f = reinterpret_cast<MAP_F>(arg1_value.function_ptr);
 
 	const auto count = arg0_value.vector_ptr->get_element_count();
+	std::vector<runtime_value_t> temp;
+	const auto elements = get_vec_elements(r, *arg0_value.vector_ptr, type0, temp);
 	auto result_vec = alloc_vec(r.heap, count, count);
 	for(int i = 0 ; i < count ; i++){
-		const auto wide_result1 = (*f)(frp, arg0_value.vector_ptr->get_element_ptr()[i]);
+		const auto wide_result1 = (*f)(frp, elements[i]);
 		result_vec->get_element_ptr()[i] = wide_result1.a;
 	}
-	return make_wide_return_vec(result_vec);
+	return make_wide_return_vec(carray_to_backend(r, result_vec, typeid_t::make_vector(output_element_type)));
 }
 
 
@@ -1700,46 +1674,28 @@ void floyd_funcdef__print(floyd_runtime_t* frp, runtime_value_t arg0_value, runt
 WIDE_RETURN_T floyd_funcdef__push_back(floyd_runtime_t* frp, runtime_value_t arg0_value, runtime_type_t arg0_type, runtime_value_t arg1_value, runtime_type_t arg1_type){
 	auto& r = get_floyd_runtime(frp);
 
-	const auto type0 = lookup_type(r.type_interner.interner, arg0_type);
-	const auto type1 = lookup_type(r.type_interner.interner, arg1_type);
+	const auto& type0 = lookup_type(r.type_interner, arg0_type);
+	const auto& type1 = lookup_type(r.type_interner, arg1_type);
 	if(type0.is_string()){
-		auto value = from_runtime_string(r, arg0_value);
-
 		QUARK_ASSERT(type1.is_int());
 
-		value.push_back((char)arg1_value.int_value);
-		const auto result2 = to_runtime_string(r, value);
-		return make_wide_return_1x64(result2);
+		const auto result = push_back_copy(r, *arg0_value.vector_ptr, type0, arg1_value);
+		return make_wide_return_1x64(runtime_value_t{ .vector_ptr = result });
 	}
 	else if(type0.is_vector()){
-		const auto vs = unpack_vec_arg(r.type_interner.interner, arg0_value, arg0_type);
+		const auto vs = unpack_vec_arg(r.type_interner, arg0_value, arg0_type);
 
 		QUARK_ASSERT(type1 == type0.get_vector_element_type());
 
-		const auto element = arg1_value;
-		const auto element_type = type1;
-
-		auto v2 = floyd_runtime__allocate_vector(frp, vs->get_element_count() + 1);
-
-		auto dest_ptr = v2->get_element_ptr();
-		auto source_ptr = vs->get_element_ptr();
-
-		if(is_rc_value(element_type)){
-			retain_value(r, element, element_type);
-
-			for(int i = 0 ; i < vs->get_element_count() ; i++){
-				retain_value(r, source_ptr[i], element_type);
-				dest_ptr[i] = source_ptr[i];
-			}
-			dest_ptr[vs->get_element_count()] = element;
+		if(is_vector_hamt(r.vectors, type0)){
+			retain_value(r, arg1_value, type1);
+			const auto result = store_vec_hamt_element(r.heap, *vs, vs->get_element_count(), arg1_value, make_hamt_element_ops(r, type1));
+			return make_wide_return_vec(result);
 		}
 		else{
-			for(int i = 0 ; i < vs->get_element_count() ; i++){
-				dest_ptr[i] = source_ptr[i];
-			}
-			dest_ptr[vs->get_element_count()] = element;
+			const auto result = push_back_copy(r, *vs, type0, arg1_value);
+			return make_wide_return_vec(result);
 		}
-		return make_wide_return_vec(v2);
 	}
 	else{
 		//	No other types allowed.
@@ -1757,27 +1713,44 @@ void floyd_host_function_1022(floyd_runtime_t* frp, runtime_value_t arg){
 	typedef runtime_value_t (*REDUCE_F)(floyd_runtime_t* frp, runtime_value_t acc_value, runtime_value_t element_value);
 
 //	R map([E] elements, R init, R f(R acc, E e))
-WIDE_RETURN_T floyd_funcdef__reduce(floyd_runtime_t* frp, runtime_value_t arg0_value, runtime_type_t arg0_type, runtime_value_t arg1_value, runtime_type_t arg1_type, runtime_value_t arg2_value, runtime_type_t arg2_type){
+//	arg3 is the reduce_kernel that pass3 found for f, see make_reduce_signature().
+WIDE_RETURN_T floyd_funcdef__reduce(floyd_runtime_t* frp, runtime_value_t arg0_value, runtime_type_t arg0_type, runtime_value_t arg1_value, runtime_type_t arg1_type, runtime_value_t arg2_value, runtime_type_t arg2_type, runtime_value_t arg3_value, runtime_type_t arg3_type){
 	auto& r = get_floyd_runtime(frp);
 
-	const auto type0 = lookup_type(r.type_interner.interner, arg0_type);
-	const auto type1 = lookup_type(r.type_interner.interner, arg1_type);
-	const auto type2 = lookup_type(r.type_interner.interner, arg2_type);
+	const auto& type0 = lookup_type(r.type_interner, arg0_type);
+	const auto& type1 = lookup_type(r.type_interner, arg1_type);
+	const auto& type2 = lookup_type(r.type_interner, arg2_type);
 
 	QUARK_ASSERT(type0.is_vector());
 	QUARK_ASSERT(type2.is_function());
 	QUARK_ASSERT(type2.get_function_args().size () == 2);
+	QUARK_ASSERT(lookup_type(r.type_interner, arg3_type).is_int());
 
 	const auto& vec = *arg0_value.vector_ptr;
 	const auto& init = arg1_value;
 	const auto f = reinterpret_cast<REDUCE_F>(arg2_value.function_ptr);
+	const auto kernel = static_cast<reduce_kernel>(arg3_value.int_value);
 
 	auto count = vec.get_element_count();
+	std::vector<runtime_value_t> temp;
+	const auto elements = get_vec_elements(r, vec, type0, temp);
+
+	if(kernel == reduce_kernel::k_count){
+		return make_wide_return_2x64(runtime_value_t{ .int_value = init.int_value + static_cast<int64_t>(count) }, {} );
+	}
+	else if(kernel != reduce_kernel::k_none && type1.is_int()){
+		const auto acc = simd_reduce_int64(kernel, reinterpret_cast<const int64_t*>(elements), count, init.int_value);
+		return make_wide_return_2x64(runtime_value_t{ .int_value = acc }, {} );
+	}
+	else if(kernel != reduce_kernel::k_none && type1.is_double()){
+		const auto acc = simd_reduce_double(kernel, reinterpret_cast<const double*>(elements), count, init.double_value);
+		return make_wide_return_2x64(runtime_value_t{ .double_value = acc }, {} );
+	}
 	runtime_value_t acc = init;
 	retain_value(r, acc, type1);
 
 	for(int i = 0 ; i < count ; i++){
-		const auto element_value = vec.get_element_ptr()[i];
+		const auto element_value = elements[i];
 		const auto acc2 = (*f)(frp, acc, element_value);
 
 		release_deep(r, acc, type1);
@@ -1814,8 +1787,8 @@ const WIDE_RETURN_T floyd_funcdef__replace(floyd_runtime_t* frp, runtime_value_t
 		quark::throw_runtime_error("replace() requires start <= end.");
 	}
 
-	const auto type0 = lookup_type(r.type_interner.interner, arg0_type);
-	const auto type3 = lookup_type(r.type_interner.interner, arg3_type);
+	const auto& type0 = lookup_type(r.type_interner, arg0_type);
+	const auto& type3 = lookup_type(r.type_interner, arg3_type);
 
 	QUARK_ASSERT(type3 == type0);
 
@@ -1829,8 +1802,12 @@ const WIDE_RETURN_T floyd_funcdef__replace(floyd_runtime_t* frp, runtime_value_t
 	else if(type0.is_vector()){
 		const auto element_type = type0.get_vector_element_type();
 
-		const auto vec = unpack_vec_arg(r.type_interner.interner, arg0_value, arg0_type);
-		const auto replace_vec = unpack_vec_arg(r.type_interner.interner, arg3_value, arg3_type);
+		const auto vec = unpack_vec_arg(r.type_interner, arg0_value, arg0_type);
+		const auto replace_vec = unpack_vec_arg(r.type_interner, arg3_value, arg3_type);
+		std::vector<runtime_value_t> temp;
+		std::vector<runtime_value_t> replace_temp;
+		const auto elements = get_vec_elements(r, *vec, type0, temp);
+		const auto replace_elements = get_vec_elements(r, *replace_vec, type3, replace_temp);
 
 		auto end2 = std::min(end, vec->get_element_count());
 		auto start2 = std::min(start, end2);
@@ -1841,9 +1818,9 @@ const WIDE_RETURN_T floyd_funcdef__replace(floyd_runtime_t* frp, runtime_value_t
 
 		const auto len2 = section1_len + section2_len + section3_len;
 		auto vec2 = alloc_vec(r.heap, len2, len2);
-		copy_elements(&vec2->get_element_ptr()[0], &vec->get_element_ptr()[0], section1_len);
-		copy_elements(&vec2->get_element_ptr()[section1_len], &replace_vec->get_element_ptr()[0], section2_len);
-		copy_elements(&vec2->get_element_ptr()[section1_len + section2_len], &vec->get_element_ptr()[end2], section3_len);
+		copy_elements(&vec2->get_element_ptr()[0], &elements[0], section1_len);
+		copy_elements(&vec2->get_element_ptr()[section1_len], &replace_elements[0], section2_len);
+		copy_elements(&vec2->get_element_ptr()[section1_len + section2_len], &elements[end2], section3_len);
 
 		if(is_rc_value(element_type)){
 			for(int i = 0 ; i < len2 ; i++){
@@ -1851,7 +1828,7 @@ const WIDE_RETURN_T floyd_funcdef__replace(floyd_runtime_t* frp, runtime_value_t
 			}
 		}
 
-		return make_wide_return_vec(vec2);
+		return make_wide_return_vec(carray_to_backend(r, vec2, type0));
 	}
 	else{
 		//	No other types allowed.
@@ -1869,17 +1846,80 @@ JSON_T* floyd_funcdef__script_to_jsonvalue(floyd_runtime_t* frp, runtime_value_t
 	return result;
 }
 
-void floyd_funcdef__send(floyd_runtime_t* frp, runtime_value_t process_id0, const JSON_T* message_json_ptr){
+//	A typed message in flight. Keeps the sender's value alive until the receiver is done with it.
+struct llvm_process_message_t {
+	llvm_process_message_t(llvm_execution_engine_t& ee, runtime_value_t value, const typeid_t& type) :
+		_ee(&ee),
+		_value(value),
+		_type(type)
+	{
+		retain_value(*_ee, _value, _type);
+	}
+	~llvm_process_message_t(){
+		release_deep(*_ee, _value, _type);
+	}
+
+	llvm_process_message_t(const llvm_process_message_t& other) = delete;
+	llvm_process_message_t& operator=(const llvm_process_message_t& other) = delete;
+
+	llvm_execution_engine_t* _ee;
+	runtime_value_t _value;
+	typeid_t _type;
+};
+
+//	JSON messages are passed as json_t. "stop" is the stop message even when sent as a plain string.
+//	All other values are passed by reference, without copying their contents.
+static process_message_t make_process_message(llvm_execution_engine_t& r, runtime_value_t message_value, const typeid_t& type){
+	if(type.is_json_value()){
+		QUARK_ASSERT(message_value.json_ptr != nullptr);
+		return process_message_t(message_value.json_ptr->get_json());
+	}
+	else if(type.is_string() && from_runtime_string(r, message_value) == "stop"){
+		return process_message_t(json_t("stop"));
+	}
+	else{
+		return process_message_t(std::shared_ptr<const void>(std::make_shared<llvm_process_message_t>(r, message_value, type)));
+	}
+}
+
+void floyd_funcdef__send(floyd_runtime_t* frp, runtime_value_t process_id0, runtime_value_t message_value, runtime_type_t message_type){
+	auto& r = get_floyd_runtime(frp);
+
+	const auto& process_id = from_runtime_string(r, process_id0);
+	const auto& type = lookup_type(r.type_interner, message_type);
+	QUARK_TRACE_SS("send(\"" << process_id << "\", " << typeid_to_compact_string(type) << ")");
+	r._handler->on_send(process_id, make_process_message(r, message_value, type));
+}
+
+int64_t floyd_funcdef__get_process_handle(floyd_runtime_t* frp, runtime_value_t process_id0){
+	auto& r = get_floyd_runtime(frp);
+
+	const auto& process_id = from_runtime_string(r, process_id0);
+	return r._handler != nullptr ? r._handler->get_process_handle(process_id) : -1;
+}
+
+void floyd_funcdef__send_to_handle(floyd_runtime_t* frp, int64_t process_handle, runtime_value_t message_value, runtime_type_t message_type){
 	auto& r = get_floyd_runtime(frp);
 
-	QUARK_ASSERT(message_json_ptr != nullptr);
+	const auto& type = lookup_type(r.type_interner, message_type);
+	r._handler->on_send_to_handle(process_handle, make_process_message(r, message_value, type));
+}
+
+void floyd_funcdef__post_at_time(floyd_runtime_t* frp, runtime_value_t process_id0, int64_t time_ms, runtime_value_t message_value, runtime_type_t message_type){
+	auto& r = get_floyd_runtime(frp);
 
 	const auto& process_id = from_runtime_string(r, process_id0);
-	const auto& message_json = message_json_ptr->get_json();
+	const auto& type = lookup_type(r.type_interner, message_type);
+	r._handler->on_post(process_id, make_process_message(r, message_value, type), get_post_time(r._start_time, time_ms));
+}
 
-	QUARK_TRACE_SS("send(\"" << process_id << "\"," << json_to_pretty_string(message_json) <<")");
+void floyd_funcdef__post_after(floyd_runtime_t* frp, runtime_value_t process_id0, int64_t delay_ms, runtime_value_t message_value, runtime_type_t message_type){
+	auto& r = get_floyd_runtime(frp);
 
-	r._handler->on_send(process_id, message_json);
+	const auto& process_id = from_runtime_string(r, process_id0);
+	const auto& type = lookup_type(r.type_interner, message_type);
+	const auto time = std::chrono::steady_clock::now() + std::chrono::milliseconds(delay_ms);
+	r._handler->on_post(process_id, make_process_message(r, message_value, type), time);
 }
 
 
@@ -1887,7 +1927,7 @@ void floyd_funcdef__send(floyd_runtime_t* frp, runtime_value_t process_id0, cons
 int64_t floyd_funcdef__size(floyd_runtime_t* frp, runtime_value_t arg0_value, runtime_type_t arg0_type){
 	auto& r = get_floyd_runtime(frp);
 
-	const auto type0 = lookup_type(r.type_interner.interner, arg0_type);
+	const auto& type0 = lookup_type(r.type_interner, arg0_type);
 
 	if(type0.is_string()){
 		return get_vec_string_size(arg0_value);
@@ -1909,11 +1949,11 @@ int64_t floyd_funcdef__size(floyd_runtime_t* frp, runtime_value_t arg0_value, ru
 		}
 	}
 	else if(type0.is_vector()){
-		const auto vs = unpack_vec_arg(r.type_interner.interner, arg0_value, arg0_type);
+		const auto vs = unpack_vec_arg(r.type_interner, arg0_value, arg0_type);
 		return vs->get_element_count();
 	}
 	else if(type0.is_dict()){
-		DICT_T* dict = unpack_dict_arg(r.type_interner.interner, arg0_value, arg0_type);
+		DICT_T* dict = unpack_dict_arg(r.type_interner, arg0_value, arg0_type);
 		return dict->size();
 	}
 	else{
@@ -1929,7 +1969,7 @@ const WIDE_RETURN_T floyd_funcdef__subset(floyd_runtime_t* frp, runtime_value_t
 		quark::throw_runtime_error("subset() requires start and end to be non-negative.");
 	}
 
-	const auto type0 = lookup_type(r.type_interner.interner, arg0_type);
+	const auto& type0 = lookup_type(r.type_interner, arg0_type);
 	if(type0.is_string()){
 		const auto value = from_runtime_string(r, arg0_value);
 
@@ -1944,7 +1984,7 @@ const WIDE_RETURN_T floyd_funcdef__subset(floyd_runtime_t* frp, runtime_value_t
 	}
 	else if(type0.is_vector()){
 		const auto element_type = type0.get_vector_element_type();
-		const auto vec = unpack_vec_arg(r.type_interner.interner, arg0_value, arg0_type);
+		const auto vec = unpack_vec_arg(r.type_interner, arg0_value, arg0_type);
 
 		const auto end2 = std::min(end, vec->get_element_count());
 		const auto start2 = std::min(start, end2);
@@ -1953,6 +1993,9 @@ const WIDE_RETURN_T floyd_funcdef__subset(floyd_runtime_t* frp, runtime_value_t
 		if(len2 >= INT32_MAX){
 			throw std::exception();
 		}
+		if(is_vector_hamt(r.vectors, type0)){
+			return make_wide_return_vec(subset_vec_hamt(r.heap, *vec, start2, end2));
+		}
 		VEC_T* vec2 = alloc_vec(r.heap, len2, len2);
 		if(is_rc_value(element_type)){
 			for(int i = 0 ; i < len2 ; i++){
@@ -1987,9 +2030,9 @@ WIDE_RETURN_T floyd_funcdef__supermap(
 ){
 	auto& r = get_floyd_runtime(frp);
 
-	const auto type0 = lookup_type(r.type_interner.interner, arg0_type);
-	const auto type1 = lookup_type(r.type_interner.interner, arg1_type);
-	const auto type2 = lookup_type(r.type_interner.interner, arg2_type);
+	const auto& type0 = lookup_type(r.type_interner, arg0_type);
+	const auto& type1 = lookup_type(r.type_interner, arg1_type);
+	const auto& type2 = lookup_type(r.type_interner, arg2_type);
 
 	//	Check topology.
 	QUARK_ASSERT(type0.is_vector());
@@ -2009,6 +2052,10 @@ WIDE_RETURN_T floyd_funcdef__supermap(
 
 	const auto elements2 = elements.vector_ptr;
 	const auto parents2 = parents.vector_ptr;
+	std::vector<runtime_value_t> elements_temp;
+	std::vector<runtime_value_t> parents_temp;
+	const auto elements3 = get_vec_elements(r, *elements2, type0, elements_temp);
+	const auto parents3 = get_vec_elements(r, *parents2, type1, parents_temp);
 
 	if(elements2->get_element_count() != parents2->get_element_count()) {
 		quark::throw_runtime_error("supermap() requires elements and parents be the same count.");
@@ -2020,7 +2067,7 @@ WIDE_RETURN_T floyd_funcdef__supermap(
 	std::vector<runtime_value_t> complete(elements2->get_element_count(), runtime_value_t());
 
 	for(int i = 0 ; i < parents2->get_element_count() ; i++){
-		const auto& e = parents2->get_element_ptr()[i];
+		const auto& e = parents3[i];
 		const auto parent_index = e.int_value;
 
 		const auto count = static_cast<int64_t>(elements2->get_element_count());
@@ -2047,12 +2094,12 @@ WIDE_RETURN_T floyd_funcdef__supermap(
 		}
 
 		for(const auto element_index: pass_ids){
-			const auto& e = elements2->get_element_ptr()[element_index];
+			const auto& e = elements3[element_index];
 
 			//	Make list of the element's inputs -- they must all be complete now.
 			std::vector<runtime_value_t> solved_deps;
 			for(int element_index2 = 0 ; element_index2 < parents2->get_element_count() ; element_index2++){
-				const auto& p = parents2->get_element_ptr()[element_index2];
+				const auto& p = parents3[element_index2];
 				const auto parent_index = p.int_value;
 				if(parent_index == element_index){
 					QUARK_ASSERT(element_index2 != -1);
@@ -2068,18 +2115,25 @@ WIDE_RETURN_T floyd_funcdef__supermap(
 			for(int i = 0 ; i < solved_deps.size() ; i++){
 				solved_deps2->get_element_ptr()[i] = solved_deps[i];
 			}
+			const auto r_vec_type = typeid_t::make_vector(r_type);
+			solved_deps2 = carray_to_backend(r, solved_deps2, r_vec_type);
 			runtime_value_t solved_deps3 { .vector_ptr = solved_deps2 };
 
 			const auto wide_result = (*f2)(frp, e, solved_deps3);
 
 			//	Release just the vec, **not the elements**. The elements are aliases for complete-vector.
 			if(dec_rc(solved_deps2->alloc) == 0){
-				dispose_vec(*solved_deps2);
+				if(is_vector_hamt(r.vectors, r_vec_type)){
+					dispose_vec_hamt(*solved_deps2, hamt_element_ops_t{});
+				}
+				else{
+					dispose_vec(*solved_deps2);
+				}
 			}
 
 			const auto result1 = wide_result.a;
 
-			const auto parent_index = parents2->get_element_ptr()[element_index].int_value;
+			const auto parent_index = parents3[element_index].int_value;
 			if(parent_index != -1){
 				rcs[parent_index]--;
 			}
@@ -2103,13 +2157,13 @@ WIDE_RETURN_T floyd_funcdef__supermap(
 	QUARK_TRACE(json_to_pretty_string(debug));
 #endif
 
-	return make_wide_return_vec(result_vec);
+	return make_wide_return_vec(carray_to_backend(r, result_vec, typeid_t::make_vector(r_type)));
 }
 
 runtime_value_t floyd_funcdef__to_pretty_string(floyd_runtime_t* frp, runtime_value_t arg0_value, runtime_type_t arg0_type){
 	auto& r = get_floyd_runtime(frp);
 
-	const auto type0 = lookup_type(r.type_interner.interner, arg0_type);
+	const auto& type0 = lookup_type(r.type_interner, arg0_type);
 	const auto& value = from_runtime_value(r, arg0_value, type0);
 	const auto json = value_to_ast_json(value, json_tags::k_plain);
 	const auto s = json_to_pretty_string(json, 0, pretty_t{ 80, 4 });
@@ -2129,7 +2183,7 @@ runtime_type_t floyd_host__typeof(floyd_runtime_t* frp, runtime_value_t arg0_val
 	auto& r = get_floyd_runtime(frp);
 
 #if DEBUG
-	const auto type0 = lookup_type(r.type_interner.interner, arg0_type);
+	const auto& type0 = lookup_type(r.type_interner, arg0_type);
 	QUARK_ASSERT(type0.check_invariant());
 #endif
 	return arg0_type;
@@ -2141,9 +2195,9 @@ runtime_type_t floyd_host__typeof(floyd_runtime_t* frp, runtime_value_t arg0_val
 const WIDE_RETURN_T floyd_funcdef__update(floyd_runtime_t* frp, runtime_value_t arg0_value, runtime_type_t arg0_type, runtime_value_t arg1_value, runtime_type_t arg1_type, runtime_value_t arg2_value, runtime_type_t arg2_type){
 	auto& r = get_floyd_runtime(frp);
 
-	const auto type0 = lookup_type(r.type_interner.interner, arg0_type);
-	const auto type1 = lookup_type(r.type_interner.interner, arg1_type);
-	const auto type2 = lookup_type(r.type_interner.interner, arg2_type);
+	const auto& type0 = lookup_type(r.type_interner, arg0_type);
+	const auto& type1 = lookup_type(r.type_interner, arg1_type);
+	const auto& type2 = lookup_type(r.type_interner, arg2_type);
 	if(type0.is_string()){
 		QUARK_ASSERT(type1.is_int());
 		QUARK_ASSERT(type2.is_int());
@@ -2166,7 +2220,7 @@ const WIDE_RETURN_T floyd_funcdef__update(floyd_runtime_t* frp, runtime_value_t
 	else if(type0.is_vector()){
 		QUARK_ASSERT(type1.is_int());
 
-		const auto vec = unpack_vec_arg(r.type_interner.interner, arg0_value, arg0_type);
+		const auto vec = unpack_vec_arg(r.type_interner, arg0_value, arg0_type);
 		const auto element_type = type0.get_vector_element_type();
 		const auto index = arg1_value.int_value;
 
@@ -2176,6 +2230,13 @@ const WIDE_RETURN_T floyd_funcdef__update(floyd_runtime_t* frp, runtime_value_t
 			throw std::runtime_error("Position argument to update() is outside collection span.");
 		}
 
+		if(is_vector_hamt(r.vectors, type0)){
+			//	Copies the path to the element. The old element is released from the copied leaf.
+			retain_value(r, arg2_value, element_type);
+			const auto result = store_vec_hamt_element(r.heap, *vec, index, arg2_value, make_hamt_element_ops(r, element_type));
+			return make_wide_return_vec(result);
+		}
+
 		auto result = alloc_vec(r.heap, vec->get_element_count(), vec->get_element_count());
 		auto dest_ptr = result->get_element_ptr();
 		auto source_ptr = vec->get_element_ptr();
@@ -2201,20 +2262,17 @@ const WIDE_RETURN_T floyd_funcdef__update(floyd_runtime_t* frp, runtime_value_t
 	else if(type0.is_dict()){
 		QUARK_ASSERT(type1.is_string());
 
-		const auto key = from_runtime_string(r, arg1_value);
-		const auto dict = unpack_dict_arg(r.type_interner.interner, arg0_value, arg0_type);
+		const auto dict = unpack_dict_arg(r.type_interner, arg0_value, arg0_type);
 		const auto value_type = type0.get_dict_value_type();
 
 		//	Deep copy dict.
-		auto dict2 = alloc_dict(r.heap);
-		dict2->get_map_mut() = dict->get_map();
-
-		dict2->get_map_mut().insert_or_assign(key, arg2_value);
+		auto dict2 = copy_dict(r.heap, *dict);
+		store_dict_value(*dict2, arg1_value, arg2_value);
 
 		if(is_rc_value(value_type)){
-			for(const auto& e: dict2->get_map()){
-				retain_value(r, e.second, value_type);
-			}
+			for_each_dict_entry(*dict2, [&](const dict_entry_t& e){
+				retain_value(r, e.value, value_type);
+			});
 		}
 
 		return make_wide_return_dict(dict2);
@@ -2231,7 +2289,7 @@ const WIDE_RETURN_T floyd_funcdef__update(floyd_runtime_t* frp, runtime_value_t
 JSON_T* floyd_funcdef__value_to_jsonvalue(floyd_runtime_t* frp, runtime_value_t arg0_value, runtime_type_t arg0_type){
 	auto& r = get_floyd_runtime(frp);
 
-	const auto type0 = lookup_type(r.type_interner.interner, arg0_type);
+	const auto& type0 = lookup_type(r.type_interner, arg0_type);
 	const auto value0 = from_runtime_value(r, arg0_value, type0);
 	const auto j = value_to_ast_json(value0, json_tags::k_plain);
 	auto result = alloc_json(r.heap, j);
@@ -2501,9 +2559,14 @@ std::map<std::string, void*> get_host_functions_map2(){
 		{ "floyd_funcdef__filter", reinterpret_cast<void *>(&floyd_funcdef__filter) },
 		{ "floyd_funcdef__reduce", reinterpret_cast<void *>(&floyd_funcdef__reduce) },
 		{ "floyd_funcdef__supermap", reinterpret_cast<void *>(&floyd_funcdef__supermap) },
+		{ "floyd_funcdef__sort", reinterpret_cast<void *>(&floyd_funcdef__sort) },
 
 		{ "floyd_funcdef__print", reinterpret_cast<void *>(&floyd_funcdef__print) },
 		{ "floyd_funcdef__send", reinterpret_cast<void *>(&floyd_funcdef__send) },
+		{ "floyd_funcdef__get_process_handle", reinterpret_cast<void *>(&floyd_funcdef__get_process_handle) },
+		{ "floyd_funcdef__send_to_handle", reinterpret_cast<void *>(&floyd_funcdef__send_to_handle) },
+		{ "floyd_funcdef__post_at_time", reinterpret_cast<void *>(&floyd_funcdef__post_at_time) },
+		{ "floyd_funcdef__post_after", reinterpret_cast<void *>(&floyd_funcdef__post_after) },
 
 
 
@@ -2560,149 +2623,178 @@ uint64_t call_floyd_runtime_deinit(llvm_execution_engine_t& ee){
 */
 
 /*
-	Try using C++ multithreading maps etc?
-	Explore std::packaged_task
+	Processes don't get their own OS thread. process_scheduler_t runs them as tasks on a pool of worker threads.
 */
-//	https://en.cppreference.com/w/cpp/thread/condition_variable/wait
 
 
 struct process_interface {
 	virtual ~process_interface(){};
-	virtual void on_message(const json_t& message) = 0;
+	virtual void on_message(const process_message_t& message) = 0;
 	virtual void on_init() = 0;
 };
 
 
-//	NOTICE: Each process inbox has its own mutex + condition variable.
+//	NOTICE: The scheduler guarantees only one thread at a time runs a process.
 //	No mutex protects cout.
 struct llvm_process_t {
-	std::condition_variable _inbox_condition_variable;
-	std::mutex _inbox_mutex;
-	std::deque<json_t> _inbox;
-
 	std::string _name_key;
 	std::string _function_key;
-	std::thread::id _thread_id;
 
 //	std::shared_ptr<interpreter_t> _interpreter;
 	std::shared_ptr<llvm_bind_t> _init_function;
 	std::shared_ptr<llvm_bind_t> _process_function;
-	value_t _process_state;
+
+	//	Owned by the process. Kept as a runtime_value_t between messages -- never converted to value_t.
+	runtime_value_t _process_state = make_blank_runtime_value();
+	typeid_t _process_state_type = typeid_t::make_undefined();
+
 	std::shared_ptr<process_interface> _processor;
 };
 
-struct llvm_process_runtime_t {
-	container_t _container;
-	std::map<std::string, std::string> _process_infos;
-	std::thread::id _main_thread_id;
+struct llvm_process_runtime_t : public process_executor_i {
+	virtual void on_process_init(int process_id){
+		auto& process = *_processes[process_id];
 
-	llvm_execution_engine_t* ee;
+		if(process._processor){
+			process._processor->on_init();
+		}
 
-	std::vector<std::shared_ptr<llvm_process_t>> _processes;
-	std::vector<std::thread> _worker_threads;
-};
+		if(process._init_function != nullptr){
+			const typeid_t process_state_type = process._init_function->type.get_function_return();
 
-/*
-??? have ONE runtime PER computer or one per interpreter?
-??? Separate system-interpreter (all processes and many clock busses) vs ONE thread of execution?
-*/
+			//	!!! This validation should be done earlier in the startup process / compilation process.
+			if(process._init_function->type != make_process_init_type(process_state_type)){
+				quark::throw_runtime_error("Invalid function prototype for process-init");
+			}
 
-static void send_message(llvm_process_runtime_t& runtime, int process_id, const json_t& message){
-	auto& process = *runtime._processes[process_id];
+			auto f = *reinterpret_cast<FLOYD_RUNTIME_PROCESS_INIT*>(process._init_function->address);
+			process._process_state = (*f)(reinterpret_cast<floyd_runtime_t*>(ee));
+			process._process_state_type = process_state_type;
+		}
+	}
 
-    {
-        std::lock_guard<std::mutex> lk(process._inbox_mutex);
-        process._inbox.push_front(message);
-        QUARK_TRACE("Notifying...");
-    }
-    process._inbox_condition_variable.notify_one();
-//    process._inbox_condition_variable.notify_all();
-}
+	virtual void on_process_message(int process_id, const process_message_t& message){
+		on_process_messages(process_id, &message, 1);
+	}
 
-static void run_process(llvm_process_runtime_t& runtime, int process_id){
-	auto& process = *runtime._processes[process_id];
-	bool stop = false;
+	virtual void on_process_messages(int process_id, const process_message_t messages[], int count){
+		auto& process = *_processes[process_id];
 
-	const auto thread_name = get_current_thread_name();
+		if(process._processor){
+			for(int i = 0 ; i < count ; i++){
+				process._processor->on_message(messages[i]);
+			}
+		}
 
-	const typeid_t process_state_type = process._init_function != nullptr ? process._init_function->type.get_function_return() : typeid_t::make_undefined();
+		if(process._process_function != nullptr){
+			const typeid_t process_state_type = process._init_function != nullptr ? process._init_function->type.get_function_return() : typeid_t::make_undefined();
+			const auto& function_args = process._process_function->type.get_function_args();
+			const typeid_t message_type = function_args.size() == 2 ? function_args[1] : typeid_t::make_undefined();
 
-	if(process._processor){
-		process._processor->on_init();
-	}
+			//	!!! This validation should be done earlier in the startup process / compilation process.
+			if(process._process_function->type != make_process_message_handler_type(process_state_type, message_type)){
+				quark::throw_runtime_error("Invalid function prototype for process message handler");
+			}
 
-	if(process._init_function != nullptr){
-		//	!!! This validation should be done earlier in the startup process / compilation process.
-		if(process._init_function->type != make_process_init_type(process_state_type)){
-			quark::throw_runtime_error("Invalid function prototype for process-init");
+			//	Batched handler: one call with all the messages.
+			if(is_batch_message_type(message_type)){
+				std::vector<value_t> elements;
+				for(int i = 0 ; i < count ; i++){
+					elements.push_back(value_t::make_json_value(make_message_json(messages[i])));
+				}
+				const auto batch = to_runtime_value(*ee, value_t::make_vector_value(message_type.get_vector_element_type(), elements));
+				call_process_function(process, process_state_type, message_type, batch);
+				release_deep(*ee, batch, message_type);
+			}
+			else{
+				for(int i = 0 ; i < count ; i++){
+					bool owns_message = false;
+					const auto message2 = make_message_arg(message_type, messages[i], owns_message);
+					call_process_function(process, process_state_type, message_type, message2);
+					if(owns_message){
+						release_deep(*ee, message2, message_type);
+					}
+				}
+			}
 		}
-
-		auto f = *reinterpret_cast<FLOYD_RUNTIME_PROCESS_INIT*>(process._init_function->address);
-		const auto result = (*f)(reinterpret_cast<floyd_runtime_t*>(runtime.ee));
-		process._process_state = from_runtime_value(*runtime.ee, result, process._init_function->type.get_function_return());
 	}
 
-	while(stop == false){
-		json_t message;
-		{
-			std::unique_lock<std::mutex> lk(process._inbox_mutex);
-
-        	QUARK_TRACE_SS(thread_name << ": waiting......");
-			process._inbox_condition_variable.wait(lk, [&]{ return process._inbox.empty() == false; });
-        	QUARK_TRACE_SS(thread_name << ": continue");
+	//	The handler borrows the state and the message and returns the new state, which we now own.
+	void call_process_function(llvm_process_t& process, const typeid_t& process_state_type, const typeid_t& message_type, runtime_value_t message){
+		const auto frp = reinterpret_cast<floyd_runtime_t*>(ee);
+		const auto result = message_type.is_double()
+			? (*reinterpret_cast<FLOYD_RUNTIME_PROCESS_MESSAGE_DOUBLE*>(process._process_function->address))(frp, process._process_state, message.double_value)
+			: (*reinterpret_cast<FLOYD_RUNTIME_PROCESS_MESSAGE*>(process._process_function->address))(frp, process._process_state, message);
+		release_deep(*ee, process._process_state, process._process_state_type);
+		process._process_state = result;
+		process._process_state_type = process_state_type;
+	}
 
-			//	Pop message.
-			QUARK_ASSERT(process._inbox.empty() == false);
-			message = process._inbox.back();
-			process._inbox.pop_back();
+	json_t make_message_json(const process_message_t& message) const {
+		if(message._value == nullptr){
+			return message._json;
+		}
+		else{
+			const auto& value = *static_cast<const llvm_process_message_t*>(message._value.get());
+			return value_to_ast_json(from_runtime_value(*ee, value._value, value._type), json_tags::k_plain);
 		}
-		QUARK_TRACE_SS("RECEIVED: " << json_to_pretty_string(message));
+	}
 
-		if(message.is_string() && message.get_string() == "stop"){
-			stop = true;
-        	QUARK_TRACE_SS(thread_name << ": STOP");
+	//	Typed messages are the sender's runtime_value_t, passed on as-is. A typed message sent to a process that
+	//	takes json_value is converted to JSON. Anything else that doesn't match the process's message type is an error.
+	//	owns_message is set when the returned value was allocated here and must be released after the call.
+	runtime_value_t make_message_arg(const typeid_t& message_type, const process_message_t& message, bool& owns_message){
+		if(message._value == nullptr){
+			if(message_type.is_json_value() == false){
+				quark::throw_runtime_error("Process expects messages of type " + typeid_to_compact_string(message_type) + ", got json_value.");
+			}
+			owns_message = true;
+			return to_runtime_value(*ee, value_t::make_json_value(message._json));
 		}
 		else{
-			if(process._processor){
-				process._processor->on_message(message);
+			const auto& value = *static_cast<const llvm_process_message_t*>(message._value.get());
+			if(message_type.is_json_value()){
+				owns_message = true;
+				return to_runtime_value(*ee, value_t::make_json_value(make_message_json(message)));
 			}
-
-			if(process._process_function != nullptr){
-				//	!!! This validation should be done earlier in the startup process / compilation process.
-				if(process._process_function->type != make_process_message_handler_type(process_state_type)){
-					quark::throw_runtime_error("Invalid function prototype for process message handler");
-				}
-
-				auto f = *reinterpret_cast<FLOYD_RUNTIME_PROCESS_MESSAGE*>(process._process_function->address);
-				const auto state2 = to_runtime_value(*runtime.ee, process._process_state);
-				const auto message2 = to_runtime_value(*runtime.ee, value_t::make_json_value(message));
-				const auto result = (*f)(reinterpret_cast<floyd_runtime_t*>(runtime.ee), state2, message2);
-				process._process_state = from_runtime_value(*runtime.ee, result, process._process_function->type.get_function_return());
+			else if(value._type != message_type){
+				quark::throw_runtime_error("Process expects messages of type " + typeid_to_compact_string(message_type) + ", got " + typeid_to_compact_string(value._type) + ".");
 			}
+			return value._value;
 		}
 	}
-}
 
+	void release_process_states(){
+		for(auto& process: _processes){
+			release_deep(*ee, process->_process_state, process->_process_state_type);
+			process->_process_state = make_blank_runtime_value();
+			process->_process_state_type = typeid_t::make_undefined();
+		}
+	}
 
-static std::map<std::string, value_t> run_container_int(llvm_ir_program_t& program_breaks, const std::vector<std::string>& main_args, const std::string& container_key){
-	QUARK_ASSERT(container_key.empty() == false);
+	container_t _container;
+	std::map<std::string, std::string> _process_infos;
 
-	llvm_execution_engine_t ee = make_engine_run_init(*program_breaks.instance, program_breaks);
+	llvm_execution_engine_t* ee;
 
-	llvm_process_runtime_t runtime;
-	runtime._main_thread_id = std::this_thread::get_id();
-	runtime.ee = &ee;
+	std::vector<std::shared_ptr<llvm_process_t>> _processes;
+	//	Process name -> handle, the process's index in _processes and in the scheduler. Filled once before any
+	//	process code runs.
+	std::unordered_map<std::string, int> _process_ids;
+	std::shared_ptr<process_scheduler_t> _scheduler;
+};
 
-	//??? Confusing. Support several containers!
-	if(std::find(program_breaks.software_system._containers.begin(), program_breaks.software_system._containers.end(), container_key) == program_breaks.software_system._containers.end()){
-		quark::throw_runtime_error("Unknown container-key");
-	}
+/*
+??? have ONE runtime PER computer or one per interpreter?
+??? Separate system-interpreter (all processes and many clock busses) vs ONE thread of execution?
+*/
 
-	if(program_breaks.container_def._name != container_key){
-		quark::throw_runtime_error("Unknown container-key");
-	}
+std::map<std::string, value_t> run_container(llvm_execution_engine_t& ee, const container_t& container){
+	QUARK_ASSERT(ee.check_invariant());
 
-	runtime._container = program_breaks.container_def;
+	llvm_process_runtime_t runtime;
+	runtime.ee = &ee;
+	runtime._container = container;
 
 	runtime._process_infos = reduce(runtime._container._clock_busses, std::map<std::string, std::string>(), [](const std::map<std::string, std::string>& acc, const std::pair<std::string, clock_bus_t>& e){
 		auto acc2 = acc;
@@ -2710,15 +2802,58 @@ static std::map<std::string, value_t> run_container_int(llvm_ir_program_t& progr
 		return acc2;
 	});
 
+	//	Processes on the same clock bus run on the same scheduler clock, so send() between them is synchronous.
+	std::map<std::string, int> clock_by_process;
+	std::map<std::string, inbox_def_t> inbox_by_process;
+	std::vector<std::pair<std::string, double>> clock_periods;
+	int clock_count = 0;
+	for(const auto& bus: runtime._container._clock_busses){
+		for(const auto& e: bus.second._processes){
+			clock_by_process.insert({ e.first, clock_count });
+			const auto inbox_it = bus.second._inboxes.find(e.first);
+			inbox_by_process.insert({ e.first, inbox_it != bus.second._inboxes.end() ? inbox_it->second : inbox_def_t{} });
+		}
+		clock_periods.push_back({ bus.first, bus.second._period_ms });
+		clock_count++;
+	}
+
+	//	Real-time clocks have threads of their own, the worker threads only run the others.
+	const auto real_time_clock_count = std::count_if(clock_periods.begin(), clock_periods.end(), [](const std::pair<std::string, double>& e){ return e.second > 0.0; });
+	std::vector<int> process_clocks;
+	std::vector<inbox_def_t> process_inboxes;
+	for(const auto& t: runtime._process_infos){
+		runtime._process_ids.insert({ t.first, static_cast<int>(process_clocks.size()) });
+		process_clocks.push_back(clock_by_process.at(t.first));
+		process_inboxes.push_back(inbox_by_process.at(t.first));
+	}
+
 
 	struct my_interpreter_handler_t : public runtime_handler_i {
 		my_interpreter_handler_t(llvm_process_runtime_t& runtime) : _runtime(runtime) {}
 
-		virtual void on_send(const std::string& process_id, const json_t& message){
-			const auto it = std::find_if(_runtime._processes.begin(), _runtime._processes.end(), [&](const std::shared_ptr<llvm_process_t>& process){ return process->_name_key == process_id; });
-			if(it != _runtime._processes.end()){
-				const auto process_index = it - _runtime._processes.begin();
-				send_message(_runtime, static_cast<int>(process_index), message);
+		virtual void on_send(const std::string& process_id, const process_message_t& message){
+			const auto it = _runtime._process_ids.find(process_id);
+			if(it != _runtime._process_ids.end()){
+				_runtime._scheduler->send_message(it->second, message);
+			}
+		}
+
+		virtual int64_t get_process_handle(const std::string& process_id){
+			const auto it = _runtime._process_ids.find(process_id);
+			return it != _runtime._process_ids.end() ? it->second : -1;
+		}
+
+		//	Like on_send(), a message to a process that doesn't exist is dropped.
+		virtual void on_send_to_handle(int64_t process_handle, const process_message_t& message){
+			if(process_handle >= 0 && process_handle < static_cast<int64_t>(_runtime._process_ids.size())){
+				_runtime._scheduler->send_message(static_cast<int>(process_handle), message);
+			}
+		}
+
+		virtual void on_post(const std::string& process_id, const process_message_t& message, std::chrono::steady_clock::time_point time){
+			const auto it = _runtime._process_ids.find(process_id);
+			if(it != _runtime._process_ids.end()){
+				_runtime._scheduler->post_message(it->second, message, time);
 			}
 		}
 
@@ -2739,32 +2874,42 @@ static std::map<std::string, value_t> run_container_int(llvm_ir_program_t& progr
 		process->_init_function = std::make_shared<llvm_bind_t>(bind_function2(*runtime.ee, t.second + "__init"));
 		process->_process_function = std::make_shared<llvm_bind_t>(bind_function2(*runtime.ee, t.second));
 
+		QUARK_ASSERT(runtime._process_ids.at(t.first) == runtime._processes.size());
 		runtime._processes.push_back(process);
 	}
 
-	//	Remember that current thread (main) is also a thread, no need to create a worker thread for one process.
-	runtime._processes[0]->_thread_id = runtime._main_thread_id;
-
-	for(int process_id = 1 ; process_id < runtime._processes.size() ; process_id++){
-		runtime._worker_threads.push_back(std::thread([&](int process_id){
-
-//			const auto native_thread = thread::native_handle();
-
-			std::stringstream thread_name;
-			thread_name << std::string() << "process " << process_id << " thread";
-#ifdef __APPLE__
-			pthread_setname_np(/*pthread_self(),*/ thread_name.str().c_str());
-#endif
-
-			run_process(runtime, process_id);
-		}, process_id));
+	runtime._scheduler = std::make_shared<process_scheduler_t>(
+		process_clocks,
+		runtime,
+		process_scheduler_t::get_default_thread_count(clock_count - static_cast<int>(real_time_clock_count))
+	);
+	for(int process_id = 0 ; process_id < process_inboxes.size() ; process_id++){
+		runtime._scheduler->set_inbox_def(process_id, process_inboxes[process_id]);
 	}
+	for(int clock_id = 0 ; clock_id < clock_periods.size() ; clock_id++){
+		if(clock_periods[clock_id].second > 0.0){
+			const auto period = std::chrono::duration<double, std::milli>(clock_periods[clock_id].second);
+			runtime._scheduler->set_clock_period(clock_id, std::chrono::duration_cast<std::chrono::nanoseconds>(period));
+		}
+	}
+	runtime._scheduler->run();
 
-	run_process(runtime, 0);
-
-	for(auto &t: runtime._worker_threads){
-		t.join();
+	for(int process_id = 0 ; process_id < runtime._processes.size() ; process_id++){
+		const auto stats = runtime._scheduler->get_inbox_stats(process_id);
+		QUARK_TRACE_SS("Inbox of " << runtime._processes[process_id]->_name_key << ": high-water mark " << stats._high_water << ", dropped " << stats._dropped);
+	}
+	for(int clock_id = 0 ; clock_id < clock_periods.size() ; clock_id++){
+		if(clock_periods[clock_id].second > 0.0){
+			const auto stats = runtime._scheduler->get_clock_stats(clock_id);
+			QUARK_TRACE_SS("Clock " << clock_periods[clock_id].first << ": " << stats._tick_count << " ticks"
+				<< ", deadline misses " << stats._deadline_misses
+				<< ", skipped ticks " << stats._skipped_ticks
+				<< ", jitter mean " << stats._jitter_mean.count() << " ns, max " << stats._jitter_max.count() << " ns"
+				<< ", execution mean " << stats._execution_mean.count() << " ns, max " << stats._execution_max.count() << " ns"
+			);
+		}
 	}
+	runtime.release_process_states();
 
 	call_floyd_runtime_deinit(ee);
 
@@ -2773,225 +2918,205 @@ static std::map<std::string, value_t> run_container_int(llvm_ir_program_t& progr
 
 
 
-std::map<std::string, value_t> run_llvm_container(llvm_ir_program_t& program_breaks, const std::vector<std::string>& main_args, const std::string& container_key){
-	if(container_key.empty()){
-		// ??? instance is already known via program_breaks.
-		llvm_execution_engine_t ee = make_engine_run_init(*program_breaks.instance, program_breaks);
-
-		const auto main_function = bind_function(ee, "main");
-		if(main_function.first != nullptr){
-			const auto main_result_int = llvm_call_main(ee, main_function, main_args);
-			const auto result = value_t::make_int(main_result_int);
+////////////////////////////////		NATIVE EXECUTABLES
 
-			call_floyd_runtime_deinit(ee);
 
-			detect_leaks(ee.heap);
-
-			return {{ "main()", result }};
-		}
-		else{
-			call_floyd_runtime_deinit(ee);
-			return {{ "global", value_t::make_void() }};
-		}
-	}
-	else{
-		return run_container_int(program_breaks, main_args, container_key);
+/*
+	{
+		"types": [ [ "itype", type ], ... ],
+		"type_infos": [ [ is_rc, struct_size, [ member_offset, ... ] ], ... ],
+		"function_defs": [ [ def_name, function_id, function_type, args ], ... ],
+		"vector_backend": "carray"
 	}
-}
 
+	Only Floyd functions are kept, without their bodies: the runtime only needs their types. itypes are strings, JSON
+	numbers are doubles and print with too few digits. type_infos has one entry per type, same order. The compiler
+	works them out from the target's data layout, so the runtime doesn't need one.
+*/
+json_t make_native_program_json(const type_interner_t& types, const std::vector<runtime_type_info_t>& type_infos, const std::vector<function_def_t>& function_defs, vector_backend vectors){
+	QUARK_ASSERT(type_infos.size() == types.interned.size());
 
+	std::vector<json_t> types2;
+	for(const auto& e: types.interned){
+		types2.push_back(json_t::make_array({ std::to_string(e.first.itype), typeid_to_ast_json(e.second, json_tags::k_tag_resolve_state) }));
+	}
 
+	std::vector<json_t> type_infos2;
+	for(const auto& e: type_infos){
+		std::vector<json_t> member_offsets;
+		for(const auto offset: e.member_offsets){
+			member_offsets.push_back(static_cast<double>(offset));
+		}
+		type_infos2.push_back(json_t::make_array({ json_t(e.is_rc), static_cast<double>(e.struct_size), json_t::make_array(member_offsets) }));
+	}
 
-#if DEBUG && 1
-//	Verify that all global functions can be accessed. If *one* is unresolved, then all return NULL!?
-void check_nulls(llvm_execution_engine_t& ee2, const llvm_ir_program_t& p){
-	int index = 0;
-	for(const auto& e: p.debug_globals._symbols){
-		if(e.second.get_type().is_function()){
-			const auto global_var = (FLOYD_RUNTIME_HOST_FUNCTION*)floyd::get_global_ptr(ee2, e.first);
-			QUARK_ASSERT(global_var != nullptr);
+	std::vector<json_t> function_defs2;
+	for(const auto& e: function_defs){
+		if(e.floyd_function_id >= 0){
+			function_defs2.push_back(json_t::make_array({
+				e.def_name,
+				static_cast<double>(e.floyd_function_id),
+				typeid_to_ast_json(e.floyd_fundef._function_type, json_tags::k_tag_resolve_state),
+				members_to_json(e.floyd_fundef._args)
+			}));
+		}
+	}
 
-			const auto f = *global_var;
-//				QUARK_ASSERT(f != nullptr);
+	return json_t::make_object({
+		{ "types", json_t::make_array(types2) },
+		{ "type_infos", json_t::make_array(type_infos2) },
+		{ "function_defs", json_t::make_array(function_defs2) },
+		{ "vector_backend", vector_backend_to_string(vectors) }
+	});
+}
 
-			const std::string suffix = f == nullptr ? " NULL POINTER" : "";
-//			const uint64_t addr = reinterpret_cast<uint64_t>(f);
-//			QUARK_TRACE_SS(index << " " << e.first << " " << addr << suffix);
+//	Interning the types in the same order gives them the same itypes as when the program was compiled.
+type_interner_t native_json_to_types(const json_t& types){
+	type_interner_t result;
+	for(const auto& e: types.get_array()){
+		const auto itype = std::stoi(e.get_array_n(0).get_string());
+		const auto type = typeid_from_ast_json(e.get_array_n(1));
+		const auto interned = intern_type(result, type);
+		if(interned.first.itype != itype){
+			quark::throw_runtime_error("Native executable has types the runtime can't recreate.");
 		}
-		else{
+	}
+	return result;
+}
+
+std::vector<runtime_type_info_t> native_json_to_type_infos(const json_t& type_infos){
+	std::vector<runtime_type_info_t> result;
+	for(const auto& e: type_infos.get_array()){
+		std::vector<size_t> member_offsets;
+		for(const auto& offset: e.get_array_n(2).get_array()){
+			member_offsets.push_back(static_cast<size_t>(offset.get_number()));
 		}
-		index++;
+		result.push_back(runtime_type_info_t{ e.get_array_n(0).is_true(), static_cast<size_t>(e.get_array_n(1).get_number()), member_offsets });
 	}
+	return result;
 }
-#endif
 
-static std::map<std::string, void*> register_c_functions(llvm::LLVMContext& context, const llvm_type_interner_t& interner){
-	const auto runtime_functions = get_runtime_functions(context, interner);
+QUARK_UNIT_TEST("", "native_json_to_type_infos()", "struct", "same type infos back"){
+	type_interner_t types;
+	const auto s = typeid_t::make_struct2({ member_t(typeid_t::make_int(), "a"), member_t(typeid_t::make_string(), "b") });
+	intern_type(types, s);
 
-	std::map<std::string, void*> runtime_functions_map;
-	for(const auto& e: runtime_functions){
-		const auto e2 = std::pair<std::string, void*>(e.name_key, e.implementation_f);
-		runtime_functions_map.insert(e2);
-	}
-	const auto host_functions_map = get_host_functions_map2();
+	std::vector<runtime_type_info_t> type_infos(types.interned.size(), runtime_type_info_t{ false, 0, {} });
+	type_infos.back() = runtime_type_info_t{ true, 16, { 0, 8 } };
 
-	std::map<std::string, void*> function_map = runtime_functions_map;
-	function_map.insert(host_functions_map.begin(), host_functions_map.end());
+	const auto program = make_native_program_json(types, type_infos, {}, vector_backend::k_carray);
+	const auto result = native_json_to_type_infos(program.get_object_element("type_infos"));
+	QUARK_UT_VERIFY(result.size() == type_infos.size());
+	QUARK_UT_VERIFY(result.back().is_rc == true);
+	QUARK_UT_VERIFY(result.back().struct_size == 16);
+	QUARK_UT_VERIFY(result.back().member_offsets == (std::vector<size_t>{ 0, 8 }));
+	QUARK_UT_VERIFY(result.front().is_rc == false);
+}
 
-	return function_map;
+vector_backend native_json_to_vector_backend(const json_t& program){
+	const auto s = program.get_optional_object_element("vector_backend", json_t("carray"));
+	return parse_vector_backend(s.get_string());
 }
 
+std::vector<function_def_t> native_json_to_function_defs(const json_t& function_defs){
+	std::vector<function_def_t> result;
+	for(const auto& e: function_defs.get_array()){
+		const auto def_name = e.get_array_n(0).get_string();
+		const auto function_id = static_cast<function_id_t>(e.get_array_n(1).get_number());
+		const auto function_type = typeid_from_ast_json(e.get_array_n(2));
+		const auto args = members_from_json(e.get_array_n(3));
+		const auto def = function_definition_t::make_host_func(k_no_location, def_name, function_type, args, function_id);
+		result.push_back(function_def_t{ def_name, nullptr, function_id, def });
+	}
+	return result;
+}
 
-//??? Move init functions to runtime source file.
-//	Destroys program, can only run it once!
-static llvm_execution_engine_t make_engine_no_init(llvm_instance_t& instance, llvm_ir_program_t& program_breaks){
-	QUARK_ASSERT(instance.check_invariant());
-	QUARK_ASSERT(program_breaks.check_invariant());
+struct native_symbols_t : public symbol_resolver_i {
+	virtual void* get_global_ptr(const std::string& name){
+		const auto it = symbols.find(name);
+		return it != symbols.end() ? it->second : nullptr;
+	}
+	virtual void* get_global_function(const std::string& name){
+		return get_global_ptr(name);
+	}
 
-	std::string collectedErrors;
+	std::unordered_map<std::string, void*> symbols;
+};
 
-	//	WARNING: Destroys p -- uses std::move().
-	llvm::ExecutionEngine* exeEng = llvm::EngineBuilder(std::move(program_breaks.module))
-		.setErrorStr(&collectedErrors)
-		.setOptLevel(llvm::CodeGenOpt::Level::None)
-		.setVerifyModules(true)
-		.setEngineKind(llvm::EngineKind::JIT)
-		.create();
+int64_t run_native_program(const native_program_image_t& image, const std::vector<std::string>& main_args){
+	const auto program = parse_json(seq_t(image.program_json)).first;
 
-	if (exeEng == nullptr){
-		std::string error = "Unable to construct execution engine: " + collectedErrors;
-		perror(error.c_str());
-		throw std::exception();
+	const auto function_map = register_c_functions();
+	for(int64_t i = 0 ; i < image.host_function_count ; i++){
+		const auto it = function_map.find(image.host_function_names[i]);
+		if(it == function_map.end()){
+			quark::throw_runtime_error(std::string() + "Native executable calls unknown runtime function \"" + image.host_function_names[i] + "\".");
+		}
+		image.host_functions[i] = it->second;
 	}
-	QUARK_ASSERT(collectedErrors.empty());
 
-	const auto start_time = std::chrono::high_resolution_clock::now();
+	auto symbols = std::make_shared<native_symbols_t>();
+	for(int64_t i = 0 ; i < image.symbol_count ; i++){
+		symbols->symbols.insert({ image.symbol_names[i], image.symbol_addresses[i] });
+	}
 
-	auto ee1 = std::shared_ptr<llvm::ExecutionEngine>(exeEng);
-	auto ee2 = llvm_execution_engine_t{
+	auto ee = llvm_execution_engine_t{
 		k_debug_magic,
-		&instance,
-		ee1,
-		program_breaks.type_interner,
-		program_breaks.debug_globals,
-		program_breaks.function_defs,
+		symbols,
+		native_json_to_types(program.get_object_element("types")),
+		native_json_to_vector_backend(program),
+		symbol_table_t{},
+		native_json_to_function_defs(program.get_object_element("function_defs")),
 		{},
 		nullptr,
-		start_time
+		std::chrono::high_resolution_clock::now(),
+		{},
+		native_json_to_type_infos(program.get_object_element("type_infos"))
 	};
-	QUARK_ASSERT(ee2.check_invariant());
-
-	auto function_map = register_c_functions(instance.context, program_breaks.type_interner);
-
-	//	Resolve all unresolved functions.
-	{
-		//	https://stackoverflow.com/questions/33328562/add-mapping-to-c-lambda-from-llvm
-		auto lambda = [&](const std::string& s) -> void* {
-			QUARK_ASSERT(s.empty() == false);
-			QUARK_ASSERT(s[0] == '_');
-			const auto s2 = s.substr(1);
-
-			const auto it = function_map.find(s2);
-			if(it != function_map.end()){
-				return it->second;
-			}
-			else{
-			}
-
-			return nullptr;
-		};
-		std::function<void*(const std::string&)> on_lazy_function_creator2 = lambda;
+	QUARK_ASSERT(ee.check_invariant());
 
-		//	NOTICE! Patch during finalizeObject() only, then restore!
-		ee2.ee->InstallLazyFunctionCreator(on_lazy_function_creator2);
-		ee2.ee->finalizeObject();
-		ee2.ee->InstallLazyFunctionCreator(nullptr);
+	const auto init_result = call_floyd_runtime_init(ee);
+	QUARK_ASSERT(init_result == 667);
 
-	//	ee2.ee->DisableGVCompilation(false);
-	//	ee2.ee->DisableSymbolSearching(false);
+	const auto main_function = bind_function(ee, "main");
+	if(main_function.first != nullptr){
+		const auto main_result_int = llvm_call_main(ee, main_function, main_args);
+		call_floyd_runtime_deinit(ee);
+		detect_leaks(ee.heap);
+		return main_result_int;
+	}
+	else{
+		call_floyd_runtime_deinit(ee);
+		return 0;
 	}
-
-#if DEBUG
-	check_nulls(ee2, program_breaks);
-#endif
-
-//	llvm::WriteBitcodeToFile(exeEng->getVerifyModules(), raw_ostream &Out);
-	return ee2;
 }
 
-//	Destroys program, can only run it once!
-//	Automatically runs floyd_runtime_init() to execute Floyd's global functions and initialize global constants.
-llvm_execution_engine_t make_engine_run_init(llvm_instance_t& instance, llvm_ir_program_t& program_breaks){
-	QUARK_ASSERT(instance.check_invariant());
-	QUARK_ASSERT(program_breaks.check_invariant());
-
-	llvm_execution_engine_t ee = make_engine_no_init(instance, program_breaks);
-
-	trace_heap(ee.heap);
-
-#if DEBUG
-	{
-		const auto print_global_ptr = (FLOYD_RUNTIME_HOST_FUNCTION*)floyd::get_global_ptr(ee, "print");
-		QUARK_ASSERT(print_global_ptr != nullptr);
-
-		const auto print_f = *print_global_ptr;
-		QUARK_ASSERT(print_f != nullptr);
-		if(print_f){
-
-//			(*print_f)(&ee, 109);
-		}
+extern "C" int floyd_native_main(int argc, const char* argv[], const native_program_image_t* image){
+	try{
+		const std::vector<std::string> main_args(argv + 1, argv + argc);
+		return static_cast<int>(run_native_program(*image, main_args));
 	}
-
-	{
-		auto a_func = reinterpret_cast<FLOYD_RUNTIME_INIT>(get_global_function(ee, "floyd_runtime_init"));
-		QUARK_ASSERT(a_func != nullptr);
+	catch(const std::runtime_error& e){
+		std::cout << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	catch(...){
+		std::cout << "Error" << std::endl;
+		return EXIT_FAILURE;
 	}
-#endif
-
-	const auto init_result = call_floyd_runtime_init(ee);
-	QUARK_ASSERT(init_result == 667);
-
-//	check_nulls(ee, program_breaks);
-
-	trace_heap(ee.heap);
-
-	return ee;
 }
 
-}	//	namespace floyd
-
-
-
-////////////////////////////////		TESTS
-
-
-
-QUARK_UNIT_TEST("", "From source: Check that floyd_runtime_init() runs and sets 'result' global", "", ""){
-	const auto cu = floyd::make_compilation_unit_nolib("let int result = 1 + 2 + 3", "myfile.floyd");
-	const auto pass3 = compile_to_sematic_ast__errors(cu);
 
-	floyd::llvm_instance_t instance;
-	auto program = generate_llvm_ir_program(instance, pass3, "myfile.floyd");
-	auto ee = make_engine_run_init(instance, *program);
 
-	const auto result = *static_cast<uint64_t*>(floyd::get_global_ptr(ee, "result"));
-	QUARK_ASSERT(result == 6);
+std::map<std::string, void*> register_c_functions(){
+	const auto host_functions_map = get_host_functions_map2();
 
-	call_floyd_runtime_deinit(ee);
+	std::map<std::string, void*> function_map = get_runtime_functions_map();
+	function_map.insert(host_functions_map.begin(), host_functions_map.end());
 
-//	QUARK_TRACE_SS("result = " << floyd::print_program(*program));
+	return function_map;
 }
 
-//	BROKEN!
-QUARK_UNIT_TEST("", "From JSON: Simple function call, call print() from floyd_runtime_init()", "", ""){
-	const auto cu = floyd::make_compilation_unit_nolib("print(5)", "myfile.floyd");
-	const auto pass3 = compile_to_sematic_ast__errors(cu);
-
-	floyd::llvm_instance_t instance;
-	auto program = generate_llvm_ir_program(instance, pass3, "myfile.floyd");
-	auto ee = make_engine_run_init(instance, *program);
-	QUARK_ASSERT(ee._print_output == std::vector<std::string>{"5"});
-	call_floyd_runtime_deinit(ee);
-}
 
 
+}	//	namespace floyd
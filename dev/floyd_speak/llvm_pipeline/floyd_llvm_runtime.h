@@ -9,39 +9,31 @@
 #ifndef floyd_llvm_runtime_hpp
 #define floyd_llvm_runtime_hpp
 
+/*
+	The runtime the generated code calls into: runtime functions, host functions, processes and the heap. It doesn't
+	use LLVM -- native executables link with it as the floyd_runtime library. Making a JIT execution engine is in
+	floyd_llvm_jit.h.
+*/
+
 #include "ast_value.h"
-#include "floyd_llvm_helpers.h"
+#include "floyd_llvm_heap.h"
 #include "ast.h"
 
-#include <llvm/IR/LLVMContext.h>
-#include <llvm/IR/Module.h>
-#include <llvm/IR/Function.h>
-#include <llvm/IR/Verifier.h>
-
 #include <string>
 #include <vector>
+#include <map>
+#include <chrono>
+#include <unordered_map>
 
 namespace llvm {
-	struct ExecutionEngine;
+	class Function;
 }
 
 namespace floyd {
 
-	struct llvm_ir_program_t;
 	struct runtime_handler_i;
 
 
-////////////////////////////////		host_func_t
-
-
-struct host_func_t {
-	std::string name_key;
-	llvm::FunctionType* function_type;
-	void* implementation_f;
-};
-
-
-
 ////////////////////////////////		function_def_t
 
 
@@ -59,16 +51,41 @@ struct function_def_t {
 
 
 
+////////////////////////////////		runtime_type_info_t
+
+
+//	What the runtime needs to know about a type to make, copy and release its values. Worked out once for each
+//	interned type when the program is compiled, instead of on every call. The runtime has no data layout of its own:
+//	the JIT passes the type infos to the execution engine and native executables have them in their program JSON.
+struct runtime_type_info_t {
+	bool is_rc;
+
+	//	Structs: the size of the struct's data and where each member is, from the data layout.
+	size_t struct_size;
+	std::vector<size_t> member_offsets;
+};
+
+
+
 ////////////////////////////////		llvm_execution_engine_t
 
 
 //https://en.wikipedia.org/wiki/Hexspeak
 const uint64_t k_debug_magic = 0xFACEFEED05050505;
 
+//	Finds the program's globals and functions by name. The JIT asks its LLVM execution engine, native executables
+//	look in the table compile_native put in the executable.
+struct symbol_resolver_i {
+	virtual ~symbol_resolver_i(){};
+	virtual void* get_global_ptr(const std::string& name) = 0;
+	virtual void* get_global_function(const std::string& name) = 0;
+};
+
 struct llvm_execution_engine_t {
 	bool check_invariant() const {
-		QUARK_ASSERT(ee);
+		QUARK_ASSERT(symbols);
 		QUARK_ASSERT(heap.check_invariant());
+		QUARK_ASSERT(type_infos.size() == type_interner.interned.size());
 		return true;
 	}
 
@@ -78,9 +95,9 @@ struct llvm_execution_engine_t {
 	//	Must be first member, checked by LLVM code.
 	uint64_t debug_magic;
 
-	llvm_instance_t* instance;
-	std::shared_ptr<llvm::ExecutionEngine> ee;
-	llvm_type_interner_t type_interner;
+	std::shared_ptr<symbol_resolver_i> symbols;
+	type_interner_t type_interner;
+	vector_backend vectors;
 	symbol_table_t global_symbols;
 	std::vector<function_def_t> function_defs;
 	public: std::vector<std::string> _print_output;
@@ -89,8 +106,13 @@ struct llvm_execution_engine_t {
 
 	public: const std::chrono::time_point<std::chrono::high_resolution_clock> _start_time;
 	public: heap_t heap;
+
+	//	One entry per type in type_interner.interned, same order. See runtime_type_info_t.
+	public: std::vector<runtime_type_info_t> type_infos;
 };
 
+const runtime_type_info_t& lookup_type_info(const llvm_execution_engine_t& runtime, const typeid_t& type);
+
 
 typedef int64_t (*FLOYD_RUNTIME_INIT)(floyd_runtime_t* frp);
 typedef int64_t (*FLOYD_RUNTIME_DEINIT)(floyd_runtime_t* frp);
@@ -120,6 +142,9 @@ typedef runtime_value_t (*FLOYD_RUNTIME_PROCESS_INIT)(floyd_runtime_t* frp);
 //		func my_gui_state_t my_gui(my_gui_state_t state, json_value message) impure{
 typedef runtime_value_t (*FLOYD_RUNTIME_PROCESS_MESSAGE)(floyd_runtime_t* frp, runtime_value_t state, runtime_value_t message);
 
+//		func my_gui_state_t my_gui(my_gui_state_t state, double message) impure{
+typedef runtime_value_t (*FLOYD_RUNTIME_PROCESS_MESSAGE_DOUBLE)(floyd_runtime_t* frp, runtime_value_t state, double message);
+
 
 
 
@@ -153,16 +178,63 @@ llvm_bind_t bind_function2(llvm_execution_engine_t& ee, const std::string& name)
 
 int64_t llvm_call_main(llvm_execution_engine_t& ee, const std::pair<void*, typeid_t>& f, const std::vector<std::string>& main_args);
 
-std::vector<host_func_t> get_runtime_functions(llvm::LLVMContext& context, const llvm_type_interner_t& interner);
+//	The runtime functions the generated code calls to allocate, dispose and look up values, by their name in the
+//	module. get_runtime_functions() in floyd_llvm_jit.h has their LLVM signatures.
+std::map<std::string, void*> get_runtime_functions_map();
 std::map<std::string, void*> get_host_functions_map2();
 
+//	All C functions the generated code calls: runtime functions and host functions, by their name in the module.
+std::map<std::string, void*> register_c_functions();
+
 uint64_t call_floyd_runtime_init(llvm_execution_engine_t& ee);
 uint64_t call_floyd_runtime_deinit(llvm_execution_engine_t& ee);
 
+//	Runs the container's processes until they are done, then floyd_runtime_deinit(). floyd_runtime_init() must
+//	already have run.
+std::map<std::string, value_t> run_container(llvm_execution_engine_t& ee, const container_t& container);
+
+
+
+////////////////////////////////		NATIVE EXECUTABLES
+
+
+/*
+	An executable made by "floyd compile_native" has no JIT and no LLVM module at runtime. This is what the runtime
+	needs to know about the program instead. compile_native emits it as constant data in the executable and
+	floyd_native_main() gets a pointer to it. Field order and sizes must match make_native_image() in
+	floyd_llvm_native.cpp.
+*/
+struct native_program_image_t {
+	//	JSON: interned types, their type infos and Floyd function definitions.
+	const char* program_json;
+
+	//	The generated code calls runtime and host functions through this table. floyd_native_main() fills it in.
+	int64_t host_function_count;
+	const char* const* host_function_names;
+	void** host_functions;
+
+	//	Addresses of the program's globals and functions, by their Floyd names.
+	int64_t symbol_count;
+	const char* const* symbol_names;
+	void* const* symbol_addresses;
+};
+
+//	The JSON in native_program_image_t::program_json. The JIT cache stores it next to the cached machine code.
+json_t make_native_program_json(const type_interner_t& types, const std::vector<runtime_type_info_t>& type_infos, const std::vector<function_def_t>& function_defs, vector_backend vectors);
+type_interner_t native_json_to_types(const json_t& types);
+std::vector<runtime_type_info_t> native_json_to_type_infos(const json_t& type_infos);
+
+//	k_carray if the JSON doesn't say.
+vector_backend native_json_to_vector_backend(const json_t& program);
+
+//	The function_defs have no llvm_f.
+std::vector<function_def_t> native_json_to_function_defs(const json_t& function_defs);
 
-llvm_execution_engine_t make_engine_run_init(llvm_instance_t& instance, llvm_ir_program_t& program);
+//	Runs floyd_runtime_init(), main() if the program has one, then floyd_runtime_deinit(). Returns main()'s result.
+int64_t run_native_program(const native_program_image_t& image, const std::vector<std::string>& main_args);
 
-std::map<std::string, value_t> run_llvm_container(llvm_ir_program_t& program_breaks, const std::vector<std::string>& main_args, const std::string& container_key);
+//	The C main() of a native executable calls this.
+extern "C" int floyd_native_main(int argc, const char* argv[], const native_program_image_t* image);
 
 
 }	//	namespace floyd
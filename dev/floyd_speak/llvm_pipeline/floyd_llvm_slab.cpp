@@ -0,0 +1,591 @@
+//
+//  floyd_llvm_slab.cpp
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-07-24.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#include "floyd_llvm_slab.h"
+
+#include "quark.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <algorithm>
+#include <cstdlib>
+#include <sys/mman.h>
+
+namespace floyd {
+
+
+//	16 bytes apart for the small blocks: most STRUCT_T and short strings are the header plus one to a few words.
+static const size_t k_block_sizes[k_slab_class_count] = {
+	64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512, 640, 768, 896,
+	1024, 1280, 1536, 2048, 3072, 4096, 6144, 8192
+};
+
+static const size_t k_max_block_size = k_block_sizes[k_slab_class_count - 1];
+
+static const uint64_t k_slab_magic = 0x51ab51ab51ab51ab;
+
+//	Size class for each multiple of 16 bytes, up to k_max_block_size.
+struct size_class_table_t {
+	size_class_table_t(){
+		int size_class = 0;
+		for(size_t i = 0 ; i <= k_max_block_size / 16 ; i++){
+			while(k_block_sizes[size_class] < i * 16){
+				size_class++;
+			}
+			classes[i] = static_cast<uint8_t>(size_class);
+		}
+	}
+
+	uint8_t classes[k_max_block_size / 16 + 1];
+};
+
+static const size_class_table_t k_size_class_table;
+
+static int size_to_class(size_t size){
+	QUARK_ASSERT(size <= k_max_block_size);
+
+	return k_size_class_table.classes[(size + 15) / 16];
+}
+
+size_t get_slab_block_size(size_t size){
+	return size <= k_max_block_size ? k_block_sizes[size_to_class(size)] : 0;
+}
+
+
+
+//////////////////////////////////////		slab_t
+
+
+
+struct free_block_t {
+	free_block_t* next;
+};
+
+struct slab_thread_cache_t;
+
+//	Sits first in its k_slab_size-aligned slab, so the slab of a block is its address rounded down.
+struct slab_t {
+	uint64_t magic;
+	std::atomic<slab_thread_cache_t*> owner;
+	int size_class;
+	size_t block_size;
+	uint32_t capacity;
+
+	//	Everything below is only touched by the owner thread, except remote_free.
+	uint32_t used;
+	free_block_t* free_list;
+
+	//	Blocks at and after bump have never been used: we don't build a free list for the whole slab up front.
+	char* bump;
+	char* end;
+
+	slab_t* prev;
+	slab_t* next;
+	bool in_full_list;
+
+	//	Blocks freed by other threads.
+	std::atomic<free_block_t*> remote_free;
+};
+
+static const size_t k_slab_header_size = (sizeof(slab_t) + 63) & ~size_t(63);
+
+static slab_t* get_slab(void* block){
+	auto slab = reinterpret_cast<slab_t*>(reinterpret_cast<uintptr_t>(block) & ~uintptr_t(k_slab_size - 1));
+	QUARK_ASSERT(slab->magic == k_slab_magic);
+	return slab;
+}
+
+//	mmap() has no alignment parameter: map twice the size and unmap what sticks out on each side.
+static slab_t* map_slab(int size_class){
+	auto p = mmap(nullptr, k_slab_size * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(p == MAP_FAILED){
+		throw std::bad_alloc();
+	}
+	const auto start = reinterpret_cast<uintptr_t>(p);
+	const auto aligned = (start + k_slab_size - 1) & ~uintptr_t(k_slab_size - 1);
+	if(aligned > start){
+		munmap(p, aligned - start);
+	}
+	const auto tail = start + k_slab_size * 2 - (aligned + k_slab_size);
+	if(tail > 0){
+		munmap(reinterpret_cast<void*>(aligned + k_slab_size), tail);
+	}
+
+	auto slab = new (reinterpret_cast<void*>(aligned)) slab_t();
+	slab->magic = k_slab_magic;
+	slab->owner = nullptr;
+	slab->size_class = size_class;
+	slab->block_size = k_block_sizes[size_class];
+	slab->capacity = static_cast<uint32_t>((k_slab_size - k_slab_header_size) / slab->block_size);
+	slab->used = 0;
+	slab->free_list = nullptr;
+	slab->bump = reinterpret_cast<char*>(aligned) + k_slab_header_size;
+	slab->end = slab->bump + slab->capacity * slab->block_size;
+	slab->prev = nullptr;
+	slab->next = nullptr;
+	slab->in_full_list = false;
+	slab->remote_free = nullptr;
+	return slab;
+}
+
+static void unmap_slab(slab_t* slab){
+	QUARK_ASSERT(slab->used == 0);
+
+	slab->magic = 0;
+	munmap(slab, k_slab_size);
+}
+
+//	Takes back the blocks other threads have freed. Owner thread only.
+static void collect_remote_frees(slab_t& slab){
+	auto list = slab.remote_free.exchange(nullptr, std::memory_order_acquire);
+	while(list != nullptr){
+		const auto next = list->next;
+		list->next = slab.free_list;
+		slab.free_list = list;
+		QUARK_ASSERT(slab.used > 0);
+		slab.used--;
+		list = next;
+	}
+}
+
+static bool has_free_block(const slab_t& slab){
+	return slab.free_list != nullptr || slab.bump < slab.end;
+}
+
+
+
+//////////////////////////////////////		GLOBALS
+
+
+
+struct class_counters_t {
+	std::atomic<uint64_t> alloc_count { 0 };
+	std::atomic<uint64_t> free_count { 0 };
+};
+
+//	Only ever created, never destroyed: threads can free blocks during static destruction.
+struct slab_globals_t {
+	std::mutex mutex;
+
+	//	Protected by mutex.
+	std::vector<slab_thread_cache_t*> caches;
+	std::vector<slab_t*> abandoned[k_slab_class_count];
+	uint64_t exited_alloc_counts[k_slab_class_count + 1] = {};
+	uint64_t exited_free_counts[k_slab_class_count + 1] = {};
+
+	std::atomic<uint64_t> slab_counts[k_slab_class_count] = {};
+	std::atomic<uint64_t> returned_slab_counts[k_slab_class_count] = {};
+};
+
+static slab_globals_t& get_globals(){
+	static auto globals = new slab_globals_t();
+	return *globals;
+}
+
+
+
+//////////////////////////////////////		slab_thread_cache_t
+
+
+
+struct slab_class_lists_t {
+	//	Slabs that had a free block last time we looked.
+	slab_t* available = nullptr;
+
+	//	Slabs that were full. Other threads may have freed blocks in them since.
+	slab_t* full = nullptr;
+
+	int empty_count = 0;
+};
+
+static void unlink_slab(slab_t*& list, slab_t* slab){
+	if(slab->prev != nullptr){
+		slab->prev->next = slab->next;
+	}
+	else{
+		QUARK_ASSERT(list == slab);
+		list = slab->next;
+	}
+	if(slab->next != nullptr){
+		slab->next->prev = slab->prev;
+	}
+	slab->prev = nullptr;
+	slab->next = nullptr;
+}
+
+static void push_slab(slab_t*& list, slab_t* slab){
+	QUARK_ASSERT(slab->prev == nullptr && slab->next == nullptr);
+
+	slab->next = list;
+	if(list != nullptr){
+		list->prev = slab;
+	}
+	list = slab;
+}
+
+struct slab_thread_cache_t {
+	slab_thread_cache_t(){
+		auto& g = get_globals();
+		std::lock_guard<std::mutex> guard(g.mutex);
+		g.caches.push_back(this);
+	}
+
+	~slab_thread_cache_t(){
+		auto& g = get_globals();
+		std::lock_guard<std::mutex> guard(g.mutex);
+
+		for(int size_class = 0 ; size_class < k_slab_class_count ; size_class++){
+			auto& lists = classes[size_class];
+			for(auto list: { lists.available, lists.full }){
+				auto slab = list;
+				while(slab != nullptr){
+					const auto next = slab->next;
+					slab->prev = nullptr;
+					slab->next = nullptr;
+					slab->in_full_list = false;
+
+					collect_remote_frees(*slab);
+					if(slab->used == 0){
+						release_slab(slab);
+					}
+					else{
+						slab->owner = nullptr;
+						g.abandoned[size_class].push_back(slab);
+					}
+					slab = next;
+				}
+			}
+		}
+
+		for(int i = 0 ; i < k_slab_class_count + 1 ; i++){
+			g.exited_alloc_counts[i] += counters[i].alloc_count;
+			g.exited_free_counts[i] += counters[i].free_count;
+		}
+		g.caches.erase(std::find(g.caches.begin(), g.caches.end(), this));
+	}
+
+	void release_slab(slab_t* slab){
+		auto& g = get_globals();
+		g.slab_counts[slab->size_class]--;
+		g.returned_slab_counts[slab->size_class]++;
+		unmap_slab(slab);
+	}
+
+	slab_t* adopt_or_map_slab(int size_class){
+		auto& g = get_globals();
+		slab_t* slab = nullptr;
+		{
+			std::lock_guard<std::mutex> guard(g.mutex);
+			auto& abandoned = g.abandoned[size_class];
+			if(abandoned.empty() == false){
+				slab = abandoned.back();
+				abandoned.pop_back();
+			}
+		}
+
+		if(slab != nullptr){
+			slab->owner = this;
+			take_back_remote_frees(slab);
+		}
+		else{
+			slab = map_slab(size_class);
+			g.slab_counts[size_class]++;
+			slab->owner = this;
+			classes[size_class].empty_count++;
+		}
+		return slab;
+	}
+
+	void take_back_remote_frees(slab_t* slab){
+		const auto was_used = slab->used > 0;
+		collect_remote_frees(*slab);
+		if(was_used && slab->used == 0){
+			classes[slab->size_class].empty_count++;
+		}
+	}
+
+	//	Finds a slab with a free block and puts it first in available.
+	slab_t* find_slab(int size_class){
+		auto& lists = classes[size_class];
+
+		while(lists.available != nullptr){
+			auto slab = lists.available;
+			if(has_free_block(*slab)){
+				return slab;
+			}
+			take_back_remote_frees(slab);
+			if(has_free_block(*slab)){
+				return slab;
+			}
+			unlink_slab(lists.available, slab);
+			push_slab(lists.full, slab);
+			slab->in_full_list = true;
+		}
+
+		//	Before getting a new slab, take back blocks other threads have freed.
+		auto slab = lists.full;
+		while(slab != nullptr){
+			const auto next = slab->next;
+			if(slab->remote_free.load(std::memory_order_relaxed) != nullptr){
+				take_back_remote_frees(slab);
+				unlink_slab(lists.full, slab);
+				push_slab(lists.available, slab);
+				slab->in_full_list = false;
+			}
+			slab = next;
+		}
+		if(lists.available != nullptr){
+			return lists.available;
+		}
+
+		auto slab2 = adopt_or_map_slab(size_class);
+		push_slab(lists.available, slab2);
+		return slab2;
+	}
+
+	void* alloc_block(int size_class){
+		auto slab = find_slab(size_class);
+		QUARK_ASSERT(has_free_block(*slab));
+
+		void* result = nullptr;
+		if(slab->free_list != nullptr){
+			result = slab->free_list;
+			slab->free_list = slab->free_list->next;
+		}
+		else{
+			result = slab->bump;
+			slab->bump += slab->block_size;
+		}
+
+		if(slab->used == 0){
+			classes[size_class].empty_count--;
+		}
+		slab->used++;
+		count(counters[size_class].alloc_count);
+		return result;
+	}
+
+	void free_own_block(slab_t* slab, void* p){
+		auto block = reinterpret_cast<free_block_t*>(p);
+		block->next = slab->free_list;
+		slab->free_list = block;
+		QUARK_ASSERT(slab->used > 0);
+		slab->used--;
+
+		auto& lists = classes[slab->size_class];
+		if(slab->in_full_list){
+			unlink_slab(lists.full, slab);
+			push_slab(lists.available, slab);
+			slab->in_full_list = false;
+		}
+
+		//	Keep one empty slab so a thread going up and down around a slab boundary doesn't map and unmap all the time.
+		if(slab->used == 0){
+			if(lists.empty_count > 0){
+				unlink_slab(lists.available, slab);
+				release_slab(slab);
+			}
+			else{
+				lists.empty_count++;
+			}
+		}
+	}
+
+	//	Only this thread writes the counter, so no need for an atomic add.
+	static void count(std::atomic<uint64_t>& counter){
+		counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+
+	////////////////////////////////		STATE
+
+	slab_class_lists_t classes[k_slab_class_count];
+
+	//	Written only by this thread, read by get_slab_stats().
+	class_counters_t counters[k_slab_class_count + 1];
+};
+
+//	Plain pointers, so they still work while other thread_local and static objects are destroyed.
+static thread_local slab_thread_cache_t* tl_cache = nullptr;
+static thread_local bool tl_cache_deleted = false;
+
+struct thread_cache_deleter_t {
+	~thread_cache_deleter_t(){
+		delete tl_cache;
+		tl_cache = nullptr;
+		tl_cache_deleted = true;
+	}
+};
+
+static slab_thread_cache_t& get_thread_cache(){
+	if(tl_cache == nullptr){
+		tl_cache = new slab_thread_cache_t();
+
+		//	Allocating after the thread's cache was deleted (during exit) makes a new cache we never delete.
+		if(tl_cache_deleted == false){
+			static thread_local thread_cache_deleter_t deleter;
+			(void)deleter;
+		}
+	}
+	return *tl_cache;
+}
+
+
+
+//////////////////////////////////////		API
+
+
+
+void* slab_alloc(size_t size){
+	auto& cache = get_thread_cache();
+	if(size > k_max_block_size){
+		void* p = std::malloc(size);
+		if(p == nullptr){
+			throw std::bad_alloc();
+		}
+		slab_thread_cache_t::count(cache.counters[k_slab_class_count].alloc_count);
+		return p;
+	}
+	return cache.alloc_block(size_to_class(size));
+}
+
+void slab_free(void* p, size_t size){
+	QUARK_ASSERT(p != nullptr);
+
+	auto& cache = get_thread_cache();
+	if(size > k_max_block_size){
+		slab_thread_cache_t::count(cache.counters[k_slab_class_count].free_count);
+		std::free(p);
+		return;
+	}
+
+	auto slab = get_slab(p);
+	QUARK_ASSERT(slab->size_class == size_to_class(size));
+
+	slab_thread_cache_t::count(cache.counters[slab->size_class].free_count);
+	if(slab->owner.load(std::memory_order_relaxed) == &cache){
+		cache.free_own_block(slab, p);
+	}
+	else{
+		auto block = reinterpret_cast<free_block_t*>(p);
+		block->next = slab->remote_free.load(std::memory_order_relaxed);
+		while(slab->remote_free.compare_exchange_weak(block->next, block, std::memory_order_release, std::memory_order_relaxed) == false){
+		}
+	}
+}
+
+std::vector<slab_class_stats_t> get_slab_stats(){
+	auto& g = get_globals();
+	std::lock_guard<std::mutex> guard(g.mutex);
+
+	std::vector<slab_class_stats_t> result;
+	for(int i = 0 ; i < k_slab_class_count + 1 ; i++){
+		const bool slab_class = i < k_slab_class_count;
+		slab_class_stats_t stats {
+			slab_class ? k_block_sizes[i] : 0,
+			g.exited_alloc_counts[i],
+			g.exited_free_counts[i],
+			slab_class ? g.slab_counts[i].load() : 0,
+			slab_class ? g.returned_slab_counts[i].load() : 0
+		};
+		for(const auto& cache: g.caches){
+			stats.alloc_count += cache->counters[i].alloc_count.load(std::memory_order_relaxed);
+			stats.free_count += cache->counters[i].free_count.load(std::memory_order_relaxed);
+		}
+		result.push_back(stats);
+	}
+	return result;
+}
+
+
+}	//	floyd
+
+
+
+////////////////////////////////		TESTS
+
+
+
+QUARK_UNIT_TEST("", "get_slab_block_size()", "", ""){
+	QUARK_UT_VERIFY(floyd::get_slab_block_size(1) == 64);
+	QUARK_UT_VERIFY(floyd::get_slab_block_size(64) == 64);
+	QUARK_UT_VERIFY(floyd::get_slab_block_size(65) == 80);
+	QUARK_UT_VERIFY(floyd::get_slab_block_size(64 + 24) == 96);
+	QUARK_UT_VERIFY(floyd::get_slab_block_size(450) == 512);
+	QUARK_UT_VERIFY(floyd::get_slab_block_size(8192) == 8192);
+	QUARK_UT_VERIFY(floyd::get_slab_block_size(8193) == 0);
+}
+
+QUARK_UNIT_TEST("", "slab_alloc()", "blocks don't overlap", ""){
+	std::vector<uint64_t*> blocks;
+	for(uint64_t i = 0 ; i < 5000 ; i++){
+		auto p = reinterpret_cast<uint64_t*>(floyd::slab_alloc(72));
+		QUARK_UT_VERIFY((reinterpret_cast<uintptr_t>(p) & 15) == 0);
+		p[0] = i;
+		p[8] = i;
+		blocks.push_back(p);
+	}
+	for(uint64_t i = 0 ; i < 5000 ; i++){
+		QUARK_UT_VERIFY(blocks[i][0] == i && blocks[i][8] == i);
+		floyd::slab_free(blocks[i], 72);
+	}
+}
+
+static floyd::slab_class_stats_t get_class_stats(size_t size){
+	const auto block_size = floyd::get_slab_block_size(size);
+	for(const auto& e: floyd::get_slab_stats()){
+		if(e.block_size == block_size){
+			return e;
+		}
+	}
+	QUARK_ASSERT(false);
+	throw std::exception();
+}
+
+QUARK_UNIT_TEST("", "slab_free()", "empty slabs go back to the OS", ""){
+	const auto returned_count = [](){ return get_class_stats(150).returned_slab_count; };
+	const auto before = returned_count();
+
+	//	160 byte blocks: several slabs' worth.
+	std::vector<void*> blocks;
+	for(int i = 0 ; i < 2000 ; i++){
+		blocks.push_back(floyd::slab_alloc(150));
+	}
+	for(auto e: blocks){
+		floyd::slab_free(e, 150);
+	}
+	QUARK_UT_VERIFY(returned_count() > before);
+}
+
+QUARK_UNIT_TEST("", "slab_free()", "free on another thread", ""){
+	const auto before = get_class_stats(100);
+	const auto malloc_before = get_class_stats(20000);
+
+	std::vector<void*> blocks;
+	std::thread producer([&](){
+		for(int i = 0 ; i < 3000 ; i++){
+			blocks.push_back(floyd::slab_alloc(i < 1500 ? 100 : 20000));
+		}
+	});
+	producer.join();
+
+	for(int i = 0 ; i < 3000 ; i++){
+		floyd::slab_free(blocks[i], i < 1500 ? 100 : 20000);
+	}
+
+	//	The producer thread has exited, its slabs were abandoned. We can still allocate and free in that size class.
+	auto p = floyd::slab_alloc(100);
+	floyd::slab_free(p, 100);
+
+	const auto after = get_class_stats(100);
+	const auto malloc_after = get_class_stats(20000);
+	QUARK_UT_VERIFY(after.alloc_count - before.alloc_count == 1501);
+	QUARK_UT_VERIFY(after.free_count - before.free_count == 1501);
+	QUARK_UT_VERIFY(malloc_after.alloc_count - malloc_before.alloc_count == 1500);
+}
@@ -0,0 +1,69 @@
+//
+//  floyd_llvm_slab.h
+//  floyd_speak
+//
+//  Created by Marcus Zetterquist on 2019-07-24.
+//  Copyright © 2019 Marcus Zetterquist. All rights reserved.
+//
+
+#ifndef floyd_llvm_slab_hpp
+#define floyd_llvm_slab_hpp
+
+/*
+	Memory for heap_t: fixed size blocks carved out of 64 KB slabs. All blocks in a slab have the same size class.
+
+	The blocks are the 64 byte heap_alloc_64_t header plus N words that VEC_T, DICT_T, JSON_T and STRUCT_T use. The
+	size classes go from 64 bytes to 8 KB, 16 bytes apart at the small end. Bigger blocks go straight to malloc().
+
+	- Each thread has its own slabs. Allocating and freeing a block from your own slab takes no lock and no atomic
+		operation.
+	- A block freed by another thread is pushed onto a lock-free list in its slab. The owning thread takes them back
+		when it runs out of free blocks.
+	- A slab where all blocks are free is given back to the OS (munmap), except one spare per size class and thread.
+	- When a thread exits, its slabs that are still in use are left for the next thread that needs that size class.
+
+	You must free a block with the same size you allocated it with: the size picks the size class.
+*/
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace floyd {
+
+
+static const size_t k_slab_size = 64 * 1024;
+
+//	Index k_slab_class_count in get_slab_stats() is for blocks too big for a slab, using malloc().
+static const int k_slab_class_count = 24;
+
+
+struct slab_class_stats_t {
+	//	0 = the malloc() blocks.
+	size_t block_size;
+
+	uint64_t alloc_count;
+	uint64_t free_count;
+
+	//	Slabs we have now and how many we have given back to the OS. Always 0 for the malloc() blocks.
+	uint64_t slab_count;
+	uint64_t returned_slab_count;
+};
+
+//	Throws if out of memory. Never returns nullptr. Blocks are 16 byte aligned.
+void* slab_alloc(size_t size);
+
+//	Any thread can free a block. size must be the same as when the block was allocated.
+void slab_free(void* p, size_t size);
+
+//	Size of the block you get for this size. 0 = too big for a slab, uses malloc().
+size_t get_slab_block_size(size_t size);
+
+//	One entry per size class, then one for the malloc() blocks. Counts are for all threads, including threads that
+//	have exited. Other threads keep allocating while you read, so the counts may not add up exactly.
+std::vector<slab_class_stats_t> get_slab_stats();
+
+
+}	//	floyd
+
+#endif /* floyd_llvm_slab_hpp */
@@ -308,10 +308,9 @@ std::string get_process_path (int process_id){
 		return std::string(pathbuf);
 	}
 #else
-     pid_t pid; int ret;
-	 char pathbuf[512]; /* /proc/<pid>/exe */
-	 snprintf(pathbuf, sizeof(pathbuf), "/proc/%i/exe", pid);
-	 return std::string(pathbuf);
+	char pathbuf[512]; /* /proc/<pid>/exe */
+	snprintf(pathbuf, sizeof(pathbuf), "/proc/%i/exe", process_id);
+	return std::string(pathbuf);
 #endif
 }
 
@@ -1118,7 +1117,7 @@ Non-option argument -
 
 
 
-command_line_args_t parse_command_line_args(const std::vector<std::string>& args, const std::string& flags){
+command_line_args_t parse_command_line_args(const std::vector<std::string>& args, const std::string& flags, const std::vector<std::string>& long_flags){
 	if(args.size() == 0){
 		return {};
 	}
@@ -1147,6 +1146,20 @@ command_line_args_t parse_command_line_args(const std::vector<std::string>& args
 
 	std::map<std::string, std::string> flags2;
 
+	//	getopt_long() returns k_long_flag_base + index for long flags. Names must outlive the getopt_long() calls.
+	const int k_long_flag_base = 256;
+	std::vector<std::string> long_names;
+	std::vector<option> long_options;
+	for(const auto& e: long_flags){
+		QUARK_ASSERT(e.empty() == false);
+		long_names.push_back(e.back() == ':' ? e.substr(0, e.size() - 1) : e);
+	}
+	for(int i = 0 ; i < long_flags.size() ; i++){
+		const auto has_arg = long_flags[i].back() == ':' ? required_argument : no_argument;
+		long_options.push_back(option{ long_names[i].c_str(), has_arg, nullptr, k_long_flag_base + i });
+	}
+	long_options.push_back(option{ nullptr, 0, nullptr, 0 });
+
 	//	The variable optind is the index of the next element to be processed in argv. The system
 	//	initializes this value to 1. The caller can reset it to 1 to restart scanning of the same argv,
 	//	or when scanning a new argument vector.
@@ -1159,8 +1172,8 @@ command_line_args_t parse_command_line_args(const std::vector<std::string>& args
     // string so that program can
     //distinguish between '?' and ':'
     int opt = 0;
-    while((opt = getopt(argc, &argv[0], flags.c_str())) != -1){
-		const auto opt_string = std::string(1, opt);
+    while((opt = getopt_long(argc, &argv[0], flags.c_str(), &long_options[0], nullptr)) != -1){
+		const auto opt_string = opt >= k_long_flag_base ? long_names[opt - k_long_flag_base] : std::string(1, opt);
 		const auto optarg_string = optarg != nullptr ? std::string(optarg) : std::string();
 		const auto optopt_string = std::string(1, optopt);
 
@@ -1197,8 +1210,8 @@ command_line_args_t parse_command_line_args(const std::vector<std::string>& args
 	return { args[0], "", flags2, extras };
 }
 
-command_line_args_t parse_command_line_args_subcommands(const std::vector<std::string>& args, const std::string& flags){
-	const auto a = parse_command_line_args({ args.begin() + 1, args.end()}, flags);
+command_line_args_t parse_command_line_args_subcommands(const std::vector<std::string>& args, const std::string& flags, const std::vector<std::string>& long_flags){
+	const auto a = parse_command_line_args({ args.begin() + 1, args.end()}, flags, long_flags);
 	return { args[0], a.command, a.flags, a.extra_arguments };
 }
 
@@ -1356,6 +1369,14 @@ QUARK_UNIT_TEST("", "parse_command_line_args()", "", ""){
 	QUARK_UT_VERIFY((result.extra_arguments == std::vector<std::string>{ "extra_one", "extra_two" }));
 }
 
+QUARK_UNIT_TEST("", "parse_command_line_args()", "long flags", ""){
+	const auto result = parse_command_line_args({ "myapp", "-i", "--cache-dir", "/tmp/cache", "--no-cache", "extra_one" }, ":if:lrx", { "cache-dir:", "no-cache" });
+	QUARK_UT_VERIFY(result.flags.find("i")->second == "");
+	QUARK_UT_VERIFY(result.flags.find("cache-dir")->second == "/tmp/cache");
+	QUARK_UT_VERIFY(result.flags.find("no-cache")->second == "");
+	QUARK_UT_VERIFY((result.extra_arguments == std::vector<std::string>{ "extra_one" }));
+}
+
 
 
 QUARK_UNIT_TEST("", "parse_command_line_args_subcommands()", "", ""){
@@ -82,6 +82,9 @@ struct process_info_t {
 };
 process_info_t get_process_info();
 
+//	Path to the executable of an OS process. On Linux this is the /proc/<pid>/exe link, which stat() follows.
+std::string get_process_path(int process_id);
+
 std::string get_working_dir();
 
 
@@ -207,11 +210,12 @@ std::string MakeAbsolutePath(const std::string& base, const std::string& relativ
 std::vector<std::string> args_to_vector(int argc, const char * argv[]);
 
 //	Flags: x: means x supports parameter.
+//	Long flags: "cache-dir:" means --cache-dir supports parameter.
 struct command_line_args_t {
 	std::string command;
 	std::string subcommand;
 
-	//	Key: flag character, value: parameter or ""
+	//	Key: flag character or long flag name, value: parameter or ""
 	std::map<std::string, std::string> flags;
 
 
@@ -219,7 +223,7 @@ struct command_line_args_t {
 	std::vector<std::string> extra_arguments;
 };
 
-command_line_args_t parse_command_line_args(const std::vector<std::string>& args, const std::string& flags);
+command_line_args_t parse_command_line_args(const std::vector<std::string>& args, const std::string& flags, const std::vector<std::string>& long_flags = {});
 
 /*
 	git commit -m "Commit message"
@@ -230,6 +234,6 @@ command_line_args_t parse_command_line_args(const std::vector<std::string>& args
 		extra_arguments
 			"Commit message"
 */
-command_line_args_t parse_command_line_args_subcommands(const std::vector<std::string>& args, const std::string& flags);
+command_line_args_t parse_command_line_args_subcommands(const std::vector<std::string>& args, const std::string& flags, const std::vector<std::string>& long_flags = {});
 
 std::string read_text_file(const std::string& abs_path);
@@ -16,6 +16,7 @@
 #include "json_support.h"
 #include "floyd_runtime.h"
 #include "floyd_filelib.h"
+#include "floyd_simd.h"
 
 #include "text_parser.h"
 #include "pass2.h"
@@ -70,6 +71,10 @@ struct analyzer_imm_t {
 struct lexical_scope_t {
 	symbol_table_t symbols;
 	epure pure;
+
+	//	Immutable symbols bound to a function definition: symbol index -> function id.
+	//	Lets the analyser look at the function a symbol refers to, for example to spot simple reduce() reducers.
+	std::map<int, function_id_t> function_binds;
 };
 
 struct analyser_t {
@@ -742,6 +747,11 @@ std::pair<analyser_t, statement_t> analyse_bind_local_statement(const analyser_t
 			//	Replace the temporary symbol with the real function defintion.
 			const auto symbol2 = mutable_flag ? symbol_t::make_mutable(lhs_type2) : symbol_t::make_immutable(lhs_type2);
 			a_acc._lexical_scope_stack.back().symbols._symbols[local_name_index] = { new_local_name, symbol2 };
+
+			const auto literal_ptr = std::get_if<expression_t::literal_exp_t>(&rhs_expr_pair.second._expression_variant);
+			if(mutable_flag == false && literal_ptr != nullptr && literal_ptr->value.is_function()){
+				a_acc._lexical_scope_stack.back().function_binds[(int)local_name_index] = literal_ptr->value.get_function_value();
+			}
 			resolve_type(a_acc, s.location, rhs_expr_pair.second.get_output_type());
 
 			return {
@@ -1506,14 +1516,172 @@ std::pair<analyser_t, expression_t> analyse_corecall_filter_expression(const ana
 	};
 }
 
+//	Returns the function definition that expression e refers to, if it can be known at compile time.
+static const function_definition_t* find_static_function_def(const analyser_t& a, const expression_t& e){
+	if(const auto literal_ptr = std::get_if<expression_t::literal_exp_t>(&e._expression_variant)){
+		if(literal_ptr->value.is_function()){
+			return &function_id_to_def(a, literal_ptr->value.get_function_value());
+		}
+	}
+	else if(const auto load_ptr = std::get_if<expression_t::load2_t>(&e._expression_variant)){
+		const auto& address = load_ptr->address;
+		const auto env_index = address._parent_steps == -1 ? 0 : a._lexical_scope_stack.size() - address._parent_steps - 1;
+		const auto& binds = a._lexical_scope_stack[env_index].function_binds;
+		const auto it = binds.find(address._index);
+		if(it != binds.end()){
+			return &function_id_to_def(a, it->second);
+		}
+	}
+	return nullptr;
+}
+
+//	Returns the index of the function argument that e reads, or -1.
+static int get_loaded_arg_index(const function_definition_t& def, const body_t& body, const expression_t& e){
+	const auto load_ptr = std::get_if<expression_t::load2_t>(&e._expression_variant);
+	if(load_ptr == nullptr || load_ptr->address._parent_steps != 0){
+		return -1;
+	}
+	const auto& name = body._symbol_table._symbols[load_ptr->address._index].first;
+	for(int i = 0 ; i < def._args.size() ; i++){
+		if(def._args[i]._name == name){
+			return i;
+		}
+	}
+	return -1;
+}
+
+static expression_type flip_comparison(expression_type op){
+	if(op == expression_type::k_comparison_smaller__2){
+		return expression_type::k_comparison_larger__2;
+	}
+	else if(op == expression_type::k_comparison_smaller_or_equal__2){
+		return expression_type::k_comparison_larger_or_equal__2;
+	}
+	else if(op == expression_type::k_comparison_larger__2){
+		return expression_type::k_comparison_smaller__2;
+	}
+	else if(op == expression_type::k_comparison_larger_or_equal__2){
+		return expression_type::k_comparison_smaller_or_equal__2;
+	}
+	else{
+		return op;
+	}
+}
+
+//	Matches "return acc OP e ? acc : e" and its variants. Normalizes to compare the kept value on the left side.
+static reduce_kernel detect_select_kernel(const function_definition_t& def, const body_t& body, const expression_t::conditional_t& cond){
+	const auto compare_ptr = std::get_if<expression_t::comparison_t>(&cond.condition->_expression_variant);
+	if(compare_ptr == nullptr){
+		return reduce_kernel::k_none;
+	}
+	const auto lhs = get_loaded_arg_index(def, body, *compare_ptr->lhs);
+	const auto rhs = get_loaded_arg_index(def, body, *compare_ptr->rhs);
+	const auto a = get_loaded_arg_index(def, body, *cond.a);
+	const auto b = get_loaded_arg_index(def, body, *cond.b);
+	if(lhs == -1 || rhs == -1 || lhs == rhs || a == -1 || b == -1 || a == b){
+		return reduce_kernel::k_none;
+	}
+
+	//	"x OP y ? y : x" is the same as "y flip(OP) x ? y : x".
+	const auto kept = a;
+	const auto op = lhs == kept ? compare_ptr->op : flip_comparison(compare_ptr->op);
+
+	const bool keep_acc = kept == 0;
+	if(op == expression_type::k_comparison_smaller__2){
+		return keep_acc ? reduce_kernel::k_keep_acc_if_smaller : reduce_kernel::k_keep_e_if_smaller;
+	}
+	else if(op == expression_type::k_comparison_smaller_or_equal__2){
+		return keep_acc ? reduce_kernel::k_keep_acc_if_smaller_or_equal : reduce_kernel::k_keep_e_if_smaller_or_equal;
+	}
+	else if(op == expression_type::k_comparison_larger__2){
+		return keep_acc ? reduce_kernel::k_keep_acc_if_larger : reduce_kernel::k_keep_e_if_larger;
+	}
+	else if(op == expression_type::k_comparison_larger_or_equal__2){
+		return keep_acc ? reduce_kernel::k_keep_acc_if_larger_or_equal : reduce_kernel::k_keep_e_if_larger_or_equal;
+	}
+	else{
+		return reduce_kernel::k_none;
+	}
+}
+
+/*
+	Looks for reducer functions that are a single return statement the runtime has a kernel for:
+
+		return acc + e
+		return acc * e
+		return acc + 1
+		return acc < e ? acc : e		(and the other min / max forms)
+
+	Operands of + and * can be in any order. Only for int and double, count works for any element type.
+*/
+static reduce_kernel detect_reduce_kernel(const analyser_t& a, const expression_t& f, const typeid_t& r_type, const typeid_t& e_type){
+	const auto def_ptr = find_static_function_def(a, f);
+	if(def_ptr == nullptr || def_ptr->_args.size() != 2){
+		return reduce_kernel::k_none;
+	}
+	const auto floyd_func_ptr = std::get_if<function_definition_t::floyd_func_t>(&def_ptr->_contents);
+	if(floyd_func_ptr == nullptr || floyd_func_ptr->_body->_statements.size() != 1){
+		return reduce_kernel::k_none;
+	}
+	const auto& body = *floyd_func_ptr->_body;
+	const auto return_ptr = std::get_if<statement_t::return_statement_t>(&body._statements[0]._contents);
+	if(return_ptr == nullptr){
+		return reduce_kernel::k_none;
+	}
+	const auto& e = return_ptr->_expression;
+
+	if(r_type.is_int() || r_type.is_double()){
+		if(const auto arithmetic_ptr = std::get_if<expression_t::arithmetic_t>(&e._expression_variant)){
+			const auto lhs = get_loaded_arg_index(*def_ptr, body, *arithmetic_ptr->lhs);
+			const auto rhs = get_loaded_arg_index(*def_ptr, body, *arithmetic_ptr->rhs);
+
+			if(r_type == e_type && ((lhs == 0 && rhs == 1) || (lhs == 1 && rhs == 0))){
+				if(arithmetic_ptr->op == expression_type::k_arithmetic_add__2){
+					return reduce_kernel::k_sum;
+				}
+				else if(arithmetic_ptr->op == expression_type::k_arithmetic_multiply__2){
+					return reduce_kernel::k_product;
+				}
+			}
+
+			const auto rhs_literal_ptr = std::get_if<expression_t::literal_exp_t>(&arithmetic_ptr->rhs->_expression_variant);
+			if(
+				r_type.is_int()
+				&& lhs == 0
+				&& arithmetic_ptr->op == expression_type::k_arithmetic_add__2
+				&& rhs_literal_ptr != nullptr
+				&& rhs_literal_ptr->value.is_int()
+				&& rhs_literal_ptr->value.get_int_value() == 1
+			){
+				return reduce_kernel::k_count;
+			}
+		}
+		else if(const auto cond_ptr = std::get_if<expression_t::conditional_t>(&e._expression_variant)){
+			if(r_type == e_type){
+				return detect_select_kernel(*def_ptr, body, *cond_ptr);
+			}
+		}
+	}
+	return reduce_kernel::k_none;
+}
+
 //	R reduce([E], R init, R f(R accumulator, E element))
+//	Arg 4 is added by us: the reduce_kernel matching f, or k_none.
 std::pair<analyser_t, expression_t> analyse_corecall_reduce_expression(const analyser_t& a, const statement_t& parent, const std::vector<expression_t>& args){
 	QUARK_ASSERT(a.check_invariant());
 	QUARK_ASSERT(parent.check_invariant());
 
 	const auto sign = make_reduce_signature();
 	auto a_acc = a;
-	const auto resolved_call = analyze_resolve_call_type(a_acc, parent, args, sign._function_type);
+
+	//	Arg 4 is ours, so check the count before adding it.
+	if(args.size() != 3){
+		quark::throw_runtime_error("reduce() requires 3 arguments.");
+	}
+
+	//	The kernel isn't known until f has been analysed. Use a placeholder to get the arity right.
+	const auto args2 = std::vector<expression_t>{ args[0], args[1], args[2], expression_t::make_literal_int(0) };
+	const auto resolved_call = analyze_resolve_call_type(a_acc, parent, args2, sign._function_type);
 	a_acc = resolved_call.first;
 
 	const auto arg1_type = resolved_call.second.function_type.get_function_args()[0];
@@ -1530,7 +1698,8 @@ std::pair<analyser_t, expression_t> analyse_corecall_reduce_expression(const ana
 		{
 			typeid_t::make_vector(e_type),
 			r_type,
-			typeid_t::make_function(r_type, { r_type, e_type }, epure::pure)
+			typeid_t::make_function(r_type, { r_type, e_type }, epure::pure),
+			typeid_t::make_int()
 		},
 		epure::pure
 	);
@@ -1538,6 +1707,49 @@ std::pair<analyser_t, expression_t> analyse_corecall_reduce_expression(const ana
 		quark::throw_runtime_error("Call to reduce() uses signature \"" + typeid_to_compact_string(resolved_call.second.function_type) + "\", expected to be \"" + typeid_to_compact_string(expected) + "\".");
 	}
 
+	auto call_args = resolved_call.second.args;
+	const auto kernel = detect_reduce_kernel(a_acc, call_args[2], r_type, e_type);
+	call_args[3] = expression_t::make_literal_int(static_cast<int>(kernel));
+
+	return {
+		a_acc,
+		expression_t::make_corecall(get_opcode(sign), call_args, resolved_call.second.function_type.get_function_return())
+	};
+}
+
+//	[E] sort([E])
+//	[E] sort([E], bool less(E a, E b))
+//	Without a comparator we pass a bool as arg 2 -- the host function sees that it's not a function and uses natural ordering.
+std::pair<analyser_t, expression_t> analyse_corecall_sort_expression(const analyser_t& a, const statement_t& parent, const std::vector<expression_t>& args){
+	QUARK_ASSERT(a.check_invariant());
+	QUARK_ASSERT(parent.check_invariant());
+
+	const auto sign = make_sort_signature();
+	auto a_acc = a;
+
+	const bool has_less = args.size() == 2;
+	const auto args2 = args.size() == 1 ? std::vector<expression_t>{ args[0], expression_t::make_literal_bool(false) } : args;
+	const auto resolved_call = analyze_resolve_call_type(a_acc, parent, args2, sign._function_type);
+	a_acc = resolved_call.first;
+
+	const auto arg1_type = resolved_call.second.function_type.get_function_args()[0];
+	if(arg1_type.is_vector() == false){
+		quark::throw_runtime_error("sort() arg 1 must be a vector.");
+	}
+	const auto e_type = arg1_type.get_vector_element_type();
+
+	const auto expected = typeid_t::make_function(
+		typeid_t::make_vector(e_type),
+		{
+			typeid_t::make_vector(e_type),
+			has_less ? typeid_t::make_function(typeid_t::make_bool(), { e_type, e_type }, epure::pure) : typeid_t::make_bool()
+		},
+		epure::pure
+	);
+	if(resolved_call.second.function_type != expected){
+		quark::throw_runtime_error("Call to sort() uses signature \"" + typeid_to_compact_string(resolved_call.second.function_type) + "\", expected to be \"" + typeid_to_compact_string(expected) + "\".");
+	}
+
 	return {
 		a_acc,
 		expression_t::make_corecall(get_opcode(sign), resolved_call.second.args, resolved_call.second.function_type.get_function_return())
@@ -2248,6 +2460,9 @@ std::pair<analyser_t, expression_t> analyse_call_expression(const analyser_t& a0
 				else if(found_symbol_ptr->first == make_supermap_signature().name){
 					return analyse_corecall_supermap_expression(a_acc, parent, details.args);
 				}
+				else if(found_symbol_ptr->first == make_sort_signature().name){
+					return analyse_corecall_sort_expression(a_acc, parent, details.args);
+				}
 
 				else if(found_symbol_ptr->first == make_print_signature().name){
 					return analyse_corecall_fallthrough_expression(a_acc, parent, details.args, make_print_signature());
@@ -2255,6 +2470,18 @@ std::pair<analyser_t, expression_t> analyse_call_expression(const analyser_t& a0
 				else if(found_symbol_ptr->first == make_send_signature().name){
 					return analyse_corecall_fallthrough_expression(a_acc, parent, details.args, make_send_signature());
 				}
+				else if(found_symbol_ptr->first == make_get_process_handle_signature().name){
+					return analyse_corecall_fallthrough_expression(a_acc, parent, details.args, make_get_process_handle_signature());
+				}
+				else if(found_symbol_ptr->first == make_send_to_handle_signature().name){
+					return analyse_corecall_fallthrough_expression(a_acc, parent, details.args, make_send_to_handle_signature());
+				}
+				else if(found_symbol_ptr->first == make_post_at_time_signature().name){
+					return analyse_corecall_fallthrough_expression(a_acc, parent, details.args, make_post_at_time_signature());
+				}
+				else if(found_symbol_ptr->first == make_post_after_signature().name){
+					return analyse_corecall_fallthrough_expression(a_acc, parent, details.args, make_post_after_signature());
+				}
 
 				else{
 				}
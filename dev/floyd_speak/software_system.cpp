@@ -26,16 +26,66 @@ vector<person_t> unpack_persons(const json_t& persons_obj){
 }
 
 
+inbox_overflow_t unpack_inbox_overflow(const std::string& s){
+	if(s == "block"){
+		return inbox_overflow_t::k_block;
+	}
+	else if(s == "drop_oldest"){
+		return inbox_overflow_t::k_drop_oldest;
+	}
+	else if(s == "coalesce"){
+		return inbox_overflow_t::k_coalesce;
+	}
+	else{
+		quark::throw_runtime_error("Unknown inbox overflow \"" + s + "\", use \"block\", \"drop_oldest\" or \"coalesce\".");
+	}
+}
+
+/*
+	A process is either just the name of its process-function:
+		"a": "my_gui"
+	or an object that also limits its inbox:
+		"a": { "func": "my_gui", "inbox_capacity": 100, "inbox_overflow": "drop_oldest" }
+
+	A bus with a "period_ms" number is a real-time clock:
+		"audio": { "period_ms": 2.9, "synth": "my_synth" }
+*/
 clock_bus_t unpack_clock_bus(const json_t& clock_bus_obj){
 	std::map<std::string, std::string> processes;
+	std::map<std::string, inbox_def_t> inboxes;
+	double period_ms = 0.0;
 
 	const auto processes_map = clock_bus_obj.get_object();
 	for(const auto& process_pair: processes_map){
 		const auto name_key = process_pair.first;
-		const auto process_function_key = process_pair.second.get_string();
-		processes.insert({name_key, process_function_key} );
+		if(name_key == "period_ms" && process_pair.second.is_number()){
+			period_ms = process_pair.second.get_number();
+			if(period_ms <= 0.0){
+				quark::throw_runtime_error("period_ms of clock bus must be more than 0.");
+			}
+		}
+		else if(process_pair.second.is_object()){
+			const auto& process_obj = process_pair.second;
+			processes.insert({name_key, process_obj.get_object_element("func").get_string()} );
+
+			inbox_def_t inbox;
+			if(process_obj.does_object_element_exist("inbox_capacity")){
+				inbox._capacity = static_cast<int>(process_obj.get_object_element("inbox_capacity").get_number());
+				if(inbox._capacity < 0){
+					quark::throw_runtime_error("inbox_capacity of process \"" + name_key + "\" must be 0 or more.");
+				}
+			}
+			if(process_obj.does_object_element_exist("inbox_overflow")){
+				inbox._overflow = unpack_inbox_overflow(process_obj.get_object_element("inbox_overflow").get_string());
+			}
+			inboxes.insert({name_key, inbox});
+		}
+		else{
+			const auto process_function_key = process_pair.second.get_string();
+			processes.insert({name_key, process_function_key} );
+		}
 	}
-	return clock_bus_t{._processes = processes};
+	return clock_bus_t{._processes = processes, ._inboxes = inboxes, ._period_ms = period_ms};
 }
 
 std::map<std::string, clock_bus_t> unpack_clock_busses(const json_t& clocks_obj){
@@ -31,9 +31,33 @@ struct connection_t {
 	std::string _tech_desc;
 };
 
+enum class inbox_overflow_t {
+	//	send() waits until the receiver has made room.
+	k_block,
+
+	//	The oldest waiting message is dropped to make room.
+	k_drop_oldest,
+
+	//	The new message replaces the newest waiting message. Good for messages that carry the latest state.
+	k_coalesce
+};
+
+struct inbox_def_t {
+	//	Max number of waiting messages. 0 means unbounded.
+	int _capacity = 0;
+	inbox_overflow_t _overflow = inbox_overflow_t::k_block;
+};
+
 struct clock_bus_t {
 	//	Right now an process is the name of the process-function, will probably get more members.
 	std::map<std::string, std::string> _processes;
+
+	//	Processes without an entry have an unbounded inbox.
+	std::map<std::string, inbox_def_t> _inboxes;
+
+	//	A real-time clock: its processes run every _period_ms milliseconds on a thread of their own. 0 means the
+	//	processes only run when they have messages.
+	double _period_ms = 0.0;
 };
 
 struct container_t {
@@ -45,6 +45,9 @@ executor_mode g_executor = executor_mode::bc_interpreter;
 executor_mode g_executor = executor_mode::llvm_jit;
 #endif
 
+//	How the llvm_jit tests store [T] vectors. Set to k_hamt to run all the tests with persistent vectors.
+vector_backend g_llvm_vector_backend = vector_backend::k_carray;
+
 
 test_report_t make_result(const value_t& result){
 	return { result, 0, {}, {} };
@@ -134,7 +137,7 @@ static test_report_t run_program_llvm(const compilation_unit_t& cu, const std::v
 		llvm_instance_t llvm_instance;
 
 		const auto pass3 = compile_to_sematic_ast__errors(cu);
-		auto exe = generate_llvm_ir_program(llvm_instance, pass3, cu.source_file_path);
+		auto exe = generate_llvm_ir_program(llvm_instance, pass3, cu.source_file_path, g_llvm_vector_backend);
 
 		//	Runs global init code.
 		auto ee = make_engine_run_init(llvm_instance, *exe);
@@ -182,7 +185,7 @@ std::map<std::string, value_t> test_run_container2(const compilation_unit_t& cu,
 	}
 	else if(g_executor == executor_mode::llvm_jit){
 		llvm_instance_t llvm_instance;
-		auto program_breaks = compile_to_ir_helper(llvm_instance, cu);
+		auto program_breaks = compile_to_ir_helper(llvm_instance, cu, g_llvm_vector_backend);
 		return run_llvm_container(*program_breaks, args, container_key);
 	}
 	else{